@@ -0,0 +1,568 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxBenchmark.cpp
+**
+** Notes: Microbenchmarks of the transfer hot path kernels
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxBenchmark.h"
+#include "UwxXModemFramer.h"
+#include "UwxImageVerifier.h"
+#include "UwxMainWindow.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QVector>
+#include <QStringList>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#ifdef Q_OS_UNIX
+#include "UwxPtySimulator.h"
+#include "UwxXModemReceiver.h"
+#include <QSerialPort>
+#include <QEventLoop>
+#include <QTimer>
+#endif
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const uint8_t    nBenchmarkPadding              = 26;
+const QString    strBenchmarkModemVersion       = QString("4.4.14.0");
+const QByteArray baBenchmarkVersionResponse     = QByteArray("\r\nHL7800.4.4.14.0\r\n\r\nOK\r\n");
+const uint64_t   nBenchmarkSwarLowBytes         = 0x00ff00ff00ff00ffULL;
+const uint64_t   nBenchmarkSwarLaneSum          = 0x0001000100010001ULL;
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Result of one kernel, an operation is one block, response or image depending on the group
+typedef struct
+{
+    QString strGroup;
+    QString strName;
+    double fNsPerOp;
+    qint64 nBytesPerOp;
+    QString strError;
+} BenchmarkResultStruct;
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static volatile uint32_t nBenchmarkSink = 0;
+
+//=============================================================================
+//=============================================================================
+static uint8_t
+LegacyCalc8BitCRC(
+    char *pData,
+    uint16_t nSize
+    )
+{
+    //Checksum as calculated by the QByteArray framing path before the template framer
+    uint8_t nCRC = 0;
+    uint16_t i = 0;
+
+    pData += XModem1KSum8Framer::HeaderSize;
+    while (i < nSize)
+    {
+        nCRC += (uint8_t)*pData;
+        ++pData;
+        ++i;
+    }
+
+    return nCRC;
+}
+
+//=============================================================================
+//=============================================================================
+static uint8_t
+SwarSum8(
+    const uint8_t *pData,
+    size_t nSize
+    )
+{
+    //8-bit sum using 64-bit words split into four 16-bit lanes, the lanes are
+    //folded before they can overflow
+    uint32_t nSum = 0;
+    size_t nWordBytes = nSize & ~(size_t)(sizeof(uint64_t) - 1);
+    size_t i = 0;
+    while (i < nWordBytes)
+    {
+        uint64_t nLanes = 0;
+        size_t nFoldEnd = qMin(nWordBytes, i + BENCHMARK_SWAR_FOLD_WORDS * sizeof(uint64_t));
+        while (i < nFoldEnd)
+        {
+            uint64_t nWord;
+            memcpy(&nWord, pData + i, sizeof(nWord));
+            nLanes += (nWord & nBenchmarkSwarLowBytes) + ((nWord >> 8) & nBenchmarkSwarLowBytes);
+            i += sizeof(uint64_t);
+        }
+        //Only the low byte of each lane matters, their sum is gathered in the top lane
+        nSum += (uint32_t)(((nLanes & nBenchmarkSwarLowBytes) * nBenchmarkSwarLaneSum) >> 48);
+    }
+
+    while (i < nSize)
+    {
+        nSum += pData[i];
+        ++i;
+    }
+
+    return (uint8_t)nSum;
+}
+
+//=============================================================================
+//=============================================================================
+static uint16_t
+BitwiseCRC16(
+    const uint8_t *pData,
+    size_t nSize
+    )
+{
+    //CRC-16/XMODEM one bit at a time, the reference for the table driven version
+    uint16_t nCRC = 0;
+    size_t i = 0;
+    while (i < nSize)
+    {
+        nCRC ^= (uint16_t)(pData[i] << 8);
+        int j = 0;
+        while (j < 8)
+        {
+            nCRC = (nCRC & 0x8000) ? (uint16_t)((nCRC << 1) ^ XMODEM_CRC16_POLYNOMIAL) : (uint16_t)(nCRC << 1);
+            ++j;
+        }
+        ++i;
+    }
+
+    return nCRC;
+}
+
+//=============================================================================
+//=============================================================================
+static QString
+MainWindowVersion(
+    const QByteArray &baRecBuf
+    )
+{
+    //Version extraction as done by the main window when the module is in modem mode
+    if (baRecBuf.indexOf(baModemModel) == INDEX_NOT_FOUND)
+    {
+        return QString();
+    }
+
+    QString strFirmwareVersion = baRecBuf.mid(baRecBuf.indexOf(baModemModel)+nModemVersionCutChars, baRecBuf.indexOf(baCR, baRecBuf.indexOf(baModemModel)+baCR.length())-(baRecBuf.indexOf(baModemModel)+nModemVersionCutChars));
+    return (baRecBuf.length() >= MODEM_VERSION_MODEL_MINIMUM_SIZE && strFirmwareVersion.length() >= MODEM_VERSION_MINIMUM_SIZE ? strFirmwareVersion : QString());
+}
+
+//=============================================================================
+//=============================================================================
+static QString
+SingleSearchVersion(
+    const QByteArray &baRecBuf
+    )
+{
+    //The same extraction with one search for the model and one for the end of the line
+    int nModel = baRecBuf.indexOf(baModemModel);
+    if (nModel == INDEX_NOT_FOUND)
+    {
+        return QString();
+    }
+
+    int nEnd = baRecBuf.indexOf(baCR, nModel + baCR.length());
+    QString strFirmwareVersion = QString::fromLatin1(baRecBuf.constData() + nModel + nModemVersionCutChars, nEnd - (nModel + nModemVersionCutChars));
+    return (baRecBuf.length() >= MODEM_VERSION_MODEL_MINIMUM_SIZE && strFirmwareVersion.length() >= MODEM_VERSION_MINIMUM_SIZE ? strFirmwareVersion : QString());
+}
+
+//=============================================================================
+//=============================================================================
+static double
+TimeBlocks(
+    const std::function<void(int)> &fnBlock,
+    int nBlocks
+    )
+{
+    //Repeats passes over the image until the minimum run time is reached, returns ns per block
+    QElapsedTimer etmrRun;
+    qint64 nIterations = 0;
+    etmrRun.start();
+    while (etmrRun.elapsed() < BENCHMARK_MINIMUM_RUN_MS)
+    {
+        int i = 0;
+        while (i < nBlocks)
+        {
+            fnBlock(i);
+            ++i;
+        }
+        nIterations += nBlocks;
+    }
+
+    return (double)etmrRun.nsecsElapsed() / nIterations;
+}
+
+//=============================================================================
+//=============================================================================
+static void
+AddResult(
+    QVector<BenchmarkResultStruct> &vecResults,
+    const QString &strGroup,
+    const QString &strName,
+    double fNsPerOp,
+    qint64 nBytesPerOp,
+    const QString &strError = QString()
+    )
+{
+    BenchmarkResultStruct brsResult;
+    brsResult.strGroup = strGroup;
+    brsResult.strName = strName;
+    brsResult.fNsPerOp = fNsPerOp;
+    brsResult.nBytesPerOp = nBytesPerOp;
+    brsResult.strError = strError;
+    vecResults.append(brsResult);
+}
+
+#ifdef Q_OS_UNIX
+//=============================================================================
+//=============================================================================
+static void
+BenchmarkReceive(
+    QVector<BenchmarkResultStruct> &vecResults,
+    const QByteArray &baImage
+    )
+{
+    //Receives the image from the simulated device over a pseudo terminal, through the same serial port and receive engine as the application
+    const QString strName = QString("XModem receive over pseudo terminal, 1K/CRC16");
+    QString strError;
+    PtySimulator psSimulator;
+    if (!psSimulator.Open(&strError))
+    {
+        AddResult(vecResults, "receive", strName, 0.0, XMODEM_1K_BLOCK_SIZE, QString("Skipped, ").append(strError));
+        return;
+    }
+
+    QSerialPort spPort;
+    spPort.setPortName(psSimulator.PortName());
+    spPort.setBaudRate(QSerialPort::Baud115200);
+    spPort.setFlowControl(QSerialPort::NoFlowControl);
+    if (!spPort.open(QIODevice::ReadWrite))
+    {
+        AddResult(vecResults, "receive", strName, 0.0, XMODEM_1K_BLOCK_SIZE, QString("Skipped, unable to open ").append(psSimulator.PortName()).append(": ").append(spPort.errorString()));
+        return;
+    }
+
+    QTemporaryDir tdOutput;
+    QString strOutput = tdOutput.filePath("receive.bin");
+    XModemReceiver xrReceiver;
+    QEventLoop elWait;
+    bool bSuccess = false;
+    QString strMessage = "Timed out";
+    QObject::connect(&spPort, &QSerialPort::readyRead, [&]()
+    {
+        xrReceiver.ProcessData(spPort.readAll());
+    });
+    QObject::connect(&xrReceiver, &XModemReceiver::WriteData, [&](QByteArray baData)
+    {
+        spPort.write(baData);
+    });
+    QObject::connect(&xrReceiver, &XModemReceiver::Finished, [&](bool bFinishedSuccess, QString strFinishedMessage)
+    {
+        bSuccess = bFinishedSuccess;
+        strMessage = strFinishedMessage;
+        elWait.quit();
+    });
+    QTimer::singleShot(BENCHMARK_RECEIVE_TIMEOUT_MS, &elWait, SLOT(quit()));
+
+    QElapsedTimer etmrRun;
+    psSimulator.StartSender(baImage);
+    etmrRun.start();
+    if (!xrReceiver.Start(strOutput, baImage.length(), &strError))
+    {
+        AddResult(vecResults, "receive", strName, 0.0, XMODEM_1K_BLOCK_SIZE, QString("Skipped, ").append(strError));
+        return;
+    }
+    elWait.exec();
+    qint64 nElapsedNs = etmrRun.nsecsElapsed();
+
+    QFile fpOutput(strOutput);
+    if (bSuccess == true && (!fpOutput.open(QFile::ReadOnly) || fpOutput.readAll() != baImage))
+    {
+        bSuccess = false;
+        strMessage = "Received data does not match";
+    }
+
+    AddResult(vecResults, "receive", strName, (bSuccess == true ? (double)nElapsedNs / (baImage.length() / XMODEM_1K_BLOCK_SIZE) : 0.0), XMODEM_1K_BLOCK_SIZE, (bSuccess == true ? QString() : QString("Failed: ").append(strMessage)));
+}
+#endif
+
+//=============================================================================
+//=============================================================================
+static void
+OutputResults(
+    QTextStream &tsOutput,
+    BenchmarkFormats nFormat,
+    const QVector<BenchmarkResultStruct> &vecResults,
+    int nBlocks,
+    const QStringList &lstMismatches
+    )
+{
+    if (nFormat == BenchmarkFormatJSON)
+    {
+        //Stable keys so results from different builds can be compared by a script
+        QJsonArray jaResults;
+        foreach (const BenchmarkResultStruct &brsResult, vecResults)
+        {
+            QJsonObject joResult;
+            joResult["group"] = brsResult.strGroup;
+            joResult["name"] = brsResult.strName;
+            joResult["ns_per_op"] = brsResult.fNsPerOp;
+            joResult["bytes_per_op"] = brsResult.nBytesPerOp;
+            joResult["mib_per_s"] = (brsResult.fNsPerOp > 0.0 ? (double)brsResult.nBytesPerOp * BENCHMARK_NS_PER_S / brsResult.fNsPerOp / BENCHMARK_BYTES_PER_MIB : 0.0);
+            joResult["error"] = brsResult.strError;
+            jaResults.append(joResult);
+        }
+
+        QJsonObject joReport;
+        joReport["version"] = BENCHMARK_RESULTS_VERSION;
+        joReport["image_size"] = BENCHMARK_IMAGE_SIZE;
+        joReport["minimum_run_ms"] = BENCHMARK_MINIMUM_RUN_MS;
+        joReport["passed"] = lstMismatches.isEmpty();
+        joReport["mismatches"] = QJsonArray::fromStringList(lstMismatches);
+        joReport["results"] = jaResults;
+        tsOutput << QJsonDocument(joReport).toJson(QJsonDocument::Indented);
+        return;
+    }
+
+    tsOutput << "Kernel cost (" << nBlocks << " blocks, minimum " << BENCHMARK_MINIMUM_RUN_MS << " ms per kernel):\n";
+    QString strGroup;
+    foreach (const BenchmarkResultStruct &brsResult, vecResults)
+    {
+        if (brsResult.strGroup != strGroup)
+        {
+            strGroup = brsResult.strGroup;
+            tsOutput << "[" << strGroup << "]\n";
+        }
+
+        tsOutput << "  " << (brsResult.strName + ":").leftJustified(52);
+        if (!brsResult.strError.isEmpty())
+        {
+            tsOutput << brsResult.strError << "\n";
+            continue;
+        }
+        tsOutput << QString::number(brsResult.fNsPerOp >= BENCHMARK_NS_PER_MS ? brsResult.fNsPerOp / BENCHMARK_NS_PER_MS : brsResult.fNsPerOp, 'f', 1).append(brsResult.fNsPerOp >= BENCHMARK_NS_PER_MS ? " ms" : " ns").leftJustified(14)
+                 << QString::number((double)brsResult.nBytesPerOp * BENCHMARK_NS_PER_S / brsResult.fNsPerOp / BENCHMARK_BYTES_PER_MIB, 'f', 0) << " MiB/s\n";
+    }
+
+    if (!lstMismatches.isEmpty())
+    {
+        tsOutput << "Kernel results do not match their reference: " << lstMismatches.join(", ") << "\n";
+    }
+}
+
+//=============================================================================
+//=============================================================================
+int
+Benchmark::Run(
+    QTextStream &tsOutput,
+    BenchmarkFormats nFormat
+    )
+{
+    //Checksum, framing, response parsing and hashing kernels, each is checked
+    //against its reference before it is timed
+    QByteArray baImage(BENCHMARK_IMAGE_SIZE, 0);
+    uint32_t nSeed = BENCHMARK_SEED;
+    int i = 0;
+    while (i < baImage.size())
+    {
+        nSeed = nSeed * 1103515245 + 12345;
+        baImage[i] = (char)(nSeed >> 16);
+        ++i;
+    }
+    const int nBlocks = baImage.size() / XMODEM_1K_BLOCK_SIZE;
+    const uint8_t *pImage = reinterpret_cast<const uint8_t *>(baImage.constData());
+    QVector<BenchmarkResultStruct> vecResults;
+    QStringList lstMismatches;
+
+    //Checksums, the legacy calculation expects the packet header before the data
+    QByteArray baHeaderedImage = QByteArray(XModem1KSum8Framer::HeaderSize, 0).append(baImage);
+    i = 0;
+    while (i < nBlocks)
+    {
+        const uint8_t *pBlock = pImage + (i * XMODEM_1K_BLOCK_SIZE);
+        uint8_t nSum8 = XModemChecksumSum8::Calculate(pBlock, XMODEM_1K_BLOCK_SIZE);
+        if (LegacyCalc8BitCRC(baHeaderedImage.data() + (i * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE) != nSum8 || SwarSum8(pBlock, XMODEM_1K_BLOCK_SIZE) != nSum8)
+        {
+            lstMismatches.append(QString("sum8 block %1").arg(i));
+        }
+        if (BitwiseCRC16(pBlock, XMODEM_1K_BLOCK_SIZE) != XModemChecksumCRC16::Calculate(pBlock, XMODEM_1K_BLOCK_SIZE))
+        {
+            lstMismatches.append(QString("CRC16 block %1").arg(i));
+        }
+        ++i;
+    }
+
+    AddResult(vecResults, "checksum", "Byte loop, 8-bit accumulator, 1K", TimeBlocks([&](int nBlock)
+    {
+        nBenchmarkSink += LegacyCalc8BitCRC(baHeaderedImage.data() + (nBlock * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE);
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    AddResult(vecResults, "checksum", "Wide accumulator (framer sum8), 1K", TimeBlocks([&](int nBlock)
+    {
+        nBenchmarkSink += XModemChecksumSum8::Calculate(pImage + (nBlock * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE);
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    AddResult(vecResults, "checksum", "64-bit word lanes sum8, 1K", TimeBlocks([&](int nBlock)
+    {
+        nBenchmarkSink += SwarSum8(pImage + (nBlock * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE);
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    AddResult(vecResults, "checksum", "Bitwise CRC16, 1K", TimeBlocks([&](int nBlock)
+    {
+        nBenchmarkSink += BitwiseCRC16(pImage + (nBlock * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE);
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    AddResult(vecResults, "checksum", "Table CRC16 (framer), 1K", TimeBlocks([&](int nBlock)
+    {
+        nBenchmarkSink += XModemChecksumCRC16::Calculate(pImage + (nBlock * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE);
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    //Framing, from the original QByteArray append path to the pooled buffers the main window frames in place
+    QByteArray baPacket;
+    AddResult(vecResults, "framing", "QByteArray append, 1K/sum8", TimeBlocks([&](int nBlock)
+    {
+        baPacket.clear();
+        baPacket.append((char)XModemPacketType1024BytePacket);
+        baPacket.append((char)(nBlock + 1));
+        baPacket.append((char)(XMODEM_INVERSE - (uint8_t)(nBlock + 1)));
+        baPacket.append(baImage.mid(nBlock * XMODEM_1K_BLOCK_SIZE, XMODEM_1K_BLOCK_SIZE));
+        baPacket.append(LegacyCalc8BitCRC(baPacket.data(), baPacket.length() - XModem1KSum8Framer::HeaderSize));
+        nBenchmarkSink += (uint8_t)baPacket.at(baPacket.length() - 1);
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    XModem1KSum8Framer::Packet aPooledPackets[2];
+    AddResult(vecResults, "framing", "Pooled buffer framed in place, 1K/sum8", TimeBlocks([&](int nBlock)
+    {
+        XModem1KSum8Framer::Packet &aPacket = aPooledPackets[nBlock & 1];
+        memcpy(XModem1KSum8Framer::Payload(aPacket), pImage + (nBlock * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE);
+        XModem1KSum8Framer::FrameInPlace(aPacket, (uint8_t)(nBlock + 1), XMODEM_1K_BLOCK_SIZE, nBenchmarkPadding);
+        nBenchmarkSink += aPacket[XModem1KSum8Framer::PacketSize - 1];
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    XModem1KSum8Framer::Packet aSum8Packet;
+    AddResult(vecResults, "framing", "Template framer, 1K/sum8", TimeBlocks([&](int nBlock)
+    {
+        XModem1KSum8Framer::Frame(aSum8Packet, (uint8_t)(nBlock + 1), pImage + (nBlock * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE, nBenchmarkPadding);
+        nBenchmarkSink += aSum8Packet[XModem1KSum8Framer::PacketSize - 1];
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    XModem1KCRC16Framer::Packet aCRC16Packet;
+    AddResult(vecResults, "framing", "Template framer, 1K/CRC16", TimeBlocks([&](int nBlock)
+    {
+        XModem1KCRC16Framer::Frame(aCRC16Packet, (uint8_t)(nBlock + 1), pImage + (nBlock * XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE, nBenchmarkPadding);
+        nBenchmarkSink += aCRC16Packet[XModem1KCRC16Framer::PacketSize - 1];
+    }, nBlocks), XMODEM_1K_BLOCK_SIZE);
+
+    XModem128Sum8Framer::Packet aSmallPacket;
+    AddResult(vecResults, "framing", "Template framer, 128/sum8", TimeBlocks([&](int nBlock)
+    {
+        XModem128Sum8Framer::Frame(aSmallPacket, (uint8_t)(nBlock + 1), pImage + (nBlock * XMODEM_128_BLOCK_SIZE), XMODEM_128_BLOCK_SIZE, nBenchmarkPadding);
+        nBenchmarkSink += aSmallPacket[XModem128Sum8Framer::PacketSize - 1];
+    }, nBlocks), XMODEM_128_BLOCK_SIZE);
+
+    //Receive buffer parsing of the version response, whole and as it arrives from the port in small reads
+    if (MainWindowVersion(baBenchmarkVersionResponse) != strBenchmarkModemVersion || SingleSearchVersion(baBenchmarkVersionResponse) != strBenchmarkModemVersion)
+    {
+        lstMismatches.append("version response");
+    }
+
+    AddResult(vecResults, "parsing", "Version response, main window extraction", TimeBlocks([&](int)
+    {
+        nBenchmarkSink += MainWindowVersion(baBenchmarkVersionResponse).length();
+    }, nBlocks), baBenchmarkVersionResponse.length());
+
+    AddResult(vecResults, "parsing", "Version response, single search", TimeBlocks([&](int)
+    {
+        nBenchmarkSink += SingleSearchVersion(baBenchmarkVersionResponse).length();
+    }, nBlocks), baBenchmarkVersionResponse.length());
+
+    QByteArray baRecBuf;
+    AddResult(vecResults, "parsing", QString("Version response in %1 byte reads").arg(BENCHMARK_RESPONSE_CHUNK_SIZE), TimeBlocks([&](int)
+    {
+        int nOffset = 0;
+        while (nOffset < baBenchmarkVersionResponse.length())
+        {
+            baRecBuf.append(baBenchmarkVersionResponse.constData() + nOffset, qMin(BENCHMARK_RESPONSE_CHUNK_SIZE, baBenchmarkVersionResponse.length() - nOffset));
+            nOffset += BENCHMARK_RESPONSE_CHUNK_SIZE;
+            QString strFirmwareVersion = MainWindowVersion(baRecBuf);
+            if (!strFirmwareVersion.isEmpty())
+            {
+                nBenchmarkSink += strFirmwareVersion.length();
+                baRecBuf.clear();
+            }
+        }
+        baRecBuf.clear();
+    }, nBlocks), baBenchmarkVersionResponse.length());
+
+    //SHA-256 of the whole image, in memory and through the verifier's file path
+    QByteArray baImageSHA256 = QCryptographicHash::hash(baImage, QCryptographicHash::Sha256).toHex();
+    AddResult(vecResults, "hashing", "SHA-256 in memory", TimeBlocks([&](int)
+    {
+        nBenchmarkSink += (uint8_t)QCryptographicHash::hash(baImage, QCryptographicHash::Sha256).at(0);
+    }, 1), baImage.length());
+
+    QTemporaryDir tdImage;
+    QString strImage = tdImage.filePath("image.bin");
+    QFile fpImage(strImage);
+    if (!tdImage.isValid() || !fpImage.open(QFile::WriteOnly) || fpImage.write(baImage) != baImage.length())
+    {
+        AddResult(vecResults, "hashing", "SHA-256 of file (image verifier)", 0.0, baImage.length(), QString("Skipped, unable to write ").append(strImage));
+    }
+    else
+    {
+        fpImage.close();
+        if (ImageVerifier::HashFile(strImage) != baImageSHA256)
+        {
+            lstMismatches.append("SHA-256 of file");
+        }
+        AddResult(vecResults, "hashing", "SHA-256 of file (image verifier)", TimeBlocks([&](int)
+        {
+            nBenchmarkSink += ImageVerifier::HashFile(strImage).length();
+        }, 1), baImage.length());
+    }
+
+#ifdef Q_OS_UNIX
+    BenchmarkReceive(vecResults, baImage);
+#endif
+
+    OutputResults(tsOutput, nFormat, vecResults, nBlocks, lstMismatches);
+    tsOutput.flush();
+
+    return (lstMismatches.isEmpty() ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,74 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxBenchmark.h
+**
+** Notes: Microbenchmarks of the transfer hot path kernels
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXBENCHMARK_H
+#define UWXBENCHMARK_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QTextStream>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define BENCHMARK_IMAGE_SIZE                      (4 * 1024 * 1024)
+#define BENCHMARK_MINIMUM_RUN_MS                  200
+#define BENCHMARK_SEED                            0x584d
+#define BENCHMARK_RECEIVE_TIMEOUT_MS              60000
+#define BENCHMARK_NS_PER_US                       1000.0
+#define BENCHMARK_NS_PER_MS                       1000000.0
+#define BENCHMARK_NS_PER_S                        1000000000.0
+#define BENCHMARK_BYTES_PER_KIB                   1024.0
+#define BENCHMARK_BYTES_PER_MIB                   1048576.0
+#define BENCHMARK_RESULTS_VERSION                 1
+#define BENCHMARK_SWAR_FOLD_WORDS                 128
+#define BENCHMARK_RESPONSE_CHUNK_SIZE             16
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Enum used for the benchmark results output format
+enum BenchmarkFormats
+{
+    BenchmarkFormatText                         = 0,
+    BenchmarkFormatJSON
+};
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class Benchmark
+{
+public:
+    static int
+    Run(
+        QTextStream &tsOutput,
+        BenchmarkFormats nFormat
+        );
+};
+
+#endif // UWXBENCHMARK_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
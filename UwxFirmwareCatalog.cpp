@@ -0,0 +1,173 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFirmwareCatalog.cpp
+**
+** Notes: Indexed list model of the online firmware upgrade files
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxFirmwareCatalog.h"
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+FirmwareCatalog::FirmwareCatalog(QObject *parent) :
+    QAbstractListModel(parent)
+{
+}
+
+//=============================================================================
+//=============================================================================
+int
+FirmwareCatalog::rowCount(
+    const QModelIndex &parent
+    ) const
+{
+    if (parent.isValid())
+    {
+        //List model, no children
+        return 0;
+    }
+
+    return vecFirmwareFiles.count();
+}
+
+//=============================================================================
+//=============================================================================
+QVariant
+FirmwareCatalog::data(
+    const QModelIndex &index,
+    int role
+    ) const
+{
+    if (!index.isValid() || index.row() >= vecFirmwareFiles.count())
+    {
+        return QVariant();
+    }
+
+    const FirmwareListStruct &fwEntry = vecFirmwareFiles.at(index.row());
+    if (role == Qt::DisplayRole)
+    {
+        return QString(fwEntry.strFromVersion).append(" to ").append(fwEntry.strToVersion);
+    }
+    else if (role == Qt::ToolTipRole)
+    {
+        return fwEntry.strFilename;
+    }
+
+    return QVariant();
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareCatalog::SetEntries(
+    const QVector<FirmwareListStruct> &vecEntries
+    )
+{
+    //Replace the whole catalog in one reset so attached views only update once
+    beginResetModel();
+    vecFirmwareFiles = vecEntries;
+    RebuildIndexes();
+    endResetModel();
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareCatalog::Clear(
+    )
+{
+    beginResetModel();
+    vecFirmwareFiles.clear();
+    RebuildIndexes();
+    endResetModel();
+}
+
+//=============================================================================
+//=============================================================================
+int
+FirmwareCatalog::Count(
+    ) const
+{
+    return vecFirmwareFiles.count();
+}
+
+//=============================================================================
+//=============================================================================
+const FirmwareListStruct *
+FirmwareCatalog::At(
+    int nIndex
+    ) const
+{
+    if (nIndex < 0 || nIndex >= vecFirmwareFiles.count())
+    {
+        return NULL;
+    }
+
+    return &vecFirmwareFiles.at(nIndex);
+}
+
+//=============================================================================
+//=============================================================================
+int
+FirmwareCatalog::IndexOfFilename(
+    const QString &strFilename
+    ) const
+{
+    return hashFilenameIndex.value(strFilename, FIRMWARE_CATALOG_INDEX_NOT_FOUND);
+}
+
+//=============================================================================
+//=============================================================================
+QList<int>
+FirmwareCatalog::IndexesFromVersion(
+    const QString &strFromVersion
+    ) const
+{
+    return hashFromVersionIndex.values(strFromVersion);
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareCatalog::RebuildIndexes(
+    )
+{
+    //Regenerate the lookup tables from the entry vector
+    hashFilenameIndex.clear();
+    hashFromVersionIndex.clear();
+    hashFilenameIndex.reserve(vecFirmwareFiles.count());
+    hashFromVersionIndex.reserve(vecFirmwareFiles.count());
+
+    int i = 0;
+    while (i < vecFirmwareFiles.count())
+    {
+        const FirmwareListStruct &fwEntry = vecFirmwareFiles.at(i);
+        hashFilenameIndex.insert(fwEntry.strFilename, i);
+        hashFromVersionIndex.insert(fwEntry.strFromVersion, i);
+        ++i;
+    }
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,112 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFirmwareCatalog.h
+**
+** Notes: Indexed list model of the online firmware upgrade files
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXFIRMWARECATALOG_H
+#define UWXFIRMWARECATALOG_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QAbstractListModel>
+#include <QVector>
+#include <QHash>
+#include <QMultiHash>
+#include <QString>
+#include <QList>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define FIRMWARE_CATALOG_INDEX_NOT_FOUND          -1
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Single firmware upgrade file entry
+typedef struct
+{
+    QString strDevice;
+    QString strFilename;
+    QString strFromVersion;
+    QString strToVersion;
+    QString strSHA256;
+} FirmwareListStruct;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class FirmwareCatalog : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit
+    FirmwareCatalog(
+        QObject *parent = 0
+        );
+    int
+    rowCount(
+        const QModelIndex &parent = QModelIndex()
+        ) const override;
+    QVariant
+    data(
+        const QModelIndex &index,
+        int role = Qt::DisplayRole
+        ) const override;
+    void
+    SetEntries(
+        const QVector<FirmwareListStruct> &vecEntries
+        );
+    void
+    Clear(
+        );
+    int
+    Count(
+        ) const;
+    const FirmwareListStruct *
+    At(
+        int nIndex
+        ) const;
+    int
+    IndexOfFilename(
+        const QString &strFilename
+        ) const;
+    QList<int>
+    IndexesFromVersion(
+        const QString &strFromVersion
+        ) const;
+
+private:
+    void
+    RebuildIndexes(
+        );
+
+    QVector<FirmwareListStruct> vecFirmwareFiles; //Contiguous storage of firmware upgrade files, row index is the vector index
+    QHash<QString, int> hashFilenameIndex;        //Filename to row lookup
+    QMultiHash<QString, int> hashFromVersionIndex; //Source version to rows lookup (one version can have several upgrade paths)
+};
+
+#endif // UWXFIRMWARECATALOG_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,402 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFirmwareMirror.cpp
+**
+** Notes: Serves the firmware catalog and verified firmware files from the
+**        local cache over HTTP with the same layout as the online server, so
+**        one station can supply the rest of the line. Anything missing is
+**        fetched once from the upstream server.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxFirmwareMirror.h"
+#include "UwxMainWindow.h"
+#include "UwxImageVerifier.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QRegularExpression>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+FirmwareMirror::FirmwareMirror(QObject *parent) :
+    QObject(parent)
+{
+    connect(&hsServer, SIGNAL(Request(QTcpSocket*,QByteArray,QUrl)), this, SLOT(Request(QTcpSocket*,QByteArray,QUrl)));
+}
+
+//=============================================================================
+//=============================================================================
+FirmwareMirror::~FirmwareMirror(
+    )
+{
+#ifndef QT_NO_SSL
+    if (sslcUpstream != NULL)
+    {
+        delete sslcUpstream;
+        sslcUpstream = NULL;
+    }
+#endif
+}
+
+//=============================================================================
+//=============================================================================
+bool
+FirmwareMirror::Listen(
+    const QHostAddress &haAddress,
+    quint16 nPort,
+    const QString &strUpstream,
+    QString *pstrError
+    )
+{
+    //Serves plain HTTP on the given interface, the catalogs fetched by earlier runs are available straight away.
+    //Stations only take the catalog from here when upstream is down, files are checked against the catalog hash.
+    if (!hsServer.Listen(haAddress, nPort, pstrError))
+    {
+        return false;
+    }
+
+    nmUpstream = new QNetworkAccessManager(this);
+    connect(nmUpstream, SIGNAL(finished(QNetworkReply*)), this, SLOT(UpstreamFinished(QNetworkReply*)));
+#ifndef QT_NO_SSL
+    connect(nmUpstream, SIGNAL(sslErrors(QNetworkReply*, QList<QSslError>)), this, SLOT(UpstreamSslErrors(QNetworkReply*, QList<QSslError>)));
+
+    //Same certificate as the online firmware requests, the mirror can run without a window
+    QFile certFile(":/certificates/UwTerminalX_new.crt");
+    if (certFile.open(QIODevice::ReadOnly))
+    {
+        sslcUpstream = new QSslCertificate(certFile.readAll());
+        certFile.close();
+    }
+#endif
+
+    this->strUpstream = strUpstream;
+    while (this->strUpstream.endsWith("/"))
+    {
+        this->strUpstream.chop(1);
+    }
+    QDir().mkpath(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+    LoadCatalogs();
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+QString
+FirmwareMirror::DefaultUpstream(
+    )
+{
+    return
+#ifdef UseSSL
+        QString("https")
+#else
+        QString("http")
+#endif
+        .append("://").append(strOnlineHost);
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareMirror::Request(
+    QTcpSocket *tsClient,
+    QByteArray baMethod,
+    QUrl urlTarget
+    )
+{
+    //Same paths as the online server
+    if (baMethod != "GET")
+    {
+        HttpServer::Respond(tsClient, "400 Bad Request", "text/plain", QByteArray());
+        return;
+    }
+
+    QString strPath = urlTarget.path();
+    if (strPath == strFirmwareMirrorCatalogPath)
+    {
+        ServeCatalog(tsClient, QUrlQuery(urlTarget).queryItemValue("Dev"), urlTarget.query());
+    }
+    else if (strPath.startsWith(strFirmwareMirrorFilesPath))
+    {
+        ServeFile(tsClient, strPath.mid(strFirmwareMirrorFilesPath.length()));
+    }
+    else
+    {
+        HttpServer::Respond(tsClient, "404 Not Found", "text/plain", QByteArray());
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareMirror::ServeCatalog(
+    QTcpSocket *tsClient,
+    const QString &strDevice,
+    const QString &strQuery
+    )
+{
+    //A cached catalog is answered immediately and refreshed in the background
+    //once it is old, so stations are not held up when the uplink is down
+    if (!QRegularExpression("^[A-Za-z0-9_-]+$").match(strDevice).hasMatch())
+    {
+        HttpServer::Respond(tsClient, "404 Not Found", "text/plain", QByteArray());
+        return;
+    }
+
+    bool bFetch = false;
+    if (hashCatalogs.contains(strDevice))
+    {
+        const FirmwareMirrorCatalogStruct &fmcCatalog = hashCatalogs[strDevice];
+        HttpServer::Respond(tsClient, "200 OK", "application/json", fmcCatalog.baJSON);
+        if (QDateTime::currentMSecsSinceEpoch() - fmcCatalog.nFetchedMs >= FIRMWARE_MIRROR_CATALOG_REFRESH_MS && !hashCatalogWaiters.contains(strDevice))
+        {
+            hashCatalogWaiters.insert(strDevice, QList<QPointer<QTcpSocket>>());
+            bFetch = true;
+        }
+    }
+    else
+    {
+        //Nothing to offer until upstream has answered
+        bFetch = !hashCatalogWaiters.contains(strDevice);
+        hashCatalogWaiters[strDevice].append(QPointer<QTcpSocket>(tsClient));
+    }
+
+    if (bFetch == true)
+    {
+        QNetworkReply *nrReply = nmUpstream->get(QNetworkRequest(QUrl(QString(strUpstream).append(strFirmwareMirrorCatalogPath).append("?").append(strQuery))));
+        nrReply->setProperty("device", strDevice);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareMirror::ServeFile(
+    QTcpSocket *tsClient,
+    const QString &strFilename
+    )
+{
+    //Only files listed in a catalog are served, and only once their hash has been checked
+    QString strSHA256 = hashFileSHA256.value(strFilename);
+    if (strSHA256.isEmpty() || strFilename.contains('/') || strFilename.contains('\\') || strFilename.startsWith("."))
+    {
+        HttpServer::Respond(tsClient, "404 Not Found", "text/plain", QByteArray());
+        return;
+    }
+
+    QString strPath = CachePath(strFilename);
+    if (QFileInfo::exists(strPath) && ImageVerifier::CachedHashFile(strPath) == strSHA256)
+    {
+        if (HttpServer::RespondFile(tsClient, "application/octet-stream", strPath))
+        {
+            return;
+        }
+    }
+
+    //Fetched once from upstream however many stations are waiting for it
+    hashFileWaiters[strFilename].append(QPointer<QTcpSocket>(tsClient));
+    if (hashFileWaiters.value(strFilename).count() == 1)
+    {
+        QNetworkReply *nrReply = nmUpstream->get(QNetworkRequest(QUrl(QString(strUpstream).append(strFirmwareMirrorFilesPath).append(strFilename))));
+        nrReply->setProperty("filename", strFilename);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareMirror::UpstreamFinished(
+    QNetworkReply *nrReply
+    )
+{
+    //Nothing is cached unless it is a valid catalog or matches the catalog hash
+    QString strDevice = nrReply->property("device").toString();
+    QString strFilename = nrReply->property("filename").toString();
+    QByteArray baBody = nrReply->readAll();
+    bool bValid = (nrReply->error() == QNetworkReply::NoError);
+    QList<QPointer<QTcpSocket>> lstWaiters;
+
+    if (!strDevice.isEmpty())
+    {
+        lstWaiters = hashCatalogWaiters.take(strDevice);
+        if (bValid == true && QJsonDocument::fromJson(baBody).object()["Result"].toString() == strOnlineResponseValid)
+        {
+            FirmwareMirrorCatalogStruct fmcCatalog;
+            fmcCatalog.baJSON = baBody;
+            fmcCatalog.nFetchedMs = QDateTime::currentMSecsSinceEpoch();
+            hashCatalogs.insert(strDevice, fmcCatalog);
+            IndexCatalog(baBody);
+
+            QSaveFile fpCatalog(CatalogPath(strDevice));
+            if (fpCatalog.open(QFile::WriteOnly))
+            {
+                fpCatalog.write(baBody);
+                fpCatalog.commit();
+            }
+        }
+        else
+        {
+            bValid = false;
+        }
+    }
+    else
+    {
+        lstWaiters = hashFileWaiters.take(strFilename);
+        if (bValid == true && QCryptographicHash::hash(baBody, QCryptographicHash::Sha256).toHex() == hashFileSHA256.value(strFilename).toLatin1())
+        {
+            QSaveFile fpFile(CachePath(strFilename));
+            if (fpFile.open(QFile::WriteOnly))
+            {
+                fpFile.write(baBody);
+                fpFile.commit();
+            }
+        }
+        else
+        {
+            bValid = false;
+        }
+    }
+
+    foreach (QPointer<QTcpSocket> tsClient, lstWaiters)
+    {
+        if (tsClient.isNull())
+        {
+            //Gave up waiting
+            continue;
+        }
+
+        if (bValid == true)
+        {
+            HttpServer::Respond(tsClient, "200 OK", (strDevice.isEmpty() ? "application/octet-stream" : "application/json"), baBody);
+        }
+        else
+        {
+            HttpServer::Respond(tsClient, "502 Bad Gateway", "text/plain", (nrReply->error() != QNetworkReply::NoError ? nrReply->errorString() : QString("invalid upstream response")).toUtf8());
+        }
+    }
+
+    nrReply->deleteLater();
+}
+
+#ifndef QT_NO_SSL
+//=============================================================================
+//=============================================================================
+void
+FirmwareMirror::UpstreamSslErrors(
+    QNetworkReply *nrReply,
+    QList<QSslError> lstSSLErrors
+    )
+{
+    if (sslcUpstream != NULL && nrReply->sslConfiguration().peerCertificate() == *sslcUpstream)
+    {
+        //Server certificate matches
+        nrReply->ignoreSslErrors(lstSSLErrors);
+    }
+}
+#endif
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareMirror::LoadCatalogs(
+    )
+{
+    //Catalogs are kept on disk so a restarted mirror can serve without the uplink
+    QDir dirCache(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+    foreach (const QFileInfo &fiCatalog, dirCache.entryInfoList(QStringList() << QString(strFirmwareMirrorCatalogPrefix).append("*").append(strFirmwareMirrorCatalogSuffix), QDir::Files))
+    {
+        QFile fpCatalog(fiCatalog.absoluteFilePath());
+        if (!fpCatalog.open(QFile::ReadOnly))
+        {
+            continue;
+        }
+
+        QString strDevice = fiCatalog.fileName().mid(strFirmwareMirrorCatalogPrefix.length());
+        strDevice.chop(strFirmwareMirrorCatalogSuffix.length());
+        FirmwareMirrorCatalogStruct fmcCatalog;
+        fmcCatalog.baJSON = fpCatalog.readAll();
+        fmcCatalog.nFetchedMs = fiCatalog.lastModified().toMSecsSinceEpoch();
+        hashCatalogs.insert(strDevice, fmcCatalog);
+        IndexCatalog(fmcCatalog.baJSON);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwareMirror::IndexCatalog(
+    const QByteArray &baJSON
+    )
+{
+    //Adds every file of every device in the catalog to the files which may be served
+    QJsonObject joDevices = QJsonDocument::fromJson(baJSON).object()["Devices"].toObject();
+    foreach (const QString &strDevice, joDevices.keys())
+    {
+        QJsonArray joFirmwareObjects = joDevices[strDevice].toArray();
+        int i = 0;
+        while (i < joFirmwareObjects.count())
+        {
+            QJsonArray joFirmwareObject = joFirmwareObjects.at(i).toArray();
+            QString strFilename = joFirmwareObject.at(OnlineFirmwareJSONIndexFilename).toString();
+            if (!strFilename.isEmpty())
+            {
+                hashFileSHA256.insert(strFilename, joFirmwareObject.at(OnlineFirmwareJSONIndexSHA256).toString().toLower());
+            }
+            ++i;
+        }
+    }
+}
+
+//=============================================================================
+//=============================================================================
+QString
+FirmwareMirror::CatalogPath(
+    const QString &strDevice
+    )
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).filePath(QString(strFirmwareMirrorCatalogPrefix).append(strDevice).append(strFirmwareMirrorCatalogSuffix));
+}
+
+//=============================================================================
+//=============================================================================
+QString
+FirmwareMirror::CachePath(
+    const QString &strFilename
+    )
+{
+    //Same location as the firmware cache used for online upgrades
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).filePath(strFilename);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,158 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFirmwareMirror.h
+**
+** Notes: Serves the firmware catalog and verified firmware files from the
+**        local cache over HTTP with the same layout as the online server, so
+**        one station can supply the rest of the line. Anything missing is
+**        fetched once from the upstream server.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXFIRMWAREMIRROR_H
+#define UWXFIRMWAREMIRROR_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxHttpServer.h"
+#include <QObject>
+#include <QHostAddress>
+#include <QPointer>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QByteArray>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#ifndef QT_NO_SSL
+#include <QSslCertificate>
+#include <QSslError>
+#endif
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define FIRMWARE_MIRROR_CATALOG_REFRESH_MS        600000
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const QString    strFirmwareMirrorCatalogPrefix = QString("mirror_catalog_");
+const QString    strFirmwareMirrorCatalogSuffix = QString(".json");
+const QString    strFirmwareMirrorCatalogPath   = QString("/Firmware/firmware.php");
+const QString    strFirmwareMirrorFilesPath     = QString("/Firmware/Files/");
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Catalog response for one device, exactly as received from upstream
+typedef struct
+{
+    QByteArray baJSON;
+    qint64 nFetchedMs;
+} FirmwareMirrorCatalogStruct;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class FirmwareMirror : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    FirmwareMirror(
+        QObject *parent = 0
+        );
+    ~FirmwareMirror(
+        );
+    bool
+    Listen(
+        const QHostAddress &haAddress,
+        quint16 nPort,
+        const QString &strUpstream,
+        QString *pstrError
+        );
+    static QString
+    DefaultUpstream(
+        );
+
+private slots:
+    void
+    Request(
+        QTcpSocket *tsClient,
+        QByteArray baMethod,
+        QUrl urlTarget
+        );
+    void
+    UpstreamFinished(
+        QNetworkReply *nrReply
+        );
+#ifndef QT_NO_SSL
+    void
+    UpstreamSslErrors(
+        QNetworkReply *nrReply,
+        QList<QSslError> lstSSLErrors
+        );
+#endif
+
+private:
+    void
+    ServeCatalog(
+        QTcpSocket *tsClient,
+        const QString &strDevice,
+        const QString &strQuery
+        );
+    void
+    ServeFile(
+        QTcpSocket *tsClient,
+        const QString &strFilename
+        );
+    void
+    LoadCatalogs(
+        );
+    void
+    IndexCatalog(
+        const QByteArray &baJSON
+        );
+    QString
+    CatalogPath(
+        const QString &strDevice
+        );
+    QString
+    CachePath(
+        const QString &strFilename
+        );
+
+    HttpServer hsServer;                            //Listens on the chosen interface so other stations can connect
+    QNetworkAccessManager *nmUpstream = NULL;       //Fetches whatever the mirror does not have yet
+    QString strUpstream;                            //Scheme and host of the upstream server
+    QHash<QString, FirmwareMirrorCatalogStruct> hashCatalogs; //Catalog of each device which has been requested
+    QHash<QString, QString> hashFileSHA256;         //Filename to SHA-256 (lower case hex) of every file in any catalog, only these are served
+    QHash<QString, QList<QPointer<QTcpSocket>>> hashCatalogWaiters; //Clients waiting for each device's catalog from upstream
+    QHash<QString, QList<QPointer<QTcpSocket>>> hashFileWaiters; //Clients waiting for each file from upstream
+#ifndef QT_NO_SSL
+    QSslCertificate *sslcUpstream = NULL;           //Certificate of the online server
+#endif
+};
+
+#endif // UWXFIRMWAREMIRROR_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
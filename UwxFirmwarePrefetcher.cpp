@@ -0,0 +1,380 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFirmwarePrefetcher.cpp
+**
+** Notes: Downloads the catalog firmware files most likely to be needed next
+**        into the firmware cache while the application is idle, ranked by
+**        the upgrades recorded in the flash history
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxFirmwarePrefetcher.h"
+#include "UwxFlashHistory.h"
+#include "UwxImageVerifier.h"
+#include "UwxUpgradePlanner.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSet>
+#include <QNetworkRequest>
+#include <QtConcurrent/QtConcurrentRun>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+FirmwarePrefetcher::FirmwarePrefetcher(
+    QObject *parent
+    ) : QObject(parent), chDownload(QCryptographicHash::Sha256)
+{
+    connect(&fwPlan, SIGNAL(finished()), this, SLOT(PlanFinished()));
+    connect(&tmrTick, SIGNAL(timeout()), this, SLOT(Tick()));
+    tmrTick.setInterval(FIRMWARE_PREFETCH_TICK_MS);
+}
+
+//=============================================================================
+//=============================================================================
+FirmwarePrefetcher::~FirmwarePrefetcher(
+    )
+{
+    //The plan job only works on copies so it can be left to finish on its own
+    Stop();
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwarePrefetcher::Start(
+    const QVector<FirmwareListStruct> &vecCatalog,
+    const QString &strUrlBase,
+    const QString &strFallbackUrlBase,
+    const QString &strCacheDirectory,
+    const QString &strHistoryFilename
+    )
+{
+    //Called whenever a new catalog has been loaded, anything from the previous catalog is abandoned
+    Stop();
+    if (nBytesPerSecond <= 0)
+    {
+        return;
+    }
+
+    this->strUrlBase = strUrlBase;
+    this->strFallbackUrlBase = strFallbackUrlBase;
+    if (fwPlan.isRunning())
+    {
+        //Only one plan at a time, this catalog is planned once the current one finishes
+        vecReplanCatalog = vecCatalog;
+        strReplanCacheDirectory = strCacheDirectory;
+        strReplanHistoryFilename = strHistoryFilename;
+        bReplan = true;
+        return;
+    }
+
+    fwPlan.setFuture(QtConcurrent::run(&FirmwarePrefetcher::Plan, vecCatalog, strCacheDirectory, strHistoryFilename));
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwarePrefetcher::Stop(
+    )
+{
+    //Abandons the download in progress, a partly written cache file is discarded
+    tmrTick.stop();
+    lstJobs.clear();
+    bReplan = false;
+
+    if (nrDownload != NULL)
+    {
+        nrDownload->abort();
+        nrDownload->deleteLater();
+        nrDownload = NULL;
+    }
+
+    if (sfDownload != NULL)
+    {
+        sfDownload->cancelWriting();
+        delete sfDownload;
+        sfDownload = NULL;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwarePrefetcher::SetPaused(
+    bool bPaused
+    )
+{
+    //Whilst paused nothing is read from the download, so the connection is
+    //throttled by the full read buffer rather than being dropped
+    this->bPaused = bPaused;
+    if (bPaused == false && nrDownload == NULL && !lstJobs.isEmpty())
+    {
+        StartNextDownload();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwarePrefetcher::SetRate(
+    qint64 nBytesPerSecond
+    )
+{
+    this->nBytesPerSecond = nBytesPerSecond;
+    if (nBytesPerSecond <= 0)
+    {
+        Stop();
+    }
+    else if (nrDownload != NULL)
+    {
+        nrDownload->setReadBufferSize(TickBudget());
+    }
+}
+
+//=============================================================================
+//=============================================================================
+QList<FirmwarePrefetchJobStruct>
+FirmwarePrefetcher::Plan(
+    const QVector<FirmwareListStruct> &vecCatalog,
+    const QString &strCacheDirectory,
+    const QString &strHistoryFilename
+    )
+{
+    //Runs on the thread pool. The most frequent recent upgrades come first:
+    //the path to the version those modules were taken to, then every other
+    //file which starts from the same version in case a newer one is chosen.
+    QList<FirmwarePrefetchJobStruct> lstPlan;
+    QVector<FlashHistoryUpgradeStruct> vecUpgrades;
+    QString strError;
+    if (!FlashHistory::RecentUpgrades(strHistoryFilename, QDateTime::currentMSecsSinceEpoch() - FIRMWARE_PREFETCH_HISTORY_DAYS * FIRMWARE_PREFETCH_MS_PER_DAY, &vecUpgrades, &strError))
+    {
+        return lstPlan;
+    }
+
+    FirmwareCatalog fcCatalog;
+    fcCatalog.SetEntries(vecCatalog);
+    QSet<int> setConsidered;
+    foreach (const FlashHistoryUpgradeStruct &fhuUpgrade, vecUpgrades)
+    {
+        QList<int> lstIndexes;
+        if (!fhuUpgrade.strVersionAfter.isEmpty())
+        {
+            UpgradePlanner::PlanPath(fcCatalog, fhuUpgrade.strVersionBefore, fhuUpgrade.strVersionAfter, &lstIndexes);
+        }
+        lstIndexes.append(fcCatalog.IndexesFromVersion(fhuUpgrade.strVersionBefore));
+
+        foreach (int nIndex, lstIndexes)
+        {
+            if (lstPlan.count() >= FIRMWARE_PREFETCH_MAX_FILES)
+            {
+                return lstPlan;
+            }
+            else if (setConsidered.contains(nIndex))
+            {
+                continue;
+            }
+            setConsidered.insert(nIndex);
+
+            const FirmwareListStruct *pEntry = fcCatalog.At(nIndex);
+            FirmwarePrefetchJobStruct fpjJob;
+            fpjJob.strFilename = pEntry->strFilename;
+            fpjJob.strSHA256 = pEntry->strSHA256.toLower();
+            fpjJob.strPath = QDir(strCacheDirectory).filePath(pEntry->strFilename);
+            fpjJob.bFallback = false;
+            if (QFileInfo::exists(fpjJob.strPath) && ImageVerifier::HashFile(fpjJob.strPath) == fpjJob.strSHA256)
+            {
+                //Already cached and intact
+                continue;
+            }
+            lstPlan.append(fpjJob);
+        }
+    }
+
+    return lstPlan;
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwarePrefetcher::PlanFinished(
+    )
+{
+    if (bReplan == true)
+    {
+        //A newer catalog arrived whilst this one was being planned
+        bReplan = false;
+        fwPlan.setFuture(QtConcurrent::run(&FirmwarePrefetcher::Plan, vecReplanCatalog, strReplanCacheDirectory, strReplanHistoryFilename));
+        vecReplanCatalog.clear();
+        return;
+    }
+
+    if (nBytesPerSecond <= 0)
+    {
+        //Prefetching was disabled whilst planning
+        return;
+    }
+
+    lstJobs = fwPlan.result();
+    if (bPaused == false && nrDownload == NULL && !lstJobs.isEmpty())
+    {
+        StartNextDownload();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwarePrefetcher::StartNextDownload(
+    )
+{
+    //One file at a time at low priority
+    if (lstJobs.isEmpty() || nBytesPerSecond <= 0)
+    {
+        return;
+    }
+
+    const FirmwarePrefetchJobStruct &fpjJob = lstJobs.first();
+    QDir().mkpath(QFileInfo(fpjJob.strPath).absolutePath());
+    sfDownload = new QSaveFile(fpjJob.strPath);
+    if (!sfDownload->open(QFile::WriteOnly))
+    {
+        QString strError = sfDownload->errorString();
+        delete sfDownload;
+        sfDownload = NULL;
+        emit Prefetched(lstJobs.takeFirst().strFilename, false, strError);
+        return;
+    }
+
+    if (nmPrefetch == NULL)
+    {
+        //Created on first use so idle instances never load the network stack
+        nmPrefetch = new QNetworkAccessManager(this);
+#ifndef QT_NO_SSL
+        connect(nmPrefetch, SIGNAL(sslErrors(QNetworkReply*, QList<QSslError>)), this, SIGNAL(SslErrors(QNetworkReply*, QList<QSslError>)));
+#endif
+    }
+
+    chDownload.reset();
+    QNetworkRequest nrRequest(QUrl(QString(fpjJob.bFallback == true ? strFallbackUrlBase : strUrlBase).append(fpjJob.strFilename)));
+    nrRequest.setPriority(QNetworkRequest::LowPriority);
+    nrDownload = nmPrefetch->get(nrRequest);
+    nrDownload->setReadBufferSize(TickBudget());
+    tmrTick.start();
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwarePrefetcher::Tick(
+    )
+{
+    //Reads at most one tick's share of the rate limit
+    if (nrDownload == NULL)
+    {
+        tmrTick.stop();
+        return;
+    }
+
+    if (bPaused == false && nrDownload->error() == QNetworkReply::NoError)
+    {
+        QByteArray baData = nrDownload->read(TickBudget());
+        if (!baData.isEmpty())
+        {
+            chDownload.addData(baData);
+            sfDownload->write(baData);
+        }
+    }
+
+    if (nrDownload->isFinished() && (nrDownload->error() != QNetworkReply::NoError || nrDownload->bytesAvailable() == 0))
+    {
+        FinishDownload();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FirmwarePrefetcher::FinishDownload(
+    )
+{
+    //The cached file is only replaced if the download matches the catalog hash
+    tmrTick.stop();
+    if (nrDownload->error() != QNetworkReply::NoError && nrDownload->error() != QNetworkReply::OperationCanceledError && !strFallbackUrlBase.isEmpty() && lstJobs.first().bFallback == false)
+    {
+        //Try the same file again from the fallback server
+        lstJobs.first().bFallback = true;
+        sfDownload->cancelWriting();
+        delete sfDownload;
+        sfDownload = NULL;
+        nrDownload->deleteLater();
+        nrDownload = NULL;
+        if (bPaused == false)
+        {
+            StartNextDownload();
+        }
+        return;
+    }
+
+    FirmwarePrefetchJobStruct fpjJob = lstJobs.takeFirst();
+    QString strError;
+    if (nrDownload->error() != QNetworkReply::NoError)
+    {
+        strError = nrDownload->errorString();
+    }
+    else if (chDownload.result().toHex() != fpjJob.strSHA256.toLatin1())
+    {
+        strError = "downloaded file does not match the catalog SHA-256";
+    }
+    else if (!sfDownload->commit())
+    {
+        strError = sfDownload->errorString();
+    }
+
+    if (!strError.isEmpty())
+    {
+        sfDownload->cancelWriting();
+    }
+    delete sfDownload;
+    sfDownload = NULL;
+    nrDownload->deleteLater();
+    nrDownload = NULL;
+    emit Prefetched(fpjJob.strFilename, strError.isEmpty(), strError);
+
+    if (bPaused == false)
+    {
+        StartNextDownload();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+qint64
+FirmwarePrefetcher::TickBudget(
+    ) const
+{
+    return qMax(nBytesPerSecond * FIRMWARE_PREFETCH_TICK_MS / FIRMWARE_PREFETCH_MS_PER_S, (qint64)1);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,163 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFirmwarePrefetcher.h
+**
+** Notes: Downloads the catalog firmware files most likely to be needed next
+**        into the firmware cache while the application is idle, ranked by
+**        the upgrades recorded in the flash history
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXFIRMWAREPREFETCHER_H
+#define UWXFIRMWAREPREFETCHER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <QCryptographicHash>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSaveFile>
+#ifndef QT_NO_SSL
+#include <QSslError>
+#endif
+#include "UwxFirmwareCatalog.h"
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define FIRMWARE_PREFETCH_DEFAULT_RATE            262144
+#define FIRMWARE_PREFETCH_HISTORY_DAYS            30
+#define FIRMWARE_PREFETCH_MS_PER_DAY              86400000LL
+#define FIRMWARE_PREFETCH_MAX_FILES               8
+#define FIRMWARE_PREFETCH_TICK_MS                 100
+#define FIRMWARE_PREFETCH_MS_PER_S                1000
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Firmware file to be downloaded into the cache
+typedef struct
+{
+    QString strFilename;
+    QString strSHA256;
+    QString strPath;
+    bool bFallback;
+} FirmwarePrefetchJobStruct;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class FirmwarePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    FirmwarePrefetcher(
+        QObject *parent = 0
+        );
+    ~FirmwarePrefetcher(
+        );
+    void
+    Start(
+        const QVector<FirmwareListStruct> &vecCatalog,
+        const QString &strUrlBase,
+        const QString &strFallbackUrlBase,
+        const QString &strCacheDirectory,
+        const QString &strHistoryFilename
+        );
+    void
+    Stop(
+        );
+    void
+    SetPaused(
+        bool bPaused
+        );
+    void
+    SetRate(
+        qint64 nBytesPerSecond
+        );
+    static QList<FirmwarePrefetchJobStruct>
+    Plan(
+        const QVector<FirmwareListStruct> &vecCatalog,
+        const QString &strCacheDirectory,
+        const QString &strHistoryFilename
+        );
+
+signals:
+    void
+    Prefetched(
+        QString strFilename,
+        bool bSuccess,
+        QString strError
+        );
+#ifndef QT_NO_SSL
+    void
+    SslErrors(
+        QNetworkReply *nrReply,
+        QList<QSslError> lstSSLErrors
+        );
+#endif
+
+private slots:
+    void
+    PlanFinished(
+        );
+    void
+    Tick(
+        );
+
+private:
+    void
+    StartNextDownload(
+        );
+    void
+    FinishDownload(
+        );
+    qint64
+    TickBudget(
+        ) const;
+
+    QNetworkAccessManager *nmPrefetch = NULL;       //Separate network manager so foreground downloads are never queued behind prefetches
+    QFutureWatcher<QList<FirmwarePrefetchJobStruct>> fwPlan; //Watches the history query and cache check running on the thread pool
+    QTimer tmrTick;                                 //Reads the download at the limited rate
+    QList<FirmwarePrefetchJobStruct> lstJobs;       //Files still to download, most likely to be needed first
+    QNetworkReply *nrDownload = NULL;               //Download in progress
+    QSaveFile *sfDownload = NULL;                   //Cache file being written, only replaces the cached file once verified
+    QCryptographicHash chDownload;                  //Hash of the data downloaded so far
+    QString strUrlBase;                             //Firmware file URL without the filename
+    QString strFallbackUrlBase;                     //Used if a file cannot be fetched from strUrlBase, empty if there is no fallback
+    QVector<FirmwareListStruct> vecReplanCatalog;   //Catalog which arrived whilst the last one was being planned
+    QString strReplanCacheDirectory;                //Cache directory for the catalog waiting to be planned
+    QString strReplanHistoryFilename;               //History database for the catalog waiting to be planned
+    bool bReplan = false;                           //If a newer catalog is waiting to be planned
+    bool bPaused = false;                           //If a foreground operation is running
+    qint64 nBytesPerSecond = FIRMWARE_PREFETCH_DEFAULT_RATE; //Download rate limit, 0 disables prefetching
+};
+
+#endif // UWXFIRMWAREPREFETCHER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,424 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFlashDaemon.cpp
+**
+** Notes: Long-running flashing service. Jobs are submitted as JSON lines over
+**        a local socket and run on engines which are kept alive per port, so
+**        start-up work is only done once.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxFlashDaemon.h"
+#include "UwxMainWindow.h"
+#include "UwxLineWatchdog.h"
+#include <QJsonDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QStandardPaths>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+FlashDaemon::FlashDaemon(QObject *parent) :
+    QObject(parent)
+{
+    connect(&lsServer, SIGNAL(newConnection()), this, SLOT(NewConnection()));
+}
+
+//=============================================================================
+//=============================================================================
+FlashDaemon::~FlashDaemon(
+    )
+{
+    disconnect(this, SLOT(NewConnection()));
+    lsServer.close();
+
+    qDeleteAll(hashEngines);
+    hashEngines.clear();
+}
+
+//=============================================================================
+//=============================================================================
+bool
+FlashDaemon::Listen(
+    const QString &strName,
+    QString *pstrError
+    )
+{
+    //A stale socket left behind by a previous instance is removed first
+    QLocalServer::removeServer(strName);
+    lsServer.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!lsServer.listen(strName))
+    {
+        *pstrError = lsServer.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashDaemon::NewConnection(
+    )
+{
+    while (lsServer.hasPendingConnections())
+    {
+        QLocalSocket *plsClient = lsServer.nextPendingConnection();
+        connect(plsClient, SIGNAL(readyRead()), this, SLOT(ClientReadyRead()));
+        connect(plsClient, SIGNAL(disconnected()), plsClient, SLOT(deleteLater()));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashDaemon::ClientReadyRead(
+    )
+{
+    //Requests are one JSON object per line
+    QLocalSocket *plsClient = qobject_cast<QLocalSocket *>(sender());
+    if (plsClient == NULL)
+    {
+        return;
+    }
+
+    while (plsClient->canReadLine())
+    {
+        QByteArray baLine = plsClient->readLine().trimmed();
+        if (baLine.isEmpty())
+        {
+            continue;
+        }
+
+        QJsonParseError jpeError;
+        QJsonDocument jdRequest = QJsonDocument::fromJson(baLine, &jpeError);
+        if (jdRequest.isNull() || !jdRequest.isObject())
+        {
+            QJsonObject joEvent;
+            joEvent["event"] = "error";
+            joEvent["message"] = QString("Invalid request: ").append(jpeError.errorString());
+            SendEvent(plsClient, joEvent);
+            continue;
+        }
+
+        HandleRequest(plsClient, jdRequest.object());
+    }
+
+    if (plsClient->bytesAvailable() > DAEMON_REQUEST_MAX_SIZE)
+    {
+        //Unterminated request, the client is not speaking the protocol
+        plsClient->disconnectFromServer();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashDaemon::HandleRequest(
+    QLocalSocket *plsClient,
+    const QJsonObject &joRequest
+    )
+{
+    //Supported requests:
+    //  {"type": "job", "id": "...", "port": "...", "firmware": "...", "baud": 115200, "flow": "hardware", "force": false}
+    //  {"type": "status"}
+    //  {"type": "ports"}
+    //  {"type": "release", "port": "..."}
+    QString strType = joRequest.value("type").toString("job");
+    if (strType == "job")
+    {
+        QueueJob(plsClient, joRequest);
+    }
+    else if (strType == "status")
+    {
+        QJsonArray jaPorts;
+        QStringList lstPorts = hashEngines.keys();
+        foreach (const QString &strPort, hashQueues.keys() + LineWatchdog::QuarantinedPorts())
+        {
+            if (!lstPorts.contains(strPort))
+            {
+                lstPorts.append(strPort);
+            }
+        }
+        foreach (const QString &strPort, lstPorts)
+        {
+            QString strReason;
+            QJsonObject joPort;
+            joPort["port"] = strPort;
+            joPort["running"] = (hashRunning.contains(strPort) ? QJsonValue(hashRunning.value(strPort).strId) : QJsonValue());
+            joPort["queued"] = hashQueues.value(strPort).count();
+            joPort["quarantined"] = (LineWatchdog::IsQuarantined(strPort, &strReason) ? QJsonValue(strReason) : QJsonValue());
+            jaPorts.append(joPort);
+        }
+
+        QJsonObject joEvent;
+        joEvent["event"] = "status";
+        joEvent["ports"] = jaPorts;
+        SendEvent(plsClient, joEvent);
+    }
+    else if (strType == "ports")
+    {
+        QJsonObject joEvent;
+        joEvent["event"] = "ports";
+        joEvent["ports"] = PortIndex();
+        SendEvent(plsClient, joEvent);
+    }
+    else if (strType == "release")
+    {
+        //The module on a quarantined port has been replugged or replaced
+        QJsonObject joEvent;
+        joEvent["event"] = "released";
+        joEvent["port"] = joRequest.value("port").toString();
+        joEvent["was_quarantined"] = LineWatchdog::Release(joRequest.value("port").toString());
+        SendEvent(plsClient, joEvent);
+    }
+    else
+    {
+        QJsonObject joEvent;
+        joEvent["event"] = "error";
+        joEvent["message"] = QString("Unknown request type '").append(strType).append("'");
+        SendEvent(plsClient, joEvent);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashDaemon::QueueJob(
+    QLocalSocket *plsClient,
+    const QJsonObject &joRequest
+    )
+{
+    //Validates a job and adds it to the queue of its port
+    FlashDaemonJob fdjJob;
+    fdjJob.strId = joRequest.value("id").toString();
+    if (fdjJob.strId.isEmpty())
+    {
+        fdjJob.strId = QString::number(nNextJobId);
+        ++nNextJobId;
+    }
+    fdjJob.strPort = joRequest.value("port").toString();
+    fdjJob.strFirmware = joRequest.value("firmware").toString();
+    fdjJob.nBaudRate = joRequest.value("baud").toInt(DAEMON_DEFAULT_BAUD_RATE);
+    fdjJob.bForce = joRequest.value("force").toBool(false);
+    fdjJob.plsClient = plsClient;
+
+    QString strFlow = joRequest.value("flow").toString("hardware");
+    fdjJob.nHandshake = (strFlow == "none" ? ComboBaudRateHandshakingNone : (strFlow == "software" ? ComboBaudRateHandshakingSoftware : ComboBaudRateHandshakingHardware));
+
+    if (!fdjJob.strFirmware.isEmpty() && QFileInfo(fdjJob.strFirmware).isRelative() && !QFile::exists(fdjJob.strFirmware))
+    {
+        //Bare filename, look for it in the firmware download cache
+        fdjJob.strFirmware = QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).filePath(fdjJob.strFirmware);
+    }
+
+    QJsonObject joEvent;
+    joEvent["id"] = fdjJob.strId;
+    if (fdjJob.strPort.isEmpty() || fdjJob.strFirmware.isEmpty())
+    {
+        joEvent["event"] = "error";
+        joEvent["message"] = "Jobs require a port and a firmware file";
+        SendEvent(plsClient, joEvent);
+        return;
+    }
+    else if (!QFile::exists(fdjJob.strFirmware))
+    {
+        joEvent["event"] = "error";
+        joEvent["message"] = QString("Firmware file '").append(fdjJob.strFirmware).append("' does not exist");
+        SendEvent(plsClient, joEvent);
+        return;
+    }
+
+    hashQueues[fdjJob.strPort].append(fdjJob);
+    joEvent["event"] = "queued";
+    joEvent["port"] = fdjJob.strPort;
+    joEvent["position"] = hashQueues.value(fdjJob.strPort).count() - 1 + (hashRunning.contains(fdjJob.strPort) ? 1 : 0);
+    SendEvent(plsClient, joEvent);
+
+    if (!hashRunning.contains(fdjJob.strPort))
+    {
+        StartNextJob(fdjJob.strPort);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashDaemon::StartNextJob(
+    const QString &strPort
+    )
+{
+    //Runs queued jobs for a port until one starts successfully or the queue is empty
+    while (!hashQueues.value(strPort).isEmpty())
+    {
+        FlashDaemonJob fdjJob = hashQueues[strPort].takeFirst();
+        QString strError;
+        fdjJob.etmrJob.start();
+        hashRunning.insert(strPort, fdjJob);
+        hashProgressTimers[strPort].start();
+
+        QJsonObject joEvent;
+        joEvent["id"] = fdjJob.strId;
+        if (Engine(strPort)->StartFirmwareJob(strPort, fdjJob.nBaudRate, fdjJob.nHandshake, fdjJob.strFirmware, fdjJob.bForce, &strError))
+        {
+            joEvent["event"] = "started";
+            SendEvent(fdjJob.plsClient, joEvent);
+            return;
+        }
+
+        hashRunning.remove(strPort);
+        joEvent["event"] = "finished";
+        joEvent["success"] = false;
+        joEvent["message"] = strError;
+        joEvent["duration_ms"] = fdjJob.etmrJob.elapsed();
+        SendEvent(fdjJob.plsClient, joEvent);
+    }
+
+    hashQueues.remove(strPort);
+}
+
+//=============================================================================
+//=============================================================================
+MainWindow *
+FlashDaemon::Engine(
+    const QString &strPort
+    )
+{
+    //Returns the engine for a port, it is created once and then reused for every job on that port
+    MainWindow *pEngine = hashEngines.value(strPort, NULL);
+    if (pEngine == NULL)
+    {
+        pEngine = new MainWindow();
+        pEngine->SetNonInteractive(true);
+        connect(pEngine, SIGNAL(TransferProgressUpdated(qint64,qint64,double)), this, SLOT(EngineProgress(qint64,qint64,double)));
+        connect(pEngine, SIGNAL(SessionFinished(bool,QString)), this, SLOT(EngineFinished(bool,QString)));
+        hashEngines.insert(strPort, pEngine);
+    }
+
+    return pEngine;
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashDaemon::EngineProgress(
+    qint64 nBytesDone,
+    qint64 nTotalBytes,
+    double fBytesPerSecond
+    )
+{
+    //The engine reports at display frame rate, clients are sent a lower rate
+    QString strPort = hashEngines.key(qobject_cast<MainWindow *>(sender()));
+    if (!hashRunning.contains(strPort) || hashProgressTimers.value(strPort).elapsed() < DAEMON_PROGRESS_INTERVAL_MS)
+    {
+        return;
+    }
+    hashProgressTimers[strPort].start();
+
+    QJsonObject joEvent;
+    joEvent["event"] = "progress";
+    joEvent["id"] = hashRunning.value(strPort).strId;
+    joEvent["bytes"] = nBytesDone;
+    joEvent["total"] = nTotalBytes;
+    joEvent["bytes_per_second"] = qRound64(fBytesPerSecond);
+    SendEvent(hashRunning.value(strPort).plsClient, joEvent);
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashDaemon::EngineFinished(
+    bool bSuccess,
+    QString strMessage
+    )
+{
+    //Reports the outcome of a job and starts the next one queued for the port
+    QString strPort = hashEngines.key(qobject_cast<MainWindow *>(sender()));
+    if (!hashRunning.contains(strPort))
+    {
+        return;
+    }
+
+    FlashDaemonJob fdjJob = hashRunning.take(strPort);
+    QJsonObject joEvent;
+    joEvent["event"] = "finished";
+    joEvent["id"] = fdjJob.strId;
+    joEvent["success"] = bSuccess;
+    joEvent["message"] = strMessage;
+    joEvent["duration_ms"] = fdjJob.etmrJob.elapsed();
+    SendEvent(fdjJob.plsClient, joEvent);
+
+    StartNextJob(strPort);
+}
+
+//=============================================================================
+//=============================================================================
+QJsonArray
+FlashDaemon::PortIndex(
+    )
+{
+    //Serial ports are only enumerated again once the cached list is old
+    if (!etmrPortIndex.isValid() || etmrPortIndex.elapsed() > DAEMON_PORT_INDEX_MAX_AGE_MS)
+    {
+        lstPortIndex = QSerialPortInfo::availablePorts();
+        etmrPortIndex.start();
+        LineWatchdog::ReleaseReplugged(lstPortIndex);
+    }
+
+    QJsonArray jaPorts;
+    foreach (const QSerialPortInfo &spiPort, lstPortIndex)
+    {
+        QJsonObject joPort;
+        joPort["port"] = spiPort.portName();
+        joPort["description"] = spiPort.description();
+        joPort["manufacturer"] = spiPort.manufacturer();
+        joPort["serial_number"] = spiPort.serialNumber();
+        joPort["busy"] = hashRunning.contains(spiPort.portName());
+        joPort["quarantined"] = LineWatchdog::QuarantinedPorts().contains(spiPort.portName());
+        jaPorts.append(joPort);
+    }
+
+    return jaPorts;
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashDaemon::SendEvent(
+    QLocalSocket *plsClient,
+    const QJsonObject &joEvent
+    )
+{
+    //Events are one JSON object per line, they are dropped if the client has gone
+    if (plsClient == NULL || plsClient->state() != QLocalSocket::ConnectedState)
+    {
+        return;
+    }
+
+    plsClient->write(QJsonDocument(joEvent).toJson(QJsonDocument::Compact).append('\n'));
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,149 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFlashDaemon.h
+**
+** Notes: Long-running flashing service. Jobs are submitted as JSON lines over
+**        a local socket and run on engines which are kept alive per port, so
+**        start-up work is only done once.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXFLASHDAEMON_H
+#define UWXFLASHDAEMON_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QHash>
+#include <QList>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSerialPortInfo>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define DAEMON_PROGRESS_INTERVAL_MS               500
+#define DAEMON_PORT_INDEX_MAX_AGE_MS              2000
+#define DAEMON_DEFAULT_BAUD_RATE                  115200
+#define DAEMON_REQUEST_MAX_SIZE                   65536
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+class MainWindow;
+
+//Queued or running flashing job
+typedef struct
+{
+    QString strId;
+    QString strPort;
+    QString strFirmware;
+    qint32 nBaudRate;
+    int nHandshake;
+    bool bForce;
+    QPointer<QLocalSocket> plsClient;
+    QElapsedTimer etmrJob;
+} FlashDaemonJob;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class FlashDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    FlashDaemon(
+        QObject *parent = 0
+        );
+    ~FlashDaemon(
+        );
+    bool
+    Listen(
+        const QString &strName,
+        QString *pstrError
+        );
+
+private slots:
+    void
+    NewConnection(
+        );
+    void
+    ClientReadyRead(
+        );
+    void
+    EngineProgress(
+        qint64 nBytesDone,
+        qint64 nTotalBytes,
+        double fBytesPerSecond
+        );
+    void
+    EngineFinished(
+        bool bSuccess,
+        QString strMessage
+        );
+
+private:
+    void
+    HandleRequest(
+        QLocalSocket *plsClient,
+        const QJsonObject &joRequest
+        );
+    void
+    QueueJob(
+        QLocalSocket *plsClient,
+        const QJsonObject &joRequest
+        );
+    void
+    StartNextJob(
+        const QString &strPort
+        );
+    MainWindow *
+    Engine(
+        const QString &strPort
+        );
+    QJsonArray
+    PortIndex(
+        );
+    void
+    SendEvent(
+        QLocalSocket *plsClient,
+        const QJsonObject &joEvent
+        );
+
+    QLocalServer lsServer;                          //Job submission socket
+    QHash<QString, MainWindow *> hashEngines;       //Warm engine per port, created on first use
+    QHash<QString, QList<FlashDaemonJob> > hashQueues; //Jobs waiting per port
+    QHash<QString, FlashDaemonJob> hashRunning;     //Job running per port
+    QHash<QString, QElapsedTimer> hashProgressTimers; //Time since the last progress event per port
+    QList<QSerialPortInfo> lstPortIndex;            //Cached list of serial ports
+    QElapsedTimer etmrPortIndex;                    //Age of the cached list of serial ports
+    quint64 nNextJobId = 1;                         //Used for jobs submitted without an ID
+};
+
+#endif // UWXFLASHDAEMON_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,443 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFlashHistory.cpp
+**
+** Notes: Local SQLite database of every flashing session, written in batches
+**        from a background thread so transfers never wait for the disk, and
+**        the throughput reports built from it
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxFlashHistory.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QStringList>
+#include <cstdlib>
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+static const char *aFlashHistorySchema[] =
+{
+    "PRAGMA journal_mode = WAL",
+    "PRAGMA synchronous = NORMAL",
+    "CREATE TABLE IF NOT EXISTS sessions (id INTEGER PRIMARY KEY, started_ms INTEGER NOT NULL, station TEXT, port TEXT, adapter TEXT, module_id TEXT, "
+        "version_before TEXT, version_after TEXT, firmware_sha256 TEXT, image_size INTEGER, detection_ms INTEGER, transfer_ms INTEGER, total_ms INTEGER, "
+        "bytes INTEGER, blocks INTEGER, retransmits INTEGER, small_blocks INTEGER, success INTEGER, message TEXT)",
+    "CREATE INDEX IF NOT EXISTS sessions_module ON sessions (module_id, started_ms)",
+    "CREATE INDEX IF NOT EXISTS sessions_started ON sessions (started_ms)"
+};
+
+//Report columns, in the order of FlashHistoryReportGroups
+static const char *aFlashHistoryReportColumns[] = {"station", "adapter", "firmware_sha256", "module_id"};
+static const char *aFlashHistoryReportTitles[] = {"Station", "Adapter", "Firmware SHA-256", "Module"};
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+FlashHistory &
+FlashHistory::Instance(
+    )
+{
+    static FlashHistory fhHistory;
+    return fhHistory;
+}
+
+//=============================================================================
+//=============================================================================
+FlashHistory::FlashHistory(
+    )
+{
+}
+
+//=============================================================================
+//=============================================================================
+FlashHistory::~FlashHistory(
+    )
+{
+    Close();
+}
+
+//=============================================================================
+//=============================================================================
+bool
+FlashHistory::Open(
+    const QString &strFilename,
+    QString *pstrError
+    )
+{
+    //Starts the writer, which opens (creating if needed) the database before this returns
+    if (bOpen.load() == true)
+    {
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(strFilename).absolutePath());
+    strDatabaseFilename = strFilename;
+    strOpenError.clear();
+    bStop = false;
+    start(QThread::LowPriority);
+    smOpened.acquire();
+    if (!strOpenError.isEmpty())
+    {
+        wait();
+        *pstrError = strOpenError;
+        return false;
+    }
+
+    bOpen.store(true);
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashHistory::OpenDefault(
+    )
+{
+    //Sessions are recorded from here on, a history that cannot be opened does not stop flashing
+    QString strError;
+    if (!Open(DefaultPath(), &strError))
+    {
+        QTextStream(stderr) << "Flash history disabled, unable to open " << DefaultPath() << ": " << strError << "\n";
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashHistory::Close(
+    )
+{
+    //Writes any records still waiting, then stops the writer
+    if (!isRunning())
+    {
+        return;
+    }
+
+    bOpen.store(false);
+    mtxPending.lock();
+    bStop = true;
+    wcPending.wakeOne();
+    mtxPending.unlock();
+    wait();
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashHistory::Append(
+    const FlashHistoryRecordStruct &fhrRecord
+    )
+{
+    //Only queues the record, the writer inserts it with the next batch
+    if (bOpen.load() == false)
+    {
+        return;
+    }
+
+    QMutexLocker mlLock(&mtxPending);
+    if (vecPending.count() >= FLASH_HISTORY_MAX_PENDING)
+    {
+        //Database is unavailable for longer than any transfer should wait on it
+        ++nDropped;
+        return;
+    }
+
+    vecPending.append(fhrRecord);
+    if (vecPending.count() >= FLASH_HISTORY_BATCH_SIZE)
+    {
+        wcPending.wakeOne();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+QString
+FlashHistory::DefaultPath(
+    )
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).filePath(strFlashHistoryFilename);
+}
+
+//=============================================================================
+//=============================================================================
+void
+FlashHistory::run(
+    )
+{
+    //The connection belongs to this thread, records are written once a batch
+    //has built up or the flush interval has passed
+    {
+        QSqlDatabase sdbDatabase = QSqlDatabase::addDatabase("QSQLITE", strFlashHistoryWriterConnection);
+        sdbDatabase.setDatabaseName(strDatabaseFilename);
+        sdbDatabase.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(FLASH_HISTORY_BUSY_TIMEOUT_MS));
+        if (!sdbDatabase.open())
+        {
+            strOpenError = sdbDatabase.lastError().text();
+        }
+        else
+        {
+            QSqlQuery sqQuery(sdbDatabase);
+            for (const char *pStatement : aFlashHistorySchema)
+            {
+                if (!sqQuery.exec(pStatement))
+                {
+                    strOpenError = sqQuery.lastError().text();
+                    break;
+                }
+            }
+            if (strOpenError.isEmpty())
+            {
+                sqQuery.exec(QString("PRAGMA user_version = %1").arg(FLASH_HISTORY_SCHEMA_VERSION));
+            }
+        }
+        smOpened.release();
+
+        while (strOpenError.isEmpty())
+        {
+            mtxPending.lock();
+            while (bStop == false && vecPending.count() < FLASH_HISTORY_BATCH_SIZE)
+            {
+                if (!wcPending.wait(&mtxPending, FLASH_HISTORY_FLUSH_INTERVAL_MS) && !vecPending.isEmpty())
+                {
+                    //Flush interval has passed with records waiting
+                    break;
+                }
+            }
+            QVector<FlashHistoryRecordStruct> vecBatch;
+            vecBatch.swap(vecPending);
+            bool bStopping = bStop;
+            quint64 nDroppedRecords = nDropped;
+            nDropped = 0;
+            mtxPending.unlock();
+
+            if (nDroppedRecords > 0)
+            {
+                QTextStream(stderr) << "Flash history: " << nDroppedRecords << " sessions were not recorded, the database was unavailable\n";
+            }
+            QString strError;
+            if (!vecBatch.isEmpty() && !WriteBatch(vecBatch, &strError))
+            {
+                QTextStream(stderr) << "Flash history: " << vecBatch.count() << " sessions were not recorded: " << strError << "\n";
+            }
+            if (bStopping == true)
+            {
+                break;
+            }
+        }
+        sdbDatabase.close();
+    }
+    QSqlDatabase::removeDatabase(strFlashHistoryWriterConnection);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+FlashHistory::WriteBatch(
+    const QVector<FlashHistoryRecordStruct> &vecBatch,
+    QString *pstrError
+    )
+{
+    //One transaction per batch, so many sessions cost a single commit
+    QSqlDatabase sdbDatabase = QSqlDatabase::database(strFlashHistoryWriterConnection, false);
+    if (!sdbDatabase.transaction())
+    {
+        *pstrError = sdbDatabase.lastError().text();
+        return false;
+    }
+
+    QSqlQuery sqInsert(sdbDatabase);
+    sqInsert.prepare("INSERT INTO sessions (started_ms, station, port, adapter, module_id, version_before, version_after, firmware_sha256, image_size, "
+                     "detection_ms, transfer_ms, total_ms, bytes, blocks, retransmits, small_blocks, success, message) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    foreach (const FlashHistoryRecordStruct &fhrRecord, vecBatch)
+    {
+        sqInsert.addBindValue(fhrRecord.nStartedMs);
+        sqInsert.addBindValue(fhrRecord.strStation);
+        sqInsert.addBindValue(fhrRecord.strPort);
+        sqInsert.addBindValue(fhrRecord.strAdapter);
+        sqInsert.addBindValue(fhrRecord.strModuleId);
+        sqInsert.addBindValue(fhrRecord.strVersionBefore);
+        sqInsert.addBindValue(fhrRecord.strVersionAfter);
+        sqInsert.addBindValue(fhrRecord.strFirmwareSHA256);
+        sqInsert.addBindValue(fhrRecord.nImageSize);
+        sqInsert.addBindValue(fhrRecord.nDetectionMs);
+        sqInsert.addBindValue(fhrRecord.nTransferMs);
+        sqInsert.addBindValue(fhrRecord.nTotalMs);
+        sqInsert.addBindValue(fhrRecord.nBytes);
+        sqInsert.addBindValue(fhrRecord.nBlocks);
+        sqInsert.addBindValue(fhrRecord.nRetransmits);
+        sqInsert.addBindValue(fhrRecord.nSmallBlocks);
+        sqInsert.addBindValue(fhrRecord.bSuccess == true ? 1 : 0);
+        sqInsert.addBindValue(fhrRecord.strMessage);
+        if (!sqInsert.exec())
+        {
+            *pstrError = sqInsert.lastError().text();
+            sdbDatabase.rollback();
+            return false;
+        }
+    }
+
+    if (!sdbDatabase.commit())
+    {
+        *pstrError = sdbDatabase.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+int
+FlashHistory::Report(
+    QTextStream &tsOutput,
+    const QString &strFilename,
+    FlashHistoryReportGroups nGroup
+    )
+{
+    //Sessions, success rate and data transfer throughput per station, adapter, firmware or module
+    if (!QFileInfo::exists(strFilename))
+    {
+        tsOutput << "No flash history at " << strFilename << "\n";
+        tsOutput.flush();
+        return EXIT_FAILURE;
+    }
+
+    int nResult = EXIT_SUCCESS;
+    {
+        QSqlDatabase sdbDatabase = QSqlDatabase::addDatabase("QSQLITE", strFlashHistoryReportConnection);
+        sdbDatabase.setDatabaseName(strFilename);
+        sdbDatabase.setConnectOptions(QString("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=%1").arg(FLASH_HISTORY_BUSY_TIMEOUT_MS));
+        QSqlQuery sqReport(sdbDatabase);
+        QString strColumn = aFlashHistoryReportColumns[nGroup];
+        if (!sdbDatabase.open() || !sqReport.exec(QString("SELECT %1, COUNT(*), SUM(success), SUM(bytes), SUM(transfer_ms), AVG(total_ms), SUM(retransmits), SUM(blocks) "
+                                                          "FROM sessions GROUP BY %1 ORDER BY %1").arg(strColumn)))
+        {
+            tsOutput << "Unable to read flash history " << strFilename << ": " << (sdbDatabase.isOpen() ? sqReport.lastError().text() : sdbDatabase.lastError().text()) << "\n";
+            nResult = EXIT_FAILURE;
+        }
+        else
+        {
+            QStringList lstKeys;
+            QVector<QStringList> vecRows;
+            while (sqReport.next())
+            {
+                QString strKey = sqReport.value(0).toString();
+                qint64 nSessions = sqReport.value(1).toLongLong();
+                qint64 nPassed = sqReport.value(2).toLongLong();
+                qint64 nBytes = sqReport.value(3).toLongLong();
+                qint64 nTransferMs = sqReport.value(4).toLongLong();
+                qint64 nBlocks = sqReport.value(7).toLongLong();
+                lstKeys.append(strKey.isEmpty() ? QString("(unknown)") : strKey);
+                vecRows.append(QStringList() << QString::number(nSessions) << QString::number(nPassed) << QString::number(nSessions - nPassed)
+                                             << (nTransferMs > 0 ? QString::number((double)nBytes * 1000.0 / nTransferMs / 1024.0, 'f', 1) : QString("-"))
+                                             << QString::number(sqReport.value(5).toDouble() / 1000.0, 'f', 1)
+                                             << (nBlocks > 0 ? QString::number(sqReport.value(6).toDouble() * 100.0 / nBlocks, 'f', 2) : QString("-")));
+            }
+
+            int nKeyWidth = QString(aFlashHistoryReportTitles[nGroup]).length();
+            foreach (const QString &strKey, lstKeys)
+            {
+                nKeyWidth = qMax(nKeyWidth, strKey.length());
+            }
+            tsOutput << QString(aFlashHistoryReportTitles[nGroup]).leftJustified(nKeyWidth + 2) << QString("Sessions").leftJustified(10) << QString("Passed").leftJustified(8)
+                     << QString("Failed").leftJustified(8) << QString("KiB/s").leftJustified(9) << QString("Avg s").leftJustified(9) << "Retransmit %\n";
+            int i = 0;
+            while (i < lstKeys.count())
+            {
+                const QStringList &lstRow = vecRows.at(i);
+                tsOutput << lstKeys.at(i).leftJustified(nKeyWidth + 2) << lstRow.at(0).leftJustified(10) << lstRow.at(1).leftJustified(8) << lstRow.at(2).leftJustified(8)
+                         << lstRow.at(3).leftJustified(9) << lstRow.at(4).leftJustified(9) << lstRow.at(5) << "\n";
+                ++i;
+            }
+        }
+        sdbDatabase.close();
+    }
+    QSqlDatabase::removeDatabase(strFlashHistoryReportConnection);
+    tsOutput.flush();
+
+    return nResult;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+FlashHistory::RecentUpgrades(
+    const QString &strFilename,
+    qint64 nSinceMs,
+    QVector<FlashHistoryUpgradeStruct> *pvecUpgrades,
+    QString *pstrError
+    )
+{
+    //Upgrades started since the given time, most frequent first. Can be called from any thread but only one at a time.
+    pvecUpgrades->clear();
+    if (!QFileInfo::exists(strFilename))
+    {
+        //Nothing has been recorded yet
+        return true;
+    }
+
+    bool bResult = true;
+    {
+        QSqlDatabase sdbDatabase = QSqlDatabase::addDatabase("QSQLITE", strFlashHistoryRecentConnection);
+        sdbDatabase.setDatabaseName(strFilename);
+        sdbDatabase.setConnectOptions(QString("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=%1").arg(FLASH_HISTORY_BUSY_TIMEOUT_MS));
+        QSqlQuery sqRecent(sdbDatabase);
+        if (!sdbDatabase.open() || !sqRecent.prepare("SELECT version_before, version_after, COUNT(*) FROM sessions WHERE started_ms >= ? AND version_before <> '' "
+                                                     "GROUP BY version_before, version_after ORDER BY COUNT(*) DESC"))
+        {
+            *pstrError = (sdbDatabase.isOpen() ? sqRecent.lastError().text() : sdbDatabase.lastError().text());
+            bResult = false;
+        }
+        else
+        {
+            sqRecent.addBindValue(nSinceMs);
+            if (!sqRecent.exec())
+            {
+                *pstrError = sqRecent.lastError().text();
+                bResult = false;
+            }
+
+            while (bResult == true && sqRecent.next())
+            {
+                FlashHistoryUpgradeStruct fhuUpgrade;
+                fhuUpgrade.strVersionBefore = sqRecent.value(0).toString();
+                fhuUpgrade.strVersionAfter = sqRecent.value(1).toString();
+                fhuUpgrade.nSessions = sqRecent.value(2).toLongLong();
+                pvecUpgrades->append(fhuUpgrade);
+            }
+        }
+        sdbDatabase.close();
+    }
+    QSqlDatabase::removeDatabase(strFlashHistoryRecentConnection);
+
+    return bResult;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,178 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFlashHistory.h
+**
+** Notes: Local SQLite database of every flashing session, written in batches
+**        from a background thread so transfers never wait for the disk, and
+**        the throughput reports built from it
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXFLASHHISTORY_H
+#define UWXFLASHHISTORY_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSemaphore>
+#include <QVector>
+#include <QString>
+#include <QTextStream>
+#include <atomic>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define FLASH_HISTORY_SCHEMA_VERSION              1
+#define FLASH_HISTORY_FLUSH_INTERVAL_MS           1000
+#define FLASH_HISTORY_BATCH_SIZE                  64
+#define FLASH_HISTORY_BUSY_TIMEOUT_MS             5000
+#define FLASH_HISTORY_MAX_PENDING                 4096
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const QString    strFlashHistoryFilename        = QString("flash_history.sqlite");
+const QString    strFlashHistoryWriterConnection = QString("FlashHistoryWriter");
+const QString    strFlashHistoryReportConnection = QString("FlashHistoryReport");
+const QString    strFlashHistoryRecentConnection = QString("FlashHistoryRecent");
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Enum used for what the history report is grouped by
+enum FlashHistoryReportGroups
+{
+    FlashHistoryReportGroupStation              = 0,
+    FlashHistoryReportGroupAdapter,
+    FlashHistoryReportGroupFirmware,
+    FlashHistoryReportGroupModule
+};
+
+//One flashing session, the module is identified by the serial number of the
+//USB serial adapter on its board
+typedef struct
+{
+    qint64 nStartedMs;
+    QString strStation;
+    QString strPort;
+    QString strAdapter;
+    QString strModuleId;
+    QString strVersionBefore;
+    QString strVersionAfter;
+    QString strFirmwareSHA256;
+    qint64 nImageSize;
+    qint64 nDetectionMs;
+    qint64 nTransferMs;
+    qint64 nTotalMs;
+    qint64 nBytes;
+    qint64 nBlocks;
+    qint64 nRetransmits;
+    qint64 nSmallBlocks;
+    bool bSuccess;
+    QString strMessage;
+} FlashHistoryRecordStruct;
+
+//Number of sessions which started from one version and finished on another,
+//the finishing version is empty for sessions which failed
+typedef struct
+{
+    QString strVersionBefore;
+    QString strVersionAfter;
+    qint64 nSessions;
+} FlashHistoryUpgradeStruct;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class FlashHistory : public QThread
+{
+    Q_OBJECT
+
+public:
+    static FlashHistory &
+    Instance(
+        );
+    ~FlashHistory(
+        );
+    bool
+    Open(
+        const QString &strFilename,
+        QString *pstrError
+        );
+    void
+    Append(
+        const FlashHistoryRecordStruct &fhrRecord
+        );
+    static QString
+    DefaultPath(
+        );
+    static int
+    Report(
+        QTextStream &tsOutput,
+        const QString &strFilename,
+        FlashHistoryReportGroups nGroup
+        );
+    static bool
+    RecentUpgrades(
+        const QString &strFilename,
+        qint64 nSinceMs,
+        QVector<FlashHistoryUpgradeStruct> *pvecUpgrades,
+        QString *pstrError
+        );
+
+public slots:
+    void
+    OpenDefault(
+        );
+    void
+    Close(
+        );
+
+protected:
+    void
+    run(
+        ) override;
+
+private:
+    FlashHistory(
+        );
+    bool
+    WriteBatch(
+        const QVector<FlashHistoryRecordStruct> &vecBatch,
+        QString *pstrError
+        );
+
+    std::atomic<bool> bOpen{false};                 //If sessions are being recorded
+    QString strDatabaseFilename;                    //Database being written
+    QString strOpenError;                           //Reason the writer could not open the database
+    QSemaphore smOpened;                            //Released once the writer has opened the database (or failed to)
+    QMutex mtxPending;                              //Protects the pending records and stop flag
+    QWaitCondition wcPending;                       //Wakes the writer when a batch is ready or it must stop
+    QVector<FlashHistoryRecordStruct> vecPending;   //Records waiting to be written
+    bool bStop = false;                             //If the writer should flush and exit
+    quint64 nDropped = 0;                           //Records discarded because the writer had fallen too far behind
+};
+
+#endif // UWXFLASHHISTORY_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,255 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFleetScanner.cpp
+**
+** Notes: Queries the module on every serial port at the same time and
+**        outputs an inventory of their modes and firmware versions
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxFleetScanner.h"
+#include "UwxMainWindow.h"
+#include <QSerialPortInfo>
+#include <QTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static QString
+CSVField(
+    const QString &strValue
+    )
+{
+    //Quotes a field if it contains a separator, quote or line break
+    if (strValue.contains(',') || strValue.contains('"') || strValue.contains('\n') || strValue.contains('\r'))
+    {
+        return QString("\"").append(QString(strValue).replace("\"", "\"\"")).append("\"");
+    }
+
+    return strValue;
+}
+
+//=============================================================================
+//=============================================================================
+FleetScanner::FleetScanner(QObject *parent) :
+    QObject(parent)
+{
+}
+
+//=============================================================================
+//=============================================================================
+FleetScanner::~FleetScanner(
+    )
+{
+    Cleanup();
+}
+
+//=============================================================================
+//=============================================================================
+int
+FleetScanner::Run(
+    QTextStream &tsOutput,
+    FleetScanFormats nFormat,
+    qint32 nBaudRate,
+    int nHandshake
+    )
+{
+    //Starts a query on every port at once, ports which do not answer in time are reported as such
+    etmrScan.start();
+    nQueriesRunning = 0;
+    foreach (const QSerialPortInfo &spiPort, QSerialPortInfo::availablePorts())
+    {
+        FleetScanEntry fseEntry;
+        fseEntry.strPort = spiPort.portName();
+        fseEntry.strSerialNumber = spiPort.serialNumber();
+        fseEntry.strDescription = spiPort.description();
+        fseEntry.pEngine = new MainWindow();
+        fseEntry.bFinished = true;
+        fseEntry.nDurationMs = 0;
+        fseEntry.pEngine->SetNonInteractive(true);
+        connect(fseEntry.pEngine, SIGNAL(QueryFinished(QString,QString,QString)), this, SLOT(EngineQueryFinished(QString,QString,QString)));
+
+        QString strError;
+        if (fseEntry.pEngine->StartQuery(fseEntry.strPort, nBaudRate, nHandshake, &strError))
+        {
+            fseEntry.bFinished = false;
+            ++nQueriesRunning;
+        }
+        else
+        {
+            fseEntry.strError = strError;
+        }
+        vecEntries.append(fseEntry);
+    }
+
+    if (nQueriesRunning > 0)
+    {
+        QTimer::singleShot(FLEET_SCAN_TIMEOUT_MS, &elWait, SLOT(quit()));
+        elWait.exec();
+    }
+
+    int i = 0;
+    while (i < vecEntries.count())
+    {
+        if (vecEntries.at(i).bFinished == false)
+        {
+            vecEntries[i].strError = strFleetScanNoResponse;
+            vecEntries[i].nDurationMs = etmrScan.elapsed();
+        }
+        ++i;
+    }
+
+    Output(tsOutput, nFormat);
+    Cleanup();
+
+    return EXIT_SUCCESS;
+}
+
+//=============================================================================
+//=============================================================================
+void
+FleetScanner::EngineQueryFinished(
+    QString strMode,
+    QString strFirmwareVersion,
+    QString strError
+    )
+{
+    MainWindow *pEngine = qobject_cast<MainWindow *>(sender());
+    int i = 0;
+    while (i < vecEntries.count())
+    {
+        if (vecEntries.at(i).pEngine == pEngine && vecEntries.at(i).bFinished == false)
+        {
+            vecEntries[i].bFinished = true;
+            vecEntries[i].strMode = strMode;
+            vecEntries[i].strFirmwareVersion = strFirmwareVersion;
+            vecEntries[i].strError = strError;
+            vecEntries[i].nDurationMs = etmrScan.elapsed();
+            --nQueriesRunning;
+            break;
+        }
+        ++i;
+    }
+
+    if (nQueriesRunning == 0)
+    {
+        elWait.quit();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+FleetScanner::Output(
+    QTextStream &tsOutput,
+    FleetScanFormats nFormat
+    )
+{
+    if (nFormat == FleetScanFormatJSON)
+    {
+        QJsonArray jaPorts;
+        foreach (const FleetScanEntry &fseEntry, vecEntries)
+        {
+            QJsonObject joPort;
+            joPort["port"] = fseEntry.strPort;
+            joPort["serial_number"] = fseEntry.strSerialNumber;
+            joPort["description"] = fseEntry.strDescription;
+            joPort["mode"] = fseEntry.strMode;
+            joPort["firmware_version"] = fseEntry.strFirmwareVersion;
+            joPort["error"] = fseEntry.strError;
+            joPort["duration_ms"] = fseEntry.nDurationMs;
+            jaPorts.append(joPort);
+        }
+        tsOutput << QJsonDocument(jaPorts).toJson(QJsonDocument::Indented);
+    }
+    else if (nFormat == FleetScanFormatCSV)
+    {
+        tsOutput << "port,serial_number,description,mode,firmware_version,error,duration_ms\n";
+        foreach (const FleetScanEntry &fseEntry, vecEntries)
+        {
+            tsOutput << CSVField(fseEntry.strPort) << "," << CSVField(fseEntry.strSerialNumber) << "," << CSVField(fseEntry.strDescription) << ","
+                     << CSVField(fseEntry.strMode) << "," << CSVField(fseEntry.strFirmwareVersion) << "," << CSVField(fseEntry.strError) << ","
+                     << fseEntry.nDurationMs << "\n";
+        }
+    }
+    else
+    {
+        //Columns are sized to their widest value
+        QStringList lstHeadings = QStringList() << "Port" << "Serial number" << "Mode" << "Firmware version" << "Notes";
+        QList<QStringList> lstRows;
+        foreach (const FleetScanEntry &fseEntry, vecEntries)
+        {
+            lstRows.append(QStringList() << fseEntry.strPort << fseEntry.strSerialNumber << fseEntry.strMode << fseEntry.strFirmwareVersion << fseEntry.strError);
+        }
+
+        QList<int> lstWidths;
+        foreach (const QString &strHeading, lstHeadings)
+        {
+            lstWidths.append(strHeading.length());
+        }
+        foreach (const QStringList &lstRow, lstRows)
+        {
+            int i = 0;
+            while (i < lstRow.count())
+            {
+                lstWidths[i] = qMax(lstWidths.at(i), lstRow.at(i).length());
+                ++i;
+            }
+        }
+
+        lstRows.prepend(lstHeadings);
+        foreach (const QStringList &lstRow, lstRows)
+        {
+            int i = 0;
+            while (i < lstRow.count())
+            {
+                tsOutput << (i == lstRow.count() - 1 ? lstRow.at(i) : QString(lstRow.at(i)).leftJustified(lstWidths.at(i) + 2));
+                ++i;
+            }
+            tsOutput << "\n";
+        }
+        tsOutput << vecEntries.count() << " ports scanned in " << etmrScan.elapsed() << " ms\n";
+    }
+    tsOutput.flush();
+}
+
+//=============================================================================
+//=============================================================================
+void
+FleetScanner::Cleanup(
+    )
+{
+    //Closing the engines closes any ports still open from queries which timed out
+    foreach (const FleetScanEntry &fseEntry, vecEntries)
+    {
+        disconnect(fseEntry.pEngine, SIGNAL(QueryFinished(QString,QString,QString)), this, SLOT(EngineQueryFinished(QString,QString,QString)));
+        delete fseEntry.pEngine;
+    }
+    vecEntries.clear();
+    nQueriesRunning = 0;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,123 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxFleetScanner.h
+**
+** Notes: Queries the module on every serial port at the same time and
+**        outputs an inventory of their modes and firmware versions
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXFLEETSCANNER_H
+#define UWXFLEETSCANNER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QTextStream>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QVector>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define FLEET_SCAN_TIMEOUT_MS                     2000
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const QString    strFleetScanNoResponse         = QString("No response");
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+class MainWindow;
+
+//Enum used for the inventory output format
+enum FleetScanFormats
+{
+    FleetScanFormatTable                        = 0,
+    FleetScanFormatCSV,
+    FleetScanFormatJSON
+};
+
+//Inventory entry for one serial port
+typedef struct
+{
+    QString strPort;
+    QString strSerialNumber;
+    QString strDescription;
+    MainWindow *pEngine;
+    bool bFinished;
+    QString strMode;
+    QString strFirmwareVersion;
+    QString strError;
+    qint64 nDurationMs;
+} FleetScanEntry;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class FleetScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    FleetScanner(
+        QObject *parent = 0
+        );
+    ~FleetScanner(
+        );
+    int
+    Run(
+        QTextStream &tsOutput,
+        FleetScanFormats nFormat,
+        qint32 nBaudRate,
+        int nHandshake
+        );
+
+private slots:
+    void
+    EngineQueryFinished(
+        QString strMode,
+        QString strFirmwareVersion,
+        QString strError
+        );
+
+private:
+    void
+    Output(
+        QTextStream &tsOutput,
+        FleetScanFormats nFormat
+        );
+    void
+    Cleanup(
+        );
+
+    QVector<FleetScanEntry> vecEntries;             //One entry per port, in enumeration order
+    int nQueriesRunning = 0;                        //Ports which have not answered yet
+    QEventLoop elWait;                              //Runs until every port has answered or the scan times out
+    QElapsedTimer etmrScan;                         //Time since the scan started
+};
+
+#endif // UWXFLEETSCANNER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
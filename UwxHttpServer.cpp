@@ -0,0 +1,194 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxHttpServer.cpp
+**
+** Notes: Minimal HTTP/1.0 server shared by the metrics endpoint and the
+**        firmware mirror, answers one GET per connection
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxHttpServer.h"
+#include <QList>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+HttpServer::HttpServer(QObject *parent) :
+    QObject(parent)
+{
+    connect(&tsServer, SIGNAL(newConnection()), this, SLOT(NewConnection()));
+}
+
+//=============================================================================
+//=============================================================================
+HttpServer::~HttpServer(
+    )
+{
+    disconnect(this, SLOT(NewConnection()));
+    tsServer.close();
+}
+
+//=============================================================================
+//=============================================================================
+bool
+HttpServer::Listen(
+    const QHostAddress &haAddress,
+    quint16 nPort,
+    QString *pstrError
+    )
+{
+    if (!tsServer.listen(haAddress, nPort))
+    {
+        *pstrError = tsServer.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+HttpServer::NewConnection(
+    )
+{
+    while (tsServer.hasPendingConnections())
+    {
+        QTcpSocket *tsClient = tsServer.nextPendingConnection();
+        connect(tsClient, SIGNAL(readyRead()), this, SLOT(ClientReadyRead()));
+        connect(tsClient, SIGNAL(disconnected()), tsClient, SLOT(deleteLater()));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+HttpServer::ClientReadyRead(
+    )
+{
+    //Passes a request on once its headers have been received, the body (if any) is ignored
+    QTcpSocket *tsClient = qobject_cast<QTcpSocket *>(sender());
+    if (tsClient == NULL)
+    {
+        return;
+    }
+
+    QByteArray baRequest = tsClient->peek(HTTP_SERVER_REQUEST_MAX_SIZE);
+    if (baRequest.indexOf("\r\n\r\n") == -1)
+    {
+        if (baRequest.length() >= HTTP_SERVER_REQUEST_MAX_SIZE)
+        {
+            tsClient->disconnectFromHost();
+        }
+        return;
+    }
+    tsClient->readAll();
+    disconnect(tsClient, SIGNAL(readyRead()), this, SLOT(ClientReadyRead()));
+
+    QList<QByteArray> lstRequestLine = baRequest.left(baRequest.indexOf("\r\n")).split(' ');
+    if (lstRequestLine.count() != 3)
+    {
+        Respond(tsClient, "400 Bad Request", "text/plain", QByteArray());
+        return;
+    }
+
+    emit Request(tsClient, lstRequestLine.at(0), QUrl(QString::fromLatin1(lstRequestLine.at(1))));
+}
+
+//=============================================================================
+//=============================================================================
+void
+HttpServer::Respond(
+    QTcpSocket *tsClient,
+    const QByteArray &baStatus,
+    const QByteArray &baContentType,
+    const QByteArray &baBody
+    )
+{
+    tsClient->write(QByteArray("HTTP/1.0 ").append(baStatus).append("\r\nContent-Type: ").append(baContentType).append("\r\nContent-Length: ").append(QByteArray::number(baBody.length())).append("\r\nConnection: close\r\n\r\n"));
+    tsClient->write(baBody);
+    tsClient->disconnectFromHost();
+}
+
+//=============================================================================
+//=============================================================================
+bool
+HttpServer::RespondFile(
+    QTcpSocket *tsClient,
+    const QByteArray &baContentType,
+    const QString &strPath
+    )
+{
+    //Sends a file without reading it all into memory, false if it cannot be opened
+    QFile *fpFile = new QFile(strPath);
+    if (!fpFile->open(QFile::ReadOnly))
+    {
+        delete fpFile;
+        return false;
+    }
+
+    tsClient->write(QByteArray("HTTP/1.0 200 OK\r\nContent-Type: ").append(baContentType).append("\r\nContent-Length: ").append(QByteArray::number(fpFile->size())).append("\r\nConnection: close\r\n\r\n"));
+    HttpFileStream *hfsStream = new HttpFileStream(tsClient, fpFile);
+    hfsStream->WriteNext();
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+HttpFileStream::HttpFileStream(
+    QTcpSocket *tsClient,
+    QFile *fpFile
+    ) : QObject(tsClient), tsClient(tsClient), fpFile(fpFile)
+{
+    fpFile->setParent(this);
+    connect(tsClient, SIGNAL(bytesWritten(qint64)), this, SLOT(WriteNext()));
+}
+
+//=============================================================================
+//=============================================================================
+void
+HttpFileStream::WriteNext(
+    )
+{
+    //Keeps at most one chunk queued on the socket
+    while (tsClient->bytesToWrite() < HTTP_SERVER_FILE_CHUNK_SIZE && !fpFile->atEnd())
+    {
+        QByteArray baChunk = fpFile->read(HTTP_SERVER_FILE_CHUNK_SIZE);
+        if (baChunk.isEmpty())
+        {
+            //Read error, the client sees a short body
+            break;
+        }
+        tsClient->write(baChunk);
+    }
+
+    if (fpFile->atEnd() || fpFile->error() != QFileDevice::NoError)
+    {
+        //Everything has been queued, the connection closes once it has been sent
+        disconnect(tsClient, SIGNAL(bytesWritten(qint64)), this, SLOT(WriteNext()));
+        fpFile->close();
+        tsClient->disconnectFromHost();
+    }
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,125 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxHttpServer.h
+**
+** Notes: Minimal HTTP/1.0 server shared by the metrics endpoint and the
+**        firmware mirror, answers one GET per connection
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXHTTPSERVER_H
+#define UWXHTTPSERVER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QUrl>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define HTTP_SERVER_REQUEST_MAX_SIZE              8192
+#define HTTP_SERVER_FILE_CHUNK_SIZE               65536
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class HttpServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    HttpServer(
+        QObject *parent = 0
+        );
+    ~HttpServer(
+        );
+    bool
+    Listen(
+        const QHostAddress &haAddress,
+        quint16 nPort,
+        QString *pstrError
+        );
+    static void
+    Respond(
+        QTcpSocket *tsClient,
+        const QByteArray &baStatus,
+        const QByteArray &baContentType,
+        const QByteArray &baBody
+        );
+    static bool
+    RespondFile(
+        QTcpSocket *tsClient,
+        const QByteArray &baContentType,
+        const QString &strPath
+        );
+
+signals:
+    void
+    Request(
+        QTcpSocket *tsClient,
+        QByteArray baMethod,
+        QUrl urlTarget
+        );
+
+private slots:
+    void
+    NewConnection(
+        );
+    void
+    ClientReadyRead(
+        );
+
+private:
+    QTcpServer tsServer;                            //Accepts the connections, one request each
+};
+
+//Writes a file to a client a chunk at a time as the socket drains, owned by
+//the socket so it goes away with the connection
+class HttpFileStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    HttpFileStream(
+        QTcpSocket *tsClient,
+        QFile *fpFile
+        );
+
+public slots:
+    void
+    WriteNext(
+        );
+
+private:
+    QTcpSocket *tsClient;                           //Connection the file is written to
+    QFile *fpFile;                                  //Open file being sent, owned by this stream
+};
+
+#endif // UWXHTTPSERVER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
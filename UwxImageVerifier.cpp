@@ -0,0 +1,315 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxImageVerifier.cpp
+**
+** Notes: Background integrity verification of firmware upgrade files
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxImageVerifier.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCryptographicHash>
+#include <QtConcurrent/QtConcurrentRun>
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Hash of a file along with the file state it was calculated for
+typedef struct
+{
+    qint64 nSize;
+    qint64 nModifiedMs;
+    QByteArray baSHA256;
+} ImageHashCacheEntry;
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static QMutex mtxHashCache;
+static QHash<QString, ImageHashCacheEntry> hashHashCache;
+
+//=============================================================================
+//=============================================================================
+ImageVerifier::ImageVerifier(QObject *parent) :
+    QObject(parent)
+{
+    connect(&fwVerification, SIGNAL(finished()), this, SLOT(VerificationFinished()));
+    connect(&fwCachedCheck, SIGNAL(finished()), this, SLOT(CheckCachedFinished()));
+}
+
+//=============================================================================
+//=============================================================================
+void
+ImageVerifier::Start(
+    const QString &strFilename,
+    const QString &strExpectedSHA256
+    )
+{
+    //Hash the file on the global thread pool, a previous job that is still running is superseded
+    fwVerification.setFuture(QtConcurrent::run(&ImageVerifier::Verify, strFilename, strExpectedSHA256));
+}
+
+//=============================================================================
+//=============================================================================
+bool
+ImageVerifier::IsRunning(
+    ) const
+{
+    return fwVerification.isRunning();
+}
+
+//=============================================================================
+//=============================================================================
+void
+ImageVerifier::CheckCached(
+    const QStringList &lstPaths,
+    const QStringList &lstSHA256
+    )
+{
+    //Checks which files are missing or damaged on the global thread pool, a previous check that is still running is superseded
+    fwCachedCheck.setFuture(QtConcurrent::run(&ImageVerifier::MissingFiles, lstPaths, lstSHA256));
+}
+
+//=============================================================================
+//=============================================================================
+bool
+ImageVerifier::IsCheckingCached(
+    ) const
+{
+    return fwCachedCheck.isRunning();
+}
+
+//=============================================================================
+//=============================================================================
+QByteArray
+ImageVerifier::HashFile(
+    const QString &strFilename,
+    qint64 *pnSize
+    )
+{
+    //Streams the file through SHA-256 in fixed size chunks, returns an empty array if the file could not be read
+    QFile fpFile(strFilename);
+    if (!fpFile.open(QFile::ReadOnly))
+    {
+        return QByteArray();
+    }
+
+    QCryptographicHash chHash(QCryptographicHash::Sha256);
+    QByteArray baChunk;
+    baChunk.resize(IMAGE_VERIFY_CHUNK_SIZE);
+    qint64 nRead;
+    while ((nRead = fpFile.read(baChunk.data(), IMAGE_VERIFY_CHUNK_SIZE)) > 0)
+    {
+        chHash.addData(baChunk.constData(), nRead);
+    }
+
+    if (pnSize != NULL)
+    {
+        *pnSize = fpFile.size();
+    }
+    fpFile.close();
+
+    return (nRead < 0 ? QByteArray() : chHash.result().toHex());
+}
+
+//=============================================================================
+//=============================================================================
+QByteArray
+ImageVerifier::CachedHashFile(
+    const QString &strFilename
+    )
+{
+    //As HashFile, but a file which has not changed (same size and modification time) since it was last hashed is not read again
+    QFileInfo fiFile(strFilename);
+    QString strKey = fiFile.absoluteFilePath();
+    qint64 nModifiedMs = fiFile.lastModified().toMSecsSinceEpoch();
+    {
+        QMutexLocker mlLock(&mtxHashCache);
+        QHash<QString, ImageHashCacheEntry>::const_iterator itEntry = hashHashCache.constFind(strKey);
+        if (itEntry != hashHashCache.constEnd() && itEntry->nSize == fiFile.size() && itEntry->nModifiedMs == nModifiedMs)
+        {
+            return itEntry->baSHA256;
+        }
+    }
+
+    qint64 nSize = 0;
+    ImageHashCacheEntry hceEntry;
+    hceEntry.baSHA256 = HashFile(strFilename, &nSize);
+    hceEntry.nSize = nSize;
+    hceEntry.nModifiedMs = nModifiedMs;
+    if (!hceEntry.baSHA256.isEmpty())
+    {
+        QMutexLocker mlLock(&mtxHashCache);
+        hashHashCache.insert(strKey, hceEntry);
+    }
+
+    return hceEntry.baSHA256;
+}
+
+//=============================================================================
+//=============================================================================
+ImageVerificationResult
+ImageVerifier::Verify(
+    const QString &strFilename,
+    const QString &strExpectedSHA256
+    )
+{
+    //Runs on a worker thread: sanity checks the image header, shares the image with other engines
+    //then checks the hash against the reference
+    ImageVerificationResult ivrResult;
+    ivrResult.bValid = false;
+    ivrResult.bReferenceFound = false;
+    ivrResult.nSize = 0;
+    ivrResult.strFilename = strFilename;
+
+    QFile fpFile(strFilename);
+    if (!fpFile.open(QFile::ReadOnly))
+    {
+        ivrResult.strError = QString("unable to open file: ").append(fpFile.errorString());
+        return ivrResult;
+    }
+    ivrResult.nSize = fpFile.size();
+    QByteArray baHeader = fpFile.peek(IMAGE_MINIMUM_SIZE);
+    fpFile.close();
+
+    if (ivrResult.nSize < IMAGE_MINIMUM_SIZE)
+    {
+        ivrResult.strError = QString("file is too small to be a FOTA image (").append(QString::number(ivrResult.nSize)).append(" bytes)");
+        return ivrResult;
+    }
+    else if (baHeader.trimmed().startsWith('<') || baHeader.trimmed().startsWith('{'))
+    {
+        //A server error page or JSON response that was saved instead of an image
+        ivrResult.strError = "file contains text (HTML/JSON) rather than a FOTA image";
+        return ivrResult;
+    }
+
+    //Find the reference hash: the catalog entry takes precedence over a sidecar file
+    QString strReference = strExpectedSHA256.trimmed().toLower();
+    if (strReference.isEmpty())
+    {
+        QFile fpSidecar(QString(strFilename).append(strSHA256SidecarExtension));
+        if (fpSidecar.open(QFile::ReadOnly))
+        {
+            //Format is that of sha256sum: hash followed by the filename
+            strReference = QString(fpSidecar.read(IMAGE_SHA256_HEX_LENGTH)).trimmed().toLower();
+            fpSidecar.close();
+        }
+    }
+
+    //Images are shared under their hash. With a reference the copy is hashed as it is made, so
+    //publishing reads the file only once, otherwise the key has to be hashed first.
+    QString strShareKey = strReference;
+    if (strShareKey.isEmpty())
+    {
+        ivrResult.strSHA256 = CachedHashFile(strFilename);
+        strShareKey = ivrResult.strSHA256;
+    }
+
+    if (!strShareKey.isEmpty())
+    {
+        ivrResult.spImage = QSharedPointer<SharedImage>(new SharedImage());
+        if (ivrResult.spImage->Open(strFilename, strShareKey, ivrResult.nSize, &ivrResult.strShareError))
+        {
+            //Hashed whilst copying here, or by the engine which published it. The file itself is not
+            //read when the copy was already published, so the caller must send the shared copy.
+            ivrResult.strSHA256 = strShareKey;
+        }
+        else
+        {
+            ivrResult.spImage.clear();
+        }
+    }
+
+    if (ivrResult.strSHA256.isEmpty())
+    {
+        ivrResult.strSHA256 = CachedHashFile(strFilename);
+    }
+
+    if (ivrResult.strSHA256.isEmpty())
+    {
+        ivrResult.strError = "unable to read file";
+        return ivrResult;
+    }
+
+    if (!strReference.isEmpty())
+    {
+        ivrResult.bReferenceFound = true;
+        if (strReference != ivrResult.strSHA256)
+        {
+            ivrResult.strError = QString("SHA-256 mismatch (expected ").append(strReference).append(", got ").append(ivrResult.strSHA256).append(")");
+            return ivrResult;
+        }
+    }
+
+    ivrResult.bValid = true;
+    return ivrResult;
+}
+
+//=============================================================================
+//=============================================================================
+QList<int>
+ImageVerifier::MissingFiles(
+    const QStringList &lstPaths,
+    const QStringList &lstSHA256
+    )
+{
+    //Runs on a worker thread: returns the positions of the files which do not exist or do not match their hash
+    QList<int> lstMissing;
+    int i = 0;
+    while (i < lstPaths.count())
+    {
+        if (!QFileInfo::exists(lstPaths.at(i)) || CachedHashFile(lstPaths.at(i)) != lstSHA256.at(i).toLower().toLatin1())
+        {
+            lstMissing.append(i);
+        }
+        ++i;
+    }
+
+    return lstMissing;
+}
+
+//=============================================================================
+//=============================================================================
+void
+ImageVerifier::VerificationFinished(
+    )
+{
+    emit Finished(fwVerification.result());
+}
+
+//=============================================================================
+//=============================================================================
+void
+ImageVerifier::CheckCachedFinished(
+    )
+{
+    emit CachedChecked(fwCachedCheck.result());
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
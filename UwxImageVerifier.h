@@ -0,0 +1,141 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxImageVerifier.h
+**
+** Notes: Background integrity verification of firmware upgrade files
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXIMAGEVERIFIER_H
+#define UWXIMAGEVERIFIER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QStringList>
+#include <QList>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include "UwxSharedImage.h"
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define IMAGE_VERIFY_CHUNK_SIZE                   65536
+#define IMAGE_MINIMUM_SIZE                        256
+#define IMAGE_SHA256_HEX_LENGTH                   64
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const QString    strSHA256SidecarExtension      = QString(".sha256");
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Outcome of verifying a firmware upgrade file
+typedef struct
+{
+    bool bValid;
+    bool bReferenceFound;
+    qint64 nSize;
+    QString strFilename;
+    QString strSHA256;
+    QString strError;
+    QSharedPointer<SharedImage> spImage;
+    QString strShareError;
+} ImageVerificationResult;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class ImageVerifier : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    ImageVerifier(
+        QObject *parent = 0
+        );
+    void
+    Start(
+        const QString &strFilename,
+        const QString &strExpectedSHA256
+        );
+    bool
+    IsRunning(
+        ) const;
+    void
+    CheckCached(
+        const QStringList &lstPaths,
+        const QStringList &lstSHA256
+        );
+    bool
+    IsCheckingCached(
+        ) const;
+    static QByteArray
+    HashFile(
+        const QString &strFilename,
+        qint64 *pnSize = NULL
+        );
+    static QByteArray
+    CachedHashFile(
+        const QString &strFilename
+        );
+    static ImageVerificationResult
+    Verify(
+        const QString &strFilename,
+        const QString &strExpectedSHA256
+        );
+    static QList<int>
+    MissingFiles(
+        const QStringList &lstPaths,
+        const QStringList &lstSHA256
+        );
+
+signals:
+    void
+    Finished(
+        ImageVerificationResult ivrResult
+        );
+    void
+    CachedChecked(
+        QList<int> lstMissing
+        );
+
+private slots:
+    void
+    VerificationFinished(
+        );
+    void
+    CheckCachedFinished(
+        );
+
+private:
+    QFutureWatcher<ImageVerificationResult> fwVerification; //Watches the hashing job running on the thread pool
+    QFutureWatcher<QList<int>> fwCachedCheck;       //Watches the cached file check running on the thread pool
+};
+
+#endif // UWXIMAGEVERIFIER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,237 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxLineWatchdog.cpp
+**
+** Notes: Watches the progress of a session and escalates through bounded
+**        recovery steps when the module stops responding, quarantining the
+**        port if none of them bring it back
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxLineWatchdog.h"
+#include <QHash>
+#include <QDateTime>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+//Engines all run on the main thread so these need no locking
+static QHash<QString, LineQuarantineStruct> hashQuarantinedPorts;
+static bool bLineResetWired = false;
+
+//=============================================================================
+//=============================================================================
+LineWatchdog::LineWatchdog(
+    QObject *parent
+    ) : QObject(parent)
+{
+    connect(&tmrStep, SIGNAL(timeout()), this, SIGNAL(Expired()));
+    tmrStep.setSingleShot(true);
+}
+
+//=============================================================================
+//=============================================================================
+void
+LineWatchdog::Arm(
+    )
+{
+    //Called once the port has been opened for a session
+    bArmed = true;
+    nStep = LineRecoveryStepNone;
+    tmrStep.start(LINE_WATCHDOG_STALL_MS);
+}
+
+//=============================================================================
+//=============================================================================
+void
+LineWatchdog::Heartbeat(
+    )
+{
+    //The session has made progress, any recovery has worked
+    if (bArmed == false)
+    {
+        return;
+    }
+
+    nStep = LineRecoveryStepNone;
+    tmrStep.start(LINE_WATCHDOG_STALL_MS);
+}
+
+//=============================================================================
+//=============================================================================
+void
+LineWatchdog::Disarm(
+    )
+{
+    bArmed = false;
+    nStep = LineRecoveryStepNone;
+    tmrStep.stop();
+}
+
+//=============================================================================
+//=============================================================================
+LineRecoverySteps
+LineWatchdog::Escalate(
+    )
+{
+    //Moves on to the next step and starts its timeout, the reset is skipped
+    //unless the fixture wires the control lines to the module
+    if (nStep == LineRecoveryStepNone)
+    {
+        nStep = LineRecoveryStepReprobe;
+        tmrStep.start(LINE_WATCHDOG_REPROBE_MS);
+    }
+    else if (nStep == LineRecoveryStepReprobe && bLineResetWired == true)
+    {
+        nStep = LineRecoveryStepReset;
+        tmrStep.start(LINE_WATCHDOG_RESET_MS);
+    }
+    else if (nStep == LineRecoveryStepReprobe || nStep == LineRecoveryStepReset)
+    {
+        nStep = LineRecoveryStepBootloader;
+        tmrStep.start(LINE_WATCHDOG_BOOTLOADER_MS);
+    }
+    else
+    {
+        //Nothing left to try
+        Disarm();
+        return LineRecoveryStepQuarantine;
+    }
+
+    return nStep;
+}
+
+//=============================================================================
+//=============================================================================
+LineRecoverySteps
+LineWatchdog::Step(
+    ) const
+{
+    return nStep;
+}
+
+//=============================================================================
+//=============================================================================
+void
+LineWatchdog::SetResetWired(
+    bool bWired
+    )
+{
+    bLineResetWired = bWired;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+LineWatchdog::IsQuarantined(
+    const QString &strPort,
+    QString *pstrReason
+    )
+{
+    if (!hashQuarantinedPorts.contains(strPort))
+    {
+        return false;
+    }
+
+    const LineQuarantineStruct &lqsPort = hashQuarantinedPorts[strPort];
+    *pstrReason = QString("Serial port '").append(strPort).append("' was quarantined at ").append(QDateTime::fromMSecsSinceEpoch(lqsPort.nQuarantinedMs).toString("HH:mm:ss")).append(": ").append(lqsPort.strReason);
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+LineWatchdog::Quarantine(
+    const QString &strPort,
+    const QString &strSerialNumber,
+    const QString &strReason
+    )
+{
+    LineQuarantineStruct lqsPort;
+    lqsPort.strReason = strReason;
+    lqsPort.strSerialNumber = strSerialNumber;
+    lqsPort.nQuarantinedMs = QDateTime::currentMSecsSinceEpoch();
+    lqsPort.bMissing = false;
+    hashQuarantinedPorts.insert(strPort, lqsPort);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+LineWatchdog::Release(
+    const QString &strPort
+    )
+{
+    //Once the module has been replugged or replaced
+    return (hashQuarantinedPorts.remove(strPort) > 0);
+}
+
+//=============================================================================
+//=============================================================================
+QStringList
+LineWatchdog::ReleaseReplugged(
+    const QList<QSerialPortInfo> &lstPorts
+    )
+{
+    //Called with each enumeration of the serial ports. A port is released once it has
+    //been missing from an enumeration and come back, or has a module with another
+    //serial number, anything else is the same module still attached.
+    QHash<QString, QString> hashPresent;
+    foreach (const QSerialPortInfo &spiPort, lstPorts)
+    {
+        hashPresent.insert(spiPort.portName(), spiPort.serialNumber());
+    }
+
+    QStringList lstReleased;
+    QHash<QString, LineQuarantineStruct>::iterator itPort = hashQuarantinedPorts.begin();
+    while (itPort != hashQuarantinedPorts.end())
+    {
+        if (!hashPresent.contains(itPort.key()))
+        {
+            itPort->bMissing = true;
+            ++itPort;
+        }
+        else if (itPort->bMissing == true || hashPresent.value(itPort.key()) != itPort->strSerialNumber)
+        {
+            lstReleased.append(itPort.key());
+            itPort = hashQuarantinedPorts.erase(itPort);
+        }
+        else
+        {
+            ++itPort;
+        }
+    }
+
+    return lstReleased;
+}
+
+//=============================================================================
+//=============================================================================
+QStringList
+LineWatchdog::QuarantinedPorts(
+    )
+{
+    return hashQuarantinedPorts.keys();
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,140 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxLineWatchdog.h
+**
+** Notes: Watches the progress of a session and escalates through bounded
+**        recovery steps when the module stops responding, quarantining the
+**        port if none of them bring it back
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXLINEWATCHDOG_H
+#define UWXLINEWATCHDOG_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QTimer>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QSerialPortInfo>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define LINE_WATCHDOG_STALL_MS                    15000
+#define LINE_WATCHDOG_REPROBE_MS                  5000
+#define LINE_WATCHDOG_RESET_MS                    15000
+#define LINE_WATCHDOG_BOOTLOADER_MS               15000
+#define LINE_WATCHDOG_RESET_PULSE_MS              100
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Recovery steps in the order they are tried
+enum LineRecoverySteps
+{
+    LineRecoveryStepNone                        = 0,
+    LineRecoveryStepReprobe,
+    LineRecoveryStepReset,
+    LineRecoveryStepBootloader,
+    LineRecoveryStepQuarantine
+};
+
+//Port which will not be used again until it is released
+typedef struct
+{
+    QString strReason;
+    QString strSerialNumber;
+    qint64 nQuarantinedMs;
+    bool bMissing;
+} LineQuarantineStruct;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+//One per engine, the engine acts on each step. Quarantined ports and the
+//fixture wiring are shared by every engine in the process.
+class LineWatchdog : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    LineWatchdog(
+        QObject *parent = 0
+        );
+    void
+    Arm(
+        );
+    void
+    Heartbeat(
+        );
+    void
+    Disarm(
+        );
+    LineRecoverySteps
+    Escalate(
+        );
+    LineRecoverySteps
+    Step(
+        ) const;
+    static void
+    SetResetWired(
+        bool bWired
+        );
+    static bool
+    IsQuarantined(
+        const QString &strPort,
+        QString *pstrReason
+        );
+    static void
+    Quarantine(
+        const QString &strPort,
+        const QString &strSerialNumber,
+        const QString &strReason
+        );
+    static bool
+    Release(
+        const QString &strPort
+        );
+    static QStringList
+    ReleaseReplugged(
+        const QList<QSerialPortInfo> &lstPorts
+        );
+    static QStringList
+    QuarantinedPorts(
+        );
+
+signals:
+    void
+    Expired(
+        );
+
+private:
+    QTimer tmrStep;                                 //Time left for the module to make progress in the current step
+    LineRecoverySteps nStep = LineRecoveryStepNone; //Last recovery step taken, none whilst the session is progressing
+    bool bArmed = false;                            //If a session is being watched
+};
+
+#endif // UWXLINEWATCHDOG_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,211 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxLinkProfiles.cpp
+**
+** Notes: Learns the transfer performance of each USB serial adapter at every
+**        baud rate and handshaking setting it has been used with, so the
+**        fastest reliable settings can be chosen for it automatically
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxLinkProfiles.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QJsonDocument>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static QString
+SettingKey(
+    qint32 nBaudRate,
+    int nHandshake
+    )
+{
+    return QString::number(nBaudRate).append("/").append(QString::number(nHandshake));
+}
+
+//=============================================================================
+//=============================================================================
+QString
+LinkProfiles::AdapterKey(
+    const QSerialPortInfo &spiPort
+    )
+{
+    //Only USB adapters can be recognised again, built-in ports have no identity
+    if (!spiPort.hasVendorIdentifier() || !spiPort.hasProductIdentifier())
+    {
+        return QString();
+    }
+
+    return QString("%1:%2:%3").arg(spiPort.vendorIdentifier(), 4, 16, QChar('0')).arg(spiPort.productIdentifier(), 4, 16, QChar('0')).arg(spiPort.serialNumber());
+}
+
+//=============================================================================
+//=============================================================================
+bool
+LinkProfiles::Record(
+    const QString &strAdapter,
+    const LinkProfileStruct &lpsSample
+    )
+{
+    //Re-read before updating so other instances sharing the file are not overwritten
+    if (strAdapter.isEmpty())
+    {
+        return false;
+    }
+
+    QJsonObject joDatabase = Load();
+    QJsonObject joAdapters = joDatabase["adapters"].toObject();
+    QJsonObject joAdapter = joAdapters[strAdapter].toObject();
+    QJsonObject joSettings = joAdapter["settings"].toObject();
+    QString strSetting = SettingKey(lpsSample.nBaudRate, lpsSample.nHandshake);
+    QJsonObject joSetting = joSettings[strSetting].toObject();
+
+    joSetting["baud"] = lpsSample.nBaudRate;
+    joSetting["handshake"] = lpsSample.nHandshake;
+    joSetting["sessions"] = (double)(joSetting["sessions"].toDouble() + lpsSample.nSessions);
+    joSetting["failures"] = (double)(joSetting["failures"].toDouble() + lpsSample.nFailures);
+    joSetting["bytes"] = (double)(joSetting["bytes"].toDouble() + lpsSample.nBytes);
+    joSetting["transfer_ms"] = (double)(joSetting["transfer_ms"].toDouble() + lpsSample.nTransferMs);
+    joSetting["blocks"] = (double)(joSetting["blocks"].toDouble() + lpsSample.nBlocks);
+    joSetting["retransmits"] = (double)(joSetting["retransmits"].toDouble() + lpsSample.nRetransmits);
+    joSetting["ack_us"] = (double)(joSetting["ack_us"].toDouble() + lpsSample.nAckUs);
+
+    joSettings[strSetting] = joSetting;
+    joAdapter["settings"] = joSettings;
+    joAdapters[strAdapter] = joAdapter;
+    joDatabase["version"] = LINK_PROFILES_VERSION;
+    joDatabase["adapters"] = joAdapters;
+
+    QSaveFile fpDatabase(Path());
+    if (!fpDatabase.open(QFile::WriteOnly))
+    {
+        return false;
+    }
+    fpDatabase.write(QJsonDocument(joDatabase).toJson(QJsonDocument::Indented));
+
+    return fpDatabase.commit();
+}
+
+//=============================================================================
+//=============================================================================
+bool
+LinkProfiles::Best(
+    const QString &strAdapter,
+    LinkProfileStruct *plpsBest
+    )
+{
+    //Fastest setting which has completed transfers without too many failures or NACKs
+    if (strAdapter.isEmpty())
+    {
+        return false;
+    }
+
+    bool bFound = false;
+    QJsonObject joSettings = Load().value("adapters").toObject().value(strAdapter).toObject().value("settings").toObject();
+    foreach (const QString &strSetting, joSettings.keys())
+    {
+        QJsonObject joSetting = joSettings[strSetting].toObject();
+        LinkProfileStruct lpsProfile;
+        lpsProfile.nBaudRate = joSetting["baud"].toInt();
+        lpsProfile.nHandshake = joSetting["handshake"].toInt();
+        lpsProfile.nSessions = (qint64)joSetting["sessions"].toDouble();
+        lpsProfile.nFailures = (qint64)joSetting["failures"].toDouble();
+        lpsProfile.nBytes = (qint64)joSetting["bytes"].toDouble();
+        lpsProfile.nTransferMs = (qint64)joSetting["transfer_ms"].toDouble();
+        lpsProfile.nBlocks = (qint64)joSetting["blocks"].toDouble();
+        lpsProfile.nRetransmits = (qint64)joSetting["retransmits"].toDouble();
+        lpsProfile.nAckUs = (qint64)joSetting["ack_us"].toDouble();
+
+        if (lpsProfile.nBaudRate <= 0 || lpsProfile.nSessions <= lpsProfile.nFailures || lpsProfile.nBytes <= 0 || lpsProfile.nTransferMs <= 0)
+        {
+            //Has never completed a transfer
+            continue;
+        }
+        else if ((double)lpsProfile.nFailures / lpsProfile.nSessions > LINK_PROFILES_MAX_FAILURE_RATE || NackRate(lpsProfile) > LINK_PROFILES_MAX_NACK_RATE)
+        {
+            //Unreliable with this adapter
+            continue;
+        }
+
+        if (bFound == false || Throughput(lpsProfile) > Throughput(*plpsBest))
+        {
+            *plpsBest = lpsProfile;
+            bFound = true;
+        }
+    }
+
+    return bFound;
+}
+
+//=============================================================================
+//=============================================================================
+double
+LinkProfiles::Throughput(
+    const LinkProfileStruct &lpsProfile
+    )
+{
+    //Bytes per second over the data transfer phase of every session
+    return (lpsProfile.nTransferMs > 0 ? (double)lpsProfile.nBytes * 1000.0 / lpsProfile.nTransferMs : 0.0);
+}
+
+//=============================================================================
+//=============================================================================
+double
+LinkProfiles::NackRate(
+    const LinkProfileStruct &lpsProfile
+    )
+{
+    return (lpsProfile.nBlocks > 0 ? (double)lpsProfile.nRetransmits / lpsProfile.nBlocks : 0.0);
+}
+
+//=============================================================================
+//=============================================================================
+QString
+LinkProfiles::Path(
+    )
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).filePath(strLinkProfilesFilename);
+}
+
+//=============================================================================
+//=============================================================================
+QJsonObject
+LinkProfiles::Load(
+    )
+{
+    //A missing or damaged database is treated as empty
+    QFile fpDatabase(Path());
+    if (!fpDatabase.open(QFile::ReadOnly))
+    {
+        return QJsonObject();
+    }
+
+    QJsonObject joDatabase = QJsonDocument::fromJson(fpDatabase.readAll()).object();
+    return (joDatabase["version"].toInt() == LINK_PROFILES_VERSION ? joDatabase : QJsonObject());
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,107 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxLinkProfiles.h
+**
+** Notes: Learns the transfer performance of each USB serial adapter at every
+**        baud rate and handshaking setting it has been used with, so the
+**        fastest reliable settings can be chosen for it automatically
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXLINKPROFILES_H
+#define UWXLINKPROFILES_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QString>
+#include <QSerialPortInfo>
+#include <QJsonObject>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define LINK_PROFILES_VERSION                     1
+#define LINK_PROFILES_MAX_FAILURE_RATE            0.2
+#define LINK_PROFILES_MAX_NACK_RATE               0.02
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const QString    strLinkProfilesFilename        = QString("link_profiles.json");
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Totals for one adapter at one baud rate and handshaking setting, a single
+//transfer is recorded as a sample with a session count of 1
+typedef struct
+{
+    qint32 nBaudRate;
+    int nHandshake;
+    qint64 nSessions;
+    qint64 nFailures;
+    qint64 nBytes;
+    qint64 nTransferMs;
+    qint64 nBlocks;
+    qint64 nRetransmits;
+    qint64 nAckUs;
+} LinkProfileStruct;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class LinkProfiles
+{
+public:
+    static QString
+    AdapterKey(
+        const QSerialPortInfo &spiPort
+        );
+    static bool
+    Record(
+        const QString &strAdapter,
+        const LinkProfileStruct &lpsSample
+        );
+    static bool
+    Best(
+        const QString &strAdapter,
+        LinkProfileStruct *plpsBest
+        );
+    static double
+    Throughput(
+        const LinkProfileStruct &lpsProfile
+        );
+    static double
+    NackRate(
+        const LinkProfileStruct &lpsProfile
+        );
+
+private:
+    static QString
+    Path(
+        );
+    static QJsonObject
+    Load(
+        );
+};
+
+#endif // UWXLINKPROFILES_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
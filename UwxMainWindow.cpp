@@ -26,10 +26,28 @@
 /******************************************************************************/
 #include "UwxMainWindow.h"
 #include "ui_UwxMainWindow.h"
+#include "UwxUpgradePlanner.h"
+#include "UwxRealtimeProfile.h"
+#include "UwxStartupProfile.h"
 #include <QMessageBox>
+#include <QApplication>
 #include <QStandardPaths>
 #include <QDesktopServices>
 #include <QCryptographicHash>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QDateTime>
+#include <QSysInfo>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <QtConcurrent/QtConcurrentRun>
+#ifdef Q_OS_LINUX
+#include <sys/ioctl.h>
+#endif
 
 /******************************************************************************/
 // Conditional Compile Defines
@@ -82,6 +100,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
+    StartupProfile::Mark("Main window UI");
 
     if (!QDir().exists(QStandardPaths::writableLocation(QStandardPaths::DataLocation)))
     {
@@ -102,36 +121,45 @@ MainWindow::MainWindow(QWidget *parent) :
     //Connect timer signals
     connect(&tmrBootloaderEntranceTimer, SIGNAL(timeout()), this, SLOT(BootloaderEntranceTimerTimeout()));
     tmrBootloaderEntranceTimer.setSingleShot(false);
+    connect(&tmrModemRestartTimer, SIGNAL(timeout()), this, SLOT(ModemRestartTimerTimeout()));
+    tmrModemRestartTimer.setSingleShot(true);
+    connect(&lwLine, SIGNAL(Expired()), this, SLOT(LineWatchdogExpired()));
+    connect(&tmrWarmSessionIdle, SIGNAL(timeout()), this, SLOT(WarmSessionIdleTimeout()));
+    tmrWarmSessionIdle.setSingleShot(true);
+    connect(&tmrWarmSessionProbe, SIGNAL(timeout()), this, SLOT(WarmSessionProbeTimeout()));
+    tmrWarmSessionProbe.setSingleShot(true);
+
+    //Progress display is refreshed at a fixed frame rate rather than per block
+    connect(&tmrProgressUpdate, SIGNAL(timeout()), this, SLOT(ProgressUpdateTimerTimeout()));
+    tmrProgressUpdate.setSingleShot(false);
+
+    //Connect firmware file verification signal
+    connect(&ivImageVerifier, SIGNAL(Finished(ImageVerificationResult)), this, SLOT(ImageVerificationFinished(ImageVerificationResult)));
+    connect(&ivImageVerifier, SIGNAL(CachedChecked(QList<int>)), this, SLOT(UpgradePathCachedChecked(QList<int>)));
+
+    //Connect receive engine signals
+    connect(&xrReceiver, SIGNAL(WriteData(QByteArray)), this, SLOT(XModemReceiveWrite(QByteArray)));
+    connect(&xrReceiver, SIGNAL(Finished(bool,QString)), this, SLOT(XModemReceiveFinished(bool,QString)));
+
+    //Connect serial port enumeration signal
+    connect(&fwSerialPorts, SIGNAL(finished()), this, SLOT(SerialDevicesFound()));
 
     //Set default UI elements
     ui->combo_Baud->setCurrentIndex(ComboBaudRateIndex115200);
     ui->combo_Handshake->setCurrentIndex(ComboBaudRateHandshakingHardware);
+    nLinkBaudRate = ui->combo_Baud->currentText().toInt();
+    nLinkHandshake = ui->combo_Handshake->currentIndex();
 
     //Create and setup objects
     nCPacket = XMODEM_FIRST_PACKET_ID;
-    nmManager = new QNetworkAccessManager();
-    connect(nmManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(replyFinished(QNetworkReply*)));
+    ui->list_Firmwares->setModel(&fcFirmwareFiles);
 #ifdef UseSSL
-    connect(nmManager, SIGNAL(sslErrors(QNetworkReply*, QList<QSslError>)), this, SLOT(sslErrors(QNetworkReply*, QList<QSslError>)));
+    connect(&fpPrefetcher, SIGNAL(SslErrors(QNetworkReply*, QList<QSslError>)), this, SLOT(sslErrors(QNetworkReply*, QList<QSslError>)));
 #endif
+    connect(&fpPrefetcher, SIGNAL(Prefetched(QString,bool,QString)), this, SLOT(FirmwarePrefetched(QString,bool,QString)));
 
-    //Display version
-    ui->statusBar->showMessage(QString("XModemUtil")
-#ifdef UseSSL
-    .append(" (with SSL)")
-#endif
-    .append(" version ").append(strUtilVersion).append(" (").append(OS).append("), Built ").append(__DATE__).append(" Using QT ").append(QT_VERSION_STR)
-#ifdef UseSSL
-#ifdef TARGET_OS_MAC
-    .append(", ").append(QString(QSslSocket::sslLibraryBuildVersionString()).replace(",", ":"))
-#else
-    .append(", ").append(QString(QSslSocket::sslLibraryBuildVersionString()).left(QSslSocket::sslLibraryBuildVersionString().indexOf(" ", 9)))
-#endif
-#endif
-#ifdef QT_DEBUG
-    .append(" [DEBUG BUILD]")
-#endif
-    );
+    //Display version, the SSL library is only named once the network is first used
+    UpdateStatusMessage();
     setWindowTitle(QString(windowTitle()).append(" (v").append(strUtilVersion).append(")"));
 
     //Initialise popup message
@@ -147,23 +175,24 @@ MainWindow::MainWindow(QWidget *parent) :
         on_radio_Online_toggled(true);
     }
 
-#ifdef UseSSL
-    //Load SSL certificate
-    QFile certFile(":/certificates/UwTerminalX_new.crt");
-    if (certFile.open(QIODevice::ReadOnly))
-    {
-        //Load certificate data
-        sslcLairdConnectivity = new QSslCertificate(certFile.readAll());
-        QSslSocket::addDefaultCaCertificate(*sslcLairdConnectivity);
-        certFile.close();
-    }
-#else
+#ifndef UseSSL
     ui->check_SSL->setEnabled(false);
     ui->check_SSL->setChecked(false);
 #endif
 
-    //Populate the list of devices
-    RefreshSerialDevices();
+    if (RealtimeProfile::Active())
+    {
+        //Packet buffers stay resident for the life of the engine, they are not
+        //unlocked on destruction as the pages may hold another engine's buffers
+        QString strError;
+        if (!RealtimeProfile::LockBuffer(aPacketBuffers, sizeof(aPacketBuffers), &strError))
+        {
+            ui->edit_Log->appendPlainText(QString("Packet buffers not locked in memory: ").append(strError));
+        }
+    }
+
+    //Anything which is not needed to draw the first frame happens once the event loop is running
+    QTimer::singleShot(0, this, SLOT(StartupDeferred()));
 }
 
 //=============================================================================
@@ -176,6 +205,14 @@ MainWindow::~MainWindow(
     disconnect(this, SLOT(SerialError(QSerialPort::SerialPortError)));
     disconnect(this, SLOT(SerialBytesWritten(qint64)));
     disconnect(this, SLOT(BootloaderEntranceTimerTimeout()));
+    disconnect(this, SLOT(ModemRestartTimerTimeout()));
+    disconnect(this, SLOT(LineWatchdogExpired()));
+    disconnect(this, SLOT(WarmSessionIdleTimeout()));
+    disconnect(this, SLOT(WarmSessionProbeTimeout()));
+    disconnect(this, SLOT(ProgressUpdateTimerTimeout()));
+    disconnect(this, SLOT(ImageVerificationFinished(ImageVerificationResult)));
+    disconnect(this, SLOT(XModemReceiveWrite(QByteArray)));
+    disconnect(this, SLOT(XModemReceiveFinished(bool,QString)));
     disconnect(this, SLOT(replyFinished(QNetworkReply*)));
 #ifdef UseSSL
     disconnect(this, SLOT(sslErrors(QNetworkReply*, QList<QSslError>)));
@@ -193,6 +230,13 @@ MainWindow::~MainWindow(
     {
         spSerialPort.close();
     }
+    trRecorder.Close();
+
+    if (trpReplayer != NULL)
+    {
+        delete trpReplayer;
+        trpReplayer = NULL;
+    }
 
     if (nmManager != NULL)
     {
@@ -215,6 +259,19 @@ MainWindow::~MainWindow(
 void
 MainWindow::RefreshSerialDevices(
     )
+{
+    //Serial port lookups can take hundreds of milliseconds with many adapters, so they are made on the thread pool
+    if (!fwSerialPorts.isRunning())
+    {
+        fwSerialPorts.setFuture(QtConcurrent::run(&QSerialPortInfo::availablePorts));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::SerialDevicesFound(
+    )
 {
     //Clears and refreshes the list of serial devices
     QString strPrev = "";
@@ -223,6 +280,18 @@ MainWindow::RefreshSerialDevices(
     lstEntries.clear();
     bool bHadDevice = false;
 
+    lstSerialPorts = fwSerialPorts.result();
+    foreach (const QString &strPort, LineWatchdog::ReleaseReplugged(lstSerialPorts))
+    {
+        ui->edit_Log->appendPlainText(QString("Serial port ").append(strPort).append(" released from quarantine, the module has been replugged or replaced"));
+    }
+
+    if (bPortFromCaller == true || bSessionActive == true)
+    {
+        //The port in use must not be changed underneath a session
+        return;
+    }
+
     if (ui->combo_COM->count() > 0)
     {
         //Remember previous option
@@ -231,7 +300,7 @@ MainWindow::RefreshSerialDevices(
     }
 
     ui->combo_COM->clear();
-    foreach (const QSerialPortInfo &info, QSerialPortInfo::availablePorts())
+    foreach (const QSerialPortInfo &info, lstSerialPorts)
     {
         QRegularExpressionMatch remTempREM = reTempRE.match(info.portName());
         if (remTempREM.hasMatch() == true)
@@ -302,8 +371,25 @@ MainWindow::SerialRead(
 {
     //Receive all data from buffer
     QByteArray baRecData = spSerialPort.readAll();
+    trRecorder.Record(SerialTraceRecordTypeReceive, baRecData);
+    SerialDataReceived(baRecData);
+}
 
-    if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate)
+//=============================================================================
+//=============================================================================
+void
+MainWindow::SerialDataReceived(
+    QByteArray baRecData
+    )
+{
+    //Process data received from the module (or from a replayed trace)
+    if (nAppMode == ApplicationModeTypes::ApplicationModeTypeXModemReceive)
+    {
+        //Receiving a file from the module
+        xrReceiver.ProcessData(baRecData);
+        tpProgress.Update(xrReceiver.BytesReceived());
+    }
+    else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate)
     {
         //Firmware upgrade mode
         if (nAction == ActionModeTypeXModemWaitForNack || nAction == ActionModeTypes::ActionModeTypeXModemSendData)
@@ -311,40 +397,24 @@ MainWindow::SerialRead(
             if (baRecData.at(0) == XModemPacketTypes::XModemPacketTypeAck)
             {
                 //XModem ACK
-                ui->edit_Log->appendPlainText("Got ACK");
-
-                //Load next packet
-                baLastPacket.clear();
-                unsigned char cTmp;
-                cTmp = XModemPacketTypes::XModemPacketType1024BytePacket;
-                baLastPacket.append(cTmp);
-
-                cTmp = nCPacket;
-                baLastPacket.append(cTmp);
-                cTmp = XMODEM_INVERSE - nCPacket;
-                baLastPacket.append(cTmp);
-                if (fpFirmwareFile.pos() != nCFilePos)
-                {
-                    fpFirmwareFile.seek(nCFilePos);
-                }
+                lwLine.Heartbeat();
+                BlockAcknowledged();
+                btTelemetry.nBytesAcked += nActiveDataSize;
+                AdaptBlockSize(false);
 
-                baLastPacket.append(fpFirmwareFile.read(nXModemDataSize));
-                if (baLastPacket.length() != nXModemHeaderSize)
+                //Load next packet, normally already framed whilst the receiver was processing the previous one
+                if (LoadNextPacket() == true)
                 {
-                    if (baLastPacket.length() < (nXModemDataSize + nXModemHeaderSize))
+                    SerialWrite(baLastPacket);
+                    BlockWriteQueued();
+                    if (pmsMetrics != NULL)
                     {
-                        //Pad with spaces
-                        baLastPacket.append(QByteArray((nXModemDataSize + nXModemHeaderSize) - baLastPacket.length(), nXModemPaddingCharacter));
-                        bLastPacketSent = true;
+                        pmsMetrics->BlockSent(baLastPacket.length());
                     }
-                    baLastPacket.append(Calc8BitCRC(baLastPacket.data(), baLastPacket.length() - nXModemHeaderSize));
-                    spSerialPort.write(baLastPacket);
-
-                    ui->progressBar->setValue((nCFilePos*PERCENT_100)/fpFirmwareFile.size());
 
-                    ui->edit_Log->appendPlainText(QString("Sent packet #").append(QString::number(nCPacket)).append(", offset ").append(QString::number(nCFilePos)).append(" of length ").append(QString::number(baLastPacket.length())));
+                    tpProgress.Update(nCFilePos);
                     ++nCPacket;
-                    nCFilePos += nXModemDataSize;
+                    nCFilePos += nActiveDataSize;
                 }
                 else
                 {
@@ -354,7 +424,7 @@ MainWindow::SerialRead(
                     unsigned char cTmp;
                     cTmp = XModemPacketTypes::XModemPacketTypeEndOfFrame;
                     baLastPacket.append(cTmp);
-                    spSerialPort.write(baLastPacket);
+                    SerialWrite(baLastPacket);
 
                     ui->edit_Log->appendPlainText("Sent EOT packet");
                 }
@@ -362,36 +432,39 @@ MainWindow::SerialRead(
             else if (baRecData.at(0) == XModemPacketTypes::XModemPacketTypeNack)
             {
                 //XModem NACK
-                ui->edit_Log->appendPlainText("Got NACK");
                 if (nAction == ActionModeTypes::ActionModeTypeXModemWaitForNack)
                 {
                     //First NACK packet has been received, modem is now ready to receive real first packet - the modem has a non-standard XModem implementation and this is a quirk
+                    ui->edit_Log->appendPlainText("Got NACK, sending firmware");
+                    lwLine.Heartbeat();
                     nAction = ActionModeTypes::ActionModeTypeXModemSendData;
                     nCFilePos = 0;
                     nCPacket = XMODEM_FIRST_PACKET_ID;
-                    baLastPacket.clear();
-                    unsigned char cTmp;
-                    cTmp = XModemPacketTypes::XModemPacketType1024BytePacket;
-                    baLastPacket.append(cTmp);
-                    cTmp = nCPacket;
-                    baLastPacket.append(cTmp);
-                    cTmp = XMODEM_INVERSE - nCPacket;
-                    baLastPacket.append(cTmp);
-                    fpFirmwareFile.seek(0);
-                    baLastPacket.append(fpFirmwareFile.read(nXModemDataSize));
-                    baLastPacket.append(Calc8BitCRC(baLastPacket.data(), nXModemDataSize));
-                    spSerialPort.write(baLastPacket);
-
-                    ui->progressBar->setValue((nCFilePos*PERCENT_100)/fpFirmwareFile.size());
+                    nNextPacketState = NextPacketStateNone;
+                    LoadNextPacket();
+                    SerialWrite(baLastPacket);
+                    BlockWriteQueued();
+                    if (pmsMetrics != NULL)
+                    {
+                        pmsMetrics->BlockSent(baLastPacket.length());
+                    }
 
-                    ui->edit_Log->appendPlainText(QString("Sent packet #").append(QString::number(nCPacket)).append(", offset ").append(QString::number(nCFilePos)).append(" of length ").append(QString::number(baLastPacket.length())));
-                    nCFilePos = nXModemDataSize;
+                    tpProgress.Update(nCFilePos);
+                    nCFilePos = nActiveDataSize;
                     nCPacket = XMODEM_SECOND_PACKET_ID;
                 }
                 else if (nAction == ActionModeTypes::ActionModeTypeXModemSendData)
                 {
-                    //Last packet has an error, retransmit it
-                    spSerialPort.write(baLastPacket);
+                    //Last packet has an error, retransmit it unchanged (the receiver may have stored it and only lost the ACK)
+                    BlockAcknowledged();
+                    ++btTelemetry.nRetransmits;
+                    AdaptBlockSize(true);
+                    SerialWrite(baLastPacket);
+                    BlockWriteQueued();
+                    if (pmsMetrics != NULL)
+                    {
+                        pmsMetrics->BlockRetransmitted(baLastPacket.length());
+                    }
                 }
             }
         }
@@ -402,36 +475,49 @@ MainWindow::SerialRead(
             if (nAction == ActionModeTypes::ActionModeTypeXModemSendEndOfFrame)
             {
                 //We are finished
+                lwLine.Heartbeat();
                 nAction = ActionModeTypes::ActionModeTypeXModemFinished;
                 nBytesWritten = 0;
                 fpFirmwareFile.close();
+                spFirmwareImage.clear();
                 ui->edit_Log->appendPlainText(QString("Sending firmware upgrade accept command..."));
 
                 baLastPacket.clear();
                 baLastPacket = QByteArray(baFirmwareUpgradeAcceptCommand).append(baCRLF);
-                spSerialPort.write(baLastPacket);
+                SerialWrite(baLastPacket);
             }
         }
     }
-    else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck || nAppMode == ApplicationModeTypes::ApplicationModeTypeQuery)
+    else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck || nAppMode == ApplicationModeTypes::ApplicationModeTypeQuery || nAppMode == ApplicationModeTypes::ApplicationModeTypeUpgradePathCheck || nAppMode == ApplicationModeTypes::ApplicationModeTypeCompletionCheck)
     {
         //Firmware download mode - query which mode
+        tmrWarmSessionProbe.stop();
         baRecBuf.append(baRecData);
         if (nAction == ActionModeTypes::ActionModeTypeModem)
         {
             //Checking which mode
-            if (baRecBuf.length() > 1 && baRecBuf.at(BOOTLOADER_ERROR_CHAR_INDEX) == BOOTLOADER_ERROR_CHAR && baRecBuf.at(BOOTLOADER_ERROR_RESPONSE_INDEX) == BOOTLOADER_ERROR_UNRECOGNISED)
+            if (tmrModemRestartTimer.isActive() && baRecBuf.indexOf(baModemModel) == INDEX_NOT_FOUND)
+            {
+                //Waiting for the modem to restart after an upgrade step, only a version response is of interest
+                if (baRecBuf.length() > ZEPHYR_APPLICATION_TRIGGER_DATA_SIZE)
+                {
+                    baRecBuf.clear();
+                }
+            }
+            else if (baRecBuf.length() > 1 && baRecBuf.at(BOOTLOADER_ERROR_CHAR_INDEX) == BOOTLOADER_ERROR_CHAR && baRecBuf.at(BOOTLOADER_ERROR_RESPONSE_INDEX) == BOOTLOADER_ERROR_UNRECOGNISED)
             {
                 //In bootloader
                 nAction = ActionModeTypes::ActionModeTypeBootloaderUnbridged;
+                DetectedMode(strModuleModeBootloader);
                 ui->edit_Log->appendPlainText("Module in bootloader mode");
-                spSerialPort.write(baBootloaderUnlockCommand);
+                SerialWrite(baBootloaderUnlockCommand);
             }
             else
             {
                 if (baRecBuf.indexOf(baModemModel) != INDEX_NOT_FOUND)
                 {
                     //In modem mode
+                    DetectedMode(strModuleModeModem);
                     ui->edit_Log->appendPlainText("Module in modem mode");
 
                     //Extract version
@@ -439,54 +525,98 @@ MainWindow::SerialRead(
                     if (baRecBuf.length() >= MODEM_VERSION_MODEL_MINIMUM_SIZE && strFirmwareVersion.length() >= MODEM_VERSION_MINIMUM_SIZE)
                     {
                         baRecBuf.clear();
+                        tmrModemRestartTimer.stop();
                         ui->edit_Log->appendPlainText(QString("Current modem firmware version: ").append(strFirmwareVersion));
+                        lwLine.Heartbeat();
 
                         bool bContinue = true;
+                        bool bSucceeded = false;
+                        QString strOutcome;
 
-                        if (nAppMode == ApplicationModeTypes::ApplicationModeTypeQuery)
+                        if (nAppMode == ApplicationModeTypes::ApplicationModeTypeQuery && bInventoryQuery == true)
+                        {
+                            //Inventory query, the result is reported once the port has been closed
+                            strQueryVersion = strFirmwareVersion;
+                            bSucceeded = true;
+                            strOutcome = QString("Modem is running firmware version ").append(strFirmwareVersion);
+                            bContinue = false;
+                        }
+                        else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeQuery)
                         {
                             //Just checking firmware, display result to user
-                            QString strMessage = QString("Modem is running firmware version ").append(strFirmwareVersion);
-                            pmErrorForm->SetMessage(&strMessage);
+                            strOutcome = QString("Modem is running firmware version ").append(strFirmwareVersion);
+                            pmErrorForm->SetMessage(&strOutcome);
                             pmErrorForm->show();
+                            bSucceeded = true;
+                            bContinue = false;
+                        }
+                        else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeUpgradePathCheck)
+                        {
+                            //Plan the upgrade steps from the current version and fetch every step before flashing
+                            bContinue = PrefetchUpgradePath(strFirmwareVersion, &strOutcome);
+                        }
+                        else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeCompletionCheck)
+                        {
+                            //Waiting for the upgraded firmware to start
+                            bContinue = CompletionVersionReceived(strFirmwareVersion, &bSucceeded, &strOutcome);
+                        }
+                        else if (!strStepVersion.isEmpty() && strFirmwareVersion == strVersionBeforeUpgrade)
+                        {
+                            //The previous firmware answers until the modem restarts into the upgrade step
+                            ui->edit_Log->appendPlainText(QString("Module is still running firmware version ").append(strFirmwareVersion).append(", waiting..."));
+                            tmrModemRestartTimer.start(nModemRestartIntervalMs);
+                        }
+                        else if (!strStepVersion.isEmpty() && strFirmwareVersion != strStepVersion)
+                        {
+                            //The next step is a delta from the version the previous step installs, it must not be flashed over anything else
+                            strOutcome = QString("Modem restarted with firmware version ").append(strFirmwareVersion).append(" instead of ").append(strStepVersion).append(" after the previous upgrade step, remaining upgrade steps have been cancelled.");
+                            pmErrorForm->SetMessage(&strOutcome);
+                            pmErrorForm->show();
+                            ui->edit_Log->appendPlainText(strOutcome);
                             bContinue = false;
                         }
                         else
                         {
                             //Not just checking firmware version on module
-                            if (ui->edit_File->text().indexOf(QString(strFirmwareVersion).append(strFileVersionTo)) == INDEX_NOT_FOUND)
-                            {
-                                //Check if user is sure they want to continue
-                                bContinue = (QMessageBox::question(this, "Confirm upgrade", QString("Your module modem appears to be running firmware version ").append(strFirmwareVersion).append(" which might not be compatible with the selected upgrade file ").append((ui->edit_File->text().indexOf(":\\") != INDEX_NOT_FOUND ? ui->edit_File->text().mid(ui->edit_File->text().lastIndexOf("\\")+1) : ui->edit_File->text().mid(ui->edit_File->text().lastIndexOf("/")+1))).append(", do you want to continue?"), QMessageBox::Yes, QMessageBox::No) == QMessageBox::Yes);
-                            }
-
-                            if (bContinue == true)
+                            strStepVersion.clear();
+                            strVersionBeforeUpgrade = strFirmwareVersion;
+                            if (trpReplayer == NULL && ui->edit_File->text().indexOf(QString(strFirmwareVersion).append(strFileVersionTo)) == INDEX_NOT_FOUND)
                             {
-                                //Firmware upgrade mode
-                                nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate;
-                                fpFirmwareFile.setFileName(ui->edit_File->text());
-                                if (fpFirmwareFile.open(QFile::ReadOnly))
+                                if (bNonInteractive == true)
                                 {
-                                    ui->edit_Log->appendPlainText(QString("Opened FOTO file, size: ").append(QString::number(fpFirmwareFile.size())));
-                                    nAction = ActionModeTypeXModemWaitForNack;
-                                    bLastPacketSent = false;
-                                    spSerialPort.write(QByteArray(baFirmwareUpgradeStartCommand).append("=").append(QString::number(fpFirmwareFile.size()).toUtf8()).append(baCRLF));
+                                    //Nobody to ask, only continue if the job asked for it
+                                    bContinue = bForceUpgrade;
+                                    if (bContinue == false)
+                                    {
+                                        strOutcome = QString("Modem is running firmware version ").append(strFirmwareVersion).append(" which might not be compatible with the selected upgrade file, not upgrading without force");
+                                        pmErrorForm->SetMessage(&strOutcome);
+                                        ui->edit_Log->appendPlainText(strOutcome);
+                                    }
                                 }
                                 else
                                 {
-                                    ui->edit_Log->appendPlainText(QString("Error occured trying to open FOTO file: ").append(fpFirmwareFile.errorString()));
-                                    bContinue = false;
-                                    QString strMessage = QString("Failed to open FOTO file '").append(ui->edit_File->text()).append("' for reading: ").append(fpFirmwareFile.errorString());
-                                    pmErrorForm->SetMessage(&strMessage);
-                                    pmErrorForm->show();
+                                    //Check if user is sure they want to continue
+                                    bContinue = (QMessageBox::question(this, "Confirm upgrade", QString("Your module modem appears to be running firmware version ").append(strFirmwareVersion).append(" which might not be compatible with the selected upgrade file ").append((ui->edit_File->text().indexOf(":\\") != INDEX_NOT_FOUND ? ui->edit_File->text().mid(ui->edit_File->text().lastIndexOf("\\")+1) : ui->edit_File->text().mid(ui->edit_File->text().lastIndexOf("/")+1))).append(", do you want to continue?"), QMessageBox::Yes, QMessageBox::No) == QMessageBox::Yes);
+                                    if (bContinue == false)
+                                    {
+                                        strOutcome = "Upgrade cancelled, the selected upgrade file might not be compatible with the modem firmware version.";
+                                    }
                                 }
                             }
+
+                            if (bContinue == true)
+                            {
+                                //Firmware upgrade mode
+                                bContinue = BeginFirmwareTransfer(&strOutcome);
+                            }
                         }
 
                         if (bContinue == false)
                         {
-                            spSerialPort.close();
-                            SetInputsEnabled(true);
+                            //The modem has just answered, so the port is left open for the next session
+                            lstUpgradePath.clear();
+                            KeepSessionWarm(strFirmwareVersion);
+                            EndSession(bSucceeded, strOutcome);
                         }
                     }
                 }
@@ -494,19 +624,27 @@ MainWindow::SerialRead(
                 {
                     //In modem mode, query firmware
                     baRecBuf.clear();
+                    DetectedMode(strModuleModeBridged);
                     ui->edit_Log->appendPlainText("UARTs already bridged, checking modem firmware version...");
-                    spSerialPort.write(QByteArray(baVersionQueryCommand).append(baCR));
+                    SerialWrite(QByteArray(baVersionQueryCommand).append(baCR));
                 }
                 else if (baRecBuf.indexOf(baNotFoundError) != INDEX_NOT_FOUND || baRecBuf.length() > ZEPHYR_APPLICATION_TRIGGER_DATA_SIZE)
                 {
                     //In Zephyr application
                     baRecBuf.clear();
+                    DetectedMode(strModuleModeApplication);
                     ui->edit_Log->appendPlainText("Module in Zephyr-application mode");
-                    spSerialPort.write(baZephyrEnterBootloader);
+                    if (nAppMode == ApplicationModeTypes::ApplicationModeTypeQuery && bInventoryQuery == true)
+                    {
+                        //Inventory queries leave the module in the mode it was found in, the modem version needs the bootloader
+                        spSerialPort.close();
+                        EndSession(true, "Module in Zephyr-application mode");
+                        return;
+                    }
+                    SerialWrite(baZephyrEnterBootloader);
                     nAction = ActionModeTypes::ActionModeTypeUserApplication;
 
-                    //Start the recurring timer to check if the bootloader has been entered
-                    nBootloaderTimerChecks = 0;
+                    //Start the recurring timer to check if the bootloader has been entered, the line watchdog decides when to give up
                     tmrBootloaderEntranceTimer.start(BOOTLOADER_ENTER_TIMER_CHECK_MS);
                 }
             }
@@ -516,7 +654,7 @@ MainWindow::SerialRead(
             //Bridge UARTs together to talk to modem
             baRecBuf.clear();
             ui->edit_Log->appendPlainText("Bridging UARTs...");
-            spSerialPort.write(baBootloaderBridgeUARTsCommand);
+            SerialWrite(baBootloaderBridgeUARTsCommand);
             nAction = ActionModeTypes::ActionModeTypeBootloaderBridged;
         }
         else if (nAction == ActionModeTypes::ActionModeTypeBootloaderBridged)
@@ -527,12 +665,120 @@ MainWindow::SerialRead(
                 baRecBuf.clear();
                 ui->edit_Log->appendPlainText("Checking modem firmware version...");
                 nAction = ActionModeTypes::ActionModeTypeModem;
-                spSerialPort.write(QByteArray(baVersionQueryCommand).append(baCR));
+                SerialWrite(QByteArray(baVersionQueryCommand).append(baCR));
             }
         }
     }
 }
 
+//=============================================================================
+//=============================================================================
+void
+MainWindow::SerialWrite(
+    const QByteArray &baData
+    )
+{
+    //Send data to the module, or to the replayer when a trace is being replayed
+    if (trpReplayer != NULL)
+    {
+        trpReplayer->Transmitted(baData);
+        return;
+    }
+
+    trRecorder.Record(SerialTraceRecordTypeTransmit, baData);
+    spSerialPort.write(baData);
+}
+
+//=============================================================================
+//=============================================================================
+quint32
+MainWindow::SerialPinoutSignals(
+    )
+{
+    //Returns the state of the serial control lines
+    if (trpReplayer != NULL)
+    {
+        return trpReplayer->PinoutSignals();
+    }
+
+    quint32 nSignals = spSerialPort.pinoutSignals();
+    trRecorder.RecordValue(SerialTraceRecordTypePinout, nSignals);
+    return nSignals;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::StartTraceRecording(
+    const QString &strFilename
+    )
+{
+    //Records all serial traffic of this instance to a trace file
+    if (!trRecorder.Open(strFilename))
+    {
+        return false;
+    }
+
+    ui->edit_Log->appendPlainText(QString("Recording serial trace to ").append(strFilename));
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::StartTraceReplay(
+    const QString &strTraceFilename,
+    const QString &strFirmwareFilename,
+    double fSpeed,
+    QString *pstrError
+    )
+{
+    //Runs a firmware update of the given file against a recorded trace instead of a module
+    trpReplayer = new SerialTraceReplayer(this);
+    if (!trpReplayer->Load(strTraceFilename, pstrError))
+    {
+        delete trpReplayer;
+        trpReplayer = NULL;
+        return false;
+    }
+
+    trpReplayer->SetSpeed(fSpeed);
+    connect(trpReplayer, SIGNAL(DataReceived(QByteArray)), this, SLOT(SerialDataReceived(QByteArray)));
+    connect(trpReplayer, SIGNAL(BytesWritten(qint64)), this, SLOT(SerialBytesWritten(qint64)));
+    connect(trpReplayer, SIGNAL(Finished(bool,QString)), this, SLOT(TraceReplayFinished(bool,QString)));
+
+    SetInputsEnabled(false);
+    ui->radio_LocalFile->setChecked(true);
+    ui->edit_File->setText(strFirmwareFilename);
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck;
+    StartImageVerification();
+    OpenSerialPort();
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::TraceReplayFinished(
+    bool bSuccess,
+    QString strMessage
+    )
+{
+    //Report replay timing for comparison with the recording and exit
+    QTextStream tsOutput(stdout);
+    tsOutput << (bSuccess ? "Replay passed: " : "Replay failed: ") << strMessage
+             << ", engine time " << (etmrElapsed.isValid() ? etmrElapsed.elapsed() : 0) << " ms"
+             << ", recorded time " << trpReplayer->RecordedDurationMs() << " ms\n";
+    if (bSuccess == false)
+    {
+        tsOutput << ui->edit_Log->toPlainText() << "\n";
+    }
+    tsOutput.flush();
+
+    QCoreApplication::exit(bSuccess ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
 //=============================================================================
 //=============================================================================
 void
@@ -545,14 +791,23 @@ MainWindow::SerialError(
         //No error, nothing more to do
         return;
     }
+    else if (bPortWarm == true && speErrorCode == QSerialPort::ResourceError)
+    {
+        //Port left open between sessions has gone (module unplugged), nobody is waiting on it
+        spSerialPort.close();
+        bPortWarm = false;
+        tmrWarmSessionIdle.stop();
+        ui->edit_Log->appendPlainText("Serial port kept open from the previous session has been removed");
+    }
     else if (speErrorCode == QSerialPort::ResourceError || speErrorCode == QSerialPort::PermissionError)
     {
         //Serial port error or was not able to open - unable to continue
         QString strMessage = QString("Error occured whilst trying to open or use the serial port, error code: ").append(QString::number(speErrorCode));
         pmErrorForm->SetMessage(&strMessage);
         pmErrorForm->show();
-        SetInputsEnabled(true);
         ui->edit_Log->appendPlainText("An error occured whilst trying to open/use the serial port");
+        EndSession(false, strMessage);
+        xrReceiver.Abort("Serial port error");
     }
 }
 
@@ -563,17 +818,86 @@ MainWindow::SerialBytesWritten(
     qint64 intByteCount
     )
 {
-    if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate && nAction == ActionModeTypes::ActionModeTypeXModemFinished)
+    trRecorder.RecordValue(SerialTraceRecordTypeTransmitComplete, intByteCount);
+    if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate && nAction == ActionModeTypes::ActionModeTypeXModemSendData)
+    {
+        //Data block being written
+        btTelemetry.nBytesDrained += intByteCount;
+        if (bBlockWritePending == true && btTelemetry.nBytesDrained >= btTelemetry.nBytesQueued && (trpReplayer != NULL || spSerialPort.bytesToWrite() == 0))
+        {
+            //Block has been handed to the tty driver but the UART is still sending it, so the drain
+            //ends once whatever is left in the output queue has been clocked out at the baud rate
+            bBlockWritePending = false;
+            nBlockDrainNs = etmrBlock.nsecsElapsed();
+            if (trpReplayer == NULL)
+            {
+                qint64 nUnsent = SerialBytesUnsent();
+                if (nUnsent >= 0)
+                {
+                    nBlockDrainNs += SerialWireTimeNs(nUnsent);
+                }
+                else
+                {
+                    //Output queue cannot be read, the UART started on the block when it was queued
+                    nBlockDrainNs = qMax(nBlockDrainNs, SerialWireTimeNs(baLastPacket.length()));
+                }
+            }
+
+            //Frame the next block now so it can be written the instant the ACK arrives
+            PrepareNextPacket();
+        }
+    }
+    else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate && nAction == ActionModeTypes::ActionModeTypeXModemFinished)
     {
         nBytesWritten += intByteCount;
-        if (nBytesWritten == baLastPacket.length())
+        if (nBytesWritten == baLastPacket.length() && lstUpgradePath.count() > 1)
+        {
+            //Upgrade step finished, keep the port open and wait for the modem to restart before the next step
+            strStepVersion = fcFirmwareFiles.At(lstUpgradePath.takeFirst())->strToVersion;
+            const FirmwareListStruct *pNextStep = fcFirmwareFiles.At(lstUpgradePath.first());
+            ui->edit_File->setText(FirmwareCachePath(pNextStep));
+            StartImageVerification();
+            ui->edit_Log->appendPlainText(QString("Upgrade step finished after ").append(QString::number(etmrElapsed.elapsed()/1000)).append(" seconds, waiting for modem to restart before upgrading to ").append(pNextStep->strToVersion).append("..."));
+            LogBlockTelemetry();
+            RecordLinkProfile(true);
+            StopProgressUpdates();
+            ui->progressBar->setValue(0);
+
+            nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck;
+            nAction = ActionModeTypes::ActionModeTypeModem;
+            baRecBuf.clear();
+            StartModemRestartPolling();
+            etmrDetection.start();
+        }
+        else if (nBytesWritten == baLastPacket.length() && trpReplayer == NULL)
+        {
+            //Upgrade accepted, stay attached until the module answers with the new firmware version
+            lstUpgradePath.clear();
+            const FirmwareListStruct *pEntry = fcFirmwareFiles.At(fcFirmwareFiles.IndexOfFilename(QFileInfo(ui->edit_File->text()).fileName()));
+            strExpectedVersion = (pEntry != NULL ? pEntry->strToVersion : QString());
+            ui->edit_Log->appendPlainText(QString("Finished XModem transfer after ").append(QString::number(etmrElapsed.elapsed()/1000)).append(" seconds, waiting for the module to install the upgrade and restart..."));
+            LogBlockTelemetry();
+            RecordLinkProfile(true);
+            StopProgressUpdates();
+            ui->progressBar->setValue(PERCENT_100);
+
+            nAppMode = ApplicationModeTypes::ApplicationModeTypeCompletionCheck;
+            nAction = ActionModeTypes::ActionModeTypeModem;
+            baRecBuf.clear();
+            StartModemRestartPolling();
+        }
+        else if (nBytesWritten == baLastPacket.length())
         {
-            //Upgrade finished
+            //Replayed upgrade finished, traces end once the upgrade has been accepted
+            lstUpgradePath.clear();
             spSerialPort.close();
             ui->edit_Log->appendPlainText(QString("Finished XModem transfer & serial port closed after ").append(QString::number(etmrElapsed.elapsed()/1000)).append(" seconds. Note that the module may be busy for a few minutes whilst the modem updates itself, this can be monitored using a serial program utility e.g. UwTerminalX, the unit can be safely rebooted once a response is recieved from the module."));
+            LogBlockTelemetry();
+            QString strResult = QString("Finished XModem transfer after ").append(QString::number(etmrElapsed.elapsed()/1000)).append(" seconds");
             etmrElapsed.invalidate();
+            StopProgressUpdates();
             ui->progressBar->setValue(PERCENT_100);
-            SetInputsEnabled(true);
+            EndSession(true, strResult);
         }
     }
 }
@@ -586,31 +910,77 @@ MainWindow::OpenSerialPort(
 {
     QString strErrorMessage = "";
     bool bErrorOccured = false;
-    if (ui->combo_COM->currentText().isEmpty())
+    strDetectedMode.clear();
+    if (trpReplayer != NULL)
+    {
+        //Replaying a trace, the replayer stands in for the serial port
+        etmrElapsed.start();
+        ui->edit_Log->appendPlainText("Replaying serial trace");
+        nAction = ActionModeTypes::ActionModeTypeModem;
+        trpReplayer->Start();
+        SerialWrite(QByteArray(baVersionQueryCommand).append(baCR));
+    }
+    else if (ui->combo_COM->currentText().isEmpty())
     {
         strErrorMessage = "No serial is selected.";
         bErrorOccured = true;
     }
+    else if (WarmSessionUsable() == true)
+    {
+        //Port was left open by the previous session with the modem answering, a single version query confirms it still is
+        bPortWarm = false;
+        tmrWarmSessionIdle.stop();
+        etmrElapsed.start();
+        etmrDetection.start();
+        DetectedMode(wssWarmSession.strState);
+        ui->edit_Log->appendPlainText(QString("Reusing open serial port, module ").append(wssWarmSession.strSerialNumber.isEmpty() ? wssWarmSession.strPort : wssWarmSession.strSerialNumber).append(" was in ").append(wssWarmSession.strState).append(" mode running firmware version ").append(wssWarmSession.strFirmwareVersion).append(" ").append(QString::number(wssWarmSession.etmrLastSeen.elapsed()/1000)).append(" seconds ago"));
+        StartSession();
+
+        nAction = ActionModeTypes::ActionModeTypeModem;
+        baRecBuf.clear();
+        lwLine.Arm();
+        tmrWarmSessionProbe.start(WARM_SESSION_PROBE_TIMEOUT_MS);
+        SerialWrite(QByteArray(baVersionQueryCommand).append(baCR));
+    }
     else
     {
+        //Any port left open by a previous session cannot be used for this one
+        if (spSerialPort.isOpen())
+        {
+            spSerialPort.close();
+        }
+        bPortWarm = false;
+        tmrWarmSessionIdle.stop();
+        ApplyLinkProfile();
+
         //Configure serial port object
         spSerialPort.setPortName(ui->combo_COM->currentText());
         spSerialPort.setBaudRate(ui->combo_Baud->currentText().toInt());
         spSerialPort.setDataBits(QSerialPort::Data8);
         spSerialPort.setStopBits(QSerialPort::OneStop);
         spSerialPort.setParity(QSerialPort::NoParity);
-        spSerialPort.setFlowControl((ui->combo_Handshake->currentIndex() == ComboBaudRateHandshakingHardware ? QSerialPort::HardwareControl : (ui->combo_Handshake->currentIndex() == ComboBaudRateHandshakingSoftware ? QSerialPort::SoftwareControl : QSerialPort::NoFlowControl)));
+        spSerialPort.setFlowControl(SelectedFlowControl());
 
         if (spSerialPort.open(QIODevice::ReadWrite))
         {
             //Serial port opened successfully
             etmrElapsed.start();
+            etmrDetection.start();
             ui->edit_Log->appendPlainText("Opened serial port");
+            StartSession();
+
+            if (nAppMode == ApplicationModeTypes::ApplicationModeTypeXModemReceive)
+            {
+                //The module is already sending, no need to query it
+                BeginXModemReceive();
+                return;
+            }
 
             nAction = ActionModeTypes::ActionModeTypeModem;
+            lwLine.Arm();
 
             //Query device mode
-            spSerialPort.write(QByteArray(baVersionQueryCommand).append(baCR));
+            SerialWrite(QByteArray(baVersionQueryCommand).append(baCR));
         }
         else
         {
@@ -630,74 +1000,258 @@ MainWindow::OpenSerialPort(
 //=============================================================================
 //=============================================================================
 void
-MainWindow::on_btn_Start_clicked(
+MainWindow::StartSession(
     )
 {
-    //Begin the selection action
-    QString strErrorMessage = "";
-    bool bHasError = false;
-
-    if (ui->combo_COM->currentText().isEmpty())
+    if (nAppMode != ApplicationModeTypes::ApplicationModeTypeQuery && bSessionActive == false)
     {
-        //No port selected
-        strErrorMessage = "No port has been selected.";
-        bHasError = true;
+        //Start of a transfer session, it ends with EndSession()
+        bSessionActive = true;
+        pmsMetrics = MetricsRegistry::Instance().Session(spSerialPort.portName());
+        if (pmsMetrics != NULL)
+        {
+            pmsMetrics->SessionStarted();
+        }
+
+        //History record is filled in as the session progresses
+        QSerialPortInfo spiPort(spSerialPort.portName());
+        fhrHistory = FlashHistoryRecordStruct();
+        fhrHistory.nStartedMs = QDateTime::currentMSecsSinceEpoch();
+        fhrHistory.strStation = QSysInfo::machineHostName();
+        fhrHistory.strPort = spSerialPort.portName();
+        fhrHistory.strAdapter = LinkProfiles::AdapterKey(spiPort);
+        fhrHistory.strModuleId = spiPort.serialNumber();
+        fhrHistory.nDetectionMs = -1;
+        etmrSession.start();
     }
-    else if (!ui->radio_LocalFile->isChecked() && !ui->radio_Online->isChecked())
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::ApplyLinkProfile(
+    )
+{
+    //Switches to the fastest reliable settings measured with this adapter, only for interactive upgrades as jobs specify their own
+    if (bNonInteractive == true || trpReplayer != NULL || (nAppMode != ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck && nAppMode != ApplicationModeTypes::ApplicationModeTypeUpgradePathCheck))
     {
-        //Neither local file or download file selected
-        strErrorMessage = "Firmware selection by local file or remote download is required.";
-        bHasError = true;
+        return;
     }
-    else if (ui->radio_LocalFile->isChecked() && ui->edit_File->text().isEmpty())
+
+    LinkProfileStruct lpsBest;
+    QString strAdapter = LinkProfiles::AdapterKey(QSerialPortInfo(ui->combo_COM->currentText()));
+    if (!LinkProfiles::Best(strAdapter, &lpsBest) || (lpsBest.nBaudRate == ui->combo_Baud->currentText().toInt() && lpsBest.nHandshake == ui->combo_Handshake->currentIndex()))
     {
-        //Local file selected but there is no file
-        strErrorMessage = "Local firmware file must be selected.";
-        bHasError = true;
+        return;
     }
-    else if (ui->radio_LocalFile->isChecked() && !QFile::exists(ui->edit_File->text()))
+    else if (ui->combo_Baud->currentText().toInt() != nLinkBaudRate || ui->combo_Handshake->currentIndex() != nLinkHandshake)
     {
-        //Local file selected but file does not exist
-        strErrorMessage = QString("Local firmware file '").append(ui->edit_File->text()).append("' does not exist.");
-        bHasError = true;
+        //The operator has changed the settings by hand since they were last chosen here, theirs take precedence
+        ui->edit_Log->appendPlainText(QString("Using the selected settings rather than those learned for adapter ").append(strAdapter));
+        return;
     }
-    else if (ui->radio_Online->isChecked() && ui->list_Firmwares->selectedItems().count() != 1)
+
+    ui->combo_Baud->setEditText(QString::number(lpsBest.nBaudRate));
+    ui->combo_Handshake->setCurrentIndex(lpsBest.nHandshake);
+    nLinkBaudRate = lpsBest.nBaudRate;
+    nLinkHandshake = lpsBest.nHandshake;
+    ui->edit_Log->appendPlainText(QString("Using learned settings for adapter ").append(strAdapter).append(": ").append(QString::number(lpsBest.nBaudRate)).append(" baud, ").append(ui->combo_Handshake->currentText()).append(" handshaking (").append(QString::number(LinkProfiles::Throughput(lpsBest) / 1024.0, 'f', 1)).append(" KiB/s, ").append(QString::number(LinkProfiles::NackRate(lpsBest) * PERCENT_100, 'f', 2)).append("% NACKs, ").append(QString::number(lpsBest.nAckUs / 1000.0 / qMax(lpsBest.nBlocks, (qint64)1), 'f', 2)).append(" ms block latency over ").append(QString::number(lpsBest.nSessions)).append(" sessions)"));
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::RecordLinkProfile(
+    bool bSuccess
+    )
+{
+    //Adds the transfer which just finished or failed to the profile of the adapter and settings it used
+    if (!etmrTransfer.isValid() || trpReplayer != NULL)
     {
-        //Download file but no file is selected
-        strErrorMessage = "Remote firmware download selected but no firmware has been selected.";
-        bHasError = true;
+        return;
     }
 
-    if (bHasError == false)
+    LinkProfileStruct lpsSample;
+    lpsSample.nBaudRate = spSerialPort.baudRate();
+    lpsSample.nHandshake = (spSerialPort.flowControl() == QSerialPort::HardwareControl ? ComboBaudRateHandshakingHardware : (spSerialPort.flowControl() == QSerialPort::SoftwareControl ? ComboBaudRateHandshakingSoftware : ComboBaudRateHandshakingNone));
+    lpsSample.nSessions = 1;
+    lpsSample.nFailures = (bSuccess == true ? 0 : 1);
+    lpsSample.nBytes = btTelemetry.nBytesAcked;
+    lpsSample.nTransferMs = etmrTransfer.elapsed();
+    lpsSample.nBlocks = btTelemetry.nBlocks;
+    lpsSample.nRetransmits = btTelemetry.nRetransmits;
+    lpsSample.nAckUs = btTelemetry.nAckNs / 1000;
+    etmrTransfer.invalidate();
+
+    //Each upgrade step adds to the session's history record
+    fhrHistory.nTransferMs += lpsSample.nTransferMs;
+    fhrHistory.nBytes += lpsSample.nBytes;
+    fhrHistory.nBlocks += lpsSample.nBlocks;
+    fhrHistory.nRetransmits += lpsSample.nRetransmits;
+    fhrHistory.nSmallBlocks += btTelemetry.nSmallBlocks;
+    LinkProfiles::Record(LinkProfiles::AdapterKey(QSerialPortInfo(spSerialPort.portName())), lpsSample);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::WarmSessionUsable(
+    )
+{
+    //A port left open can only be reused by detection sessions on the same port, settings and module
+    if (bPortWarm == false || !spSerialPort.isOpen() || wssWarmSession.etmrLastSeen.elapsed() > WARM_SESSION_MAX_AGE_MS)
     {
-        //Disable inputs
-        SetInputsEnabled(false);
+        return false;
+    }
+    else if (nAppMode != ApplicationModeTypes::ApplicationModeTypeQuery && nAppMode != ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck && nAppMode != ApplicationModeTypes::ApplicationModeTypeUpgradePathCheck)
+    {
+        return false;
+    }
+    else if (spSerialPort.portName() != ui->combo_COM->currentText() || spSerialPort.baudRate() != ui->combo_Baud->currentText().toInt() || spSerialPort.flowControl() != SelectedFlowControl())
+    {
+        return false;
+    }
 
-        if (ui->radio_Online->isChecked())
+    //The port name can be reused by a different module after re-enumeration
+    return (QSerialPortInfo(spSerialPort).serialNumber() == wssWarmSession.strSerialNumber);
+}
+
+//=============================================================================
+//=============================================================================
+QSerialPort::FlowControl
+MainWindow::SelectedFlowControl(
+    )
+{
+    return (ui->combo_Handshake->currentIndex() == ComboBaudRateHandshakingHardware ? QSerialPort::HardwareControl : (ui->combo_Handshake->currentIndex() == ComboBaudRateHandshakingSoftware ? QSerialPort::SoftwareControl : QSerialPort::NoFlowControl));
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::KeepSessionWarm(
+    const QString &strFirmwareVersion
+    )
+{
+    //Leaves the port open with the modem answering, remembering what the module was doing
+    if (trpReplayer != NULL || !spSerialPort.isOpen())
+    {
+        return;
+    }
+
+    wssWarmSession.strSerialNumber = QSerialPortInfo(spSerialPort).serialNumber();
+    wssWarmSession.strPort = spSerialPort.portName();
+    wssWarmSession.strState = (strDetectedMode == strModuleModeModem ? strModuleModeModem : strModuleModeBridged);
+    wssWarmSession.strFirmwareVersion = strFirmwareVersion;
+    wssWarmSession.etmrLastSeen.start();
+    bPortWarm = true;
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeWarmIdle;
+    tmrWarmSessionIdle.start(WARM_SESSION_IDLE_MS);
+    ui->edit_Log->appendPlainText(QString("Serial port kept open for ").append(QString::number(WARM_SESSION_IDLE_MS/1000)).append(" seconds for the next session"));
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::WarmSessionIdleTimeout(
+    )
+{
+    //Nothing else has used the port, release it for other applications
+    if (bPortWarm == true)
+    {
+        spSerialPort.close();
+        bPortWarm = false;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::WarmSessionProbeTimeout(
+    )
+{
+    //The module stopped answering whilst the port was idle, detect it from scratch
+    ui->edit_Log->appendPlainText("No response on the reused serial port, reopening it");
+    spSerialPort.close();
+    OpenSerialPort();
+    if (!spSerialPort.isOpen())
+    {
+        EndSession(false, QString("Failed to reopen serial port '").append(spSerialPort.portName()).append("': ").append(spSerialPort.errorString()));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::on_btn_Start_clicked(
+    )
+{
+    //Begin the selection action
+    QString strErrorMessage = "";
+    bool bHasError = false;
+
+    if (ui->combo_COM->currentText().isEmpty())
+    {
+        //No port selected
+        strErrorMessage = "No port has been selected.";
+        bHasError = true;
+    }
+    else if (!ui->radio_LocalFile->isChecked() && !ui->radio_Online->isChecked())
+    {
+        //Neither local file or download file selected
+        strErrorMessage = "Firmware selection by local file or remote download is required.";
+        bHasError = true;
+    }
+    else if (ui->radio_LocalFile->isChecked() && ui->edit_File->text().isEmpty())
+    {
+        //Local file selected but there is no file
+        strErrorMessage = "Local firmware file must be selected.";
+        bHasError = true;
+    }
+    else if (ui->radio_LocalFile->isChecked() && !QFile::exists(ui->edit_File->text()))
+    {
+        //Local file selected but file does not exist
+        strErrorMessage = QString("Local firmware file '").append(ui->edit_File->text()).append("' does not exist.");
+        bHasError = true;
+    }
+    else if (ui->radio_Online->isChecked() && SelectedFirmware() == NULL)
+    {
+        //Download file but no file is selected
+        strErrorMessage = "Remote firmware download selected but no firmware has been selected.";
+        bHasError = true;
+    }
+    else if (LineWatchdog::IsQuarantined(ui->combo_COM->currentText(), &strErrorMessage))
+    {
+        //Module on this port could not be recovered by a previous session
+        bHasError = true;
+    }
+
+    if (bHasError == false)
+    {
+        //Disable inputs
+        SetInputsEnabled(false);
+
+        if (ui->radio_Online->isChecked())
         {
             //Download file
             bool bSkipDownload = false;
             nAppMode = ApplicationModeTypes::ApplicationModeTypeOnlineFileDownload;
 
-            std::list<FirmwareListStruct>::iterator it = lstFirmwareFiles.begin();
-            uint8_t i = ui->list_Firmwares->row(ui->list_Firmwares->selectedItems().at(0));
-            while (i > 0)
+            const FirmwareListStruct *it = SelectedFirmware();
+
+            if (ui->check_UpgradePath->isChecked())
             {
-                it++;
-                --i;
+                //Multi-step upgrade, the path can only be planned once the current modem version is known
+                nAppMode = ApplicationModeTypes::ApplicationModeTypeUpgradePathCheck;
+                OpenSerialPort();
+                return;
             }
 
-            //Check if file already exists
-            QFile fpTestFile(QString(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).append("/").append(it->strFilename));
-            if (fpTestFile.exists() && fpTestFile.open(QFile::ReadOnly))
+            //Check if file already exists, the cached copy is verified against the catalog whilst the module is detected
+            if (QFile::exists(FirmwareCachePath(it)))
             {
-                if (QCryptographicHash::hash(fpTestFile.readAll(), QCryptographicHash::Sha256).toHex() == it->strSHA256)
-                {
-                    //No need to download file again
-                    bSkipDownload = true;
-                    ui->edit_File->setText(QString(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).append("/").append(it->strFilename));
-                }
-                fpTestFile.close();
+                //No need to download file again
+                bSkipDownload = true;
+                ui->edit_File->setText(FirmwareCachePath(it));
             }
 
             if (bSkipDownload == true)
@@ -705,24 +1259,21 @@ MainWindow::on_btn_Start_clicked(
                 //Store file in writeable location
                 ui->radio_LocalFile->setChecked(true);
                 nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck;
+                StartImageVerification();
+                bVerifyingCachedDownload = true;
                 OpenSerialPort();
             }
             else
             {
                 //Download file
-                nmrReply = nmManager->get(QNetworkRequest(QUrl(
-#ifdef UseSSL
-                    QString((ui->check_SSL->isChecked() ? "https" : "http"))
-#else
-                    QString("http")
-#endif
-                    .append("://").append(strOnlineHost).append("/Firmware/Files/").append(it->strFilename))));
+                nmrReply = NetworkManager()->get(QNetworkRequest(FirmwareDownloadUrl(it)));
             }
         }
         else
         {
             //Use local file
             nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck;
+            StartImageVerification();
             OpenSerialPort();
         }
     }
@@ -760,291 +1311,1735 @@ MainWindow::on_btn_Browse_clicked(
 
 //=============================================================================
 //=============================================================================
-uint8_t
-MainWindow::Calc8BitCRC(
-    char *pData,
-    uint16_t nSize
+bool
+MainWindow::LoadNextPacket(
     )
 {
-    //Calculates an 8-bit XModem checksum
-    uint8_t nCRC = 0;
-    uint16_t i = 0;
+    //Makes the next packet the active one (framing it first if that has not already happened), returns false at the end of the file
+    if (nNextPacketState == NextPacketStateNone)
+    {
+        PrepareNextPacket();
+    }
 
-    //Skip header
-    pData += nXModemHeaderSize;
+    if (nNextPacketState == NextPacketStateEndOfFile)
+    {
+        nNextPacketState = NextPacketStateNone;
+        return false;
+    }
 
-    while (i < nSize)
+    //Swap buffers, the previous packet's buffer is free as it has been acknowledged
+    nActivePacketBuffer ^= 1;
+    nNextPacketState = NextPacketStateNone;
+    nActiveDataSize = nPreparedDataSize;
+    if (nActiveDataSize == XModemFallbackFramer::DataSize)
     {
-        nCRC += (uint8_t)*pData;
-        ++pData;
-        ++i;
+        ++btTelemetry.nSmallBlocks;
     }
+    baLastPacket = QByteArray::fromRawData(reinterpret_cast<const char *>(aPacketBuffers[nActivePacketBuffer].data()), (nActiveDataSize == XModemFallbackFramer::DataSize ? XModemFallbackFramer::PacketSize : XModemFirmwareFramer::PacketSize));
 
-    return nCRC;
+    return true;
 }
 
 //=============================================================================
 //=============================================================================
 void
-MainWindow::SetInputsEnabled(
-    bool bEnabled
+MainWindow::PrepareNextPacket(
     )
 {
-    ui->btn_Start->setEnabled(bEnabled);
-    ui->radio_LocalFile->setEnabled(bEnabled);
-    ui->radio_Online->setEnabled(bEnabled);
-#ifdef UseSSL
-    ui->check_SSL->setEnabled(bEnabled);
-#endif
-    ui->btn_OnlineFirmwareRefresh->setEnabled(bEnabled);
-    ui->btn_Refresh->setEnabled(bEnabled);
-    ui->btn_Query->setEnabled(bEnabled);
-    ui->combo_COM->setEnabled(bEnabled);
-    ui->combo_Baud->setEnabled(bEnabled);
-    ui->combo_Handshake->setEnabled(bEnabled);
-    ui->edit_File->setEnabled(bEnabled);
+    //Reads the block at the current file offset straight into the spare packet buffer and frames it at the current block size
+    if (nNextPacketState != NextPacketStateNone)
+    {
+        return;
+    }
 
-    if (bEnabled == true)
+    //Both framers have the same header, so the payload is in the same place for either block size
+    XModemFirmwareFramer::Packet &aPacket = aPacketBuffers[nActivePacketBuffer ^ 1];
+    qint64 nRead;
+    if (!spFirmwareImage.isNull())
     {
-        if (ui->radio_LocalFile->isChecked())
-        {
-            on_radio_LocalFile_toggled(true);
-        }
-        else if (ui->radio_Online->isChecked())
+        //Copied from the shared mapping of the image
+        nRead = qBound((qint64)0, spFirmwareImage->Size() - nCFilePos, (qint64)nBlockDataSize);
+        memcpy(XModemFirmwareFramer::Payload(aPacket), spFirmwareImage->Data() + nCFilePos, nRead);
+    }
+    else
+    {
+        if (fpFirmwareFile.pos() != nCFilePos)
         {
-            on_radio_Online_toggled(true);
+            fpFirmwareFile.seek(nCFilePos);
         }
+
+        nRead = fpFirmwareFile.read(reinterpret_cast<char *>(XModemFirmwareFramer::Payload(aPacket)), nBlockDataSize);
+    }
+    if (nRead <= 0)
+    {
+        nNextPacketState = NextPacketStateEndOfFile;
+        return;
+    }
+    else if (nRead < (qint64)nBlockDataSize)
+    {
+        //Final (padded) block
+        bLastPacketSent = true;
+    }
+
+    if (nBlockDataSize == XModemFallbackFramer::DataSize)
+    {
+        XModemFallbackFramer::FrameInPlace(aPacket.data(), nCPacket, nRead, nXModemPaddingCharacter);
     }
     else
     {
-        ui->edit_File->setEnabled(false);
-        ui->btn_Browse->setEnabled(false);
-        ui->btn_OnlineFirmwareRefresh->setEnabled(false);
-        ui->list_Firmwares->setEnabled(false);
+        XModemFirmwareFramer::FrameInPlace(aPacket, nCPacket, nRead, nXModemPaddingCharacter);
     }
+    nPreparedDataSize = nBlockDataSize;
+    nNextPacketState = NextPacketStateReady;
 }
 
 //=============================================================================
 //=============================================================================
 void
-MainWindow::on_combo_COM_currentIndexChanged(
-    int
+MainWindow::BlockWriteQueued(
     )
 {
-    //Serial port selection has been changed, update text
-    if (ui->combo_COM->currentText().length() > 0)
+    //A block has been handed to the serial port, start timing it
+    btTelemetry.nBytesQueued += baLastPacket.length();
+    bBlockWritePending = true;
+    nBlockDrainNs = 0;
+    etmrBlock.start();
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::BlockAcknowledged(
+    )
+{
+    //Splits the block turnaround into write drain time and receiver (ACK) time
+    if (!etmrBlock.isValid())
     {
-        QSerialPortInfo spiSerialInfo(ui->combo_COM->currentText());
-        if (spiSerialInfo.isValid())
-        {
-            //Port exists
-            QString strDisplayText(spiSerialInfo.description());
-            if (spiSerialInfo.manufacturer().length() > 1)
-            {
-                //Add manufacturer
-                strDisplayText.append(" (").append(spiSerialInfo.manufacturer()).append(")");
-            }
-            if (spiSerialInfo.serialNumber().length() > 1)
-            {
-                //Add serial
-                strDisplayText.append(" [").append(spiSerialInfo.serialNumber()).append("]");
-            }
-            ui->label_SerialInfo->setText(strDisplayText);
-        }
-        else
+        return;
+    }
+
+    qint64 nTotalNs = etmrBlock.nsecsElapsed();
+    if (bBlockWritePending == true || nBlockDrainNs > nTotalNs)
+    {
+        //Response arrived before the write completion was reported or the computed wire time ran past it, count all of it as drain time
+        bBlockWritePending = false;
+        nBlockDrainNs = nTotalNs;
+    }
+    btTelemetry.nDrainNs += nBlockDrainNs;
+    btTelemetry.nMaxDrainNs = qMax(btTelemetry.nMaxDrainNs, nBlockDrainNs);
+
+    qint64 nAckNs = nTotalNs - nBlockDrainNs;
+    if (pmsMetrics != NULL)
+    {
+        pmsMetrics->BlockAcknowledged(nTotalNs);
+    }
+    btTelemetry.nAckNs += nAckNs;
+    btTelemetry.nMaxAckNs = qMax(btTelemetry.nMaxAckNs, nAckNs);
+    ++btTelemetry.nBlocks;
+    vecBlockTurnaroundNs.append(nTotalNs);
+    etmrBlock.invalidate();
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::AdaptBlockSize(
+    bool bNack
+    )
+{
+    //Falls back to 128 byte blocks when NACKs spike, and returns to 1K blocks
+    //once the NACK rate at 128 bytes predicts 1K blocks would mostly get through
+    fNackRate = fNackRate * (1.0 - BLOCK_SIZE_NACK_RATE_WEIGHT) + (bNack == true ? BLOCK_SIZE_NACK_RATE_WEIGHT : 0.0);
+    if (bNack == false)
+    {
+        ++nBlocksAtBlockSize;
+    }
+
+    if (bAdaptiveBlockSize == false)
+    {
+        return;
+    }
+
+    if (nBlockDataSize == XModemFirmwareFramer::DataSize && fNackRate > BLOCK_SIZE_FALLBACK_NACK_RATE)
+    {
+        ui->edit_Log->appendPlainText(QString("NACK rate ").append(QString::number(fNackRate * PERCENT_100, 'f', 0)).append("%, sending 128 byte blocks"));
+        nBlockDataSize = XModemFallbackFramer::DataSize;
+
+        //The spare packet has not been sent yet, frame it again at the new size
+        if (nNextPacketState == NextPacketStateReady)
         {
-            //No such port
-            ui->label_SerialInfo->setText("Invalid serial port selected");
+            nNextPacketState = NextPacketStateNone;
+            bLastPacketSent = false;
         }
     }
+    else if (nBlockDataSize == XModemFallbackFramer::DataSize && nBlocksAtBlockSize >= BLOCK_SIZE_RESTORE_MINIMUM_BLOCKS && 1.0 - pow(1.0 - fNackRate, (double)XModemFirmwareFramer::PacketSize / XModemFallbackFramer::PacketSize) < BLOCK_SIZE_RESTORE_NACK_RATE)
+    {
+        //Errors are per byte, so a block 8 times longer is about 8 times as likely to be corrupted
+        ui->edit_Log->appendPlainText("Link is clean, sending 1K blocks");
+        nBlockDataSize = XModemFirmwareFramer::DataSize;
+    }
     else
     {
-        //Clear text as no port is selected
-        ui->label_SerialInfo->clear();
+        return;
     }
+
+    fNackRate = 0.0;
+    nBlocksAtBlockSize = 0;
+    ++btTelemetry.nBlockSizeChanges;
 }
 
 //=============================================================================
 //=============================================================================
-void
-MainWindow::on_btn_Query_clicked(
+qint64
+MainWindow::SerialWireTimeNs(
+    qint64 nBytes
     )
 {
-    //Query the current firmware version on the module
-    SetInputsEnabled(false);
-    nAppMode = ApplicationModeTypes::ApplicationModeTypeQuery;
-    OpenSerialPort();
+    //Time for the UART to clock out the bytes, with a start and stop bit per byte
+    if (spSerialPort.baudRate() <= 0)
+    {
+        return 0;
+    }
+    return nBytes * SERIAL_BITS_PER_BYTE * NS_PER_S / spSerialPort.baudRate();
 }
 
 //=============================================================================
 //=============================================================================
-void
-MainWindow::on_btn_OnlineFirmwareRefresh_clicked(
+qint64
+MainWindow::SerialBytesUnsent(
     )
 {
-    SetInputsEnabled(false);
-    nAppMode = ApplicationModeTypes::ApplicationModeTypeOnlineRefresh;
-    nmrReply = nmManager->get(QNetworkRequest(QUrl(
-#ifdef UseSSL
-        QString((ui->check_SSL->isChecked() ? "https" : "http"))
-#else
-        QString("http")
+    //Bytes still waiting in the tty output queue and UART, -1 if this cannot be read on this platform
+#ifdef Q_OS_LINUX
+    int nQueued = 0;
+    if (spSerialPort.handle() >= 0 && ioctl(spSerialPort.handle(), TIOCOUTQ, &nQueued) == 0)
+    {
+        return nQueued;
+    }
 #endif
-        .append("://").append(strOnlineHost).append("/Firmware/firmware.php?JSON=1&Dev=Pinnacle_100"))));
+    return -1;
 }
 
 //=============================================================================
 //=============================================================================
 void
-MainWindow::replyFinished(
-    QNetworkReply* nrReply
+MainWindow::LogBlockTelemetry(
     )
 {
-    //Response received from online server
-    if (nrReply->error() != QNetworkReply::NoError && nrReply->error() != QNetworkReply::ServiceUnavailableError)
+    //Outputs the per-block timing summary of the transfer which just finished
+    if (btTelemetry.nBlocks > 0)
     {
-        //Display error message if operation wasn't cancelled
-        if (nrReply->error() != QNetworkReply::OperationCanceledError)
+        ui->edit_Log->appendPlainText(QString("Block timing: ").append(QString::number(btTelemetry.nBlocks)).append(" blocks, ").append(QString::number(btTelemetry.nRetransmits)).append(" retransmits, write drain avg ").append(QString::number((double)btTelemetry.nDrainNs / btTelemetry.nBlocks / NS_PER_MS, 'f', 2)).append(" ms (max ").append(QString::number((double)btTelemetry.nMaxDrainNs / NS_PER_MS, 'f', 2)).append(" ms), receiver ACK avg ").append(QString::number((double)btTelemetry.nAckNs / btTelemetry.nBlocks / NS_PER_MS, 'f', 2)).append(" ms (max ").append(QString::number((double)btTelemetry.nMaxAckNs / NS_PER_MS, 'f', 2)).append(" ms)"));
+    }
+
+    if (btTelemetry.nBlockSizeChanges > 0)
+    {
+        ui->edit_Log->appendPlainText(QString("Block size: ").append(QString::number(btTelemetry.nSmallBlocks)).append(" blocks sent as 128 bytes, ").append(QString::number(btTelemetry.nBlockSizeChanges)).append(" block size changes"));
+    }
+
+    if (!vecBlockTurnaroundNs.isEmpty())
+    {
+        //Jitter is the spread of the block turnaround (write to ACK) times
+        QVector<qint64> vecSorted = vecBlockTurnaroundNs;
+        std::sort(vecSorted.begin(), vecSorted.end());
+        double fMeanNs = 0.0;
+        foreach (qint64 nTurnaroundNs, vecSorted)
         {
-            //Output error message
-            QString strMessage = QString("An error occured during an online request: ").append(nrReply->errorString());
-            pmErrorForm->SetMessage(&strMessage);
-            pmErrorForm->show();
-            SetInputsEnabled(true);
-            ui->edit_Log->appendPlainText("Error occured during online request");
+            fMeanNs += nTurnaroundNs;
+        }
+        fMeanNs /= vecSorted.count();
+        double fVarianceNs = 0.0;
+        foreach (qint64 nTurnaroundNs, vecSorted)
+        {
+            fVarianceNs += (nTurnaroundNs - fMeanNs) * (nTurnaroundNs - fMeanNs);
         }
+        fVarianceNs /= vecSorted.count();
+        qint64 nP50Ns = vecSorted.at((int)((vecSorted.count() - 1) * BLOCK_JITTER_PERCENTILE_50));
+        qint64 nP99Ns = vecSorted.at((int)((vecSorted.count() - 1) * BLOCK_JITTER_PERCENTILE_99));
+        ui->edit_Log->appendPlainText(QString("Block jitter: turnaround p50 ").append(QString::number((double)nP50Ns / NS_PER_MS, 'f', 2)).append(" ms, p99 ").append(QString::number((double)nP99Ns / NS_PER_MS, 'f', 2)).append(" ms, max ").append(QString::number((double)vecSorted.last() / NS_PER_MS, 'f', 2)).append(" ms, p99-p50 ").append(QString::number((double)(nP99Ns - nP50Ns) / NS_PER_MS, 'f', 2)).append(" ms, std dev ").append(QString::number(sqrt(fVarianceNs) / NS_PER_MS, 'f', 2)).append(" ms, real-time profile: ").append(RealtimeProfile::Summary()));
     }
-    else
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::EndSession(
+    bool bSuccess,
+    const QString &strMessage
+    )
+{
+    //Ends the current transfer session or query with the outcome given by the caller and hands the inputs back
+    lwLine.Disarm();
+    strStepVersion.clear();
+    strVersionBeforeUpgrade.clear();
+    tmrBootloaderEntranceTimer.stop();
+    SetInputsEnabled(true);
+
+    if (bSessionActive == true)
     {
-        //if (gchTermMode == MODE_CHECK_FIRMWARE_VERSIONS)
-        if (nAppMode == ApplicationModeTypes::ApplicationModeTypeOnlineRefresh)
+        bSessionActive = false;
+        spFirmwareImage.clear();
+        RecordLinkProfile(bSuccess);
+        if (pmsMetrics != NULL)
         {
-            //Response containing latest firmware versions for modules
-            QByteArray baTmpBA = nrReply->readAll();
-            QJsonParseError jpeJsonError;
-            QJsonDocument jdJsonData = QJsonDocument::fromJson(baTmpBA, &jpeJsonError);
+            pmsMetrics->SessionFinished(bSuccess);
+        }
 
-            if (jpeJsonError.error == QJsonParseError::NoError)
-            {
-                //Decoded JSON
-                QJsonObject joJsonObject = jdJsonData.object();
+        if (trpReplayer == NULL)
+        {
+            //Queued for the history writer thread, this does not wait for the database
+            fhrHistory.nTotalMs = etmrSession.elapsed();
+            fhrHistory.bSuccess = bSuccess;
+            fhrHistory.strMessage = strMessage;
+            FlashHistory::Instance().Append(fhrHistory);
+        }
+        emit SessionFinished(bSuccess, strMessage);
+    }
+
+    if (bInventoryQuery == true)
+    {
+        //Only failures carry an error for the inventory
+        bInventoryQuery = false;
+        emit QueryFinished(strDetectedMode, strQueryVersion, (bSuccess == true ? QString() : strMessage));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::SetInputsEnabled(
+    bool bEnabled
+    )
+{
+    ui->btn_Start->setEnabled(bEnabled);
+    ui->radio_LocalFile->setEnabled(bEnabled);
+    ui->radio_Online->setEnabled(bEnabled);
+#ifdef UseSSL
+    ui->check_SSL->setEnabled(bEnabled);
+#endif
+    ui->btn_OnlineFirmwareRefresh->setEnabled(bEnabled);
+    ui->check_UpgradePath->setEnabled(bEnabled);
+    ui->btn_Refresh->setEnabled(bEnabled);
+    ui->btn_Query->setEnabled(bEnabled);
+    ui->btn_Receive->setEnabled(bEnabled);
+    ui->combo_COM->setEnabled(bEnabled);
+    ui->combo_Baud->setEnabled(bEnabled);
+    ui->combo_Handshake->setEnabled(bEnabled);
+    ui->edit_File->setEnabled(bEnabled);
+    fpPrefetcher.SetPaused(!bEnabled);
+
+    if (bEnabled == true)
+    {
+        if (ui->radio_LocalFile->isChecked())
+        {
+            on_radio_LocalFile_toggled(true);
+        }
+        else if (ui->radio_Online->isChecked())
+        {
+            on_radio_Online_toggled(true);
+        }
+    }
+    else
+    {
+        ui->edit_File->setEnabled(false);
+        ui->btn_Browse->setEnabled(false);
+        ui->btn_OnlineFirmwareRefresh->setEnabled(false);
+        ui->check_UpgradePath->setEnabled(false);
+        ui->list_Firmwares->setEnabled(false);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+const FirmwareListStruct *
+MainWindow::SelectedFirmware(
+    )
+{
+    //Returns the catalog entry of the selected online firmware, or NULL if there is no selection
+    if (ui->list_Firmwares->selectionModel() == NULL)
+    {
+        return NULL;
+    }
+
+    QModelIndexList lstSelected = ui->list_Firmwares->selectionModel()->selectedRows();
+    if (lstSelected.count() != 1)
+    {
+        return NULL;
+    }
+
+    return fcFirmwareFiles.At(lstSelected.at(0).row());
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::StartupDeferred(
+    )
+{
+    //Runs once the first frame has been queued, engines driven by jobs never use the port list
+    if (bNonInteractive == false && bPortFromCaller == false)
+    {
+        RefreshSerialDevices();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+QNetworkAccessManager *
+MainWindow::NetworkManager(
+    )
+{
+    //Created on first online use, as it loads the SSL library and certificate
+    if (nmManager == NULL)
+    {
+        nmManager = new QNetworkAccessManager();
+        connect(nmManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(replyFinished(QNetworkReply*)));
+#ifdef UseSSL
+        connect(nmManager, SIGNAL(sslErrors(QNetworkReply*, QList<QSslError>)), this, SLOT(sslErrors(QNetworkReply*, QList<QSslError>)));
+
+        //Load SSL certificate
+        QFile certFile(":/certificates/UwTerminalX_new.crt");
+        if (certFile.open(QIODevice::ReadOnly))
+        {
+            //Load certificate data
+            sslcLairdConnectivity = new QSslCertificate(certFile.readAll());
+            QSslSocket::addDefaultCaCertificate(*sslcLairdConnectivity);
+            certFile.close();
+        }
+#endif
+        UpdateStatusMessage();
+    }
+
+    return nmManager;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::UpdateStatusMessage(
+    )
+{
+    ui->statusBar->showMessage(QString("XModemUtil")
+#ifdef UseSSL
+    .append(" (with SSL)")
+#endif
+    .append(" version ").append(strUtilVersion).append(" (").append(OS).append("), Built ").append(__DATE__).append(" Using QT ").append(QT_VERSION_STR)
+#ifdef UseSSL
+#ifdef TARGET_OS_MAC
+    .append(nmManager == NULL ? QString() : QString(", ").append(QString(QSslSocket::sslLibraryBuildVersionString()).replace(",", ":")))
+#else
+    .append(nmManager == NULL ? QString() : QString(", ").append(QString(QSslSocket::sslLibraryBuildVersionString()).left(QSslSocket::sslLibraryBuildVersionString().indexOf(" ", 9))))
+#endif
+#endif
+#ifdef QT_DEBUG
+    .append(" [DEBUG BUILD]")
+#endif
+    );
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::on_combo_COM_currentIndexChanged(
+    int
+    )
+{
+    //Serial port selection has been changed, update text
+    if (ui->combo_COM->currentText().length() > 0)
+    {
+        //Looked up in the last enumeration, constructing a QSerialPortInfo enumerates every port again
+        QSerialPortInfo spiSerialInfo;
+        foreach (const QSerialPortInfo &spiPort, lstSerialPorts)
+        {
+            if (spiPort.portName() == ui->combo_COM->currentText())
+            {
+                spiSerialInfo = spiPort;
+                break;
+            }
+        }
+
+        if (!spiSerialInfo.isNull())
+        {
+            //Port exists
+            QString strDisplayText(spiSerialInfo.description());
+            if (spiSerialInfo.manufacturer().length() > 1)
+            {
+                //Add manufacturer
+                strDisplayText.append(" (").append(spiSerialInfo.manufacturer()).append(")");
+            }
+            if (spiSerialInfo.serialNumber().length() > 1)
+            {
+                //Add serial
+                strDisplayText.append(" [").append(spiSerialInfo.serialNumber()).append("]");
+            }
+            ui->label_SerialInfo->setText(strDisplayText);
+        }
+        else
+        {
+            //No such port
+            ui->label_SerialInfo->setText("Invalid serial port selected");
+        }
+    }
+    else
+    {
+        //Clear text as no port is selected
+        ui->label_SerialInfo->clear();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::on_btn_Query_clicked(
+    )
+{
+    //Query the current firmware version on the module
+    QString strErrorMessage;
+    if (LineWatchdog::IsQuarantined(ui->combo_COM->currentText(), &strErrorMessage))
+    {
+        pmErrorForm->SetMessage(&strErrorMessage);
+        pmErrorForm->show();
+        return;
+    }
+
+    SetInputsEnabled(false);
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeQuery;
+    OpenSerialPort();
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::on_btn_Receive_clicked(
+    )
+{
+    //Receive a file from the module, the transfer needs to be started on the module
+    if (ui->combo_COM->currentText().isEmpty())
+    {
+        QString strMessage = "No port has been selected.";
+        pmErrorForm->SetMessage(&strMessage);
+        pmErrorForm->show();
+        return;
+    }
+
+    QString strFilename = QFileDialog::getSaveFileName(this, "Save Received File", QStandardPaths::writableLocation(QStandardPaths::DataLocation), "All Files (*.*)", NULL, QFileDialog::DontConfirmOverwrite);
+    if (strFilename.isEmpty())
+    {
+        return;
+    }
+
+    strReceiveFilename = strFilename;
+    nReceiveExpectedSize = 0;
+    SetInputsEnabled(false);
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeXModemReceive;
+    OpenSerialPort();
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::SetNonInteractive(
+    bool bEnabled
+    )
+{
+    //Used when driven by a job queue rather than a user, questions are answered by the job options instead
+    bNonInteractive = bEnabled;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::SetAdaptiveBlockSize(
+    bool bEnabled
+    )
+{
+    //When disabled every block is sent at 1K regardless of the NACK rate
+    bAdaptiveBlockSize = bEnabled;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::SetPrefetchRate(
+    qint64 nBytesPerSecond
+    )
+{
+    //Bandwidth used to prefetch firmware files after the catalog is loaded, 0 disables prefetching
+    fpPrefetcher.SetRate(nBytesPerSecond);
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::SetFirmwareHost(
+    const QString &strHost
+    )
+{
+    //Local mirror (host:port) used for firmware files, falling back to the online server, and for the catalog only whilst the online server is down
+    strFirmwareHost = strHost;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::StartFirmwareJob(
+    const QString &strPort,
+    qint32 nBaudRate,
+    int nHandshake,
+    const QString &strFirmwareFilename,
+    bool bForce,
+    QString *pstrError
+    )
+{
+    //Upgrades the module on a port with a local firmware file, SessionFinished() is emitted once it completes
+    if (bSessionActive == true || (spSerialPort.isOpen() && bPortWarm == false))
+    {
+        *pstrError = "A session is already running on this port";
+        return false;
+    }
+    else if (!QFile::exists(strFirmwareFilename))
+    {
+        *pstrError = QString("Firmware file '").append(strFirmwareFilename).append("' does not exist");
+        return false;
+    }
+    else if (LineWatchdog::IsQuarantined(strPort, pstrError))
+    {
+        return false;
+    }
+
+    ui->combo_COM->setEditText(strPort);
+    bPortFromCaller = true;
+    ui->combo_Baud->setEditText(QString::number(nBaudRate));
+    ui->combo_Handshake->setCurrentIndex(nHandshake);
+    ui->radio_LocalFile->setChecked(true);
+    ui->edit_File->setText(strFirmwareFilename);
+    ui->check_UpgradePath->setChecked(false);
+    bForceUpgrade = bForce;
+    lstUpgradePath.clear();
+    SetInputsEnabled(false);
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck;
+    StartImageVerification();
+    OpenSerialPort();
+
+    if (!spSerialPort.isOpen())
+    {
+        *pstrError = QString("Failed to open serial port '").append(strPort).append("': ").append(spSerialPort.errorString());
+        EndSession(false, *pstrError);
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::StartQuery(
+    const QString &strPort,
+    qint32 nBaudRate,
+    int nHandshake,
+    QString *pstrError
+    )
+{
+    //Detects the mode and firmware version of the module on a port without changing its mode, QueryFinished() is emitted once done
+    if (bSessionActive == true || (spSerialPort.isOpen() && bPortWarm == false))
+    {
+        *pstrError = "A session is already running on this port";
+        return false;
+    }
+    else if (LineWatchdog::IsQuarantined(strPort, pstrError))
+    {
+        return false;
+    }
+
+    ui->combo_COM->setEditText(strPort);
+    bPortFromCaller = true;
+    ui->combo_Baud->setEditText(QString::number(nBaudRate));
+    ui->combo_Handshake->setCurrentIndex(nHandshake);
+    strQueryVersion.clear();
+    SetInputsEnabled(false);
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeQuery;
+    bInventoryQuery = true;
+    OpenSerialPort();
+
+    if (!spSerialPort.isOpen())
+    {
+        *pstrError = QString("Failed to open serial port '").append(strPort).append("': ").append(spSerialPort.errorString());
+        bInventoryQuery = false;
+        EndSession(false, *pstrError);
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::DetectedMode(
+    const QString &strMode
+    )
+{
+    //Only the mode the module was first found in is reported
+    if (strDetectedMode.isEmpty())
+    {
+        strDetectedMode = strMode;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::StartXModemReceive(
+    const QString &strPort,
+    qint32 nBaudRate,
+    const QString &strFilename,
+    qint64 nExpectedSize,
+    QString *pstrError
+    )
+{
+    //Receives a file from the command line, the application exits once it finishes
+    ui->combo_COM->setEditText(strPort);
+    bPortFromCaller = true;
+    ui->combo_Baud->setEditText(QString::number(nBaudRate));
+    strReceiveFilename = strFilename;
+    nReceiveExpectedSize = nExpectedSize;
+    bExitWhenReceiveFinished = true;
+    SetInputsEnabled(false);
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeXModemReceive;
+    OpenSerialPort();
+
+    if (!spSerialPort.isOpen())
+    {
+        *pstrError = QString("Failed to open serial port '").append(strPort).append("': ").append(spSerialPort.errorString());
+        return false;
+    }
+    else if (!xrReceiver.IsRunning())
+    {
+        *pstrError = QString("Failed to open '").append(strFilename).append("' for writing");
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::BeginXModemReceive(
+    )
+{
+    //Starts the receive engine once the port is open
+    QString strError;
+    if (!xrReceiver.Start(strReceiveFilename, nReceiveExpectedSize, &strError))
+    {
+        spSerialPort.close();
+        ui->edit_Log->appendPlainText(QString("Unable to open '").append(strReceiveFilename).append("' for writing: ").append(strError));
+        EndSession(false, QString("Unable to open '").append(strReceiveFilename).append("' for writing: ").append(strError));
+        return;
+    }
+
+    if (xrReceiver.ResumedBytes() > 0)
+    {
+        ui->edit_Log->appendPlainText(QString("Resuming receive of ").append(strReceiveFilename).append(", ").append(QString::number(xrReceiver.ResumedBytes())).append(" bytes already stored"));
+    }
+    ui->edit_Log->appendPlainText(QString("Waiting for module to send ").append(strReceiveFilename).append("..."));
+
+    tpProgress.Begin(nReceiveExpectedSize);
+    tmrProgressUpdate.start(PROGRESS_FRAME_INTERVAL_MS);
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::XModemReceiveWrite(
+    QByteArray baData
+    )
+{
+    //Responses from the receive engine go out through the normal serial path (so are included in traces)
+    SerialWrite(baData);
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::XModemReceiveFinished(
+    bool bSuccess,
+    QString strMessage
+    )
+{
+    //Receive has completed or failed, the partial file and its checkpoint are kept on failure
+    qint64 nElapsedMs = (etmrElapsed.isValid() ? etmrElapsed.elapsed() : 0);
+    QString strResult = QString(bSuccess ? "Finished receiving " : "Failed receiving ").append(strReceiveFilename).append(": ").append(strMessage).append(" in ").append(QString::number(nElapsedMs / 1000.0, 'f', 1)).append(" seconds");
+    if (bSuccess == true && nElapsedMs > 0)
+    {
+        strResult.append(" (").append(QString::number(xrReceiver.BytesReceived() * 1000 / nElapsedMs)).append(" bytes/s)");
+    }
+    else if (bSuccess == false)
+    {
+        strResult.append(", it can be resumed by receiving to the same file again");
+    }
+
+    if (spSerialPort.isOpen())
+    {
+        //Make sure the final response has been handed to the port before closing it
+        spSerialPort.flush();
+        spSerialPort.close();
+    }
+    etmrElapsed.invalidate();
+    StopProgressUpdates();
+    ui->progressBar->setValue(bSuccess ? PERCENT_100 : 0);
+    ui->edit_Log->appendPlainText(strResult);
+    EndSession(bSuccess, strResult);
+
+    if (bExitWhenReceiveFinished == true)
+    {
+        QTextStream tsOutput(bSuccess ? stdout : stderr);
+        tsOutput << strResult << "\n";
+        tsOutput.flush();
+        QCoreApplication::exit(bSuccess ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::on_btn_OnlineFirmwareRefresh_clicked(
+    )
+{
+    //The catalog holds the hashes every download is checked against, so it comes from the online server whenever it can be reached
+    SetInputsEnabled(false);
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeOnlineRefresh;
+    nmrReply = NetworkManager()->get(QNetworkRequest(QUrl(FirmwareServerUrl(true).append("/Firmware/firmware.php?JSON=1&Dev=").append(strOnlineDevice))));
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::replyFinished(
+    QNetworkReply* nrReply
+    )
+{
+    //Response received from online server
+    if (RetryUpstream(nrReply))
+    {
+        //The mirror or online server could not answer, the request has been repeated to the other
+        nrReply->deleteLater();
+        return;
+    }
+    else if (hashUpgradePathReplies.contains(nrReply))
+    {
+        //Download of one step of a multi-step upgrade
+        UpgradePathDownloadFinished(nrReply);
+    }
+    else if (nrReply->error() != QNetworkReply::NoError && nrReply->error() != QNetworkReply::ServiceUnavailableError)
+    {
+        //Display error message if operation wasn't cancelled
+        if (nrReply->error() != QNetworkReply::OperationCanceledError)
+        {
+            //Output error message
+            QString strMessage = QString("An error occured during an online request: ").append(nrReply->errorString());
+            pmErrorForm->SetMessage(&strMessage);
+            pmErrorForm->show();
+            ui->edit_Log->appendPlainText("Error occured during online request");
+            EndSession(false, strMessage);
+        }
+    }
+    else
+    {
+        //if (gchTermMode == MODE_CHECK_FIRMWARE_VERSIONS)
+        if (nAppMode == ApplicationModeTypes::ApplicationModeTypeOnlineRefresh)
+        {
+            //Response containing latest firmware versions for modules
+            QByteArray baTmpBA = nrReply->readAll();
+            QJsonParseError jpeJsonError;
+            QJsonDocument jdJsonData = QJsonDocument::fromJson(baTmpBA, &jpeJsonError);
+
+            if (jpeJsonError.error == QJsonParseError::NoError)
+            {
+                //Decoded JSON
+                QJsonObject joJsonObject = jdJsonData.object();
+
+                if (joJsonObject["Result"].toString() == strOnlineResponseValid)
+                {
+                    //Update version list, the whole catalog is built first and then swapped into the model in a single reset
+                    FirmwareListStruct strNewFirmware;
+                    QVector<FirmwareListStruct> vecNewFirmwareFiles;
+
+                    QJsonArray joJsonFirmwareObjects = joJsonObject["Devices"].toObject()[strOnlineDevice].toArray();
+                    vecNewFirmwareFiles.reserve(joJsonFirmwareObjects.count());
+                    strNewFirmware.strDevice = strOnlineDevice;
+                    int i = 0;
+                    while (i < joJsonFirmwareObjects.count())
+                    {
+                        QJsonArray joJsonFirmwareObject = joJsonFirmwareObjects.at(i).toArray();
+                        strNewFirmware.strFilename = joJsonFirmwareObject.at(OnlineFirmwareJSONIndexFilename).toString();
+                        strNewFirmware.strFromVersion = joJsonFirmwareObject.at(OnlineFirmwareJSONIndexFromVersion).toString();
+                        strNewFirmware.strToVersion = joJsonFirmwareObject.at(OnlineFirmwareJSONIndexToVersion).toString();
+                        strNewFirmware.strSHA256 = joJsonFirmwareObject.at(OnlineFirmwareJSONIndexSHA256).toString();
+                        vecNewFirmwareFiles.append(strNewFirmware);
+                        ++i;
+                    }
+                    fcFirmwareFiles.SetEntries(vecNewFirmwareFiles);
+
+                    //Fetch the files recent modules are likely to need in the background, paused whilst anything else is running
+                    fpPrefetcher.Start(vecNewFirmwareFiles, FirmwareDownloadBaseUrl(), (strFirmwareHost.isEmpty() ? QString() : FirmwareServerUrl(true).append("/Firmware/Files/")),
+                                       QStandardPaths::writableLocation(QStandardPaths::DataLocation), FlashHistory::DefaultPath());
+                }
+                else
+                {
+                    //Server responded with error
+                    QString strMessage = QString("Server responded with error code ").append(joJsonObject["Result"].toString()).append(": ").append(joJsonObject["Error"].toString());
+                    pmErrorForm->SetMessage(&strMessage);
+                    pmErrorForm->show();
+                    ui->edit_Log->appendPlainText(QString("Error occured with online request (error: ").append(joJsonObject["Error"].toString()).append(")"));
+                }
+            }
+            else
+            {
+                //Error whilst decoding JSON
+                QString strMessage = QString("Unable to decode JSON data from server, debug data: ").append(jdJsonData.toBinaryData());
+                pmErrorForm->SetMessage(&strMessage);
+                pmErrorForm->show();
+                ui->edit_Log->appendPlainText("Error occured with decoding online JSON data");
+            }
+            SetInputsEnabled(true);
+        }
+        else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeOnlineFileDownload)
+        {
+            //Firmware upgrade file data received from server
+            const FirmwareListStruct *it = SelectedFirmware();
+
+            //Store file in writeable location
+            QFile fpTestFile(FirmwareCachePath(it));
+            ui->edit_File->setText(FirmwareCachePath(it));
+            fpTestFile.open(QFile::ReadWrite | QFile::Truncate);
+            fpTestFile.write(nrReply->readAll());
+            fpTestFile.flush();
+            fpTestFile.close();
+
+            //Switch to local file firmware download and begin the update process
+            ui->radio_LocalFile->setChecked(true);
+            nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck;
+            StartImageVerification();
+            OpenSerialPort();
+        }
+    }
+
+    //Queue the network reply object to be deleted
+    nrReply->deleteLater();
+}
+
+//=============================================================================
+//=============================================================================
+#ifdef UseSSL
+void
+MainWindow::sslErrors(
+    QNetworkReply* nrReply,
+    QList<QSslError> lstSSLErrors
+    )
+{
+    //Error detected with SSL
+    if (sslcLairdConnectivity != NULL && nrReply->sslConfiguration().peerCertificate() == *sslcLairdConnectivity)
+    {
+        //Server certificate matches
+        nrReply->ignoreSslErrors(lstSSLErrors);
+    }
+}
+#endif
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::BootloaderEntranceTimerTimeout(
+    )
+{
+    //Should now be in bootloader mode, checked until it is or the line watchdog steps in
+    if (SerialPinoutSignals() & QSerialPort::ClearToSendSignal)
+    {
+        //CTS is asserted, we are in the bootloader
+        tmrBootloaderEntranceTimer.stop();
+        DetectedMode(strModuleModeBootloader);
+        nAction = ActionModeTypes::ActionModeTypeBootloaderUnbridged;
+        ui->edit_Log->appendPlainText("Module in bootloader mode (assumed)");
+        SerialWrite(baBootloaderUnlockCommand);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::ModemRestartTimerTimeout(
+    )
+{
+    //Poll the modem for its version whilst it restarts after an upgrade step
+    if (nAppMode == ApplicationModeTypes::ApplicationModeTypeCompletionCheck && etmrModemRestart.elapsed() > MODEM_COMPLETION_TIMEOUT_MS)
+    {
+        //Upgrade never completed
+        QString strMessage = QString("Modem did not report firmware version ").append(strExpectedVersion.isEmpty() ? QString("other than ").append(strVersionBeforeUpgrade) : strExpectedVersion).append(" within ").append(QString::number(MODEM_COMPLETION_TIMEOUT_MS/60000)).append(" minutes of the upgrade being accepted, the upgrade may have failed.");
+        pmErrorForm->SetMessage(&strMessage);
+        pmErrorForm->show();
+        ui->edit_Log->appendPlainText("Error occured waiting for the module to complete the upgrade");
+        spSerialPort.close();
+        EndSession(false, strMessage);
+        return;
+    }
+    else if (nAppMode != ApplicationModeTypes::ApplicationModeTypeCompletionCheck && etmrModemRestart.elapsed() > MODEM_RESTART_TIMEOUT_MS)
+    {
+        //Modem never came back
+        lstUpgradePath.clear();
+        QString strMessage = "Modem did not respond after restarting from the previous upgrade step, remaining upgrade steps have been cancelled.";
+        pmErrorForm->SetMessage(&strMessage);
+        pmErrorForm->show();
+        ui->edit_Log->appendPlainText("Error occured waiting for modem to restart between upgrade steps");
+        spSerialPort.close();
+        EndSession(false, strMessage);
+        return;
+    }
+
+    baRecBuf.clear();
+    SerialWrite(QByteArray(baVersionQueryCommand).append(baCR));
+
+    //Back off so a module busy installing an upgrade is not flooded with commands
+    nModemRestartIntervalMs = qMin(nModemRestartIntervalMs * 2, MODEM_RESTART_CHECK_MAX_MS);
+    tmrModemRestartTimer.start(nModemRestartIntervalMs);
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::StartModemRestartPolling(
+    )
+{
+    //The first poll is soon after the upgrade is accepted, later polls back off
+    nModemRestartIntervalMs = MODEM_RESTART_CHECK_INITIAL_MS;
+    etmrModemRestart.start();
+    tmrModemRestartTimer.start(nModemRestartIntervalMs);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::AwaitingModule(
+    )
+{
+    //If the session is waiting on a prompt response from the module, rather than on the user,
+    //a download, file verification or the modem installing an upgrade
+    if (trpReplayer != NULL || !spSerialPort.isOpen() || QApplication::activeModalWidget() != NULL || bTransferAwaitingVerification == true || ivImageVerifier.IsCheckingCached() || !hashUpgradePathReplies.isEmpty() || tmrModemRestartTimer.isActive())
+    {
+        return false;
+    }
+
+    return (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate || nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck || nAppMode == ApplicationModeTypes::ApplicationModeTypeQuery || nAppMode == ApplicationModeTypes::ApplicationModeTypeUpgradePathCheck);
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::RestartDetection(
+    bool bEnterBootloader
+    )
+{
+    //Detects the module from scratch on the open port, a transfer in progress starts again once it has been found
+    tmrBootloaderEntranceTimer.stop();
+    tmrWarmSessionProbe.stop();
+    if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate)
+    {
+        RecordLinkProfile(false);
+        StopProgressUpdates();
+        ui->progressBar->setValue(0);
+        fpFirmwareFile.close();
+        nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck;
+    }
+
+    baRecBuf.clear();
+    if (bEnterBootloader == true)
+    {
+        SerialWrite(baZephyrEnterBootloader);
+        nAction = ActionModeTypes::ActionModeTypeUserApplication;
+        tmrBootloaderEntranceTimer.start(BOOTLOADER_ENTER_TIMER_CHECK_MS);
+    }
+    else
+    {
+        nAction = ActionModeTypes::ActionModeTypeModem;
+        SerialWrite(QByteArray(baVersionQueryCommand).append(baCR));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::LineWatchdogExpired(
+    )
+{
+    //The module has not made progress in the time allowed for the current recovery step
+    if (AwaitingModule() == false)
+    {
+        //Not a stall, the session is waiting on something else
+        lwLine.Heartbeat();
+        return;
+    }
+
+    LineRecoverySteps nStep = lwLine.Escalate();
+    if (nStep == LineRecoveryStepReprobe && nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate && (nAction == ActionModeTypes::ActionModeTypeXModemSendData || nAction == ActionModeTypes::ActionModeTypeXModemSendEndOfFrame))
+    {
+        //Send the last packet again unchanged, a receiver which already has it discards the duplicate
+        ui->edit_Log->appendPlainText("No response from module, sending the last packet again");
+        if (nAction == ActionModeTypes::ActionModeTypeXModemSendData)
+        {
+            BlockAcknowledged();
+            ++btTelemetry.nRetransmits;
+            SerialWrite(baLastPacket);
+            BlockWriteQueued();
+            if (pmsMetrics != NULL)
+            {
+                pmsMetrics->BlockRetransmitted(baLastPacket.length());
+            }
+        }
+        else
+        {
+            SerialWrite(baLastPacket);
+        }
+    }
+    else if (nStep == LineRecoveryStepReprobe)
+    {
+        ui->edit_Log->appendPlainText("No response from module, probing it again");
+        RestartDetection(false);
+    }
+    else if (nStep == LineRecoveryStepReset)
+    {
+        //The fixture wires DTR, and RTS when it is not used for flow control, to the module reset
+        ui->edit_Log->appendPlainText("Module is still not responding, resetting it");
+        spSerialPort.setDataTerminalReady(false);
+        if (spSerialPort.flowControl() != QSerialPort::HardwareControl)
+        {
+            spSerialPort.setRequestToSend(false);
+        }
+        QTimer::singleShot(LINE_WATCHDOG_RESET_PULSE_MS, this, SLOT(LineResetReleased()));
+    }
+    else if (nStep == LineRecoveryStepBootloader)
+    {
+        ui->edit_Log->appendPlainText("Module is still not responding, asking the application to enter the bootloader");
+        RestartDetection(true);
+    }
+    else
+    {
+        //Nothing brought the module back, the port is not used again until it has been released
+        QString strMessage;
+        LineWatchdog::Quarantine(spSerialPort.portName(), QSerialPortInfo(spSerialPort).serialNumber(), QString("module stopped responding").append(strDetectedMode.isEmpty() ? QString() : QString(" in ").append(strDetectedMode).append(" mode")).append(" and could not be recovered"));
+        LineWatchdog::IsQuarantined(spSerialPort.portName(), &strMessage);
+        strMessage.append(". Unplug the module and refresh the serial port list, then plug it or a replacement back in and refresh again to use the port.");
+        lstUpgradePath.clear();
+        tmrBootloaderEntranceTimer.stop();
+        StopProgressUpdates();
+        fpFirmwareFile.close();
+        spSerialPort.close();
+        pmErrorForm->SetMessage(&strMessage);
+        pmErrorForm->show();
+        ui->edit_Log->appendPlainText("Module could not be recovered, serial port quarantined");
+        EndSession(false, strMessage);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::LineResetReleased(
+    )
+{
+    //End of the reset pulse, the module restarts into its application
+    if (!spSerialPort.isOpen() || lwLine.Step() != LineRecoveryStepReset)
+    {
+        return;
+    }
+
+    spSerialPort.setDataTerminalReady(true);
+    if (spSerialPort.flowControl() != QSerialPort::HardwareControl)
+    {
+        spSerialPort.setRequestToSend(true);
+    }
+    RestartDetection(false);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::CompletionVersionReceived(
+    const QString &strFirmwareVersion,
+    bool *pbSuccess,
+    QString *pstrMessage
+    )
+{
+    //Checks the version reported after an upgrade, returns true whilst still waiting for the new firmware otherwise sets the outcome of the session
+    if (strFirmwareVersion == strVersionBeforeUpgrade)
+    {
+        //Previous firmware is still running until the upgrade has been installed
+        ui->edit_Log->appendPlainText(QString("Module is still running firmware version ").append(strFirmwareVersion).append(", waiting..."));
+        tmrModemRestartTimer.start(nModemRestartIntervalMs);
+        return true;
+    }
+    else if (!strExpectedVersion.isEmpty() && strFirmwareVersion != strExpectedVersion)
+    {
+        //Neither the old nor the new firmware, waiting any longer will not change that
+        *pstrMessage = QString("Modem restarted with firmware version ").append(strFirmwareVersion).append(" instead of ").append(strExpectedVersion).append(", the upgrade may have failed.");
+        pmErrorForm->SetMessage(pstrMessage);
+        pmErrorForm->show();
+        ui->edit_Log->appendPlainText(*pstrMessage);
+        return false;
+    }
+
+    if (pmsMetrics != NULL && etmrElapsed.isValid())
+    {
+        pmsMetrics->UpdateFinished(etmrElapsed.nsecsElapsed());
+    }
+    fhrHistory.strVersionAfter = strFirmwareVersion;
+    *pstrMessage = QString("Upgrade complete, module is running firmware version ").append(strFirmwareVersion).append(strExpectedVersion.isEmpty() ? " (no catalog entry to verify against)" : " (verified)").append(", total update time ").append(QString::number(etmrElapsed.elapsed()/1000)).append(" seconds");
+    ui->edit_Log->appendPlainText(*pstrMessage);
+    etmrElapsed.invalidate();
+    *pbSuccess = true;
+
+    return false;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::ProgressUpdateTimerTimeout(
+    )
+{
+    //Sample the progress published by the transfer engine
+    if ((nAppMode != ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate && nAppMode != ApplicationModeTypes::ApplicationModeTypeXModemReceive) || (!spSerialPort.isOpen() && trpReplayer == NULL))
+    {
+        //Transfer has ended or was aborted
+        StopProgressUpdates();
+        return;
+    }
+
+    tpProgress.Sample();
+    if (pmsMetrics != NULL)
+    {
+        pmsMetrics->SetBytesPerSecond(tpProgress.BytesPerSecond());
+    }
+    emit TransferProgressUpdated(tpProgress.BytesDone(), tpProgress.TotalBytes(), tpProgress.BytesPerSecond());
+    ui->progressBar->setValue(tpProgress.Percent());
+    ui->progressBar->setFormat(tpProgress.Summary());
+
+    if (nAppMode == ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate && etmrProgressLog.elapsed() >= PROGRESS_LOG_INTERVAL_MS)
+    {
+        //Blocks are summarised in the log rather than logged one by one, so the log costs the same at any block rate
+        etmrProgressLog.start();
+        ui->edit_Log->appendPlainText(QString("Sent ").append(QString::number(nCFilePos)).append(" bytes, ").append(QString::number(btTelemetry.nBlocks)).append(" blocks acknowledged, ").append(QString::number(btTelemetry.nRetransmits)).append(" retransmits"));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::StopProgressUpdates(
+    )
+{
+    tmrProgressUpdate.stop();
+    ui->progressBar->setFormat("%p%");
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::BeginFirmwareTransfer(
+    QString *pstrError
+    )
+{
+    //Opens the selected firmware file and asks the modem to start receiving it, sets the error if it could not be started
+    nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdate;
+    if (ivImageVerifier.IsRunning())
+    {
+        //Module detection finished before the file was verified, the transfer begins once verification completes
+        bTransferAwaitingVerification = true;
+        ui->edit_Log->appendPlainText("Waiting for firmware file verification to complete...");
+        return true;
+    }
+    else if (bImageVerified == false)
+    {
+        *pstrError = QString("Firmware file '").append(ui->edit_File->text()).append("' has not passed verification.");
+        pmErrorForm->SetMessage(pstrError);
+        pmErrorForm->show();
+        return false;
+    }
 
-                if (joJsonObject["Result"].toString() == strOnlineResponseValid)
-                {
-                    //Update version list
-                    FirmwareListStruct strNewFirmware;
-                    ui->list_Firmwares->clear();
-                    lstFirmwareFiles.clear();
+    fpFirmwareFile.setFileName(ui->edit_File->text());
+    if (fpFirmwareFile.open(QFile::ReadOnly))
+    {
+        if (!spFirmwareImage.isNull() && spFirmwareImage->Size() != fpFirmwareFile.size())
+        {
+            //File was replaced after it was verified, nothing unverified is sent so the transfer waits for it to be verified again
+            fpFirmwareFile.close();
+            ui->edit_Log->appendPlainText("Firmware file has changed since it was verified, verifying it again...");
+            StartImageVerification();
+            bTransferAwaitingVerification = true;
+            return true;
+        }
+        ui->edit_Log->appendPlainText(QString("Opened FOTO file, size: ").append(QString::number(fpFirmwareFile.size())));
+        tpProgress.Begin(fpFirmwareFile.size());
+        if (pmsMetrics != NULL && etmrDetection.isValid())
+        {
+            pmsMetrics->DetectionFinished(etmrDetection.nsecsElapsed());
+        }
+        etmrDetection.invalidate();
+        memset(&btTelemetry, 0, sizeof(btTelemetry));
+        vecBlockTurnaroundNs.clear();
+        if (fhrHistory.nDetectionMs < 0)
+        {
+            fhrHistory.nDetectionMs = etmrSession.elapsed();
+            fhrHistory.strVersionBefore = strVersionBeforeUpgrade;
+        }
+        fhrHistory.strFirmwareSHA256 = strImageSHA256;
+        fhrHistory.nImageSize += fpFirmwareFile.size();
+        etmrTransfer.start();
+        vecBlockTurnaroundNs.reserve((int)(fpFirmwareFile.size() / (qint64)XModemFirmwareFramer::DataSize) + 1);
+        bBlockWritePending = false;
+        etmrBlock.invalidate();
+        nNextPacketState = NextPacketStateNone;
+        nBlockDataSize = XModemFirmwareFramer::DataSize;
+        fNackRate = 0.0;
+        nBlocksAtBlockSize = 0;
+        tmrProgressUpdate.start(PROGRESS_FRAME_INTERVAL_MS);
+        etmrProgressLog.start();
+        nAction = ActionModeTypeXModemWaitForNack;
+        bLastPacketSent = false;
+        SerialWrite(QByteArray(baFirmwareUpgradeStartCommand).append("=").append(QString::number(fpFirmwareFile.size()).toUtf8()).append(baCRLF));
+        return true;
+    }
 
-                    QJsonArray joJsonFirmwareObjects = joJsonObject["Devices"].toObject()["Pinnacle_100"].toArray();
-                    uint8_t i = 0;
-                    while (i < joJsonFirmwareObjects.count())
-                    {
-                        QJsonArray joJsonFirmwareObject = joJsonFirmwareObjects.at(i).toArray();
-                        strNewFirmware.strFilename = joJsonFirmwareObject.at(OnlineFirmwareJSONIndexFilename).toString();
-                        strNewFirmware.strFromVersion = joJsonFirmwareObject.at(OnlineFirmwareJSONIndexFromVersion).toString();
-                        strNewFirmware.strToVersion = joJsonFirmwareObject.at(OnlineFirmwareJSONIndexToVersion).toString();
-                        strNewFirmware.strSHA256 = joJsonFirmwareObject.at(OnlineFirmwareJSONIndexSHA256).toString();
-                        lstFirmwareFiles.push_back(strNewFirmware);
-                        ui->list_Firmwares->addItem(QString(strNewFirmware.strFromVersion).append(" to ").append(strNewFirmware.strToVersion));
-                        ++i;
-                    }
-                }
-                else
-                {
-                    //Server responded with error
-                    QString strMessage = QString("Server responded with error code ").append(joJsonObject["Result"].toString()).append(": ").append(joJsonObject["Error"].toString());
-                    pmErrorForm->SetMessage(&strMessage);
-                    pmErrorForm->show();
-                    ui->edit_Log->appendPlainText(QString("Error occured with online request (error: ").append(joJsonObject["Error"].toString()).append(")"));
-                }
-            }
-            else
-            {
-                //Error whilst decoding JSON
-                QString strMessage = QString("Unable to decode JSON data from server, debug data: ").append(jdJsonData.toBinaryData());
-                pmErrorForm->SetMessage(&strMessage);
-                pmErrorForm->show();
-                ui->edit_Log->appendPlainText("Error occured with decoding online JSON data");
-            }
-            SetInputsEnabled(true);
+    ui->edit_Log->appendPlainText(QString("Error occured trying to open FOTO file: ").append(fpFirmwareFile.errorString()));
+    *pstrError = QString("Failed to open FOTO file '").append(ui->edit_File->text()).append("' for reading: ").append(fpFirmwareFile.errorString());
+    pmErrorForm->SetMessage(pstrError);
+    pmErrorForm->show();
+    return false;
+}
+
+//=============================================================================
+//=============================================================================
+QString
+MainWindow::FirmwareCachePath(
+    const FirmwareListStruct *pEntry
+    )
+{
+    return QString(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).append("/").append(pEntry->strFilename);
+}
+
+//=============================================================================
+//=============================================================================
+QUrl
+MainWindow::FirmwareDownloadUrl(
+    const FirmwareListStruct *pEntry
+    )
+{
+    return QUrl(FirmwareDownloadBaseUrl().append(pEntry->strFilename));
+}
+
+//=============================================================================
+//=============================================================================
+QString
+MainWindow::FirmwareDownloadBaseUrl(
+    )
+{
+    return FirmwareServerUrl(false).append("/Firmware/Files/");
+}
+
+//=============================================================================
+//=============================================================================
+QString
+MainWindow::FirmwareServerUrl(
+    bool bUpstream
+    )
+{
+    //The local mirror is plain HTTP, files from it are checked against the hashes in the online catalog
+    if (bUpstream == false && !strFirmwareHost.isEmpty())
+    {
+        return QString("http://").append(strFirmwareHost);
+    }
+
+    return
+#ifdef UseSSL
+        QString((ui->check_SSL->isChecked() ? "https" : "http"))
+#else
+        QString("http")
+#endif
+        .append("://").append(strOnlineHost);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::RetryUpstream(
+    QNetworkReply *nrReply
+    )
+{
+    //Requests the mirror failed are repeated to the online server, so the line keeps working if the mirror station is down.
+    //The catalog is the other way round: it is only taken from the mirror when the online server cannot be reached.
+    QUrl urlMirror(FirmwareServerUrl(false));
+    if (strFirmwareHost.isEmpty() || nrReply->error() == QNetworkReply::NoError || nrReply->error() == QNetworkReply::OperationCanceledError)
+    {
+        return false;
+    }
+    else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeOnlineRefresh && nmrReply == nrReply)
+    {
+        if (nrReply->url().host() == urlMirror.host() && nrReply->url().port() == urlMirror.port())
+        {
+            //Neither could be reached
+            return false;
         }
-        else if (nAppMode == ApplicationModeTypes::ApplicationModeTypeOnlineFileDownload)
+
+        QString strMirrorCatalog = FirmwareServerUrl(false).append(nrReply->url().path());
+        if (nrReply->url().hasQuery())
         {
-            //Firmware upgrade file data received from server
-            std::list<FirmwareListStruct>::iterator it = lstFirmwareFiles.begin();
-            uint8_t i = ui->list_Firmwares->row(ui->list_Firmwares->selectedItems().first());
-            while (i > 0)
+            strMirrorCatalog.append("?").append(nrReply->url().query());
+        }
+        ui->edit_Log->appendPlainText(QString("Online server ").append(strOnlineHost).append(" unavailable (").append(nrReply->errorString()).append("), using the unauthenticated firmware catalog from mirror ").append(strFirmwareHost));
+        nmrReply = NetworkManager()->get(QNetworkRequest(QUrl(strMirrorCatalog)));
+        return true;
+    }
+    else if (nrReply->url().host() != urlMirror.host() || nrReply->url().port() != urlMirror.port())
+    {
+        return false;
+    }
+
+    QString strUpstream = FirmwareServerUrl(true).append(nrReply->url().path());
+    if (nrReply->url().hasQuery())
+    {
+        strUpstream.append("?").append(nrReply->url().query());
+    }
+    ui->edit_Log->appendPlainText(QString("Firmware mirror ").append(strFirmwareHost).append(" unavailable (").append(nrReply->errorString()).append("), using ").append(strOnlineHost));
+
+    if (hashUpgradePathReplies.contains(nrReply))
+    {
+        //Written again from the start, the partial file is discarded
+        StartUpgradePathDownload(hashUpgradePathReplies.take(nrReply).nIndex, QUrl(strUpstream));
+        return true;
+    }
+
+    QNetworkReply *nrUpstream = NetworkManager()->get(QNetworkRequest(QUrl(strUpstream)));
+    if (nmrReply == nrReply)
+    {
+        nmrReply = nrUpstream;
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::StartImageVerification(
+    )
+{
+    //Begins hashing the selected firmware file in the background, known catalog files are checked against the catalog hash
+    QString strExpectedSHA256;
+    const FirmwareListStruct *pEntry = fcFirmwareFiles.At(fcFirmwareFiles.IndexOfFilename(QFileInfo(ui->edit_File->text()).fileName()));
+    if (pEntry != NULL)
+    {
+        strExpectedSHA256 = pEntry->strSHA256;
+    }
+
+    bImageVerified = false;
+    strImageSHA256.clear();
+    spFirmwareImage.clear();
+    bTransferAwaitingVerification = false;
+    bVerifyingCachedDownload = false;
+    ivImageVerifier.Start(ui->edit_File->text(), strExpectedSHA256);
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::ImageVerificationFinished(
+    ImageVerificationResult ivrResult
+    )
+{
+    if (ivrResult.strFilename != ui->edit_File->text())
+    {
+        //Result for a file which is no longer selected
+        return;
+    }
+
+    if (ivrResult.bValid == true)
+    {
+        bImageVerified = true;
+        strImageSHA256 = ivrResult.strSHA256;
+        spFirmwareImage = ivrResult.spImage;
+        ui->edit_Log->appendPlainText(QString("Firmware file ").append(ivrResult.bReferenceFound ? "verified" : "has no reference hash to verify against").append(", size: ").append(QString::number(ivrResult.nSize)).append(", SHA-256: ").append(ivrResult.strSHA256));
+        if (!spFirmwareImage.isNull())
+        {
+            ui->edit_Log->appendPlainText(spFirmwareImage->Published() ? "Firmware image published to shared memory" : "Using shared memory copy of firmware image");
+        }
+        else if (!ivrResult.strShareError.isEmpty())
+        {
+            //Transfer reads from the file as before
+            ui->edit_Log->appendPlainText(QString("Firmware image not shared: ").append(ivrResult.strShareError));
+        }
+
+        if (bTransferAwaitingVerification == true)
+        {
+            bTransferAwaitingVerification = false;
+            QString strError;
+            if (BeginFirmwareTransfer(&strError) == false)
             {
-                it++;
-                --i;
+                lstUpgradePath.clear();
+                spSerialPort.close();
+                EndSession(false, strError);
             }
+        }
+    }
+    else
+    {
+        //Reject the file before anything is sent to the modem
+        ui->edit_Log->appendPlainText(QString("Firmware file failed verification: ").append(ivrResult.strError));
+        bTransferAwaitingVerification = false;
+        tmrBootloaderEntranceTimer.stop();
+        tmrModemRestartTimer.stop();
+        if (spSerialPort.isOpen())
+        {
+            spSerialPort.close();
+        }
 
-            //Store file in writeable location
-            QFile fpTestFile(QString(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).append("/").append(it->strFilename));
-            ui->edit_File->setText(QString(QStandardPaths::writableLocation(QStandardPaths::DataLocation)).append("/").append(it->strFilename));
-            fpTestFile.open(QFile::ReadWrite | QFile::Truncate);
-            fpTestFile.write(nrReply->readAll());
-            fpTestFile.flush();
-            fpTestFile.close();
-
-            //Switch to local file firmware download and begin the update process
-            ui->radio_LocalFile->setChecked(true);
-            nAppMode = ApplicationModeTypes::ApplicationModeTypeFirmwareUpdateModeCheck;
-            OpenSerialPort();
+        if (bVerifyingCachedDownload == true && SelectedFirmware() != NULL)
+        {
+            //Cached copy of an online file is damaged, remove it and download it again
+            ui->edit_Log->appendPlainText("Removing damaged cached file and downloading it again...");
+            QFile::remove(ivrResult.strFilename);
+            ui->radio_Online->setChecked(true);
+            SetInputsEnabled(false);
+            nAppMode = ApplicationModeTypes::ApplicationModeTypeOnlineFileDownload;
+            nmrReply = NetworkManager()->get(QNetworkRequest(FirmwareDownloadUrl(SelectedFirmware())));
+        }
+        else
+        {
+            lstUpgradePath.clear();
+            QString strMessage = QString("Firmware file '").append(ivrResult.strFilename).append("' failed verification: ").append(ivrResult.strError);
+            pmErrorForm->SetMessage(&strMessage);
+            pmErrorForm->show();
+            EndSession(false, strMessage);
         }
     }
+    bVerifyingCachedDownload = false;
+}
 
-    //Queue the network reply object to be deleted
-    nrReply->deleteLater();
+//=============================================================================
+//=============================================================================
+void
+MainWindow::FirmwarePrefetched(
+    QString strFilename,
+    bool bSuccess,
+    QString strError
+    )
+{
+    //A background download into the firmware cache has finished
+    if (bSuccess == true)
+    {
+        ui->edit_Log->appendPlainText(QString("Prefetched ").append(strFilename));
+    }
+    else
+    {
+        ui->edit_Log->appendPlainText(QString("Unable to prefetch ").append(strFilename).append(": ").append(strError));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MainWindow::PrefetchUpgradePath(
+    const QString &strFirmwareVersion,
+    QString *pstrError
+    )
+{
+    //Plans the upgrade steps to the selected target version and downloads all missing steps in parallel, sets the error if there is nothing to upgrade
+    strVersionBeforeUpgrade = strFirmwareVersion;
+    const FirmwareListStruct *pTarget = SelectedFirmware();
+    if (pTarget == NULL || !UpgradePlanner::PlanPath(fcFirmwareFiles, strFirmwareVersion, pTarget->strToVersion, &lstUpgradePath))
+    {
+        *pstrError = QString("No upgrade path is available from firmware version ").append(strFirmwareVersion).append(" to ").append(pTarget == NULL ? QString("the selected version") : pTarget->strToVersion).append(".");
+        pmErrorForm->SetMessage(pstrError);
+        pmErrorForm->show();
+        ui->edit_Log->appendPlainText("Unable to plan upgrade path");
+        return false;
+    }
+
+    if (lstUpgradePath.isEmpty())
+    {
+        *pstrError = QString("Modem is already running firmware version ").append(strFirmwareVersion).append(".");
+        pmErrorForm->SetMessage(pstrError);
+        pmErrorForm->show();
+        return false;
+    }
+
+    QString strPlan = strFirmwareVersion;
+    QStringList lstPaths;
+    QStringList lstSHA256;
+    foreach (int nIndex, lstUpgradePath)
+    {
+        const FirmwareListStruct *pStep = fcFirmwareFiles.At(nIndex);
+        strPlan.append(" -> ").append(pStep->strToVersion);
+        lstPaths.append(FirmwareCachePath(pStep));
+        lstSHA256.append(pStep->strSHA256);
+    }
+    ui->edit_Log->appendPlainText(QString("Upgrade path (").append(QString::number(lstUpgradePath.count())).append(" steps): ").append(strPlan));
+
+    //Cached steps are hashed on the verifier's worker, the missing ones are downloaded once it has finished
+    ivImageVerifier.CheckCached(lstPaths, lstSHA256);
+
+    return true;
 }
 
 //=============================================================================
 //=============================================================================
-#ifdef UseSSL
 void
-MainWindow::sslErrors(
-    QNetworkReply* nrReply,
-    QList<QSslError> lstSSLErrors
+MainWindow::UpgradePathCachedChecked(
+    QList<int> lstMissing
     )
 {
-    //Error detected with SSL
-    if (sslcLairdConnectivity != NULL && nrReply->sslConfiguration().peerCertificate() == *sslcLairdConnectivity)
+    //Positions in the upgrade path of the steps which are not in the cache
+    if (nAppMode != ApplicationModeTypes::ApplicationModeTypeUpgradePathCheck || lstUpgradePath.isEmpty() || !spSerialPort.isOpen())
     {
-        //Server certificate matches
-        nrReply->ignoreSslErrors(lstSSLErrors);
+        //Session ended whilst the cache was checked
+        return;
+    }
+
+    if (lstMissing.isEmpty())
+    {
+        //Every step is already in the cache
+        StartUpgradePath();
+        return;
     }
+
+    foreach (int nStep, lstMissing)
+    {
+        //Queue download, replies are handled as they complete
+        StartUpgradePathDownload(lstUpgradePath.at(nStep), FirmwareDownloadUrl(fcFirmwareFiles.At(lstUpgradePath.at(nStep))));
+    }
+    ui->edit_Log->appendPlainText(QString("Downloading ").append(QString::number(hashUpgradePathReplies.count())).append(" upgrade files..."));
 }
-#endif
 
 //=============================================================================
 //=============================================================================
 void
-MainWindow::BootloaderEntranceTimerTimeout(
+MainWindow::StartUpgradePathDownload(
+    int nIndex,
+    const QUrl &urlFile
+    )
+{
+    //The cached file is only replaced once the whole download matches the catalog hash
+    UpgradePathDownloadStruct updDownload;
+    updDownload.nIndex = nIndex;
+    updDownload.spFile = QSharedPointer<QSaveFile>(new QSaveFile(FirmwareCachePath(fcFirmwareFiles.At(nIndex))));
+    updDownload.spFile->open(QFile::WriteOnly);
+    updDownload.spHash = QSharedPointer<QCryptographicHash>(new QCryptographicHash(QCryptographicHash::Sha256));
+
+    QNetworkReply *nrStepReply = NetworkManager()->get(QNetworkRequest(urlFile));
+    connect(nrStepReply, SIGNAL(readyRead()), this, SLOT(UpgradePathDownloadReadyRead()));
+    hashUpgradePathReplies.insert(nrStepReply, updDownload);
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::UpgradePathDownloadReadyRead(
     )
 {
-    //Should now be in bootloader mode
-    if (spSerialPort.pinoutSignals() & QSerialPort::ClearToSendSignal)
+    //Each chunk is hashed and written as it arrives, so no step is held in memory or hashed in one go
+    QNetworkReply *nrReply = qobject_cast<QNetworkReply *>(sender());
+    if (nrReply == NULL || !hashUpgradePathReplies.contains(nrReply))
     {
-        //CTS is asserted, we are in the bootloader
-        tmrBootloaderEntranceTimer.stop();
-        nAction = ActionModeTypes::ActionModeTypeBootloaderUnbridged;
-        ui->edit_Log->appendPlainText("Module in bootloader mode (assumed)");
-        spSerialPort.write(baBootloaderUnlockCommand);
         return;
     }
 
-    ++nBootloaderTimerChecks;
-    if (nBootloaderTimerChecks > BOOTLOADER_ENTER_CHECK_TIMES)
+    UpgradePathDownloadStruct &updDownload = hashUpgradePathReplies[nrReply];
+    QByteArray baData = nrReply->readAll();
+    updDownload.spHash->addData(baData);
+    if (updDownload.spFile->isOpen())
     {
-        //Failed to enter bootloader mode
-        tmrBootloaderEntranceTimer.stop();
-        QString strMessage = "CTS is de-asserted, module has failed to enter bootloader mode.";
+        updDownload.spFile->write(baData);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::UpgradePathDownloadFinished(
+    QNetworkReply *nrReply
+    )
+{
+    //One step of a multi-step upgrade has been downloaded, the remainder of the reply is hashed and written first
+    bool bFailed = (nrReply->error() != QNetworkReply::NoError);
+    UpgradePathDownloadStruct updDownload = hashUpgradePathReplies.take(nrReply);
+    const FirmwareListStruct *pStep = fcFirmwareFiles.At(updDownload.nIndex);
+    if (bFailed == false)
+    {
+        QByteArray baData = nrReply->readAll();
+        updDownload.spHash->addData(baData);
+        if (updDownload.spFile->isOpen())
+        {
+            updDownload.spFile->write(baData);
+        }
+
+        if (updDownload.spHash->result().toHex() != pStep->strSHA256.toLower().toLatin1())
+        {
+            //Download corrupt
+            bFailed = true;
+        }
+        else if (!updDownload.spFile->commit())
+        {
+            bFailed = true;
+        }
+        else
+        {
+            ui->edit_Log->appendPlainText(QString("Downloaded ").append(pStep->strFilename));
+        }
+    }
+
+    if (bFailed == true && updDownload.spFile->isOpen())
+    {
+        updDownload.spFile->cancelWriting();
+    }
+
+    if (bFailed == true)
+    {
+        //Abort remaining downloads and the upgrade
+        QList<QNetworkReply *> lstPending = hashUpgradePathReplies.keys();
+        hashUpgradePathReplies.clear();
+        foreach (QNetworkReply *nrPending, lstPending)
+        {
+            nrPending->abort();
+        }
+        lstUpgradePath.clear();
+        spSerialPort.close();
+        QString strMessage = QString("Failed to download upgrade file ").append(pStep->strFilename).append(": ").append(nrReply->error() != QNetworkReply::NoError ? nrReply->errorString() : QString("file could not be verified or saved"));
         pmErrorForm->SetMessage(&strMessage);
         pmErrorForm->show();
-        ui->edit_Log->appendPlainText("Error occured with module entering bootloader mode (CTS de-asserted)");
+        ui->edit_Log->appendPlainText("Error occured downloading upgrade path");
+        EndSession(false, strMessage);
+    }
+    else if (hashUpgradePathReplies.isEmpty() && !lstUpgradePath.isEmpty())
+    {
+        StartUpgradePath();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MainWindow::StartUpgradePath(
+    )
+{
+    //All steps are available locally, begin the first transfer on the already open port
+    ui->edit_File->setText(FirmwareCachePath(fcFirmwareFiles.At(lstUpgradePath.first())));
+    ui->radio_LocalFile->setChecked(true);
+    StartImageVerification();
+    QString strError;
+    if (BeginFirmwareTransfer(&strError) == false)
+    {
+        lstUpgradePath.clear();
         spSerialPort.close();
-        SetInputsEnabled(true);
+        EndSession(false, strError);
     }
 }
 
@@ -1054,6 +3049,7 @@ void
 MainWindow::on_btn_Refresh_clicked(
     )
 {
+    //Quarantined ports which have been replugged are released once the ports have been enumerated
     RefreshSerialDevices();
 }
 
@@ -1078,6 +3074,7 @@ MainWindow::on_radio_LocalFile_toggled(
         ui->edit_File->setEnabled(true);
         ui->btn_Browse->setEnabled(true);
         ui->btn_OnlineFirmwareRefresh->setEnabled(false);
+        ui->check_UpgradePath->setEnabled(false);
         ui->list_Firmwares->setEnabled(false);
     }
 }
@@ -1094,6 +3091,7 @@ MainWindow::on_radio_Online_toggled(
         ui->edit_File->setEnabled(false);
         ui->btn_Browse->setEnabled(false);
         ui->btn_OnlineFirmwareRefresh->setEnabled(true);
+        ui->check_UpgradePath->setEnabled(true);
         ui->list_Firmwares->setEnabled(true);
     }
 }
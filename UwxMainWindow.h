@@ -41,12 +41,29 @@
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QUrl>
+#include <QVector>
+#include <QList>
+#include <QFutureWatcher>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QSharedPointer>
 #include "UwxPopup.h"
+#include "UwxFirmwareCatalog.h"
+#include "UwxFirmwarePrefetcher.h"
+#include "UwxFlashHistory.h"
+#include "UwxImageVerifier.h"
+#include "UwxLineWatchdog.h"
+#include "UwxLinkProfiles.h"
+#include "UwxMetrics.h"
+#include "UwxSerialTrace.h"
+#include "UwxSharedImage.h"
+#include "UwxTransferProgress.h"
+#include "UwxXModemFramer.h"
+#include "UwxXModemReceiver.h"
 
 /******************************************************************************/
 // Defines
 /******************************************************************************/
-#define XMODEM_INVERSE                            0xff
 #define XMODEM_FIRST_PACKET_ID                    1
 #define XMODEM_SECOND_PACKET_ID                   2
 #define PERCENT_100                               100
@@ -57,11 +74,28 @@
 #define BOOTLOADER_ERROR_CHAR_INDEX               0
 #define BOOTLOADER_ERROR_RESPONSE_INDEX           1
 #define BOOTLOADER_ENTER_TIMER_CHECK_MS           1500
-#define BOOTLOADER_ENTER_CHECK_TIMES              5
 #define MODEM_WAKEUP_RESPONSE_MINIMUM_SIZE        3
 #define MODEM_VERSION_MODEL_MINIMUM_SIZE          14
 #define MODEM_VERSION_MINIMUM_SIZE                7
 #define ZEPHYR_APPLICATION_TRIGGER_DATA_SIZE      30
+#define MODEM_RESTART_CHECK_INITIAL_MS            1000
+#define MODEM_RESTART_CHECK_MAX_MS                8000
+#define MODEM_RESTART_TIMEOUT_MS                  300000
+#define MODEM_COMPLETION_TIMEOUT_MS               600000
+#define WARM_SESSION_IDLE_MS                      30000
+#define WARM_SESSION_MAX_AGE_MS                   30000
+#define WARM_SESSION_PROBE_TIMEOUT_MS             500
+#define XMODEM_PACKET_BUFFERS                     2
+#define NS_PER_MS                                 1000000.0
+#define NS_PER_S                                  1000000000LL
+#define SERIAL_BITS_PER_BYTE                      10
+#define PROGRESS_LOG_INTERVAL_MS                  1000
+#define BLOCK_JITTER_PERCENTILE_50                0.50
+#define BLOCK_JITTER_PERCENTILE_99                0.99
+#define BLOCK_SIZE_NACK_RATE_WEIGHT               0.125
+#define BLOCK_SIZE_FALLBACK_NACK_RATE             0.25
+#define BLOCK_SIZE_RESTORE_NACK_RATE              0.1
+#define BLOCK_SIZE_RESTORE_MINIMUM_BLOCKS         32
 
 #ifndef QT_NO_SSL
     #define UseSSL //By default enable SSL if Qt supports it (requires OpenSSL runtime libraries). Comment this line out to build without SSL support or if you get errors when communicating with the server
@@ -75,8 +109,6 @@
 /******************************************************************************/
 const QString    strUtilVersion                 = "0.3"; //Version string
 const uint8_t    nXModemPaddingCharacter        = 26;
-const qint16     nXModemDataSize                = 1024;
-const qint16     nXModemHeaderSize              = 3;
 const QByteArray baBootloaderUnlockCommand      = QByteArray("p\x0f\x51\x2a\x51");
 const QByteArray baBootloaderBridgeUARTsCommand = QByteArray("~\x01\x06\x01\x06");
 const QByteArray baFirmwareUpgradeStartCommand  = QByteArray("AT+WDSD");
@@ -90,8 +122,13 @@ const QByteArray baNotFoundError                = QByteArray("not found");
 const uint8_t    nModemVersionCutChars          = 7;
 const QString    strFileVersionTo               = QString("_to");
 const QByteArray baZephyrEnterBootloader        = QByteArray("mg100 bootloader\r\noob bootloader\r\n");
+const QString    strModuleModeModem             = QString("modem");
+const QString    strModuleModeBootloader        = QString("bootloader");
+const QString    strModuleModeBridged           = QString("bootloader (bridged)");
+const QString    strModuleModeApplication       = QString("application");
 const QString    strOnlineResponseValid         = QString("1");
 const QString    strOnlineHost                  = "uwterminalx.lairdconnect.com";
+const QString    strOnlineDevice                = "Pinnacle_100";
 
 /******************************************************************************/
 // Forward declaration of Class, Struct & Unions
@@ -101,23 +138,54 @@ namespace Ui
     class MainWindow;
 }
 
-//
+//Framer used for firmware upgrades, the HL7800 expects 1K blocks with an 8-bit checksum
+typedef XModem1KSum8Framer XModemFirmwareFramer;
+
+//Framer used whilst the link is noisy, a corrupted block costs far less to
+//retransmit. Packets of either size are held in the same buffers.
+typedef XModem128Sum8Framer XModemFallbackFramer;
+
+//Per-transfer block timing, drain is the time until the last bit of a block
+//has left the UART and ACK is the time from then until the receiver responds
+typedef struct
+{
+    qint64 nBlocks;
+    qint64 nRetransmits;
+    qint64 nBytesQueued;
+    qint64 nBytesDrained;
+    qint64 nDrainNs;
+    qint64 nMaxDrainNs;
+    qint64 nAckNs;
+    qint64 nMaxAckNs;
+    qint64 nBytesAcked;
+    qint64 nSmallBlocks;
+    qint64 nBlockSizeChanges;
+} BlockTelemetryStruct;
+
+//Module state remembered for a port left open between sessions
+typedef struct
+{
+    QString strSerialNumber;
+    QString strPort;
+    QString strState;
+    QString strFirmwareVersion;
+    QElapsedTimer etmrLastSeen;
+} WarmSessionStruct;
+
+//Upgrade step being downloaded, written to the cache and hashed as it arrives
 typedef struct
 {
-    QString strFilename;
-    QString strFromVersion;
-    QString strToVersion;
-    QString strSHA256;
-} FirmwareListStruct;
+    int nIndex;
+    QSharedPointer<QSaveFile> spFile;
+    QSharedPointer<QCryptographicHash> spHash;
+} UpgradePathDownloadStruct;
 
-//Enum used for type of XModem packet
-enum XModemPacketTypes
+//Enum used for the state of the spare packet buffer
+enum NextPacketStates
 {
-    XModemPacketType128BytePacket               = 0x01,
-    XModemPacketType1024BytePacket              = 0x02,
-    XModemPacketTypeEndOfFrame                  = 0x04,
-    XModemPacketTypeAck                         = 0x06,
-    XModemPacketTypeNack                        = 0x15
+    NextPacketStateNone                         = 0,
+    NextPacketStateReady,
+    NextPacketStateEndOfFile
 };
 
 //Enum used for the current application mode
@@ -127,7 +195,11 @@ enum ApplicationModeTypes
     ApplicationModeTypeQuery,
     ApplicationModeTypeOnlineFileDownload,
     ApplicationModeTypeOnlineRefresh,
-    ApplicationModeTypeFirmwareUpdateModeCheck
+    ApplicationModeTypeFirmwareUpdateModeCheck,
+    ApplicationModeTypeUpgradePathCheck,
+    ApplicationModeTypeXModemReceive,
+    ApplicationModeTypeCompletionCheck,
+    ApplicationModeTypeWarmIdle
 };
 
 //Enum used for the current action type
@@ -190,12 +262,86 @@ public:
         );
     ~MainWindow(
         );
+    bool
+    StartTraceRecording(
+        const QString &strFilename
+        );
+    bool
+    StartTraceReplay(
+        const QString &strTraceFilename,
+        const QString &strFirmwareFilename,
+        double fSpeed,
+        QString *pstrError
+        );
+    void
+    SetNonInteractive(
+        bool bEnabled
+        );
+    void
+    SetAdaptiveBlockSize(
+        bool bEnabled
+        );
+    void
+    SetPrefetchRate(
+        qint64 nBytesPerSecond
+        );
+    void
+    SetFirmwareHost(
+        const QString &strHost
+        );
+    bool
+    StartFirmwareJob(
+        const QString &strPort,
+        qint32 nBaudRate,
+        int nHandshake,
+        const QString &strFirmwareFilename,
+        bool bForce,
+        QString *pstrError
+        );
+    bool
+    StartXModemReceive(
+        const QString &strPort,
+        qint32 nBaudRate,
+        const QString &strFilename,
+        qint64 nExpectedSize,
+        QString *pstrError
+        );
+    bool
+    StartQuery(
+        const QString &strPort,
+        qint32 nBaudRate,
+        int nHandshake,
+        QString *pstrError
+        );
+
+signals:
+    void
+    SessionFinished(
+        bool bSuccess,
+        QString strMessage
+        );
+    void
+    TransferProgressUpdated(
+        qint64 nBytesDone,
+        qint64 nTotalBytes,
+        double fBytesPerSecond
+        );
+    void
+    QueryFinished(
+        QString strMode,
+        QString strFirmwareVersion,
+        QString strError
+        );
 
 public slots:
     void
     SerialRead(
         );
     void
+    SerialDataReceived(
+        QByteArray baRecData
+        );
+    void
     SerialError(
         QSerialPort::SerialPortError speErrorCode
         );
@@ -222,6 +368,18 @@ private slots:
     on_btn_Query_clicked(
         );
     void
+    on_btn_Receive_clicked(
+        );
+    void
+    XModemReceiveWrite(
+        QByteArray baData
+        );
+    void
+    XModemReceiveFinished(
+        bool bSuccess,
+        QString strMessage
+        );
+    void
     replyFinished(
         QNetworkReply* nrReply
         );
@@ -239,6 +397,52 @@ private slots:
     BootloaderEntranceTimerTimeout(
         );
     void
+    ModemRestartTimerTimeout(
+        );
+    void
+    LineWatchdogExpired(
+        );
+    void
+    LineResetReleased(
+        );
+    void
+    WarmSessionIdleTimeout(
+        );
+    void
+    WarmSessionProbeTimeout(
+        );
+    void
+    ProgressUpdateTimerTimeout(
+        );
+    void
+    TraceReplayFinished(
+        bool bSuccess,
+        QString strMessage
+        );
+    void
+    ImageVerificationFinished(
+        ImageVerificationResult ivrResult
+        );
+    void
+    UpgradePathCachedChecked(
+        QList<int> lstMissing
+        );
+    void
+    UpgradePathDownloadReadyRead(
+        );
+    void
+    FirmwarePrefetched(
+        QString strFilename,
+        bool bSuccess,
+        QString strError
+        );
+    void
+    StartupDeferred(
+        );
+    void
+    SerialDevicesFound(
+        );
+    void
     on_btn_Refresh_clicked(
         );
     void
@@ -260,40 +464,230 @@ private:
     void
     RefreshSerialDevices(
         );
+    QNetworkAccessManager *
+    NetworkManager(
+        );
+    void
+    UpdateStatusMessage(
+        );
     void
     OpenSerialPort(
         );
-    uint8_t
-    Calc8BitCRC(
-        char *pData,
-        uint16_t nSize
+    void
+    SerialWrite(
+        const QByteArray &baData
+        );
+    quint32
+    SerialPinoutSignals(
+        );
+    void
+    BeginXModemReceive(
+        );
+    bool
+    LoadNextPacket(
+        );
+    void
+    PrepareNextPacket(
+        );
+    void
+    BlockWriteQueued(
+        );
+    void
+    BlockAcknowledged(
+        );
+    void
+    AdaptBlockSize(
+        bool bNack
+        );
+    qint64
+    SerialWireTimeNs(
+        qint64 nBytes
+        );
+    qint64
+    SerialBytesUnsent(
+        );
+    void
+    LogBlockTelemetry(
+        );
+    void
+    EndSession(
+        bool bSuccess,
+        const QString &strMessage
         );
     void
     SetInputsEnabled(
         bool bEnabled
         );
+    const FirmwareListStruct *
+    SelectedFirmware(
+        );
+    void
+    StopProgressUpdates(
+        );
+    bool
+    BeginFirmwareTransfer(
+        QString *pstrError
+        );
+    QString
+    FirmwareCachePath(
+        const FirmwareListStruct *pEntry
+        );
+    QUrl
+    FirmwareDownloadUrl(
+        const FirmwareListStruct *pEntry
+        );
+    QString
+    FirmwareDownloadBaseUrl(
+        );
+    QString
+    FirmwareServerUrl(
+        bool bUpstream
+        );
+    bool
+    RetryUpstream(
+        QNetworkReply *nrReply
+        );
+    void
+    StartImageVerification(
+        );
+    bool
+    PrefetchUpgradePath(
+        const QString &strFirmwareVersion,
+        QString *pstrError
+        );
+    void
+    StartUpgradePathDownload(
+        int nIndex,
+        const QUrl &urlFile
+        );
+    void
+    UpgradePathDownloadFinished(
+        QNetworkReply *nrReply
+        );
+    void
+    StartUpgradePath(
+        );
+    void
+    StartModemRestartPolling(
+        );
+    bool
+    AwaitingModule(
+        );
+    void
+    RestartDetection(
+        bool bEnterBootloader
+        );
+    bool
+    CompletionVersionReceived(
+        const QString &strFirmwareVersion,
+        bool *pbSuccess,
+        QString *pstrMessage
+        );
+    void
+    DetectedMode(
+        const QString &strMode
+        );
+    void
+    StartSession(
+        );
+    bool
+    WarmSessionUsable(
+        );
+    QSerialPort::FlowControl
+    SelectedFlowControl(
+        );
+    void
+    KeepSessionWarm(
+        const QString &strFirmwareVersion
+        );
+    void
+    ApplyLinkProfile(
+        );
+    void
+    RecordLinkProfile(
+        bool bSuccess
+        );
 
     Ui::MainWindow *ui;
     QSerialPort spSerialPort;                       //Contains the handle for the serial port
     QFile fpFirmwareFile;                           //Currently open firmware upgrade file
-    QByteArray baLastPacket;                        //Contains the last sent (serial) packet
+    XModemFirmwareFramer::Packet aPacketBuffers[XMODEM_PACKET_BUFFERS]; //Fixed size buffers for the current and next XModem packets
+    uint8_t nActivePacketBuffer = 0;                //Index of the buffer holding the current packet
+    NextPacketStates nNextPacketState = NextPacketStateNone; //State of the spare buffer
+    size_t nPreparedDataSize = 0;                   //Block size of the packet in the spare buffer
+    size_t nActiveDataSize = 0;                     //Block size of the current packet
+    size_t nBlockDataSize = XModemFirmwareFramer::DataSize; //Block size new packets are framed with
+    bool bAdaptiveBlockSize = true;                 //If the block size is reduced whilst the link is noisy
+    double fNackRate = 0.0;                         //Moving average of the NACK rate at the current block size
+    qint64 nBlocksAtBlockSize = 0;                  //Blocks acknowledged since the block size last changed
+    QByteArray baLastPacket;                        //Contains the last sent (serial) packet, refers to the active packet buffer during data transfer
     ApplicationModeTypes nAppMode;                  //Current application mode
     ActionModeTypes nAction;                        //Current action of mode
     uint8_t nCPacket = 0;                           //Current packet index
-    uint32_t nCFilePos = 0;                         //Current offset of firmware file for reading
+    qint64 nCFilePos = 0;                           //Current offset of firmware file for reading
     bool bLastPacketSent = false;                   //If the final end of frame packet has been sent
     QElapsedTimer etmrElapsed;                      //Elapsed timer for timing firmware update
     QTimer tmrBootloaderEntranceTimer;              //Timer used for checking if the bootloader has been entered
-    uint16_t nBytesWritten = 0;                     //Bytes written to the remote (serial) device
+    qint64 nBytesWritten = 0;                       //Bytes written to the remote (serial) device
+    BlockTelemetryStruct btTelemetry;               //Block timing of the current transfer
+    QElapsedTimer etmrBlock;                        //Time since the current block was written
+    bool bBlockWritePending = false;                //If the current block has not finished draining from the serial port
+    qint64 nBlockDrainNs = 0;                       //Drain time of the current block
+    QElapsedTimer etmrTransfer;                     //Time since the data transfer of the current image started, invalid once it has been recorded
+    int nLinkBaudRate = 0;                          //Baud rate last selected by default or from a link profile, differs from the input once the operator changes it
+    int nLinkHandshake = 0;                         //Handshake last selected by default or from a link profile, differs from the input once the operator changes it
+    QVector<qint64> vecBlockTurnaroundNs;           //Write to ACK time of each block of the current transfer, for jitter statistics
+    FlashHistoryRecordStruct fhrHistory = FlashHistoryRecordStruct(); //History record of the current session, written when it ends
+    QElapsedTimer etmrSession;                      //Time since the current session started
     QNetworkAccessManager *nmManager = NULL;        //Network access manager
     QNetworkReply *nmrReply = NULL;                 //Network reply
-    std::list<FirmwareListStruct> lstFirmwareFiles; //List of remote server firmware upgrade files
+    FirmwareCatalog fcFirmwareFiles;                //Indexed catalog of remote server firmware upgrade files
+    FirmwarePrefetcher fpPrefetcher;                //Downloads the firmware files likely to be needed next whilst idle
+    QString strFirmwareHost;                        //Host and port of a local firmware mirror, empty to use the online server directly
     PopupMessage *pmErrorForm = NULL;               //Error message form
-    uint8_t nBootloaderTimerChecks = 0;             //Number of times the bootloader status has been checked (timeout checking)
+    LineWatchdog lwLine;                            //Recovers the module if the session stops making progress
+    QTimer tmrModemRestartTimer;                    //Timer used for polling the modem whilst it restarts after an upgrade step
+    int nModemRestartIntervalMs = MODEM_RESTART_CHECK_INITIAL_MS; //Delay before the next poll, doubles up to the maximum
+    QElapsedTimer etmrModemRestart;                 //Time since the modem started restarting
+    QString strVersionBeforeUpgrade;                //Modem firmware version detected before the transfer
+    QString strExpectedVersion;                     //Version the modem should report once the upgrade is installed, empty if not in the catalog
+    QString strStepVersion;                         //Version installed by the previous upgrade step, only set until the next step starts
+    QList<int> lstUpgradePath;                      //Catalog indexes of the remaining upgrade steps, first entry is the current step
+    QHash<QNetworkReply *, UpgradePathDownloadStruct> hashUpgradePathReplies; //Outstanding upgrade step downloads
+    ImageVerifier ivImageVerifier;                  //Background verifier of the selected firmware file
+    QFutureWatcher<QList<QSerialPortInfo>> fwSerialPorts; //Serial port enumeration running on the thread pool
+    QList<QSerialPortInfo> lstSerialPorts;          //Ports found by the last enumeration
+    bool bPortFromCaller = false;                   //If the port was given by a job or the command line, so enumeration must not change it
+    bool bImageVerified = false;                    //If the selected firmware file has passed verification
+    QString strImageSHA256;                         //SHA-256 of the selected firmware file once verified
+    QSharedPointer<SharedImage> spFirmwareImage;    //Verified shared memory copy of the firmware file, always sent when set, NULL to read from the file
+    bool bTransferAwaitingVerification = false;     //If the module is ready and the transfer is waiting for verification to finish
+    bool bVerifyingCachedDownload = false;          //If the file being verified is a previously downloaded online file (re-downloaded on failure)
 #ifdef UseSSL
     QSslCertificate *sslcLairdConnectivity = NULL;  //Holds the Laird Connectivity SSL certificate
 #endif
     QByteArray baRecBuf;                            //Receive buffer (serial)
+    TransferProgress tpProgress;                    //Progress published by the transfer for display
+    QTimer tmrProgressUpdate;                       //Timer used for refreshing the progress display
+    QElapsedTimer etmrProgressLog;                  //Time since the transfer was last summarised in the log
+    SerialTraceRecorder trRecorder;                 //Records serial traffic when enabled
+    SerialTraceReplayer *trpReplayer = NULL;        //Replays a recorded trace in place of the serial port, NULL when not replaying
+    XModemReceiver xrReceiver;                      //Receive engine for pulling files (logs, core dumps) from the module
+    QString strReceiveFilename;                     //File being received
+    qint64 nReceiveExpectedSize = 0;                //Expected size of the file being received, 0 if unknown
+    bool bExitWhenReceiveFinished = false;          //If the application exits once the receive finishes (command line use)
+    MetricsSession *pmsMetrics = NULL;              //Statistics for the current port, NULL when metrics are disabled
+    bool bSessionActive = false;                    //If a transfer session is in progress
+    bool bNonInteractive = false;                   //If there is no user to ask questions of (daemon jobs)
+    bool bForceUpgrade = false;                     //Upgrade even if the modem version does not match the file (non-interactive only)
+    QElapsedTimer etmrDetection;                    //Time since the module detection phase started
+    bool bInventoryQuery = false;                   //If the query reports with QueryFinished() and must not change the module's mode
+    QString strDetectedMode;                        //Mode the module was first found in by the current query
+    QString strQueryVersion;                        //Modem firmware version found by the current query
+    bool bPortWarm = false;                         //If the port has been left open between sessions with the modem answering
+    WarmSessionStruct wssWarmSession;               //State of the module on the port left open
+    QTimer tmrWarmSessionIdle;                      //Closes the port left open if no session uses it
+    QTimer tmrWarmSessionProbe;                     //Falls back to full detection if the module on the reused port does not answer
 };
 
 #endif // MainWindow_H
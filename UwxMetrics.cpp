@@ -0,0 +1,301 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxMetrics.cpp
+**
+** Notes: Per-port transfer statistics served on localhost in the Prometheus
+**        text exposition format
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxMetrics.h"
+#include <QHostAddress>
+#include <QMutexLocker>
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+//Bucket bounds in ns
+static const qint64 aBlockLatencyBoundsNs[] = {1000000, 2000000, 5000000, 10000000, 20000000, 50000000, 100000000, 200000000, 500000000, 1000000000, 2000000000, 5000000000};
+static const qint64 aDetectionBoundsNs[] = {100000000, 250000000, 500000000, 1000000000, 2500000000, 5000000000, 10000000000, 30000000000, 60000000000};
+static const qint64 aUpdateBoundsNs[] = {30000000000, 60000000000, 120000000000, 180000000000, 300000000000, 450000000000, 600000000000, 900000000000, 1200000000000, 1800000000000, 3600000000000};
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static QString
+PortLabel(
+    const QString &strPort
+    )
+{
+    //Label set for a port, with the characters Prometheus requires to be escaped
+    return QString("port=\"").append(QString(strPort).replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n")).append("\"");
+}
+
+//=============================================================================
+//=============================================================================
+MetricsHistogram::MetricsHistogram(
+    const qint64 *pBoundsNs,
+    int nBounds
+    ) : pBounds(pBoundsNs), nBoundCount(qMin(nBounds, METRICS_HISTOGRAM_MAX_BOUNDS))
+{
+    int i = 0;
+    while (i <= METRICS_HISTOGRAM_MAX_BOUNDS)
+    {
+        aBuckets[i].store(0, std::memory_order_relaxed);
+        ++i;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+MetricsHistogram::Write(
+    QTextStream &tsOutput,
+    const char *pName,
+    const QString &strLabels
+    ) const
+{
+    //Prometheus buckets are cumulative
+    quint64 nCumulative = 0;
+    int i = 0;
+    while (i < nBoundCount)
+    {
+        nCumulative += aBuckets[i].load(std::memory_order_relaxed);
+        tsOutput << pName << "_bucket{" << strLabels << ",le=\"" << QString::number(pBounds[i] / METRICS_NS_PER_S) << "\"} " << nCumulative << "\n";
+        ++i;
+    }
+    nCumulative += aBuckets[nBoundCount].load(std::memory_order_relaxed);
+    tsOutput << pName << "_bucket{" << strLabels << ",le=\"+Inf\"} " << nCumulative << "\n";
+    tsOutput << pName << "_sum{" << strLabels << "} " << QString::number(nSumNs.load(std::memory_order_relaxed) / METRICS_NS_PER_S, 'f', 6) << "\n";
+    tsOutput << pName << "_count{" << strLabels << "} " << nCumulative << "\n";
+}
+
+//=============================================================================
+//=============================================================================
+MetricsSession::MetricsSession(
+    const QString &strPortName
+    ) : strPort(strPortName),
+    mhBlockLatency(aBlockLatencyBoundsNs, sizeof(aBlockLatencyBoundsNs) / sizeof(aBlockLatencyBoundsNs[0])),
+    mhDetection(aDetectionBoundsNs, sizeof(aDetectionBoundsNs) / sizeof(aDetectionBoundsNs[0])),
+    mhUpdate(aUpdateBoundsNs, sizeof(aUpdateBoundsNs) / sizeof(aUpdateBoundsNs[0]))
+{
+}
+
+//=============================================================================
+//=============================================================================
+MetricsRegistry &
+MetricsRegistry::Instance(
+    )
+{
+    static MetricsRegistry mrRegistry;
+    return mrRegistry;
+}
+
+//=============================================================================
+//=============================================================================
+MetricsRegistry::MetricsRegistry(
+    )
+{
+}
+
+//=============================================================================
+//=============================================================================
+MetricsRegistry::~MetricsRegistry(
+    )
+{
+    qDeleteAll(lstSessions);
+    lstSessions.clear();
+}
+
+//=============================================================================
+//=============================================================================
+void
+MetricsRegistry::Enable(
+    )
+{
+    bEnabled.store(true);
+}
+
+//=============================================================================
+//=============================================================================
+MetricsSession *
+MetricsRegistry::Session(
+    const QString &strPortName
+    )
+{
+    //Returns the session for a port (creating it on first use), or NULL when metrics are disabled
+    if (bEnabled.load() == false)
+    {
+        return NULL;
+    }
+
+    QMutexLocker mlLock(&mtxSessions);
+    foreach (MetricsSession *pSession, lstSessions)
+    {
+        if (pSession->strPort == strPortName)
+        {
+            return pSession;
+        }
+    }
+
+    lstSessions.append(new MetricsSession(strPortName));
+    return lstSessions.last();
+}
+
+//=============================================================================
+//=============================================================================
+void
+MetricsRegistry::Write(
+    QTextStream &tsOutput
+    )
+{
+    //Outputs every metric family with one series per port
+    QMutexLocker mlLock(&mtxSessions);
+
+    tsOutput << "# HELP xmodemutil_blocks_sent_total XModem data blocks sent, excluding retransmits.\n# TYPE xmodemutil_blocks_sent_total counter\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        tsOutput << "xmodemutil_blocks_sent_total{" << PortLabel(pSession->strPort) << "} " << pSession->nBlocksSent.load(std::memory_order_relaxed) << "\n";
+    }
+
+    tsOutput << "# HELP xmodemutil_nacks_total NACKs received for XModem data blocks.\n# TYPE xmodemutil_nacks_total counter\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        tsOutput << "xmodemutil_nacks_total{" << PortLabel(pSession->strPort) << "} " << pSession->nNacks.load(std::memory_order_relaxed) << "\n";
+    }
+
+    tsOutput << "# HELP xmodemutil_retransmits_total XModem data blocks sent again after a NACK.\n# TYPE xmodemutil_retransmits_total counter\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        tsOutput << "xmodemutil_retransmits_total{" << PortLabel(pSession->strPort) << "} " << pSession->nRetransmits.load(std::memory_order_relaxed) << "\n";
+    }
+
+    tsOutput << "# HELP xmodemutil_bytes_sent_total XModem data block bytes written, including retransmits.\n# TYPE xmodemutil_bytes_sent_total counter\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        tsOutput << "xmodemutil_bytes_sent_total{" << PortLabel(pSession->strPort) << "} " << pSession->nBytesSent.load(std::memory_order_relaxed) << "\n";
+    }
+
+    tsOutput << "# HELP xmodemutil_transfer_bytes_per_second Current transfer rate.\n# TYPE xmodemutil_transfer_bytes_per_second gauge\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        tsOutput << "xmodemutil_transfer_bytes_per_second{" << PortLabel(pSession->strPort) << "} " << pSession->nBytesPerSecond.load(std::memory_order_relaxed) << "\n";
+    }
+
+    tsOutput << "# HELP xmodemutil_sessions_active Sessions in progress.\n# TYPE xmodemutil_sessions_active gauge\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        tsOutput << "xmodemutil_sessions_active{" << PortLabel(pSession->strPort) << "} " << pSession->nSessionsActive.load(std::memory_order_relaxed) << "\n";
+    }
+
+    tsOutput << "# HELP xmodemutil_sessions_succeeded_total Sessions which completed.\n# TYPE xmodemutil_sessions_succeeded_total counter\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        tsOutput << "xmodemutil_sessions_succeeded_total{" << PortLabel(pSession->strPort) << "} " << pSession->nSessionsSucceeded.load(std::memory_order_relaxed) << "\n";
+    }
+
+    tsOutput << "# HELP xmodemutil_sessions_failed_total Sessions which ended without completing.\n# TYPE xmodemutil_sessions_failed_total counter\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        tsOutput << "xmodemutil_sessions_failed_total{" << PortLabel(pSession->strPort) << "} " << pSession->nSessionsFailed.load(std::memory_order_relaxed) << "\n";
+    }
+
+    tsOutput << "# HELP xmodemutil_block_latency_seconds Time from writing an XModem data block to receiving its ACK.\n# TYPE xmodemutil_block_latency_seconds histogram\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        pSession->mhBlockLatency.Write(tsOutput, "xmodemutil_block_latency_seconds", PortLabel(pSession->strPort));
+    }
+
+    tsOutput << "# HELP xmodemutil_detection_duration_seconds Time from opening the port to starting the transfer (module detection and mode changes).\n# TYPE xmodemutil_detection_duration_seconds histogram\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        pSession->mhDetection.Write(tsOutput, "xmodemutil_detection_duration_seconds", PortLabel(pSession->strPort));
+    }
+
+    tsOutput << "# HELP xmodemutil_update_duration_seconds Time from opening the port to the module reporting the new firmware version.\n# TYPE xmodemutil_update_duration_seconds histogram\n";
+    foreach (const MetricsSession *pSession, lstSessions)
+    {
+        pSession->mhUpdate.Write(tsOutput, "xmodemutil_update_duration_seconds", PortLabel(pSession->strPort));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+MetricsServer::MetricsServer(QObject *parent) :
+    QObject(parent)
+{
+    connect(&hsServer, SIGNAL(Request(QTcpSocket*,QByteArray,QUrl)), this, SLOT(Request(QTcpSocket*,QByteArray,QUrl)));
+}
+
+//=============================================================================
+//=============================================================================
+MetricsServer::~MetricsServer(
+    )
+{
+}
+
+//=============================================================================
+//=============================================================================
+bool
+MetricsServer::Listen(
+    quint16 nPort,
+    QString *pstrError
+    )
+{
+    //Serves metrics over HTTP on the loopback interface and starts collecting them
+    if (!hsServer.Listen(QHostAddress::LocalHost, nPort, pstrError))
+    {
+        return false;
+    }
+
+    MetricsRegistry::Instance().Enable();
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+MetricsServer::Request(
+    QTcpSocket *tsClient,
+    QByteArray baMethod,
+    QUrl urlTarget
+    )
+{
+    //Answers a scrape
+    QByteArray baBody;
+    QByteArray baStatus = "200 OK";
+    if (baMethod == "GET" && (urlTarget.path() == "/metrics" || urlTarget.path() == "/"))
+    {
+        QTextStream tsBody(&baBody);
+        MetricsRegistry::Instance().Write(tsBody);
+        tsBody.flush();
+    }
+    else
+    {
+        baStatus = "404 Not Found";
+    }
+
+    HttpServer::Respond(tsClient, baStatus, "text/plain; version=0.0.4", baBody);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,234 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxMetrics.h
+**
+** Notes: Per-port transfer statistics served on localhost in the Prometheus
+**        text exposition format
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXMETRICS_H
+#define UWXMETRICS_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxHttpServer.h"
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include <QString>
+#include <QTextStream>
+#include <atomic>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define METRICS_HISTOGRAM_MAX_BOUNDS              16
+#define METRICS_NS_PER_S                          1000000000.0
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+//Fixed bucket histogram, observations are relaxed atomic increments so they
+//can be made from the transfer path without locking
+class MetricsHistogram
+{
+public:
+    MetricsHistogram(
+        const qint64 *pBoundsNs,
+        int nBounds
+        );
+    inline void
+    Observe(
+        qint64 nValueNs
+        )
+    {
+        int i = 0;
+        while (i < nBoundCount && nValueNs > pBounds[i])
+        {
+            ++i;
+        }
+        aBuckets[i].fetch_add(1, std::memory_order_relaxed);
+        nSumNs.fetch_add(nValueNs, std::memory_order_relaxed);
+    }
+    void
+    Write(
+        QTextStream &tsOutput,
+        const char *pName,
+        const QString &strLabels
+        ) const;
+
+private:
+    const qint64 *pBounds;                          //Upper bounds of the buckets in ns
+    int nBoundCount;                                //Number of bounds, there is one extra bucket for +Inf
+    std::atomic<quint64> aBuckets[METRICS_HISTOGRAM_MAX_BOUNDS + 1]; //Observations per bucket (not cumulative)
+    std::atomic<qint64> nSumNs{0};                  //Sum of all observations
+};
+
+//Statistics for one serial port, kept for the lifetime of the application so
+//counters never go backwards
+class MetricsSession
+{
+public:
+    explicit
+    MetricsSession(
+        const QString &strPortName
+        );
+    inline void
+    BlockSent(
+        qint64 nBytes
+        )
+    {
+        nBlocksSent.fetch_add(1, std::memory_order_relaxed);
+        nBytesSent.fetch_add(nBytes, std::memory_order_relaxed);
+    }
+    inline void
+    BlockRetransmitted(
+        qint64 nBytes
+        )
+    {
+        nNacks.fetch_add(1, std::memory_order_relaxed);
+        nRetransmits.fetch_add(1, std::memory_order_relaxed);
+        nBytesSent.fetch_add(nBytes, std::memory_order_relaxed);
+    }
+    inline void
+    BlockAcknowledged(
+        qint64 nLatencyNs
+        )
+    {
+        mhBlockLatency.Observe(nLatencyNs);
+    }
+    inline void
+    DetectionFinished(
+        qint64 nDurationNs
+        )
+    {
+        mhDetection.Observe(nDurationNs);
+    }
+    inline void
+    UpdateFinished(
+        qint64 nDurationNs
+        )
+    {
+        mhUpdate.Observe(nDurationNs);
+    }
+    inline void
+    SetBytesPerSecond(
+        qint64 nRate
+        )
+    {
+        nBytesPerSecond.store(nRate, std::memory_order_relaxed);
+    }
+    inline void
+    SessionStarted(
+        )
+    {
+        nSessionsActive.fetch_add(1, std::memory_order_relaxed);
+    }
+    inline void
+    SessionFinished(
+        bool bSuccess
+        )
+    {
+        nSessionsActive.fetch_sub(1, std::memory_order_relaxed);
+        nBytesPerSecond.store(0, std::memory_order_relaxed);
+        (bSuccess ? nSessionsSucceeded : nSessionsFailed).fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    friend class MetricsRegistry;
+
+    const QString strPort;                          //Port name, used as the label of every metric
+    std::atomic<quint64> nBlocksSent{0};            //Data blocks written (first attempts)
+    std::atomic<quint64> nNacks{0};                 //NACKs received for data blocks
+    std::atomic<quint64> nRetransmits{0};           //Data blocks written again after a NACK
+    std::atomic<quint64> nBytesSent{0};             //Data block bytes written, including retransmits
+    std::atomic<qint64> nBytesPerSecond{0};         //Current transfer rate
+    std::atomic<qint64> nSessionsActive{0};         //Sessions in progress
+    std::atomic<quint64> nSessionsSucceeded{0};     //Sessions which completed
+    std::atomic<quint64> nSessionsFailed{0};        //Sessions which ended without completing
+    MetricsHistogram mhBlockLatency;                //Write to ACK time of each block
+    MetricsHistogram mhDetection;                   //Port open to transfer start time
+    MetricsHistogram mhUpdate;                      //Port open to new firmware running time
+};
+
+//Owner of all sessions. Registration takes a lock but happens once per port,
+//updates only touch the session's atomics.
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &
+    Instance(
+        );
+    ~MetricsRegistry(
+        );
+    void
+    Enable(
+        );
+    MetricsSession *
+    Session(
+        const QString &strPortName
+        );
+    void
+    Write(
+        QTextStream &tsOutput
+        );
+
+private:
+    MetricsRegistry(
+        );
+
+    std::atomic<bool> bEnabled{false};              //If metrics are being collected
+    QMutex mtxSessions;                             //Protects the session list
+    QList<MetricsSession *> lstSessions;            //All sessions, never removed
+};
+
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    MetricsServer(
+        QObject *parent = 0
+        );
+    ~MetricsServer(
+        );
+    bool
+    Listen(
+        quint16 nPort,
+        QString *pstrError
+        );
+
+private slots:
+    void
+    Request(
+        QTcpSocket *tsClient,
+        QByteArray baMethod,
+        QUrl urlTarget
+        );
+
+private:
+    HttpServer hsServer;                            //Listens on localhost only
+};
+
+#endif // UWXMETRICS_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,657 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxPtySimulator.cpp
+**
+** Notes: Simulated XModem device on a pseudo terminal, the slave side can be
+**        opened like any other serial port. Only available on unix-like
+**        systems.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxPtySimulator.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+PtySimulator::PtySimulator(QObject *parent) :
+    QObject(parent)
+{
+    tmrModemReply.setSingleShot(true);
+    connect(&tmrModemReply, SIGNAL(timeout()), this, SLOT(ModemReplyTimeout()));
+    tmrModemBlock.setSingleShot(true);
+    connect(&tmrModemBlock, SIGNAL(timeout()), this, SLOT(ModemBlockTimeout()));
+    tmrModemRestart.setSingleShot(true);
+    connect(&tmrModemRestart, SIGNAL(timeout()), this, SLOT(ModemRestartTimeout()));
+}
+
+//=============================================================================
+//=============================================================================
+PtySimulator::~PtySimulator(
+    )
+{
+    disconnect(this, SLOT(ModemReplyTimeout()));
+    disconnect(this, SLOT(ModemBlockTimeout()));
+    disconnect(this, SLOT(ModemRestartTimeout()));
+    Close();
+}
+
+//=============================================================================
+//=============================================================================
+bool
+PtySimulator::Open(
+    QString *pstrError
+    )
+{
+    //Creates the pseudo terminal, the slave is put in raw mode so data passes through unmodified
+    Close();
+    nMasterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (nMasterFd < 0 || grantpt(nMasterFd) != 0 || unlockpt(nMasterFd) != 0 || ptsname(nMasterFd) == NULL)
+    {
+        *pstrError = QString("Unable to create pseudo terminal: ").append(strerror(errno));
+        Close();
+        return false;
+    }
+
+    strPortName = QString::fromLocal8Bit(ptsname(nMasterFd));
+    nSlaveFd = open(ptsname(nMasterFd), O_RDWR | O_NOCTTY);
+    if (nSlaveFd < 0)
+    {
+        *pstrError = QString("Unable to open pseudo terminal ").append(strPortName).append(": ").append(strerror(errno));
+        Close();
+        return false;
+    }
+
+    struct termios tiSettings;
+    if (tcgetattr(nSlaveFd, &tiSettings) == 0)
+    {
+        cfmakeraw(&tiSettings);
+        tcsetattr(nSlaveFd, TCSANOW, &tiSettings);
+    }
+    fcntl(nMasterFd, F_SETFL, fcntl(nMasterFd, F_GETFL) | O_NONBLOCK);
+
+    snRead = new QSocketNotifier(nMasterFd, QSocketNotifier::Read, this);
+    connect(snRead, SIGNAL(activated(int)), this, SLOT(MasterReadable()));
+    snWrite = new QSocketNotifier(nMasterFd, QSocketNotifier::Write, this);
+    snWrite->setEnabled(false);
+    connect(snWrite, SIGNAL(activated(int)), this, SLOT(MasterWritable()));
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::Close(
+    )
+{
+    if (snRead != NULL)
+    {
+        delete snRead;
+        snRead = NULL;
+    }
+    if (snWrite != NULL)
+    {
+        delete snWrite;
+        snWrite = NULL;
+    }
+    if (nSlaveFd >= 0)
+    {
+        close(nSlaveFd);
+        nSlaveFd = -1;
+    }
+    if (nMasterFd >= 0)
+    {
+        close(nMasterFd);
+        nMasterFd = -1;
+    }
+
+    tmrModemReply.stop();
+    tmrModemBlock.stop();
+    tmrModemRestart.stop();
+    bModemReceiving = false;
+    baModemInput.clear();
+    baPending.clear();
+    nRole = PtySimulatorRoleNone;
+    strPortName.clear();
+}
+
+//=============================================================================
+//=============================================================================
+QString
+PtySimulator::PortName(
+    ) const
+{
+    return strPortName;
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::StartSender(
+    const QByteArray &baData
+    )
+{
+    //Waits for a receiver to request the transfer then sends the data with 1K blocks
+    baPayload = baData;
+    nPayloadOffset = 0;
+    nPacket = PTY_SIMULATOR_FIRST_PACKET_ID;
+    bStarted = false;
+    bCRCMode = true;
+    bEndSent = false;
+    nCancels = 0;
+    nRole = PtySimulatorRoleSender;
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::StartModem(
+    const QString &strVersion,
+    const QString &strUpgradedVersion,
+    const PtySimulatorImpairments &psiImpairments,
+    quint32 nSeed
+    )
+{
+    //Behaves as an HL7800 in modem mode: answers the version query and receives firmware upgrades
+    strModemVersion = strVersion;
+    strModemUpgradedVersion = strUpgradedVersion;
+    psiModemImpairments = psiImpairments;
+    mtRandom.seed(nSeed);
+    bModemReceiving = false;
+    baModemInput.clear();
+    memset(&pmsModemStats, 0, sizeof(pmsModemStats));
+    vecBlockCycleNs.clear();
+    chModemReceived.reset();
+    nRole = PtySimulatorRoleModem;
+}
+
+//=============================================================================
+//=============================================================================
+const PtySimulatorModemStats &
+PtySimulator::ModemStats(
+    ) const
+{
+    return pmsModemStats;
+}
+
+//=============================================================================
+//=============================================================================
+const QVector<qint64> &
+PtySimulator::BlockCycleTimes(
+    ) const
+{
+    return vecBlockCycleNs;
+}
+
+//=============================================================================
+//=============================================================================
+QByteArray
+PtySimulator::ReceivedSHA256(
+    )
+{
+    return chModemReceived.result();
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::MasterReadable(
+    )
+{
+    //Reads everything the port user has written
+    uint8_t aBuffer[PTY_SIMULATOR_READ_SIZE];
+    ssize_t nRead;
+    while ((nRead = read(nMasterFd, aBuffer, sizeof(aBuffer))) > 0)
+    {
+        if (nRole == PtySimulatorRoleSender)
+        {
+            SenderDataReceived(aBuffer, nRead);
+        }
+        else if (nRole == PtySimulatorRoleModem)
+        {
+            ModemDataReceived(aBuffer, nRead);
+        }
+
+        if (nMasterFd < 0)
+        {
+            //Closed whilst handling the data
+            return;
+        }
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::MasterWritable(
+    )
+{
+    //Writes queued data once the pseudo terminal has space for it
+    ssize_t nWritten = write(nMasterFd, baPending.constData(), baPending.length());
+    if (nWritten > 0)
+    {
+        baPending.remove(0, nWritten);
+    }
+
+    if (baPending.isEmpty())
+    {
+        snWrite->setEnabled(false);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::SenderDataReceived(
+    const uint8_t *pData,
+    size_t nSize
+    )
+{
+    //Sender side of the XModem protocol
+    size_t i = 0;
+    while (i < nSize && nRole == PtySimulatorRoleSender)
+    {
+        uint8_t nByte = pData[i];
+        ++i;
+
+        if (nByte == XModemPacketTypeCancel)
+        {
+            ++nCancels;
+            if (nCancels >= PTY_SIMULATOR_CANCEL_COUNT)
+            {
+                Complete(false, "Transfer cancelled by receiver");
+            }
+            continue;
+        }
+        nCancels = 0;
+
+        if (bStarted == false)
+        {
+            if (nByte == XModemPacketTypeCRCRequest || nByte == XModemPacketTypeNack)
+            {
+                //Receiver is ready, the request byte selects the checksum type
+                bStarted = true;
+                bCRCMode = (nByte == XModemPacketTypeCRCRequest);
+                SenderFrameNext();
+            }
+        }
+        else if (nByte == XModemPacketTypeAck)
+        {
+            if (bEndSent == true)
+            {
+                Complete(true, QString("Sent ").append(QString::number(baPayload.length())).append(" bytes"));
+            }
+            else
+            {
+                nPayloadOffset += XMODEM_1K_BLOCK_SIZE;
+                ++nPacket;
+                SenderFrameNext();
+            }
+        }
+        else if (nByte == XModemPacketTypeNack)
+        {
+            //Retransmit the last packet
+            Transmit(baCurrent);
+        }
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::SenderFrameNext(
+    )
+{
+    //Sends the block at the current offset, or the end of transfer once all data has been sent
+    if (nPayloadOffset >= baPayload.length())
+    {
+        bEndSent = true;
+        baCurrent = QByteArray(1, (char)XModemPacketTypeEndOfFrame);
+    }
+    else
+    {
+        const uint8_t *pBlock = reinterpret_cast<const uint8_t *>(baPayload.constData()) + nPayloadOffset;
+        size_t nBlockSize = qMin((qint64)XMODEM_1K_BLOCK_SIZE, baPayload.length() - nPayloadOffset);
+        if (bCRCMode == true)
+        {
+            XModem1KCRC16Framer::Packet aPacket;
+            XModem1KCRC16Framer::Frame(aPacket, nPacket, pBlock, nBlockSize, PTY_SIMULATOR_PADDING);
+            baCurrent = QByteArray(reinterpret_cast<const char *>(aPacket.data()), XModem1KCRC16Framer::PacketSize);
+        }
+        else
+        {
+            XModem1KSum8Framer::Packet aPacket;
+            XModem1KSum8Framer::Frame(aPacket, nPacket, pBlock, nBlockSize, PTY_SIMULATOR_PADDING);
+            baCurrent = QByteArray(reinterpret_cast<const char *>(aPacket.data()), XModem1KSum8Framer::PacketSize);
+        }
+    }
+
+    Transmit(baCurrent);
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::ModemDataReceived(
+    const uint8_t *pData,
+    size_t nSize
+    )
+{
+    //Modem side, commands are lines ending in a carriage return until an upgrade is started
+    if (tmrModemRestart.isActive())
+    {
+        //Restarting, input is lost
+        return;
+    }
+
+    size_t i = 0;
+    while (i < nSize && bModemReceiving == false)
+    {
+        char cByte = (char)pData[i];
+        ++i;
+
+        if (cByte == '\r')
+        {
+            QByteArray baCommand = baModemInput.trimmed();
+            baModemInput.clear();
+            ModemCommand(baCommand);
+        }
+        else if (baModemInput.length() < PTY_SIMULATOR_COMMAND_MAX_SIZE)
+        {
+            baModemInput.append(cByte);
+        }
+    }
+
+    if (bModemReceiving == false)
+    {
+        return;
+    }
+
+    //Receiving data blocks, input which arrives whilst a reply is delayed is handled once it has been sent
+    if (i < nSize)
+    {
+        baModemInput.append(reinterpret_cast<const char *>(pData + i), nSize - i);
+        if (!tmrModemReply.isActive())
+        {
+            tmrModemBlock.start(PTY_SIMULATOR_BLOCK_TIMEOUT_MS);
+        }
+    }
+
+    while (bModemReceiving == true && !baModemInput.isEmpty() && !tmrModemReply.isActive())
+    {
+        uint8_t nType = (uint8_t)baModemInput.at(0);
+        int nPacketSize;
+        if (nType == XModemPacketTypeEndOfFrame)
+        {
+            //Transfer complete, back to accepting commands
+            baModemInput.remove(0, 1);
+            bModemReceiving = false;
+            tmrModemBlock.stop();
+            Transmit(QByteArray(1, (char)XModemPacketTypeAck));
+            return;
+        }
+        else if (nType == XModemPacketType1024BytePacket)
+        {
+            nPacketSize = XModem1KSum8Framer::PacketSize;
+        }
+        else if (nType == XModemPacketType128BytePacket)
+        {
+            nPacketSize = XModem128Sum8Framer::PacketSize;
+        }
+        else
+        {
+            //Line noise or the end of the start command, not the start of a block
+            baModemInput.remove(0, 1);
+            continue;
+        }
+
+        if (baModemInput.length() < nPacketSize)
+        {
+            return;
+        }
+        ModemBlockReceived();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::ModemCommand(
+    const QByteArray &baCommand
+    )
+{
+    //Answers the commands used by the application
+    if (baCommand.isEmpty())
+    {
+        return;
+    }
+    else if (baCommand == "ATI3")
+    {
+        Transmit(QByteArray("\r\nHL7800.").append(strModemVersion.toUtf8()).append("\r\n\r\nOK\r\n"));
+    }
+    else if (baCommand.startsWith("AT+WDSD="))
+    {
+        //Upgrade start, the HL7800 requests the first block with a NACK (8-bit checksum)
+        bool bValid = false;
+        nModemExpectedSize = baCommand.mid(baCommand.indexOf('=') + 1).toLongLong(&bValid);
+        if (bValid == false || nModemExpectedSize <= 0)
+        {
+            Transmit("\r\nERROR\r\n");
+            return;
+        }
+
+        memset(&pmsModemStats, 0, sizeof(pmsModemStats));
+        vecBlockCycleNs.clear();
+        chModemReceived.reset();
+        nModemPacket = PTY_SIMULATOR_FIRST_PACKET_ID;
+        etmrModemCycle.invalidate();
+        bModemReceiving = true;
+        ModemReply(XModemPacketTypeNack);
+    }
+    else if (baCommand.startsWith("AT+WDSR="))
+    {
+        //Upgrade accepted, the modem restarts to install it and then answers with the new version
+        Transmit("\r\nOK\r\n");
+        tmrModemRestart.start(PTY_SIMULATOR_RESTART_MS);
+        emit Finished(pmsModemStats.nBytes == nModemExpectedSize, QString("Received ").append(QString::number(pmsModemStats.nBytes)).append(" of ").append(QString::number(nModemExpectedSize)).append(" bytes"));
+    }
+    else
+    {
+        Transmit("\r\nERROR\r\n");
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::ModemBlockReceived(
+    )
+{
+    //Checks the block at the start of the input, then replies to it with any injected faults applied
+    const uint8_t *pPacket = reinterpret_cast<const uint8_t *>(baModemInput.constData());
+    bool bLarge = (pPacket[0] == XModemPacketType1024BytePacket);
+    int nPacketSize = (bLarge ? XModem1KSum8Framer::PacketSize : XModem128Sum8Framer::PacketSize);
+    int nDataSize = (bLarge ? XModem1KSum8Framer::DataSize : XModem128Sum8Framer::DataSize);
+    uint8_t nPrevious = (uint8_t)(nModemPacket - 1);
+    uint8_t nReply = XModemPacketTypeAck;
+    tmrModemBlock.stop();
+
+    if ((bLarge ? XModem1KSum8Framer::Validate(pPacket, nModemPacket) : XModem128Sum8Framer::Validate(pPacket, nModemPacket)))
+    {
+        if (std::bernoulli_distribution(psiModemImpairments.fNackProbability)(mtRandom) || (psiModemImpairments.fByteErrorProbability > 0.0 && std::bernoulli_distribution(1.0 - pow(1.0 - psiModemImpairments.fByteErrorProbability, nPacketSize))(mtRandom)))
+        {
+            //Treat the block as corrupted
+            nReply = XModemPacketTypeNack;
+        }
+        else
+        {
+            qint64 nStore = qMin((qint64)nDataSize, nModemExpectedSize - pmsModemStats.nBytes);
+            if (nStore > 0)
+            {
+                chModemReceived.addData(reinterpret_cast<const char *>(pPacket) + XModem1KSum8Framer::HeaderSize, nStore);
+                pmsModemStats.nBytes += nStore;
+            }
+            ++pmsModemStats.nBlocks;
+            pmsModemStats.nSmallBlocks += (bLarge == true ? 0 : 1);
+            ++nModemPacket;
+        }
+    }
+    else if ((bLarge ? XModem1KSum8Framer::Validate(pPacket, nPrevious) : XModem128Sum8Framer::Validate(pPacket, nPrevious)))
+    {
+        //Retransmit of a block whose ACK was lost, acknowledge it again
+        ++pmsModemStats.nDuplicates;
+    }
+    else
+    {
+        nReply = XModemPacketTypeNack;
+    }
+    baModemInput.remove(0, nPacketSize);
+
+    if (nReply == XModemPacketTypeNack)
+    {
+        ++pmsModemStats.nNacks;
+    }
+    else if (std::bernoulli_distribution(psiModemImpairments.fDropAckProbability)(mtRandom))
+    {
+        //ACK lost on the way to the sender, the block timeout recovers with a NACK
+        ++pmsModemStats.nDroppedAcks;
+        tmrModemBlock.start(PTY_SIMULATOR_BLOCK_TIMEOUT_MS);
+        return;
+    }
+
+    ModemReply(nReply);
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::ModemReply(
+    uint8_t nReply
+    )
+{
+    //Replies after a random processing delay, as the module does whilst writing to flash
+    int nLatencyMs = std::uniform_int_distribution<int>(psiModemImpairments.nMinLatencyMs, qMax(psiModemImpairments.nMinLatencyMs, psiModemImpairments.nMaxLatencyMs))(mtRandom);
+    nModemReply = nReply;
+    if (nLatencyMs <= 0)
+    {
+        ModemReplyTimeout();
+    }
+    else
+    {
+        tmrModemReply.start(nLatencyMs);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::ModemReplyTimeout(
+    )
+{
+    if (nModemReply == XModemPacketTypeAck)
+    {
+        if (etmrModemCycle.isValid())
+        {
+            vecBlockCycleNs.append(etmrModemCycle.nsecsElapsed());
+        }
+        etmrModemCycle.start();
+    }
+    Transmit(QByteArray(1, (char)nModemReply));
+    if (bModemReceiving == true)
+    {
+        tmrModemBlock.start(PTY_SIMULATOR_BLOCK_TIMEOUT_MS);
+        ModemDataReceived(NULL, 0);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::ModemBlockTimeout(
+    )
+{
+    //Nothing (or only part of a block) arrived in time, ask for the block again
+    baModemInput.clear();
+    ++pmsModemStats.nNacks;
+    ModemReply(XModemPacketTypeNack);
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::ModemRestartTimeout(
+    )
+{
+    if (!strModemUpgradedVersion.isEmpty())
+    {
+        strModemVersion = strModemUpgradedVersion;
+    }
+    baModemInput.clear();
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::Transmit(
+    const QByteArray &baData
+    )
+{
+    //Writes to the port user, anything the pseudo terminal cannot accept yet is queued
+    if (baPending.isEmpty())
+    {
+        ssize_t nWritten = write(nMasterFd, baData.constData(), baData.length());
+        if (nWritten == baData.length())
+        {
+            return;
+        }
+
+        baPending = baData.mid(nWritten > 0 ? nWritten : 0);
+    }
+    else
+    {
+        baPending.append(baData);
+    }
+
+    snWrite->setEnabled(true);
+}
+
+//=============================================================================
+//=============================================================================
+void
+PtySimulator::Complete(
+    bool bSuccess,
+    const QString &strMessage
+    )
+{
+    nRole = PtySimulatorRoleNone;
+    emit Finished(bSuccess, strMessage);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
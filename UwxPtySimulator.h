@@ -0,0 +1,228 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxPtySimulator.h
+**
+** Notes: Simulated XModem device on a pseudo terminal, the slave side can be
+**        opened like any other serial port. Only available on unix-like
+**        systems.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXPTYSIMULATOR_H
+#define UWXPTYSIMULATOR_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QSocketNotifier>
+#include <QByteArray>
+#include <QString>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QCryptographicHash>
+#include <random>
+#include "UwxXModemFramer.h"
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define PTY_SIMULATOR_READ_SIZE                   4096
+#define PTY_SIMULATOR_PADDING                     0x1a
+#define PTY_SIMULATOR_FIRST_PACKET_ID             1
+#define PTY_SIMULATOR_CANCEL_COUNT                2
+#define PTY_SIMULATOR_BLOCK_TIMEOUT_MS            2000
+#define PTY_SIMULATOR_COMMAND_MAX_SIZE            256
+#define PTY_SIMULATOR_RESTART_MS                  2000
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Enum used for the role the simulated device plays
+enum PtySimulatorRoles
+{
+    PtySimulatorRoleNone                        = 0,
+    PtySimulatorRoleSender,
+    PtySimulatorRoleModem
+};
+
+//Faults injected by the simulated modem whilst receiving data blocks, the
+//byte error probability applies to every byte of a block so longer blocks
+//are corrupted more often, as on a noisy line
+typedef struct
+{
+    int nMinLatencyMs;
+    int nMaxLatencyMs;
+    double fNackProbability;
+    double fDropAckProbability;
+    double fByteErrorProbability;
+} PtySimulatorImpairments;
+
+//What the simulated modem saw during a transfer
+typedef struct
+{
+    qint64 nBytes;
+    quint32 nBlocks;
+    quint32 nSmallBlocks;
+    quint32 nNacks;
+    quint32 nDroppedAcks;
+    quint32 nDuplicates;
+} PtySimulatorModemStats;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class PtySimulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    PtySimulator(
+        QObject *parent = 0
+        );
+    ~PtySimulator(
+        );
+    bool
+    Open(
+        QString *pstrError
+        );
+    void
+    Close(
+        );
+    QString
+    PortName(
+        ) const;
+    void
+    StartSender(
+        const QByteArray &baData
+        );
+    void
+    StartModem(
+        const QString &strVersion,
+        const QString &strUpgradedVersion,
+        const PtySimulatorImpairments &psiImpairments,
+        quint32 nSeed
+        );
+    const PtySimulatorModemStats &
+    ModemStats(
+        ) const;
+    const QVector<qint64> &
+    BlockCycleTimes(
+        ) const;
+    QByteArray
+    ReceivedSHA256(
+        );
+
+signals:
+    void
+    Finished(
+        bool bSuccess,
+        QString strMessage
+        );
+
+private slots:
+    void
+    MasterReadable(
+        );
+    void
+    MasterWritable(
+        );
+    void
+    ModemReplyTimeout(
+        );
+    void
+    ModemBlockTimeout(
+        );
+    void
+    ModemRestartTimeout(
+        );
+
+private:
+    void
+    SenderDataReceived(
+        const uint8_t *pData,
+        size_t nSize
+        );
+    void
+    SenderFrameNext(
+        );
+    void
+    ModemDataReceived(
+        const uint8_t *pData,
+        size_t nSize
+        );
+    void
+    ModemCommand(
+        const QByteArray &baCommand
+        );
+    void
+    ModemBlockReceived(
+        );
+    void
+    ModemReply(
+        uint8_t nReply
+        );
+    void
+    Transmit(
+        const QByteArray &baData
+        );
+    void
+    Complete(
+        bool bSuccess,
+        const QString &strMessage
+        );
+
+    int nMasterFd = -1;                             //Pseudo terminal master (device) side
+    int nSlaveFd = -1;                              //Slave side held open so the master does not see a hangup between port opens
+    QString strPortName;                            //Path of the slave side
+    QSocketNotifier *snRead = NULL;                 //Notifier for data from the port user
+    QSocketNotifier *snWrite = NULL;                //Notifier for space to write queued data
+    QByteArray baPending;                           //Data not yet accepted by the pseudo terminal
+    PtySimulatorRoles nRole = PtySimulatorRoleNone; //Current role
+    QByteArray baPayload;                           //Data sent in the sender role
+    qint64 nPayloadOffset = 0;                      //Offset of the block currently being sent
+    uint8_t nPacket = PTY_SIMULATOR_FIRST_PACKET_ID; //Number of the packet currently being sent
+    bool bStarted = false;                          //If the receiver has requested the transfer
+    bool bCRCMode = true;                           //If the receiver requested CRC-16
+    bool bEndSent = false;                          //If the end of transfer has been sent
+    int nCancels = 0;                               //Consecutive cancel bytes received
+    QByteArray baCurrent;                           //Last sent packet, kept for retransmission
+    QString strModemVersion;                        //Firmware version reported in the modem role
+    QString strModemUpgradedVersion;                //Firmware version reported once an upgrade has been installed
+    PtySimulatorImpairments psiModemImpairments;    //Faults injected in the modem role
+    std::mt19937 mtRandom;                          //Source of injected faults, seeded so runs can be repeated
+    bool bModemReceiving = false;                   //If the modem is receiving XModem blocks rather than commands
+    QByteArray baModemInput;                        //Partial command line or data block
+    qint64 nModemExpectedSize = 0;                  //Size given in the upgrade start command
+    uint8_t nModemPacket = PTY_SIMULATOR_FIRST_PACKET_ID; //Number of the next expected data block
+    uint8_t nModemReply = 0;                        //Reply waiting for the injected latency to pass
+    QTimer tmrModemReply;                           //Delays replies to data blocks
+    QTimer tmrModemBlock;                           //Sends a NACK when no block arrives, the sender does not time out by itself
+    QTimer tmrModemRestart;                         //Running whilst the modem installs an upgrade, commands are not answered
+    QElapsedTimer etmrModemCycle;                   //Time since the previous block was acknowledged
+    PtySimulatorModemStats pmsModemStats;           //Counters for the current transfer
+    QVector<qint64> vecBlockCycleNs;                //ACK to ACK time of every block
+    QCryptographicHash chModemReceived{QCryptographicHash::Sha256}; //Hash of the data received in the modem role
+};
+
+#endif // UWXPTYSIMULATOR_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,309 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxReactor.cpp
+**
+** Notes: Single-threaded epoll reactor which runs transfer sessions as C++20
+**        coroutines, so hundreds of ports can be served by one thread. Only
+**        available on Linux.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxReactor.h"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+Reactor::Reactor(
+    )
+{
+    nEpollFd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+//=============================================================================
+//=============================================================================
+Reactor::~Reactor(
+    )
+{
+    if (nEpollFd >= 0)
+    {
+        close(nEpollFd);
+        nEpollFd = -1;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+bool
+Reactor::IsValid(
+    ) const
+{
+    return (nEpollFd >= 0);
+}
+
+//=============================================================================
+//=============================================================================
+ReactorFd *
+Reactor::Add(
+    int nFd
+    )
+{
+    //Registered once for both directions, edge triggered so no further epoll_ctl calls are needed
+    std::unique_ptr<ReactorFd> pFd(new ReactorFd());
+    pFd->nFd = nFd;
+    pFd->bReadable = false;
+    pFd->bWritable = false;
+    pFd->nReadTimer = 0;
+    pFd->nWriteTimer = 0;
+
+    struct epoll_event eeEvent;
+    eeEvent.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    eeEvent.data.ptr = pFd.get();
+    if (epoll_ctl(nEpollFd, EPOLL_CTL_ADD, nFd, &eeEvent) != 0)
+    {
+        return nullptr;
+    }
+
+    vecFds.push_back(std::move(pFd));
+    return vecFds.back().get();
+}
+
+//=============================================================================
+//=============================================================================
+void
+Reactor::Remove(
+    ReactorFd *pFd
+    )
+{
+    //The descriptor is not closed here, that is left to its owner
+    if (pFd->nFd >= 0)
+    {
+        epoll_ctl(nEpollFd, EPOLL_CTL_DEL, pFd->nFd, nullptr);
+        pFd->nFd = -1;
+    }
+    pFd->hReader = nullptr;
+    pFd->hWriter = nullptr;
+}
+
+//=============================================================================
+//=============================================================================
+Reactor::ReadinessAwaiter
+Reactor::Readable(
+    ReactorFd *pFd,
+    int nTimeoutMs
+    )
+{
+    return ReadinessAwaiter(this, pFd, ReactorDirectionRead, nTimeoutMs);
+}
+
+//=============================================================================
+//=============================================================================
+Reactor::ReadinessAwaiter
+Reactor::Writable(
+    ReactorFd *pFd,
+    int nTimeoutMs
+    )
+{
+    return ReadinessAwaiter(this, pFd, ReactorDirectionWrite, nTimeoutMs);
+}
+
+//=============================================================================
+//=============================================================================
+Reactor::SleepAwaiter
+Reactor::Sleep(
+    int nDelayMs
+    )
+{
+    return SleepAwaiter(this, nDelayMs);
+}
+
+//=============================================================================
+//=============================================================================
+void
+Reactor::Spawn(
+    ReactorTask<bool> &rtTask
+    )
+{
+    //Runs the task up to its first wait, the caller keeps ownership of it
+    rtTask.hTask.promise().prOwner = this;
+    ++nTasksRunning;
+    rtTask.hTask.resume();
+}
+
+//=============================================================================
+//=============================================================================
+void
+Reactor::Run(
+    )
+{
+    //Dispatches readiness and deadlines until every spawned task has finished
+    struct epoll_event aEvents[REACTOR_MAX_EVENTS];
+    while (nTasksRunning > 0)
+    {
+        int nEvents = epoll_wait(nEpollFd, aEvents, REACTOR_MAX_EVENTS, NextTimeoutMs());
+        if (nEvents < 0 && errno != EINTR)
+        {
+            break;
+        }
+
+        int i = 0;
+        while (i < nEvents)
+        {
+            ReactorFd *pFd = static_cast<ReactorFd *>(aEvents[i].data.ptr);
+            ++i;
+            if (pFd->nFd < 0)
+            {
+                //Removed by a task resumed earlier in this batch
+                continue;
+            }
+
+            //Errors and hangups are reported as readiness so the next read or write sees them
+            if (aEvents[i - 1].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+            {
+                pFd->bWritable = true;
+                if (pFd->hWriter)
+                {
+                    std::coroutine_handle<> hWaiter = std::exchange(pFd->hWriter, nullptr);
+                    hWaiter.resume();
+                }
+            }
+            if (pFd->nFd >= 0 && (aEvents[i - 1].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)))
+            {
+                pFd->bReadable = true;
+                if (pFd->hReader)
+                {
+                    std::coroutine_handle<> hWaiter = std::exchange(pFd->hReader, nullptr);
+                    hWaiter.resume();
+                }
+            }
+        }
+
+        ExpireTimers();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+Reactor::TaskFinished(
+    )
+{
+    --nTasksRunning;
+}
+
+//=============================================================================
+//=============================================================================
+int64_t
+Reactor::NowNs(
+    )
+{
+    struct timespec tsNow;
+    clock_gettime(CLOCK_MONOTONIC, &tsNow);
+    return (int64_t)tsNow.tv_sec * 1000000000LL + tsNow.tv_nsec;
+}
+
+//=============================================================================
+//=============================================================================
+void
+Reactor::Wait(
+    ReactorFd *pFd,
+    ReactorDirections nDirection,
+    int nTimeoutMs,
+    std::coroutine_handle<> hWaiter
+    )
+{
+    //Parks a coroutine on a descriptor and/or a deadline
+    ReactorTimer rtTimer;
+    rtTimer.nDeadlineNs = NowNs() + (int64_t)nTimeoutMs * REACTOR_NS_PER_MS;
+    rtTimer.nId = nNextTimerId++;
+    rtTimer.pFd = pFd;
+    rtTimer.nDirection = nDirection;
+    rtTimer.hWaiter = hWaiter;
+
+    if (nDirection == ReactorDirectionRead)
+    {
+        pFd->hReader = hWaiter;
+        pFd->nReadTimer = rtTimer.nId;
+    }
+    else if (nDirection == ReactorDirectionWrite)
+    {
+        pFd->hWriter = hWaiter;
+        pFd->nWriteTimer = rtTimer.nId;
+    }
+    pqTimers.push(rtTimer);
+}
+
+//=============================================================================
+//=============================================================================
+int
+Reactor::NextTimeoutMs(
+    ) const
+{
+    //Time until the earliest deadline, rounded up so it is never woken early
+    if (pqTimers.empty())
+    {
+        return -1;
+    }
+
+    int64_t nRemainingNs = pqTimers.top().nDeadlineNs - NowNs();
+    return (nRemainingNs <= 0 ? 0 : (int)((nRemainingNs + REACTOR_NS_PER_MS - 1) / REACTOR_NS_PER_MS));
+}
+
+//=============================================================================
+//=============================================================================
+void
+Reactor::ExpireTimers(
+    )
+{
+    //Resumes coroutines whose deadline has passed, the awaiter sees the descriptor as not ready
+    int64_t nNowNs = NowNs();
+    while (!pqTimers.empty() && pqTimers.top().nDeadlineNs <= nNowNs)
+    {
+        ReactorTimer rtTimer = pqTimers.top();
+        pqTimers.pop();
+
+        if (rtTimer.nDirection == ReactorDirectionRead)
+        {
+            if (rtTimer.pFd->hReader != rtTimer.hWaiter || rtTimer.pFd->nReadTimer != rtTimer.nId)
+            {
+                //Already resumed by readiness
+                continue;
+            }
+            rtTimer.pFd->hReader = nullptr;
+        }
+        else if (rtTimer.nDirection == ReactorDirectionWrite)
+        {
+            if (rtTimer.pFd->hWriter != rtTimer.hWaiter || rtTimer.pFd->nWriteTimer != rtTimer.nId)
+            {
+                continue;
+            }
+            rtTimer.pFd->hWriter = nullptr;
+        }
+        rtTimer.hWaiter.resume();
+    }
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
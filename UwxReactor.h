@@ -0,0 +1,393 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxReactor.h
+**
+** Notes: Single-threaded epoll reactor which runs transfer sessions as C++20
+**        coroutines, so hundreds of ports can be served by one thread. Only
+**        available on Linux.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXREACTOR_H
+#define UWXREACTOR_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define REACTOR_MAX_EVENTS                        64
+#define REACTOR_NS_PER_MS                         1000000LL
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+template <class T>
+class ReactorTask;
+
+//Enum used for which readiness a coroutine is waiting on
+enum ReactorDirections
+{
+    ReactorDirectionNone                        = 0,
+    ReactorDirectionRead,
+    ReactorDirectionWrite
+};
+
+//File descriptor registered with the reactor. Readiness is edge triggered:
+//a flag is set by the reactor and cleared by the user once I/O returns EAGAIN.
+typedef struct
+{
+    int nFd;
+    bool bReadable;
+    bool bWritable;
+    std::coroutine_handle<> hReader;
+    std::coroutine_handle<> hWriter;
+    uint64_t nReadTimer;
+    uint64_t nWriteTimer;
+} ReactorFd;
+
+//Wait deadline, entries whose waiter has already been resumed are skipped
+typedef struct
+{
+    int64_t nDeadlineNs;
+    uint64_t nId;
+    ReactorFd *pFd;
+    ReactorDirections nDirection;
+    std::coroutine_handle<> hWaiter;
+} ReactorTimer;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class Reactor
+{
+public:
+    //Awaiter for a descriptor becoming readable or writable, yields false on timeout
+    class ReadinessAwaiter
+    {
+    public:
+        ReadinessAwaiter(
+            Reactor *prReactor,
+            ReactorFd *pFd,
+            ReactorDirections nDirection,
+            int nTimeoutMs
+            ) : prReactor(prReactor), pFd(pFd), nDirection(nDirection), nTimeoutMs(nTimeoutMs)
+        {
+        }
+        bool
+        await_ready(
+            ) const noexcept
+        {
+            return (nDirection == ReactorDirectionRead ? pFd->bReadable : pFd->bWritable);
+        }
+        void
+        await_suspend(
+            std::coroutine_handle<> hWaiter
+            )
+        {
+            prReactor->Wait(pFd, nDirection, nTimeoutMs, hWaiter);
+        }
+        bool
+        await_resume(
+            ) const noexcept
+        {
+            return await_ready();
+        }
+
+    private:
+        Reactor *prReactor;
+        ReactorFd *pFd;
+        ReactorDirections nDirection;
+        int nTimeoutMs;
+    };
+
+    //Awaiter which resumes after a delay
+    class SleepAwaiter
+    {
+    public:
+        SleepAwaiter(
+            Reactor *prReactor,
+            int nDelayMs
+            ) : prReactor(prReactor), nDelayMs(nDelayMs)
+        {
+        }
+        bool
+        await_ready(
+            ) const noexcept
+        {
+            return (nDelayMs <= 0);
+        }
+        void
+        await_suspend(
+            std::coroutine_handle<> hWaiter
+            )
+        {
+            prReactor->Wait(nullptr, ReactorDirectionNone, nDelayMs, hWaiter);
+        }
+        void
+        await_resume(
+            ) const noexcept
+        {
+        }
+
+    private:
+        Reactor *prReactor;
+        int nDelayMs;
+    };
+
+    Reactor(
+        );
+    ~Reactor(
+        );
+    Reactor(
+        const Reactor &
+        ) = delete;
+    Reactor &
+    operator=(
+        const Reactor &
+        ) = delete;
+    bool
+    IsValid(
+        ) const;
+    ReactorFd *
+    Add(
+        int nFd
+        );
+    void
+    Remove(
+        ReactorFd *pFd
+        );
+    ReadinessAwaiter
+    Readable(
+        ReactorFd *pFd,
+        int nTimeoutMs
+        );
+    ReadinessAwaiter
+    Writable(
+        ReactorFd *pFd,
+        int nTimeoutMs
+        );
+    SleepAwaiter
+    Sleep(
+        int nDelayMs
+        );
+    void
+    Spawn(
+        ReactorTask<bool> &rtTask
+        );
+    void
+    Run(
+        );
+    void
+    TaskFinished(
+        );
+    static int64_t
+    NowNs(
+        );
+
+private:
+    void
+    Wait(
+        ReactorFd *pFd,
+        ReactorDirections nDirection,
+        int nTimeoutMs,
+        std::coroutine_handle<> hWaiter
+        );
+    int
+    NextTimeoutMs(
+        ) const;
+    void
+    ExpireTimers(
+        );
+
+    struct TimerLater
+    {
+        bool
+        operator()(
+            const ReactorTimer &rtA,
+            const ReactorTimer &rtB
+            ) const
+        {
+            return (rtA.nDeadlineNs > rtB.nDeadlineNs);
+        }
+    };
+
+    int nEpollFd = -1;                              //epoll instance all descriptors are registered with
+    std::vector<std::unique_ptr<ReactorFd>> vecFds; //Registered descriptors, kept until destruction as timers may still refer to them
+    std::priority_queue<ReactorTimer, std::vector<ReactorTimer>, TimerLater> pqTimers; //Pending deadlines, earliest first
+    uint64_t nNextTimerId = 1;                      //Identifier given to the next deadline
+    int nTasksRunning = 0;                          //Spawned tasks which have not finished
+};
+
+//Lazily started coroutine producing a T. A task awaited by another coroutine
+//resumes it on completion, a task given to Reactor::Spawn reports to the reactor.
+template <class T>
+class ReactorTask
+{
+public:
+    class promise_type
+    {
+    public:
+        struct FinalAwaiter
+        {
+            bool
+            await_ready(
+                ) const noexcept
+            {
+                return false;
+            }
+            std::coroutine_handle<>
+            await_suspend(
+                std::coroutine_handle<promise_type> hTask
+                ) noexcept
+            {
+                promise_type &ptPromise = hTask.promise();
+                if (ptPromise.hContinuation)
+                {
+                    return ptPromise.hContinuation;
+                }
+                else if (ptPromise.prOwner != nullptr)
+                {
+                    ptPromise.prOwner->TaskFinished();
+                }
+                return std::noop_coroutine();
+            }
+            void
+            await_resume(
+                ) const noexcept
+            {
+            }
+        };
+
+        ReactorTask
+        get_return_object(
+            )
+        {
+            return ReactorTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always
+        initial_suspend(
+            ) noexcept
+        {
+            return {};
+        }
+        FinalAwaiter
+        final_suspend(
+            ) noexcept
+        {
+            return {};
+        }
+        void
+        return_value(
+            T tValue
+            )
+        {
+            tResult = std::move(tValue);
+        }
+        void
+        unhandled_exception(
+            )
+        {
+            std::terminate();
+        }
+
+        T tResult{};                                //Value given to co_return
+        std::coroutine_handle<> hContinuation;      //Coroutine awaiting this task, if any
+        Reactor *prOwner = nullptr;                 //Reactor the task was spawned on, if any
+    };
+
+    ReactorTask(
+        ReactorTask &&rtOther
+        ) noexcept : hTask(std::exchange(rtOther.hTask, nullptr))
+    {
+    }
+    ReactorTask(
+        const ReactorTask &
+        ) = delete;
+    ReactorTask &
+    operator=(
+        const ReactorTask &
+        ) = delete;
+    ~ReactorTask(
+        )
+    {
+        if (hTask)
+        {
+            hTask.destroy();
+        }
+    }
+    bool
+    Done(
+        ) const
+    {
+        return (!hTask || hTask.done());
+    }
+    T
+    Result(
+        ) const
+    {
+        return hTask.promise().tResult;
+    }
+    bool
+    await_ready(
+        ) const noexcept
+    {
+        return false;
+    }
+    std::coroutine_handle<>
+    await_suspend(
+        std::coroutine_handle<> hCaller
+        ) noexcept
+    {
+        //Symmetric transfer into the task, it transfers back to the caller when it completes
+        hTask.promise().hContinuation = hCaller;
+        return hTask;
+    }
+    T
+    await_resume(
+        )
+    {
+        return std::move(hTask.promise().tResult);
+    }
+
+private:
+    friend class Reactor;
+
+    explicit
+    ReactorTask(
+        std::coroutine_handle<promise_type> hTask
+        ) : hTask(hTask)
+    {
+    }
+
+    std::coroutine_handle<promise_type> hTask;      //The coroutine, destroyed with the task object
+};
+
+#endif // UWXREACTOR_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
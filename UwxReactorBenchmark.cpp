@@ -0,0 +1,335 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxReactorBenchmark.cpp
+**
+** Notes: Compares the single-threaded coroutine reactor with a thread per
+**        port when upgrading many simulated HL7800 modules. Only available
+**        on Linux.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxReactorBenchmark.h"
+#include "UwxReactorSession.h"
+#include "UwxPtySimulator.h"
+#include "UwxStressTest.h"
+#include <QThread>
+#include <QSemaphore>
+#include <QStringList>
+#include <QVector>
+#include <QCryptographicHash>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <ctime>
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+static const int aReactorBenchmarkPorts[] = {16, 64, 256};
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Engine cost measured on the thread(s) which ran the sessions
+typedef struct
+{
+    int nPassed;
+    qint64 nWallNs;
+    qint64 nCpuNs;
+    qint64 nContextSwitches;
+    int nThreads;
+} ReactorBenchmarkResult;
+
+//Runs the simulated modules on their own event loop, so the engine under
+//test has the calling thread (or its own threads) to itself
+class SimulatorHost : public QThread
+{
+public:
+    SimulatorHost(
+        int nModems,
+        const QByteArray &baImageSHA256
+        ) : nModems(nModems), baImageSHA256(baImageSHA256)
+    {
+    }
+    bool
+    Begin(
+        QString *pstrError
+        )
+    {
+        start();
+        smReady.acquire();
+        *pstrError = strError;
+        return strError.isEmpty();
+    }
+    void
+    End(
+        )
+    {
+        quit();
+        wait();
+    }
+    QStringList
+    PortNames(
+        ) const
+    {
+        return lstPortNames;
+    }
+    int
+    Verified(
+        ) const
+    {
+        return nVerified;
+    }
+
+protected:
+    void
+    run(
+        ) override
+    {
+        PtySimulatorImpairments psiImpairments;
+        psiImpairments.nMinLatencyMs = 0;
+        psiImpairments.nMaxLatencyMs = 0;
+        psiImpairments.fNackProbability = 0.0;
+        psiImpairments.fDropAckProbability = 0.0;
+        psiImpairments.fByteErrorProbability = 0.0;
+
+        QVector<PtySimulator *> vecSimulators;
+        int i = 0;
+        while (i < nModems && strError.isEmpty())
+        {
+            PtySimulator *psSimulator = new PtySimulator();
+            vecSimulators.append(psSimulator);
+            if (psSimulator->Open(&strError))
+            {
+                psSimulator->StartModem(strStressModemVersion, strStressUpgradedVersion, psiImpairments, REACTOR_BENCHMARK_SEED + i);
+                lstPortNames.append(psSimulator->PortName());
+            }
+            ++i;
+        }
+
+        smReady.release();
+        if (strError.isEmpty())
+        {
+            exec();
+        }
+
+        foreach (PtySimulator *psSimulator, vecSimulators)
+        {
+            if (psSimulator->ReceivedSHA256() == baImageSHA256)
+            {
+                ++nVerified;
+            }
+            delete psSimulator;
+        }
+    }
+
+private:
+    int nModems;                                    //Number of modules to simulate
+    QByteArray baImageSHA256;                       //Hash every module should have received
+    QSemaphore smReady;                             //Released once the modules are listening
+    QString strError;                               //Reason the modules could not be created
+    QStringList lstPortNames;                       //Port of each module
+    int nVerified = 0;                              //Modules which received the whole image
+};
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static qint64
+ThreadCpuNs(
+    )
+{
+    struct timespec tsCpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tsCpu);
+    return (qint64)tsCpu.tv_sec * 1000000000LL + tsCpu.tv_nsec;
+}
+
+//=============================================================================
+//=============================================================================
+static qint64
+ThreadContextSwitches(
+    )
+{
+    struct rusage ruUsage;
+    getrusage(RUSAGE_THREAD, &ruUsage);
+    return (qint64)ruUsage.ru_nvcsw + ruUsage.ru_nivcsw;
+}
+
+//=============================================================================
+//=============================================================================
+static ReactorBenchmarkResult
+RunReactor(
+    const QStringList &lstPorts,
+    const QByteArray &baImage
+    )
+{
+    //Every session on one reactor on the calling thread
+    ReactorBenchmarkResult rbrResult;
+    memset(&rbrResult, 0, sizeof(rbrResult));
+    rbrResult.nThreads = 1;
+    qint64 nStartCpuNs = ThreadCpuNs();
+    qint64 nStartSwitches = ThreadContextSwitches();
+    int64_t nStartNs = Reactor::NowNs();
+
+    Reactor rReactor;
+    std::vector<std::unique_ptr<ReactorUpgradeSession>> vecSessions;
+    std::vector<ReactorTask<bool>> vecTasks;
+    vecTasks.reserve(lstPorts.count());
+    foreach (const QString &strPort, lstPorts)
+    {
+        vecSessions.emplace_back(new ReactorUpgradeSession(rReactor, strPort.toStdString(), reinterpret_cast<const uint8_t *>(baImage.constData()), baImage.size()));
+        vecTasks.push_back(vecSessions.back()->Run());
+    }
+    for (ReactorTask<bool> &rtTask : vecTasks)
+    {
+        rReactor.Spawn(rtTask);
+    }
+    rReactor.Run();
+
+    rbrResult.nWallNs = Reactor::NowNs() - nStartNs;
+    rbrResult.nCpuNs = ThreadCpuNs() - nStartCpuNs;
+    rbrResult.nContextSwitches = ThreadContextSwitches() - nStartSwitches;
+    for (const ReactorTask<bool> &rtTask : vecTasks)
+    {
+        rbrResult.nPassed += (rtTask.Done() && rtTask.Result() ? 1 : 0);
+    }
+
+    return rbrResult;
+}
+
+//=============================================================================
+//=============================================================================
+static ReactorBenchmarkResult
+RunThreadPerPort(
+    const QStringList &lstPorts,
+    const QByteArray &baImage
+    )
+{
+    //The same session code, but each port has its own thread and reactor so every wait blocks a thread
+    ReactorBenchmarkResult rbrResult;
+    memset(&rbrResult, 0, sizeof(rbrResult));
+    rbrResult.nThreads = lstPorts.count();
+    std::vector<ReactorBenchmarkResult> vecThreadResults(lstPorts.count());
+    std::vector<std::thread> vecThreads;
+    vecThreads.reserve(lstPorts.count());
+    int64_t nStartNs = Reactor::NowNs();
+
+    int i = 0;
+    while (i < lstPorts.count())
+    {
+        std::string strPort = lstPorts.at(i).toStdString();
+        ReactorBenchmarkResult *pThreadResult = &vecThreadResults[i];
+        vecThreads.emplace_back([strPort, pThreadResult, &baImage]()
+        {
+            Reactor rReactor;
+            ReactorUpgradeSession rusSession(rReactor, strPort, reinterpret_cast<const uint8_t *>(baImage.constData()), baImage.size());
+            ReactorTask<bool> rtTask = rusSession.Run();
+            rReactor.Spawn(rtTask);
+            rReactor.Run();
+            pThreadResult->nPassed = (rtTask.Done() && rtTask.Result() ? 1 : 0);
+            pThreadResult->nCpuNs = ThreadCpuNs();
+            pThreadResult->nContextSwitches = ThreadContextSwitches();
+        });
+        ++i;
+    }
+
+    for (std::thread &tThread : vecThreads)
+    {
+        tThread.join();
+    }
+    rbrResult.nWallNs = Reactor::NowNs() - nStartNs;
+
+    for (const ReactorBenchmarkResult &rbrThread : vecThreadResults)
+    {
+        rbrResult.nPassed += rbrThread.nPassed;
+        rbrResult.nCpuNs += rbrThread.nCpuNs;
+        rbrResult.nContextSwitches += rbrThread.nContextSwitches;
+    }
+
+    return rbrResult;
+}
+
+//=============================================================================
+//=============================================================================
+int
+ReactorBenchmark::Run(
+    QTextStream &tsOutput
+    )
+{
+    //Each design upgrades fresh simulated modules, a port passes if its module received the whole image
+    QByteArray baImage(REACTOR_BENCHMARK_IMAGE_SIZE, 0);
+    uint32_t nImageSeed = REACTOR_BENCHMARK_SEED;
+    int i = 0;
+    while (i < baImage.size())
+    {
+        nImageSeed = nImageSeed * 1103515245 + 12345;
+        baImage[i] = (char)(nImageSeed >> 16);
+        ++i;
+    }
+    QByteArray baImageSHA256 = QCryptographicHash::hash(baImage, QCryptographicHash::Sha256);
+
+    tsOutput << "Reactor benchmark: " << REACTOR_BENCHMARK_IMAGE_SIZE / 1024 << " KiB image per port, simulated HL7800 modules without latency or faults on a separate thread\n";
+    tsOutput << QString("Ports").leftJustified(7) << QString("Engine").leftJustified(17) << QString("Passed").leftJustified(8) << QString("Wall").leftJustified(12)
+             << QString("Throughput").leftJustified(15) << QString("Engine CPU").leftJustified(13) << QString("CPU/port").leftJustified(11)
+             << QString("Switches").leftJustified(10) << "Threads\n";
+    tsOutput.flush();
+
+    bool bAllPassed = true;
+    for (int nPorts : aReactorBenchmarkPorts)
+    {
+        int nDesign = 0;
+        while (nDesign < 2)
+        {
+            SimulatorHost shHost(nPorts, baImageSHA256);
+            QString strError;
+            if (!shHost.Begin(&strError))
+            {
+                shHost.End();
+                tsOutput << "Unable to create " << nPorts << " simulated modules: " << strError << "\n";
+                return EXIT_FAILURE;
+            }
+
+            ReactorBenchmarkResult rbrResult = (nDesign == 0 ? RunReactor(shHost.PortNames(), baImage) : RunThreadPerPort(shHost.PortNames(), baImage));
+            shHost.End();
+            rbrResult.nPassed = qMin(rbrResult.nPassed, shHost.Verified());
+            bAllPassed = (bAllPassed && rbrResult.nPassed == nPorts);
+
+            tsOutput << QString::number(nPorts).leftJustified(7) << QString(nDesign == 0 ? "reactor" : "thread per port").leftJustified(17)
+                     << QString::number(rbrResult.nPassed).leftJustified(8)
+                     << QString::number((double)rbrResult.nWallNs / REACTOR_BENCHMARK_NS_PER_MS, 'f', 1).append(" ms").leftJustified(12)
+                     << QString::number((double)nPorts * baImage.size() * REACTOR_BENCHMARK_NS_PER_S / qMax(rbrResult.nWallNs, (qint64)1) / REACTOR_BENCHMARK_BYTES_PER_KIB, 'f', 0).append(" KiB/s").leftJustified(15)
+                     << QString::number((double)rbrResult.nCpuNs / REACTOR_BENCHMARK_NS_PER_MS, 'f', 1).append(" ms").leftJustified(13)
+                     << QString::number((double)rbrResult.nCpuNs / nPorts / REACTOR_BENCHMARK_NS_PER_MS, 'f', 2).append(" ms").leftJustified(11)
+                     << QString::number(rbrResult.nContextSwitches).leftJustified(10) << rbrResult.nThreads << "\n";
+            tsOutput.flush();
+            ++nDesign;
+        }
+    }
+
+    return (bAllPassed == true ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
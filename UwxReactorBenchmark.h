@@ -0,0 +1,58 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxReactorBenchmark.h
+**
+** Notes: Compares the single-threaded coroutine reactor with a thread per
+**        port when upgrading many simulated HL7800 modules. Only available
+**        on Linux.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXREACTORBENCHMARK_H
+#define UWXREACTORBENCHMARK_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QTextStream>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define REACTOR_BENCHMARK_IMAGE_SIZE              (64 * 1024)
+#define REACTOR_BENCHMARK_SEED                    0x584d
+#define REACTOR_BENCHMARK_NS_PER_MS               1000000.0
+#define REACTOR_BENCHMARK_NS_PER_S                1000000000.0
+#define REACTOR_BENCHMARK_BYTES_PER_KIB           1024.0
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class ReactorBenchmark
+{
+public:
+    static int
+    Run(
+        QTextStream &tsOutput
+        );
+};
+
+#endif // UWXREACTORBENCHMARK_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,386 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxReactorSession.cpp
+**
+** Notes: HL7800 firmware upgrade written as a coroutine for the reactor,
+**        the same command and XModem flow the main window engine drives
+**        through its mode and action state. Only available on Linux.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxReactorSession.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+ReactorUpgradeSession::ReactorUpgradeSession(
+    Reactor &rReactor,
+    const std::string &strPort,
+    const uint8_t *pImage,
+    size_t nImageSize
+    ) : rReactor(rReactor), strPort(strPort), pImage(pImage), nImageSize(nImageSize)
+{
+}
+
+//=============================================================================
+//=============================================================================
+ReactorUpgradeSession::~ReactorUpgradeSession(
+    )
+{
+    Close();
+}
+
+//=============================================================================
+//=============================================================================
+ReactorTask<bool>
+ReactorUpgradeSession::Run(
+    )
+{
+    //Detection, transfer and accept, each wait suspends only this session
+    if (!Open())
+    {
+        co_return false;
+    }
+
+    if (!co_await Command("ATI3") || !co_await Line("HL7800", REACTOR_SESSION_COMMAND_TIMEOUT_MS) || !co_await Line("OK", REACTOR_SESSION_COMMAND_TIMEOUT_MS))
+    {
+        strError = (strError.empty() ? std::string("Module did not respond to the version query") : strError);
+        Close();
+        co_return false;
+    }
+
+    //The module requests the first block with a NACK (8-bit checksum)
+    if (!co_await Command(std::string("AT+WDSD=").append(std::to_string(nImageSize))) || co_await Reply(REACTOR_SESSION_COMMAND_TIMEOUT_MS) != XModemPacketTypeNack)
+    {
+        strError = (strError.empty() ? std::string("Module did not start the upgrade") : strError);
+        Close();
+        co_return false;
+    }
+
+    size_t nOffset = 0;
+    uint8_t nPacket = 1;
+    while (nOffset < nImageSize)
+    {
+        size_t nDataSize = std::min(XModem1KSum8Framer::DataSize, nImageSize - nOffset);
+        XModem1KSum8Framer::Frame(aPacket, nPacket, pImage + nOffset, nDataSize, REACTOR_SESSION_PADDING);
+
+        int nRetries = 0;
+        while (true)
+        {
+            if (!co_await Write(aPacket.data(), aPacket.size()))
+            {
+                Close();
+                co_return false;
+            }
+
+            int nReply = co_await Reply(REACTOR_SESSION_BLOCK_TIMEOUT_MS);
+            if (nReply == XModemPacketTypeAck)
+            {
+                break;
+            }
+            else if (nReply == XModemPacketTypeCancel || ++nRetries > REACTOR_SESSION_MAX_RETRIES)
+            {
+                strError = std::string("Block ").append(std::to_string(nPacket)).append(nReply == XModemPacketTypeCancel ? " was cancelled by the module" : " was not acknowledged");
+                Close();
+                co_return false;
+            }
+            ++nRetransmits;
+        }
+
+        nOffset += nDataSize;
+        ++nPacket;
+    }
+
+    //End of transfer, then the module is told to install the upgrade
+    const uint8_t nEndOfFrame = XModemPacketTypeEndOfFrame;
+    int nRetries = 0;
+    while (true)
+    {
+        if (!co_await Write(&nEndOfFrame, sizeof(nEndOfFrame)))
+        {
+            Close();
+            co_return false;
+        }
+        else if (co_await Reply(REACTOR_SESSION_COMMAND_TIMEOUT_MS) == XModemPacketTypeAck)
+        {
+            break;
+        }
+        else if (++nRetries > REACTOR_SESSION_MAX_RETRIES)
+        {
+            strError = "End of transfer was not acknowledged";
+            Close();
+            co_return false;
+        }
+    }
+
+    if (!co_await Command("AT+WDSR=4") || !co_await Line("OK", REACTOR_SESSION_COMMAND_TIMEOUT_MS))
+    {
+        strError = (strError.empty() ? std::string("Module did not accept the upgrade") : strError);
+        Close();
+        co_return false;
+    }
+
+    Close();
+    co_return true;
+}
+
+//=============================================================================
+//=============================================================================
+const std::string &
+ReactorUpgradeSession::Error(
+    ) const
+{
+    return strError;
+}
+
+//=============================================================================
+//=============================================================================
+size_t
+ReactorUpgradeSession::Retransmits(
+    ) const
+{
+    return nRetransmits;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+ReactorUpgradeSession::Open(
+    )
+{
+    //Non-blocking raw port registered with the reactor
+    nFd = open(strPort.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (nFd < 0)
+    {
+        strError = std::string("Unable to open ").append(strPort).append(": ").append(strerror(errno));
+        return false;
+    }
+
+    struct termios tiSettings;
+    if (tcgetattr(nFd, &tiSettings) == 0)
+    {
+        cfmakeraw(&tiSettings);
+        cfsetspeed(&tiSettings, B115200);
+        tcsetattr(nFd, TCSANOW, &tiSettings);
+    }
+
+    pFd = rReactor.Add(nFd);
+    if (pFd == nullptr)
+    {
+        strError = std::string("Unable to register ").append(strPort).append(" with the reactor: ").append(strerror(errno));
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+ReactorUpgradeSession::Close(
+    )
+{
+    if (pFd != nullptr)
+    {
+        rReactor.Remove(pFd);
+        pFd = nullptr;
+    }
+    if (nFd >= 0)
+    {
+        close(nFd);
+        nFd = -1;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+ReactorTask<bool>
+ReactorUpgradeSession::Receive(
+    int64_t nDeadlineNs
+    )
+{
+    //Reads everything available, waiting until the deadline if nothing is
+    while (true)
+    {
+        if (pFd->bReadable == false)
+        {
+            int64_t nRemainingNs = nDeadlineNs - Reactor::NowNs();
+            if (nRemainingNs <= 0 || !co_await rReactor.Readable(pFd, (int)((nRemainingNs + REACTOR_NS_PER_MS - 1) / REACTOR_NS_PER_MS)))
+            {
+                co_return false;
+            }
+        }
+
+        bool bReceived = false;
+        while (true)
+        {
+            ssize_t nRead = read(nFd, aReadBuffer, sizeof(aReadBuffer));
+            if (nRead > 0)
+            {
+                strInput.append(reinterpret_cast<const char *>(aReadBuffer), nRead);
+                bReceived = true;
+            }
+            else if (nRead < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (nRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                //Drained, the reactor sets the flag again on the next edge
+                pFd->bReadable = false;
+                break;
+            }
+            else
+            {
+                strError = std::string("Serial port ").append(strPort).append(" closed");
+                co_return false;
+            }
+        }
+
+        if (bReceived == true)
+        {
+            co_return true;
+        }
+    }
+}
+
+//=============================================================================
+//=============================================================================
+ReactorTask<bool>
+ReactorUpgradeSession::Write(
+    const uint8_t *pData,
+    size_t nSize
+    )
+{
+    //Writes all of the data, waiting for space in the port's buffer when it is full
+    size_t nWritten = 0;
+    while (nWritten < nSize)
+    {
+        ssize_t nResult = write(nFd, pData + nWritten, nSize - nWritten);
+        if (nResult > 0)
+        {
+            nWritten += nResult;
+        }
+        else if (nResult < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (nResult < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            pFd->bWritable = false;
+            if (!co_await rReactor.Writable(pFd, REACTOR_SESSION_BLOCK_TIMEOUT_MS))
+            {
+                strError = std::string("Writing to ").append(strPort).append(" timed out");
+                co_return false;
+            }
+        }
+        else
+        {
+            strError = std::string("Unable to write to ").append(strPort).append(": ").append(strerror(errno));
+            co_return false;
+        }
+    }
+
+    co_return true;
+}
+
+//=============================================================================
+//=============================================================================
+ReactorTask<bool>
+ReactorUpgradeSession::Command(
+    const std::string &strCommand
+    )
+{
+    std::string strLine = std::string(strCommand).append("\r\n");
+    co_return co_await Write(reinterpret_cast<const uint8_t *>(strLine.data()), strLine.size());
+}
+
+//=============================================================================
+//=============================================================================
+ReactorTask<bool>
+ReactorUpgradeSession::Line(
+    const std::string &strText,
+    int nTimeoutMs
+    )
+{
+    //Waits for a line containing the text, lines before it are discarded
+    int64_t nDeadlineNs = Reactor::NowNs() + (int64_t)nTimeoutMs * REACTOR_NS_PER_MS;
+    while (true)
+    {
+        size_t nEnd;
+        while ((nEnd = strInput.find('\n')) != std::string::npos)
+        {
+            bool bFound = (strInput.substr(0, nEnd).find(strText) != std::string::npos);
+            strInput.erase(0, nEnd + 1);
+            if (bFound == true)
+            {
+                co_return true;
+            }
+        }
+
+        if (!co_await Receive(nDeadlineNs))
+        {
+            co_return false;
+        }
+    }
+}
+
+//=============================================================================
+//=============================================================================
+ReactorTask<int>
+ReactorUpgradeSession::Reply(
+    int nTimeoutMs
+    )
+{
+    //Waits for an ACK, NACK or cancel byte, anything else is discarded
+    int64_t nDeadlineNs = Reactor::NowNs() + (int64_t)nTimeoutMs * REACTOR_NS_PER_MS;
+    while (true)
+    {
+        size_t i = 0;
+        while (i < strInput.size())
+        {
+            uint8_t nByte = (uint8_t)strInput[i];
+            if (nByte == XModemPacketTypeAck || nByte == XModemPacketTypeNack || nByte == XModemPacketTypeCancel)
+            {
+                strInput.erase(0, i + 1);
+                co_return nByte;
+            }
+            ++i;
+        }
+        strInput.clear();
+
+        if (!co_await Receive(nDeadlineNs))
+        {
+            co_return REACTOR_SESSION_NO_REPLY;
+        }
+    }
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
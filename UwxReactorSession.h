@@ -0,0 +1,116 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxReactorSession.h
+**
+** Notes: HL7800 firmware upgrade written as a coroutine for the reactor,
+**        the same command and XModem flow the main window engine drives
+**        through its mode and action state. Only available on Linux.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXREACTORSESSION_H
+#define UWXREACTORSESSION_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxReactor.h"
+#include "UwxXModemFramer.h"
+#include <string>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define REACTOR_SESSION_READ_SIZE                 4096
+#define REACTOR_SESSION_COMMAND_TIMEOUT_MS        5000
+#define REACTOR_SESSION_BLOCK_TIMEOUT_MS          10000
+#define REACTOR_SESSION_MAX_RETRIES               10
+#define REACTOR_SESSION_PADDING                   0x1a
+#define REACTOR_SESSION_NO_REPLY                  -1
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class ReactorUpgradeSession
+{
+public:
+    ReactorUpgradeSession(
+        Reactor &rReactor,
+        const std::string &strPort,
+        const uint8_t *pImage,
+        size_t nImageSize
+        );
+    ~ReactorUpgradeSession(
+        );
+    ReactorTask<bool>
+    Run(
+        );
+    const std::string &
+    Error(
+        ) const;
+    size_t
+    Retransmits(
+        ) const;
+
+private:
+    bool
+    Open(
+        );
+    void
+    Close(
+        );
+    ReactorTask<bool>
+    Receive(
+        int64_t nDeadlineNs
+        );
+    ReactorTask<bool>
+    Write(
+        const uint8_t *pData,
+        size_t nSize
+        );
+    ReactorTask<bool>
+    Command(
+        const std::string &strCommand
+        );
+    ReactorTask<bool>
+    Line(
+        const std::string &strText,
+        int nTimeoutMs
+        );
+    ReactorTask<int>
+    Reply(
+        int nTimeoutMs
+        );
+
+    Reactor &rReactor;                              //Reactor all waits are made on
+    std::string strPort;                            //Serial port path
+    const uint8_t *pImage;                          //Firmware image, owned by the caller
+    size_t nImageSize;                              //Size of the firmware image
+    int nFd = -1;                                   //Open serial port
+    ReactorFd *pFd = nullptr;                       //Serial port registration with the reactor
+    std::string strInput;                           //Data received and not yet consumed
+    uint8_t aReadBuffer[REACTOR_SESSION_READ_SIZE]; //Buffer for reads from the port
+    XModem1KSum8Framer::Packet aPacket;             //Packet currently being sent, the HL7800 expects 1K blocks with an 8-bit checksum
+    std::string strError;                           //Reason the session failed
+    size_t nRetransmits = 0;                        //Blocks sent again after a NACK or timeout
+};
+
+#endif // UWXREACTORSESSION_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
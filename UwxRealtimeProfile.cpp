@@ -0,0 +1,172 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxRealtimeProfile.cpp
+**
+** Notes: Opt-in performance profile for the thread running the transfer
+**        engines: real-time scheduling, CPU affinity and locked packet
+**        buffers. Each part is skipped with a note if it is not permitted.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxRealtimeProfile.h"
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#endif
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+bool RealtimeProfile::bActive = false;
+QString RealtimeProfile::strSummary;
+bool RealtimeProfile::bBuffersLocked = false;
+
+//=============================================================================
+//=============================================================================
+void
+RealtimeProfile::Apply(
+    RealtimeSchedulingPolicies nPolicy,
+    int nPriority,
+    const QList<int> &lstCpus,
+    QStringList *plstNotes
+    )
+{
+    //Applies to the calling thread, which must be the one running the engines'
+    //event loop. Engines created afterwards lock their packet buffers.
+    QStringList lstApplied;
+#ifdef Q_OS_LINUX
+    int nSchedulingPolicy = (nPolicy == RealtimeSchedulingPolicyRoundRobin ? SCHED_RR : SCHED_FIFO);
+    QString strPolicy = (nPolicy == RealtimeSchedulingPolicyRoundRobin ? QString("SCHED_RR") : QString("SCHED_FIFO"));
+    struct sched_param spParam;
+    memset(&spParam, 0, sizeof(spParam));
+    spParam.sched_priority = qBound(sched_get_priority_min(nSchedulingPolicy), nPriority, sched_get_priority_max(nSchedulingPolicy));
+
+    //Threads started later (file hashing, downloads) revert to normal scheduling so they cannot starve the engines
+    if (sched_setscheduler(0, nSchedulingPolicy | SCHED_RESET_ON_FORK, &spParam) == 0)
+    {
+        lstApplied.append(QString("%1 priority %2").arg(strPolicy).arg(spParam.sched_priority));
+    }
+    else
+    {
+        int nError = errno;
+        plstNotes->append(QString("%1 priority %2 not applied, using normal scheduling: %3%4").arg(strPolicy).arg(spParam.sched_priority).arg(strerror(nError)).arg(nError == EPERM ? QString(" (needs CAP_SYS_NICE or a high enough RLIMIT_RTPRIO)") : QString()));
+    }
+
+    if (!lstCpus.isEmpty())
+    {
+        cpu_set_t csCpus;
+        CPU_ZERO(&csCpus);
+        QStringList lstCpuNames;
+        foreach (int nCpu, lstCpus)
+        {
+            if (nCpu >= 0 && nCpu < CPU_SETSIZE)
+            {
+                CPU_SET(nCpu, &csCpus);
+                lstCpuNames.append(QString::number(nCpu));
+            }
+        }
+
+        if (lstCpuNames.isEmpty())
+        {
+            plstNotes->append(QString("CPU affinity not applied: no valid CPU numbers given"));
+        }
+        else if (sched_setaffinity(0, sizeof(csCpus), &csCpus) == 0)
+        {
+            lstApplied.append(QString("CPU ").append(lstCpuNames.join(",")));
+        }
+        else
+        {
+            plstNotes->append(QString("CPU affinity ").append(lstCpuNames.join(",")).append(" not applied: ").append(strerror(errno)));
+        }
+    }
+#else
+    Q_UNUSED(nPolicy);
+    Q_UNUSED(nPriority);
+    Q_UNUSED(lstCpus);
+    plstNotes->append(QString("Real-time scheduling and CPU affinity are not supported on this platform"));
+#endif
+
+    bActive = true;
+    strSummary = lstApplied.join(", ");
+}
+
+//=============================================================================
+//=============================================================================
+bool
+RealtimeProfile::Active(
+    )
+{
+    return bActive;
+}
+
+//=============================================================================
+//=============================================================================
+QString
+RealtimeProfile::Summary(
+    )
+{
+    //Buffers are only reported once an engine has actually locked them
+    if (bActive == false)
+    {
+        return QString("off");
+    }
+    if (bBuffersLocked == true)
+    {
+        return (strSummary.isEmpty() ? QString("locked packet buffers") : QString(strSummary).append(", locked packet buffers"));
+    }
+    return (strSummary.isEmpty() ? QString("no settings applied") : strSummary);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+RealtimeProfile::LockBuffer(
+    const void *pBuffer,
+    size_t nSize,
+    QString *pstrError
+    )
+{
+    //Keeps a buffer resident so packet building never waits on a page fault
+#ifdef Q_OS_UNIX
+    if (mlock(pBuffer, nSize) != 0)
+    {
+        int nError = errno;
+        *pstrError = QString(strerror(nError)).append(nError == ENOMEM || nError == EPERM ? QString(" (RLIMIT_MEMLOCK too low)") : QString());
+        return false;
+    }
+
+    bBuffersLocked = true;
+    return true;
+#else
+    Q_UNUSED(pBuffer);
+    Q_UNUSED(nSize);
+    *pstrError = QString("not supported on this platform");
+    return false;
+#endif
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,86 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxRealtimeProfile.h
+**
+** Notes: Opt-in performance profile for the thread running the transfer
+**        engines: real-time scheduling, CPU affinity and locked packet
+**        buffers. Each part is skipped with a note if it is not permitted.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXREALTIMEPROFILE_H
+#define UWXREALTIMEPROFILE_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define REALTIME_DEFAULT_PRIORITY                 10
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Enum used for the real-time scheduling policy
+enum RealtimeSchedulingPolicies
+{
+    RealtimeSchedulingPolicyFIFO                = 0,
+    RealtimeSchedulingPolicyRoundRobin
+};
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class RealtimeProfile
+{
+public:
+    static void
+    Apply(
+        RealtimeSchedulingPolicies nPolicy,
+        int nPriority,
+        const QList<int> &lstCpus,
+        QStringList *plstNotes
+        );
+    static bool
+    Active(
+        );
+    static QString
+    Summary(
+        );
+    static bool
+    LockBuffer(
+        const void *pBuffer,
+        size_t nSize,
+        QString *pstrError
+        );
+
+private:
+    static bool bActive;                            //If Apply() has been called
+    static QString strSummary;                      //What was applied, for reports
+    static bool bBuffersLocked;                     //If LockBuffer() has locked a packet buffer
+};
+
+#endif // UWXREALTIMEPROFILE_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
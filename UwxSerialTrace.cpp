@@ -0,0 +1,360 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxSerialTrace.cpp
+**
+** Notes: Recording and replaying of timestamped serial traffic
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxSerialTrace.h"
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+bool
+SerialTraceRecorder::Open(
+    const QString &strFilename
+    )
+{
+    //Creates the trace file and writes the file header
+    Close();
+    fpTraceFile.setFileName(strFilename);
+    if (!fpTraceFile.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        return false;
+    }
+
+    dsTrace.setDevice(&fpTraceFile);
+    dsTrace.setByteOrder(QDataStream::LittleEndian);
+    dsTrace << (quint32)SERIAL_TRACE_MAGIC << (quint16)SERIAL_TRACE_VERSION;
+    etmrTrace.start();
+    nLastRecordNs = 0;
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceRecorder::Close(
+    )
+{
+    if (fpTraceFile.isOpen())
+    {
+        dsTrace.setDevice(NULL);
+        fpTraceFile.close();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+bool
+SerialTraceRecorder::IsRecording(
+    ) const
+{
+    return fpTraceFile.isOpen();
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceRecorder::Record(
+    SerialTraceRecordTypes nType,
+    const QByteArray &baData
+    )
+{
+    if (!fpTraceFile.isOpen())
+    {
+        return;
+    }
+
+    WriteHeader(nType, baData.length());
+    if (nType == SerialTraceRecordTypeTransmit)
+    {
+        //Only the header of outgoing data is kept
+        fpTraceFile.write(baData.left(SERIAL_TRACE_TRANSMIT_PREFIX_SIZE));
+    }
+    else
+    {
+        fpTraceFile.write(baData);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceRecorder::RecordValue(
+    SerialTraceRecordTypes nType,
+    quint32 nValue
+    )
+{
+    if (!fpTraceFile.isOpen())
+    {
+        return;
+    }
+
+    WriteHeader(nType, nValue);
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceRecorder::WriteHeader(
+    SerialTraceRecordTypes nType,
+    quint32 nValue
+    )
+{
+    //Timestamps are stored as the delta from the previous record in microseconds
+    quint32 nDeltaUs = (quint32)((etmrTrace.nsecsElapsed() - nLastRecordNs) / SERIAL_TRACE_NS_PER_US);
+    dsTrace << nDeltaUs << (quint8)nType << nValue;
+    nLastRecordNs += (qint64)nDeltaUs * SERIAL_TRACE_NS_PER_US;
+}
+
+//=============================================================================
+//=============================================================================
+SerialTraceReplayer::SerialTraceReplayer(QObject *parent) :
+    QObject(parent)
+{
+    tmrEvent.setSingleShot(true);
+    tmrStall.setSingleShot(true);
+    connect(&tmrEvent, SIGNAL(timeout()), this, SLOT(EventTimerTimeout()));
+    connect(&tmrStall, SIGNAL(timeout()), this, SLOT(StallTimerTimeout()));
+}
+
+//=============================================================================
+//=============================================================================
+bool
+SerialTraceReplayer::Load(
+    const QString &strFilename,
+    QString *pstrError
+    )
+{
+    //Reads the whole trace into memory
+    QFile fpTraceFile(strFilename);
+    if (!fpTraceFile.open(QFile::ReadOnly))
+    {
+        *pstrError = fpTraceFile.errorString();
+        return false;
+    }
+
+    QDataStream dsTrace(&fpTraceFile);
+    dsTrace.setByteOrder(QDataStream::LittleEndian);
+    quint32 nMagic;
+    quint16 nVersion;
+    dsTrace >> nMagic >> nVersion;
+    if (nMagic != SERIAL_TRACE_MAGIC || nVersion != SERIAL_TRACE_VERSION)
+    {
+        *pstrError = "not a supported serial trace file";
+        return false;
+    }
+
+    vecRecords.clear();
+    while (!dsTrace.atEnd())
+    {
+        SerialTraceRecord strRecord;
+        dsTrace >> strRecord.nDeltaUs >> strRecord.nType >> strRecord.nValue;
+        if (strRecord.nType == SerialTraceRecordTypeReceive)
+        {
+            strRecord.baData = fpTraceFile.read(strRecord.nValue);
+        }
+        else if (strRecord.nType == SerialTraceRecordTypeTransmit)
+        {
+            strRecord.baData = fpTraceFile.read(qMin(strRecord.nValue, (quint32)SERIAL_TRACE_TRANSMIT_PREFIX_SIZE));
+        }
+
+        if (dsTrace.status() != QDataStream::Ok || (strRecord.nType == SerialTraceRecordTypeReceive && (quint32)strRecord.baData.length() != strRecord.nValue))
+        {
+            *pstrError = "trace file is truncated";
+            return false;
+        }
+        vecRecords.append(strRecord);
+    }
+
+    nPosition = 0;
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceReplayer::SetSpeed(
+    double fNewSpeed
+    )
+{
+    fSpeed = fNewSpeed;
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceReplayer::Start(
+    )
+{
+    //The engine has "opened" the port, replay up to its first write
+    nPosition = 0;
+    bStarted = true;
+    ScheduleNext();
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceReplayer::Transmitted(
+    const QByteArray &baData
+    )
+{
+    //The engine wrote data, match it with the next transmit record of the trace
+    if (bStarted == false)
+    {
+        return;
+    }
+
+    int i = nPosition;
+    while (i < vecRecords.count() && vecRecords.at(i).nType != SerialTraceRecordTypeTransmit)
+    {
+        ++i;
+    }
+
+    if (i == vecRecords.count() || vecRecords.at(i).nValue != (quint32)baData.length() || vecRecords.at(i).baData != baData.left(SERIAL_TRACE_TRANSMIT_PREFIX_SIZE))
+    {
+        //Engine is no longer following the trace
+        bStarted = false;
+        tmrEvent.stop();
+        tmrStall.stop();
+        emit Finished(false, QString("replay diverged at record ").append(QString::number(i)).append(": engine wrote ").append(QString::number(baData.length())).append(" bytes which were not expected"));
+        return;
+    }
+
+    if (i == nPosition)
+    {
+        //Expected write, carry on with the records after it
+        ++nPosition;
+        tmrStall.stop();
+        if (!tmrEvent.isActive())
+        {
+            ScheduleNext();
+        }
+    }
+    else
+    {
+        //Engine wrote earlier than in the recording, drop the record but keep the trace timing intact
+        if (i + 1 < vecRecords.count())
+        {
+            vecRecords[i + 1].nDeltaUs += vecRecords.at(i).nDeltaUs;
+        }
+        vecRecords.remove(i);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+quint32
+SerialTraceReplayer::PinoutSignals(
+    ) const
+{
+    return nPinoutSignals;
+}
+
+//=============================================================================
+//=============================================================================
+qint64
+SerialTraceReplayer::RecordedDurationMs(
+    ) const
+{
+    qint64 nTotalUs = 0;
+    foreach (const SerialTraceRecord &strRecord, vecRecords)
+    {
+        nTotalUs += strRecord.nDeltaUs;
+    }
+
+    return nTotalUs / SERIAL_TRACE_US_PER_MS;
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceReplayer::ScheduleNext(
+    )
+{
+    if (nPosition >= vecRecords.count())
+    {
+        //All records replayed
+        bStarted = false;
+        tmrStall.stop();
+        emit Finished(true, QString("replayed ").append(QString::number(vecRecords.count())).append(" records"));
+    }
+    else if (vecRecords.at(nPosition).nType == SerialTraceRecordTypeTransmit)
+    {
+        //Waiting for the engine to write
+        tmrStall.start(SERIAL_TRACE_STALL_TIMEOUT_MS);
+    }
+    else
+    {
+        tmrEvent.start(fSpeed > 0 ? (int)(vecRecords.at(nPosition).nDeltaUs / fSpeed / SERIAL_TRACE_US_PER_MS) : 0);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceReplayer::EventTimerTimeout(
+    )
+{
+    //Deliver the scheduled record to the engine
+    if (bStarted == false || nPosition >= vecRecords.count())
+    {
+        return;
+    }
+
+    const SerialTraceRecord strRecord = vecRecords.at(nPosition);
+    ++nPosition;
+    if (strRecord.nType == SerialTraceRecordTypeReceive)
+    {
+        emit DataReceived(strRecord.baData);
+    }
+    else if (strRecord.nType == SerialTraceRecordTypeTransmitComplete)
+    {
+        emit BytesWritten(strRecord.nValue);
+    }
+    else if (strRecord.nType == SerialTraceRecordTypePinout)
+    {
+        nPinoutSignals = strRecord.nValue;
+    }
+
+    if (bStarted == true && !tmrEvent.isActive())
+    {
+        ScheduleNext();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+SerialTraceReplayer::StallTimerTimeout(
+    )
+{
+    bStarted = false;
+    emit Finished(false, QString("replay stalled at record ").append(QString::number(nPosition)).append(", engine did not write the expected data"));
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,184 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxSerialTrace.h
+**
+** Notes: Recording and replaying of timestamped serial traffic
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXSERIALTRACE_H
+#define UWXSERIALTRACE_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <QByteArray>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define SERIAL_TRACE_MAGIC                        0x584d5452
+#define SERIAL_TRACE_VERSION                      1
+#define SERIAL_TRACE_TRANSMIT_PREFIX_SIZE         3
+#define SERIAL_TRACE_STALL_TIMEOUT_MS             10000
+#define SERIAL_TRACE_NS_PER_US                    1000
+#define SERIAL_TRACE_US_PER_MS                    1000
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Enum used for the type of trace record
+enum SerialTraceRecordTypes
+{
+    SerialTraceRecordTypeReceive                = 0,
+    SerialTraceRecordTypeTransmit,
+    SerialTraceRecordTypeTransmitComplete,
+    SerialTraceRecordTypePinout
+};
+
+//Single trace record. Received data is stored in full, transmitted data is
+//stored only up to the XModem header as the replayer only needs to match the
+//write sequence. Transmit complete and pinout records carry no data, nValue
+//holds the byte count or signal mask instead.
+typedef struct
+{
+    quint32 nDeltaUs;
+    quint8 nType;
+    quint32 nValue;
+    QByteArray baData;
+} SerialTraceRecord;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class SerialTraceRecorder
+{
+public:
+    bool
+    Open(
+        const QString &strFilename
+        );
+    void
+    Close(
+        );
+    bool
+    IsRecording(
+        ) const;
+    void
+    Record(
+        SerialTraceRecordTypes nType,
+        const QByteArray &baData
+        );
+    void
+    RecordValue(
+        SerialTraceRecordTypes nType,
+        quint32 nValue
+        );
+
+private:
+    void
+    WriteHeader(
+        SerialTraceRecordTypes nType,
+        quint32 nValue
+        );
+
+    QFile fpTraceFile;                              //Trace output file
+    QDataStream dsTrace;                            //Stream used to write records
+    QElapsedTimer etmrTrace;                        //Monotonic timer for record timestamps
+    qint64 nLastRecordNs = 0;                       //Timestamp of the previous record
+};
+
+class SerialTraceReplayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    SerialTraceReplayer(
+        QObject *parent = 0
+        );
+    bool
+    Load(
+        const QString &strFilename,
+        QString *pstrError
+        );
+    void
+    SetSpeed(
+        double fNewSpeed
+        );
+    void
+    Start(
+        );
+    void
+    Transmitted(
+        const QByteArray &baData
+        );
+    quint32
+    PinoutSignals(
+        ) const;
+    qint64
+    RecordedDurationMs(
+        ) const;
+
+signals:
+    void
+    DataReceived(
+        QByteArray baData
+        );
+    void
+    BytesWritten(
+        qint64 intByteCount
+        );
+    void
+    Finished(
+        bool bSuccess,
+        QString strMessage
+        );
+
+private slots:
+    void
+    EventTimerTimeout(
+        );
+    void
+    StallTimerTimeout(
+        );
+
+private:
+    void
+    ScheduleNext(
+        );
+
+    QVector<SerialTraceRecord> vecRecords;          //All records of the loaded trace
+    int nPosition = 0;                              //Index of the next record to be replayed
+    double fSpeed = 1.0;                            //Replay speed multiplier, 0 replays without delays
+    quint32 nPinoutSignals = 0;                     //Most recently replayed pinout signal mask
+    bool bStarted = false;                          //If the replay is running
+    QTimer tmrEvent;                                //Timer for the next scheduled record
+    QTimer tmrStall;                                //Timer that detects when the engine stops following the trace
+};
+
+#endif // UWXSERIALTRACE_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
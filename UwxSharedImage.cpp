@@ -0,0 +1,235 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxSharedImage.cpp
+**
+** Notes: Firmware image published once into shared memory keyed by its
+**        SHA-256, so every engine and every XModemUtil process flashing the
+**        same image maps a single copy instead of buffering its own
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxSharedImage.h"
+#include <QFile>
+#include <QCryptographicHash>
+#include <cstring>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+SharedImage::SharedImage(
+    )
+{
+    static_assert(sizeof(SharedImageHeader) <= SHARED_IMAGE_HEADER_SIZE, "Shared image header does not fit");
+}
+
+//=============================================================================
+//=============================================================================
+SharedImage::~SharedImage(
+    )
+{
+    Close();
+}
+
+//=============================================================================
+//=============================================================================
+bool
+SharedImage::Open(
+    const QString &strFilename,
+    const QString &strSHA256,
+    qint64 nImageSize,
+    QString *pstrError
+    )
+{
+    //Maps the copy another engine or process has published, or publishes one.
+    //The segment is removed once the last user has closed it. Publishing reads
+    //the whole file so this is called from the image verifier's worker thread.
+    Close();
+    smSegment.setKey(QString(strSharedImageKeyPrefix).append(strSHA256.toLower()));
+    if (smSegment.attach(QSharedMemory::ReadOnly))
+    {
+        return Attached(nImageSize, pstrError);
+    }
+    else if (smSegment.create(SHARED_IMAGE_HEADER_SIZE + nImageSize))
+    {
+        return Publish(strFilename, strSHA256, nImageSize, pstrError);
+    }
+    else if (smSegment.error() == QSharedMemory::AlreadyExists && smSegment.attach(QSharedMemory::ReadOnly))
+    {
+        //Another process created it in between
+        return Attached(nImageSize, pstrError);
+    }
+
+    *pstrError = smSegment.errorString();
+    return false;
+}
+
+//=============================================================================
+//=============================================================================
+void
+SharedImage::Close(
+    )
+{
+    if (smSegment.isAttached())
+    {
+        smSegment.detach();
+    }
+    pImage = NULL;
+    nSize = 0;
+    bPublished = false;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+SharedImage::IsOpen(
+    ) const
+{
+    return (pImage != NULL);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+SharedImage::Published(
+    ) const
+{
+    return bPublished;
+}
+
+//=============================================================================
+//=============================================================================
+const uchar *
+SharedImage::Data(
+    ) const
+{
+    return pImage;
+}
+
+//=============================================================================
+//=============================================================================
+qint64
+SharedImage::Size(
+    ) const
+{
+    return nSize;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+SharedImage::Attached(
+    qint64 nImageSize,
+    QString *pstrError
+    )
+{
+    //The publisher holds the lock while copying, so the state is final once the lock is taken.
+    //A segment attached before its publisher took the lock has a zeroed header and is rejected.
+    smSegment.lock();
+    const SharedImageHeader *pHeader = static_cast<const SharedImageHeader *>(smSegment.constData());
+    bool bReady = (smSegment.size() >= SHARED_IMAGE_HEADER_SIZE + nImageSize && memcmp(pHeader->aMagic, aSharedImageMagic, SHARED_IMAGE_MAGIC_SIZE) == 0 && pHeader->nState == SharedImageStateReady && pHeader->nSize == nImageSize);
+    smSegment.unlock();
+
+    if (bReady == false)
+    {
+        //Left behind by a publisher which failed or was killed while copying, or not yet started
+        smSegment.detach();
+        *pstrError = "shared copy is incomplete";
+        return false;
+    }
+
+    pImage = static_cast<const uchar *>(smSegment.constData()) + SHARED_IMAGE_HEADER_SIZE;
+    nSize = nImageSize;
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+SharedImage::Publish(
+    const QString &strFilename,
+    const QString &strSHA256,
+    qint64 nImageSize,
+    QString *pstrError
+    )
+{
+    //Copies the file into the new segment, hashing each chunk as it is copied. The segment
+    //is created zeroed and cannot be locked until it exists, a user which attaches before
+    //the lock is taken here sees no magic and reads from its own file instead. Users which
+    //attach later wait on the lock until the copy is complete.
+    smSegment.lock();
+    SharedImageHeader *pHeader = static_cast<SharedImageHeader *>(smSegment.data());
+    memset(pHeader, 0, SHARED_IMAGE_HEADER_SIZE);
+    memcpy(pHeader->aMagic, aSharedImageMagic, SHARED_IMAGE_MAGIC_SIZE);
+    pHeader->nState = SharedImageStateWriting;
+    pHeader->nSize = nImageSize;
+    uchar *pCopy = static_cast<uchar *>(smSegment.data()) + SHARED_IMAGE_HEADER_SIZE;
+
+    QFile fpFile(strFilename);
+    QCryptographicHash chHash(QCryptographicHash::Sha256);
+    qint64 nCopied = 0;
+    bool bSuccess = false;
+    if (!fpFile.open(QFile::ReadOnly))
+    {
+        *pstrError = fpFile.errorString();
+    }
+    else
+    {
+        qint64 nRead = 0;
+        while (nCopied < nImageSize && (nRead = fpFile.read(reinterpret_cast<char *>(pCopy + nCopied), qMin(nImageSize - nCopied, (qint64)SHARED_IMAGE_COPY_CHUNK_SIZE))) > 0)
+        {
+            chHash.addData(reinterpret_cast<const char *>(pCopy + nCopied), (int)nRead);
+            nCopied += nRead;
+        }
+
+        if (nCopied != nImageSize)
+        {
+            *pstrError = "file is shorter than its expected size";
+        }
+        else if (chHash.result().toHex() != strSHA256.toLower().toLatin1())
+        {
+            //It must not be shared under a hash it does not have
+            *pstrError = "file does not match its SHA-256";
+        }
+        else
+        {
+            bSuccess = true;
+        }
+    }
+    fpFile.close();
+
+    pHeader->nState = (bSuccess == true ? SharedImageStateReady : SharedImageStateFailed);
+    smSegment.unlock();
+
+    if (bSuccess == false)
+    {
+        smSegment.detach();
+        return false;
+    }
+
+    pImage = pCopy;
+    nSize = nImageSize;
+    bPublished = true;
+    return true;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,124 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxSharedImage.h
+**
+** Notes: Firmware image published once into shared memory keyed by its
+**        SHA-256, so every engine and every XModemUtil process flashing the
+**        same image maps a single copy instead of buffering its own
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXSHAREDIMAGE_H
+#define UWXSHAREDIMAGE_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QString>
+#include <QSharedMemory>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define SHARED_IMAGE_HEADER_SIZE                  64
+#define SHARED_IMAGE_MAGIC_SIZE                   8
+#define SHARED_IMAGE_COPY_CHUNK_SIZE              65536
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const QString    strSharedImageKeyPrefix        = QString("XModemUtil-image-");
+const char       aSharedImageMagic[SHARED_IMAGE_MAGIC_SIZE] = {'X', 'M', 'U', 'I', 'M', 'G', '0', '1'};
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Enum used for the state of a shared image segment
+enum SharedImageStates
+{
+    SharedImageStateWriting                     = 0,
+    SharedImageStateReady,
+    SharedImageStateFailed
+};
+
+//Start of every shared image segment, the image follows at SHARED_IMAGE_HEADER_SIZE
+typedef struct
+{
+    char aMagic[SHARED_IMAGE_MAGIC_SIZE];
+    quint32 nState;
+    quint32 nReserved;
+    qint64 nSize;
+} SharedImageHeader;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class SharedImage
+{
+public:
+    SharedImage(
+        );
+    ~SharedImage(
+        );
+    bool
+    Open(
+        const QString &strFilename,
+        const QString &strSHA256,
+        qint64 nImageSize,
+        QString *pstrError
+        );
+    void
+    Close(
+        );
+    bool
+    IsOpen(
+        ) const;
+    bool
+    Published(
+        ) const;
+    const uchar *
+    Data(
+        ) const;
+    qint64
+    Size(
+        ) const;
+
+private:
+    bool
+    Attached(
+        qint64 nImageSize,
+        QString *pstrError
+        );
+    bool
+    Publish(
+        const QString &strFilename,
+        const QString &strSHA256,
+        qint64 nImageSize,
+        QString *pstrError
+        );
+
+    QSharedMemory smSegment;                        //Shared memory segment holding the header and image
+    const uchar *pImage = NULL;                     //Start of the image in the segment, NULL if not open
+    qint64 nSize = 0;                               //Size of the image
+    bool bPublished = false;                        //If this instance copied the image into the segment
+};
+
+#endif // UWXSHAREDIMAGE_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
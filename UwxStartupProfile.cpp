@@ -0,0 +1,159 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxStartupProfile.cpp
+**
+** Notes: Records how long each phase of application startup takes, up to
+**        the first frame of the main window, and checks the total against
+**        the cold start budget
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxStartupProfile.h"
+#include <QElapsedTimer>
+#include <QString>
+#include <cstdlib>
+#ifdef Q_OS_LINUX
+#include <QFile>
+#include <unistd.h>
+#endif
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Time from main() to the end of one phase
+typedef struct
+{
+    const char *pPhase;
+    qint64 nNs;
+} StartupPhaseStruct;
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static QElapsedTimer etmrStartup;
+static StartupPhaseStruct aStartupPhases[STARTUP_PROFILE_MAX_PHASES];
+static int nStartupPhases = 0;
+static qint64 nStartupPreMainMs = -1;
+
+//=============================================================================
+//=============================================================================
+static qint64
+PreMainMs(
+    )
+{
+    //Process creation to main(), which covers loading the Qt libraries. Only
+    //known on Linux, to the resolution of the kernel's clock tick.
+#ifdef Q_OS_LINUX
+    QFile fpStat("/proc/self/stat");
+    QFile fpUptime("/proc/uptime");
+    if (!fpStat.open(QFile::ReadOnly) || !fpUptime.open(QFile::ReadOnly))
+    {
+        return -1;
+    }
+
+    //The process name may contain spaces, the fields are counted from after it (starttime is field 22)
+    QByteArray baStat = fpStat.readAll();
+    QList<QByteArray> lstFields = baStat.mid(baStat.lastIndexOf(')') + 2).split(' ');
+    double fUptimeS = fpUptime.readAll().split(' ').at(0).toDouble();
+    if (lstFields.count() < 20 || sysconf(_SC_CLK_TCK) <= 0)
+    {
+        return -1;
+    }
+
+    return qMax((qint64)(fUptimeS * 1000.0) - lstFields.at(19).toLongLong() * 1000 / sysconf(_SC_CLK_TCK), (qint64)0);
+#else
+    return -1;
+#endif
+}
+
+//=============================================================================
+//=============================================================================
+void
+StartupProfile::Begin(
+    )
+{
+    //Called first thing in main()
+    etmrStartup.start();
+    nStartupPreMainMs = PreMainMs();
+    nStartupPhases = 0;
+}
+
+//=============================================================================
+//=============================================================================
+void
+StartupProfile::Mark(
+    const char *pPhase
+    )
+{
+    if (etmrStartup.isValid() && nStartupPhases < STARTUP_PROFILE_MAX_PHASES)
+    {
+        aStartupPhases[nStartupPhases].pPhase = pPhase;
+        aStartupPhases[nStartupPhases].nNs = etmrStartup.nsecsElapsed();
+        ++nStartupPhases;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+int
+StartupProfile::Report(
+    QTextStream &tsOutput,
+    qint64 nBudgetMs
+    )
+{
+    //Each phase with its own duration and the time since main(), fails if the first frame was late
+    int nPhaseWidth = QString("Process start to main()").length();
+    int i = 0;
+    while (i < nStartupPhases)
+    {
+        nPhaseWidth = qMax(nPhaseWidth, QString(aStartupPhases[i].pPhase).length());
+        ++i;
+    }
+
+    tsOutput << QString("Phase").leftJustified(nPhaseWidth + 2) << QString("Step").leftJustified(12) << "Since main()\n";
+    if (nStartupPreMainMs >= 0)
+    {
+        tsOutput << QString("Process start to main()").leftJustified(nPhaseWidth + 2) << QString::number(nStartupPreMainMs).append(" ms").leftJustified(12) << "-\n";
+    }
+
+    qint64 nPreviousNs = 0;
+    i = 0;
+    while (i < nStartupPhases)
+    {
+        tsOutput << QString(aStartupPhases[i].pPhase).leftJustified(nPhaseWidth + 2)
+                 << QString::number((aStartupPhases[i].nNs - nPreviousNs) / STARTUP_PROFILE_NS_PER_MS, 'f', 1).append(" ms").leftJustified(12)
+                 << QString::number(aStartupPhases[i].nNs / STARTUP_PROFILE_NS_PER_MS, 'f', 1) << " ms\n";
+        nPreviousNs = aStartupPhases[i].nNs;
+        ++i;
+    }
+
+    double fTotalMs = nPreviousNs / STARTUP_PROFILE_NS_PER_MS + (nStartupPreMainMs > 0 ? nStartupPreMainMs : 0);
+    bool bWithinBudget = (fTotalMs <= nBudgetMs);
+    tsOutput << "Cold start: " << QString::number(fTotalMs, 'f', 1) << " ms" << (nStartupPreMainMs >= 0 ? "" : " (from main())") << ", budget " << nBudgetMs << " ms, "
+             << (bWithinBudget == true ? "within budget" : "OVER BUDGET") << "\n";
+    tsOutput.flush();
+
+    return (bWithinBudget == true ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
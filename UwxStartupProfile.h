@@ -0,0 +1,66 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxStartupProfile.h
+**
+** Notes: Records how long each phase of application startup takes, up to
+**        the first frame of the main window, and checks the total against
+**        the cold start budget
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXSTARTUPPROFILE_H
+#define UWXSTARTUPPROFILE_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QTextStream>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define STARTUP_PROFILE_BUDGET_MS                 150
+#define STARTUP_PROFILE_MAX_PHASES                32
+#define STARTUP_PROFILE_NS_PER_MS                 1000000.0
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+//Phases are recorded from the main thread only, marking one is a clock read
+//so they are always recorded and only reported when asked for
+class StartupProfile
+{
+public:
+    static void
+    Begin(
+        );
+    static void
+    Mark(
+        const char *pPhase
+        );
+    static int
+    Report(
+        QTextStream &tsOutput,
+        qint64 nBudgetMs
+        );
+};
+
+#endif // UWXSTARTUPPROFILE_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,370 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxStressTest.cpp
+**
+** Notes: Runs many concurrent firmware upgrades in one process against
+**        simulated HL7800 modules on pseudo terminals, then reports how the
+**        transfer engine scaled. Only available on unix-like systems.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxStressTest.h"
+#include "UwxMainWindow.h"
+#include "UwxRealtimeProfile.h"
+#include <QTemporaryDir>
+#include <QFile>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <algorithm>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+static qint64
+ProcessCpuNs(
+    )
+{
+    //User and system time used by the whole process
+    struct rusage ruUsage;
+    if (getrusage(RUSAGE_SELF, &ruUsage) != 0)
+    {
+        return 0;
+    }
+
+    return ((qint64)ruUsage.ru_utime.tv_sec + ruUsage.ru_stime.tv_sec) * 1000000000LL + ((qint64)ruUsage.ru_utime.tv_usec + ruUsage.ru_stime.tv_usec) * 1000LL;
+}
+
+//=============================================================================
+//=============================================================================
+static qint64
+ProcessRSSKiB(
+    )
+{
+    //Current resident set size, falls back to the peak where /proc is not available
+    QFile fileStatm("/proc/self/statm");
+    if (fileStatm.open(QFile::ReadOnly))
+    {
+        QList<QByteArray> lstFields = fileStatm.readAll().split(' ');
+        if (lstFields.count() > 1)
+        {
+            return lstFields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) / 1024;
+        }
+    }
+
+    struct rusage ruUsage;
+    getrusage(RUSAGE_SELF, &ruUsage);
+#ifdef Q_OS_MAC
+    return ruUsage.ru_maxrss / 1024;
+#else
+    return ruUsage.ru_maxrss;
+#endif
+}
+
+//=============================================================================
+//=============================================================================
+static qint64
+Percentile(
+    QVector<qint64> vecValues,
+    double fFraction
+    )
+{
+    //Nearest-rank percentile
+    if (vecValues.isEmpty())
+    {
+        return 0;
+    }
+
+    std::sort(vecValues.begin(), vecValues.end());
+    int nIndex = qBound(0, (int)(fFraction * vecValues.count() + 0.5) - 1, vecValues.count() - 1);
+    return vecValues.at(nIndex);
+}
+
+//=============================================================================
+//=============================================================================
+static QString
+FormatMs(
+    qint64 nValueNs
+    )
+{
+    return QString::number((double)nValueNs / STRESS_NS_PER_MS, 'f', 2).append(" ms");
+}
+
+//=============================================================================
+//=============================================================================
+StressTest::StressTest(QObject *parent) :
+    QObject(parent)
+{
+}
+
+//=============================================================================
+//=============================================================================
+StressTest::~StressTest(
+    )
+{
+    Cleanup();
+}
+
+//=============================================================================
+//=============================================================================
+int
+StressTest::Run(
+    QTextStream &tsOutput,
+    int nSessions,
+    qint64 nImageSize,
+    quint32 nSeed,
+    double fByteErrorProbability,
+    bool bAdaptiveBlockSize
+    )
+{
+    //Upgrades every simulated module at once from a single event loop
+    nSessions = qBound(1, nSessions, STRESS_MAX_SESSIONS);
+    nImageSize = qMax(nImageSize, (qint64)IMAGE_MINIMUM_SIZE);
+    fByteErrors = qBound(0.0, fByteErrorProbability, 1.0);
+    bAdaptiveBlocks = bAdaptiveBlockSize;
+
+    QTemporaryDir tdImage;
+    QString strImage = tdImage.filePath(strStressImageFilename);
+    QByteArray baImage(nImageSize, 0);
+    uint32_t nImageSeed = nSeed;
+    qint64 i = 0;
+    while (i < baImage.size())
+    {
+        nImageSeed = nImageSeed * 1103515245 + 12345;
+        baImage[(int)i] = (char)(nImageSeed >> 16);
+        ++i;
+    }
+
+    QFile fileImage(strImage);
+    if (!tdImage.isValid() || !fileImage.open(QFile::WriteOnly) || fileImage.write(baImage) != baImage.length())
+    {
+        tsOutput << "Stress test: unable to create firmware image " << strImage << "\n";
+        tsOutput.flush();
+        return EXIT_FAILURE;
+    }
+    fileImage.close();
+    QByteArray baImageSHA256 = QCryptographicHash::hash(baImage, QCryptographicHash::Sha256);
+    baImage.clear();
+
+    PtySimulatorImpairments psiImpairments;
+    psiImpairments.nMinLatencyMs = STRESS_MIN_LATENCY_MS;
+    psiImpairments.nMaxLatencyMs = STRESS_MAX_LATENCY_MS;
+    psiImpairments.fNackProbability = STRESS_NACK_PROBABILITY;
+    psiImpairments.fDropAckProbability = STRESS_DROP_ACK_PROBABILITY;
+    psiImpairments.fByteErrorProbability = fByteErrors;
+
+    qint64 nRSSBeforeKiB = ProcessRSSKiB();
+    qint64 nCpuBeforeNs = ProcessCpuNs();
+    QElapsedTimer etmrRun;
+    etmrRun.start();
+
+    vecSessions.reserve(nSessions);
+    nSessionsRunning = 0;
+    int nSession = 0;
+    while (nSession < nSessions)
+    {
+        StressSession ssSession;
+        ssSession.psSimulator = new PtySimulator();
+        ssSession.pEngine = NULL;
+        ssSession.bFinished = true;
+        ssSession.bSuccess = false;
+        vecSessions.append(ssSession);
+        StressSession &ssAdded = vecSessions.last();
+
+        QString strError;
+        if (!ssAdded.psSimulator->Open(&strError))
+        {
+            ssAdded.strMessage = strError;
+            ++nSession;
+            continue;
+        }
+        ssAdded.psSimulator->StartModem(strStressModemVersion, strStressUpgradedVersion, psiImpairments, nSeed + nSession);
+
+        ssAdded.pEngine = new MainWindow();
+        ssAdded.pEngine->SetNonInteractive(true);
+        ssAdded.pEngine->SetAdaptiveBlockSize(bAdaptiveBlocks);
+        connect(ssAdded.pEngine, SIGNAL(SessionFinished(bool,QString)), this, SLOT(EngineFinished(bool,QString)));
+        if (!ssAdded.pEngine->StartFirmwareJob(ssAdded.psSimulator->PortName(), STRESS_BAUD_RATE, ComboBaudRateHandshakingNone, strImage, true, &strError))
+        {
+            ssAdded.strMessage = strError;
+            ++nSession;
+            continue;
+        }
+
+        ssAdded.bFinished = false;
+        ++nSessionsRunning;
+        ++nSession;
+    }
+
+    if (nSessionsRunning > 0)
+    {
+        QTimer::singleShot(STRESS_TIMEOUT_MS, &elWait, SLOT(quit()));
+        elWait.exec();
+    }
+
+    qint64 nWallNs = etmrRun.nsecsElapsed();
+    qint64 nCpuNs = ProcessCpuNs() - nCpuBeforeNs;
+    qint64 nRSSGrowthKiB = ProcessRSSKiB() - nRSSBeforeKiB;
+    Report(tsOutput, baImageSHA256, nWallNs, nCpuNs, nRSSGrowthKiB);
+
+    bool bAllPassed = true;
+    foreach (const StressSession &ssSession, vecSessions)
+    {
+        if (ssSession.bSuccess == false || ssSession.psSimulator->ReceivedSHA256() != baImageSHA256)
+        {
+            bAllPassed = false;
+        }
+    }
+    Cleanup();
+
+    return (bAllPassed ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+//=============================================================================
+//=============================================================================
+void
+StressTest::EngineFinished(
+    bool bSuccess,
+    QString strMessage
+    )
+{
+    MainWindow *pEngine = qobject_cast<MainWindow *>(sender());
+    int i = 0;
+    while (i < vecSessions.count())
+    {
+        if (vecSessions.at(i).pEngine == pEngine && vecSessions.at(i).bFinished == false)
+        {
+            vecSessions[i].bFinished = true;
+            vecSessions[i].bSuccess = bSuccess;
+            vecSessions[i].strMessage = strMessage;
+            --nSessionsRunning;
+            break;
+        }
+        ++i;
+    }
+
+    if (nSessionsRunning == 0)
+    {
+        elWait.quit();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void
+StressTest::Report(
+    QTextStream &tsOutput,
+    const QByteArray &baImageSHA256,
+    qint64 nWallNs,
+    qint64 nCpuNs,
+    qint64 nRSSGrowthKiB
+    )
+{
+    //Aggregate figures, then the spread of the per-session block latency percentiles
+    int nPassed = 0;
+    qint64 nBytes = 0;
+    qint64 nNacks = 0;
+    qint64 nDroppedAcks = 0;
+    qint64 nBlocks = 0;
+    qint64 nSmallBlocks = 0;
+    QVector<qint64> vecSessionP50Ns;
+    QVector<qint64> vecSessionP99Ns;
+    foreach (const StressSession &ssSession, vecSessions)
+    {
+        const PtySimulatorModemStats &pmsStats = ssSession.psSimulator->ModemStats();
+        nBytes += pmsStats.nBytes;
+        nNacks += pmsStats.nNacks;
+        nDroppedAcks += pmsStats.nDroppedAcks;
+        nBlocks += pmsStats.nBlocks;
+        nSmallBlocks += pmsStats.nSmallBlocks;
+        if (ssSession.bSuccess == true && ssSession.psSimulator->ReceivedSHA256() == baImageSHA256)
+        {
+            ++nPassed;
+        }
+        if (!ssSession.psSimulator->BlockCycleTimes().isEmpty())
+        {
+            vecSessionP50Ns.append(Percentile(ssSession.psSimulator->BlockCycleTimes(), STRESS_PERCENTILE_50));
+            vecSessionP99Ns.append(Percentile(ssSession.psSimulator->BlockCycleTimes(), STRESS_PERCENTILE_99));
+        }
+    }
+
+    int nSessions = vecSessions.count();
+    tsOutput << "Stress test: " << nSessions << " concurrent sessions over pseudo terminals, simulated HL7800 latency "
+             << STRESS_MIN_LATENCY_MS << "-" << STRESS_MAX_LATENCY_MS << " ms, NACK probability " << STRESS_NACK_PROBABILITY
+             << ", dropped ACK probability " << STRESS_DROP_ACK_PROBABILITY << ", byte error probability " << fByteErrors << "\n";
+    tsOutput << "  Real-time profile: " << RealtimeProfile::Summary() << "\n";
+    tsOutput << "  Sessions: " << nPassed << " passed, " << (nSessions - nPassed) << " failed\n";
+    tsOutput << "  Wall time: " << FormatMs(nWallNs) << "\n";
+    tsOutput << "  Aggregate throughput: " << QString::number((double)nBytes * STRESS_NS_PER_S / qMax(nWallNs, (qint64)1) / STRESS_BYTES_PER_KIB, 'f', 1) << " KiB/s ("
+             << QString::number((double)nBytes * STRESS_NS_PER_S / qMax(nWallNs, (qint64)1) / STRESS_BYTES_PER_KIB / nSessions, 'f', 1) << " KiB/s per session)\n";
+    tsOutput << "  Injected faults: " << nNacks << " NACKs, " << nDroppedAcks << " dropped ACKs\n";
+    tsOutput << "  Block size: " << (bAdaptiveBlocks == true ? "adaptive" : "fixed 1K") << ", " << nSmallBlocks << " of " << nBlocks << " blocks received as 128 bytes\n";
+    if (!vecSessionP50Ns.isEmpty())
+    {
+        tsOutput << "  Block latency (ACK to ACK) per-session p50: median " << FormatMs(Percentile(vecSessionP50Ns, STRESS_PERCENTILE_50)) << ", worst " << FormatMs(Percentile(vecSessionP50Ns, STRESS_PERCENTILE_100)) << "\n";
+        tsOutput << "  Block latency (ACK to ACK) per-session p99: median " << FormatMs(Percentile(vecSessionP99Ns, STRESS_PERCENTILE_50)) << ", worst " << FormatMs(Percentile(vecSessionP99Ns, STRESS_PERCENTILE_100)) << "\n";
+    }
+    tsOutput << "  CPU (engines and simulators): " << FormatMs(nCpuNs) << " total, " << FormatMs(nCpuNs / nSessions) << " per session ("
+             << QString::number((double)nCpuNs * 100.0 / nSessions / qMax(nWallNs, (qint64)1), 'f', 2) << "% of a core)\n";
+    tsOutput << "  RSS growth: " << nRSSGrowthKiB << " KiB total, " << nRSSGrowthKiB / nSessions << " KiB per session\n";
+
+    int i = 0;
+    while (i < nSessions)
+    {
+        const StressSession &ssSession = vecSessions.at(i);
+        if (ssSession.bSuccess == false || ssSession.psSimulator->ReceivedSHA256() != baImageSHA256)
+        {
+            tsOutput << "  Session " << i << " (" << ssSession.psSimulator->PortName() << ") failed: "
+                     << (ssSession.bFinished == false ? QString("did not finish") : (ssSession.bSuccess == true ? QString("received data does not match") : ssSession.strMessage)) << "\n";
+        }
+        ++i;
+    }
+    tsOutput.flush();
+}
+
+//=============================================================================
+//=============================================================================
+void
+StressTest::Cleanup(
+    )
+{
+    //Engines are removed first as their serial ports are open on the simulators
+    foreach (const StressSession &ssSession, vecSessions)
+    {
+        if (ssSession.pEngine != NULL)
+        {
+            disconnect(ssSession.pEngine, SIGNAL(SessionFinished(bool,QString)), this, SLOT(EngineFinished(bool,QString)));
+            delete ssSession.pEngine;
+        }
+    }
+    foreach (const StressSession &ssSession, vecSessions)
+    {
+        delete ssSession.psSimulator;
+    }
+    vecSessions.clear();
+    nSessionsRunning = 0;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,133 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxStressTest.h
+**
+** Notes: Runs many concurrent firmware upgrades in one process against
+**        simulated HL7800 modules on pseudo terminals, then reports how the
+**        transfer engine scaled. Only available on unix-like systems.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXSTRESSTEST_H
+#define UWXSTRESSTEST_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QTextStream>
+#include <QEventLoop>
+#include <QVector>
+#include "UwxPtySimulator.h"
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define STRESS_MAX_SESSIONS                       256
+#define STRESS_DEFAULT_IMAGE_SIZE                 (256 * 1024)
+#define STRESS_DEFAULT_SEED                       0x584d
+#define STRESS_TIMEOUT_MS                         600000
+#define STRESS_BAUD_RATE                          115200
+#define STRESS_MIN_LATENCY_MS                     0
+#define STRESS_MAX_LATENCY_MS                     5
+#define STRESS_NACK_PROBABILITY                   0.01
+#define STRESS_DROP_ACK_PROBABILITY               0.002
+#define STRESS_NS_PER_MS                          1000000.0
+#define STRESS_NS_PER_S                           1000000000.0
+#define STRESS_BYTES_PER_KIB                      1024.0
+#define STRESS_PERCENTILE_50                      0.50
+#define STRESS_PERCENTILE_99                      0.99
+#define STRESS_PERCENTILE_100                     1.0
+
+/******************************************************************************/
+// Constants
+/******************************************************************************/
+const QString    strStressModemVersion          = QString("4.4.14.0");
+const QString    strStressUpgradedVersion       = QString("4.4.14.99");
+const QString    strStressImageFilename         = QString("4.4.14.0_to_4.4.14.99.ua");
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+class MainWindow;
+
+//One simulated module and the engine upgrading it
+typedef struct
+{
+    PtySimulator *psSimulator;
+    MainWindow *pEngine;
+    bool bFinished;
+    bool bSuccess;
+    QString strMessage;
+} StressSession;
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class StressTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    StressTest(
+        QObject *parent = 0
+        );
+    ~StressTest(
+        );
+    int
+    Run(
+        QTextStream &tsOutput,
+        int nSessions,
+        qint64 nImageSize,
+        quint32 nSeed,
+        double fByteErrorProbability,
+        bool bAdaptiveBlockSize
+        );
+
+private slots:
+    void
+    EngineFinished(
+        bool bSuccess,
+        QString strMessage
+        );
+
+private:
+    void
+    Report(
+        QTextStream &tsOutput,
+        const QByteArray &baImageSHA256,
+        qint64 nWallNs,
+        qint64 nCpuNs,
+        qint64 nRSSGrowthKiB
+        );
+    void
+    Cleanup(
+        );
+
+    QVector<StressSession> vecSessions;             //All sessions, index is the session number
+    int nSessionsRunning = 0;                       //Sessions which have not finished yet
+    QEventLoop elWait;                              //Runs until every session has finished
+    double fByteErrors = 0.0;                       //Probability of each byte of a block being corrupted
+    bool bAdaptiveBlocks = true;                    //If the engines may fall back to 128 byte blocks
+};
+
+#endif // UWXSTRESSTEST_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
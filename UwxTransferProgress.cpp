@@ -0,0 +1,148 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxTransferProgress.cpp
+**
+** Notes: Transfer progress shared between the transfer engine and the GUI
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxTransferProgress.h"
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+void
+TransferProgress::Begin(
+    qint64 nTotal
+    )
+{
+    nTotalBytes.store(nTotal, std::memory_order_relaxed);
+    nBytesDone.store(0, std::memory_order_relaxed);
+    nRateSampleBytes = 0;
+    fBytesPerSecond = 0;
+    etmrRate.start();
+}
+
+//=============================================================================
+//=============================================================================
+void
+TransferProgress::Update(
+    qint64 nDone
+    )
+{
+    nBytesDone.store(nDone, std::memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+void
+TransferProgress::Sample(
+    )
+{
+    //Updates the smoothed rate once per rate window, frames in between reuse the previous value
+    if (!etmrRate.isValid() || etmrRate.elapsed() < PROGRESS_RATE_WINDOW_MS)
+    {
+        return;
+    }
+
+    qint64 nDone = BytesDone();
+    double fInstant = (double)(nDone - nRateSampleBytes) * PROGRESS_MS_PER_SECOND / etmrRate.restart();
+    fBytesPerSecond = (fBytesPerSecond == 0 ? fInstant : (PROGRESS_RATE_SMOOTHING * fInstant) + ((1.0 - PROGRESS_RATE_SMOOTHING) * fBytesPerSecond));
+    nRateSampleBytes = nDone;
+}
+
+//=============================================================================
+//=============================================================================
+qint64
+TransferProgress::BytesDone(
+    ) const
+{
+    return nBytesDone.load(std::memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+qint64
+TransferProgress::TotalBytes(
+    ) const
+{
+    return nTotalBytes.load(std::memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+int
+TransferProgress::Percent(
+    ) const
+{
+    qint64 nTotal = TotalBytes();
+    if (nTotal <= 0)
+    {
+        return 0;
+    }
+
+    return (int)qMin((qint64)PROGRESS_PERCENT_100, (BytesDone() * PROGRESS_PERCENT_100) / nTotal);
+}
+
+//=============================================================================
+//=============================================================================
+double
+TransferProgress::BytesPerSecond(
+    ) const
+{
+    return fBytesPerSecond;
+}
+
+//=============================================================================
+//=============================================================================
+qint64
+TransferProgress::EtaMs(
+    ) const
+{
+    if (fBytesPerSecond <= 0)
+    {
+        return PROGRESS_ETA_UNKNOWN;
+    }
+
+    return (qint64)((TotalBytes() - BytesDone()) * PROGRESS_MS_PER_SECOND / fBytesPerSecond);
+}
+
+//=============================================================================
+//=============================================================================
+QString
+TransferProgress::Summary(
+    ) const
+{
+    //Text for the progress bar, e.g. "42% - 11.2 KiB/s, 1:05 remaining"
+    QString strSummary = QString::number(Percent()).append("%");
+    if (fBytesPerSecond > 0)
+    {
+        qint64 nEtaSeconds = EtaMs() / PROGRESS_MS_PER_SECOND;
+        strSummary.append(" - ").append(QString::number(fBytesPerSecond / 1024, 'f', 1)).append(" KiB/s, ")
+                  .append(QString::number(nEtaSeconds / 60)).append(":").append(QString::number(nEtaSeconds % 60).rightJustified(2, '0')).append(" remaining");
+    }
+
+    return strSummary;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
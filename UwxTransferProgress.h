@@ -0,0 +1,94 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxTransferProgress.h
+**
+** Notes: Transfer progress shared between the transfer engine and the GUI
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXTRANSFERPROGRESS_H
+#define UWXTRANSFERPROGRESS_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QElapsedTimer>
+#include <QString>
+#include <atomic>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define PROGRESS_FRAME_INTERVAL_MS                33
+#define PROGRESS_RATE_WINDOW_MS                   250
+#define PROGRESS_RATE_SMOOTHING                   0.3
+#define PROGRESS_PERCENT_100                      100
+#define PROGRESS_MS_PER_SECOND                    1000
+#define PROGRESS_ETA_UNKNOWN                      -1
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+//The engine side (Begin/Update) only performs relaxed atomic stores so it can
+//be called on every block from any thread. The GUI side (Sample and the
+//getters) is called at a fixed frame rate and does all of the arithmetic.
+class TransferProgress
+{
+public:
+    void
+    Begin(
+        qint64 nTotal
+        );
+    void
+    Update(
+        qint64 nDone
+        );
+    void
+    Sample(
+        );
+    qint64
+    BytesDone(
+        ) const;
+    qint64
+    TotalBytes(
+        ) const;
+    int
+    Percent(
+        ) const;
+    double
+    BytesPerSecond(
+        ) const;
+    qint64
+    EtaMs(
+        ) const;
+    QString
+    Summary(
+        ) const;
+
+private:
+    std::atomic<qint64> nBytesDone{0};              //Bytes acknowledged by the receiver (engine writes)
+    std::atomic<qint64> nTotalBytes{0};             //Total bytes to transfer (engine writes)
+    QElapsedTimer etmrRate;                         //Time since the last rate sample (GUI only)
+    qint64 nRateSampleBytes = 0;                    //Bytes done at the last rate sample (GUI only)
+    double fBytesPerSecond = 0;                     //Smoothed transfer rate (GUI only)
+};
+
+#endif // UWXTRANSFERPROGRESS_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,92 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxUpgradePlanner.cpp
+**
+** Notes: Plans multi-step upgrade paths over the firmware catalog
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxUpgradePlanner.h"
+#include <QHash>
+#include <QQueue>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+bool
+UpgradePlanner::PlanPath(
+    const FirmwareCatalog &fcCatalog,
+    const QString &strFromVersion,
+    const QString &strToVersion,
+    QList<int> *plstPath
+    )
+{
+    //Breadth-first search over versions (nodes) and catalog entries (edges).
+    //Every step costs one full transfer and modem restart so the plan with
+    //the fewest steps is the cheapest one.
+    QHash<QString, int> hashReachedBy;
+    QQueue<QString> qVersions;
+
+    plstPath->clear();
+    if (strFromVersion == strToVersion)
+    {
+        //Nothing to do
+        return true;
+    }
+
+    hashReachedBy.insert(strFromVersion, FIRMWARE_CATALOG_INDEX_NOT_FOUND);
+    qVersions.enqueue(strFromVersion);
+
+    while (!qVersions.isEmpty() && !hashReachedBy.contains(strToVersion))
+    {
+        QString strVersion = qVersions.dequeue();
+        foreach (int nIndex, fcCatalog.IndexesFromVersion(strVersion))
+        {
+            const FirmwareListStruct *pEntry = fcCatalog.At(nIndex);
+            if (!hashReachedBy.contains(pEntry->strToVersion))
+            {
+                hashReachedBy.insert(pEntry->strToVersion, nIndex);
+                qVersions.enqueue(pEntry->strToVersion);
+            }
+        }
+    }
+
+    if (!hashReachedBy.contains(strToVersion))
+    {
+        //No upgrade path exists
+        return false;
+    }
+
+    //Walk back from the target to the source version
+    QString strVersion = strToVersion;
+    while (strVersion != strFromVersion)
+    {
+        int nIndex = hashReachedBy.value(strVersion);
+        plstPath->prepend(nIndex);
+        strVersion = fcCatalog.At(nIndex)->strFromVersion;
+    }
+
+    return true;
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,52 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxUpgradePlanner.h
+**
+** Notes: Plans multi-step upgrade paths over the firmware catalog
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXUPGRADEPLANNER_H
+#define UWXUPGRADEPLANNER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QList>
+#include <QString>
+#include "UwxFirmwareCatalog.h"
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class UpgradePlanner
+{
+public:
+    static bool
+    PlanPath(
+        const FirmwareCatalog &fcCatalog,
+        const QString &strFromVersion,
+        const QString &strToVersion,
+        QList<int> *plstPath
+        );
+};
+
+#endif // UWXUPGRADEPLANNER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
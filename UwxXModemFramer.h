@@ -0,0 +1,273 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxXModemFramer.h
+**
+** Notes: Compile-time specialised XModem packet framing. Block size and
+**        integrity type are template parameters so the packet geometry is
+**        known at compile time, packets are built in fixed size buffers and
+**        the whole framing path can be inlined.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXXMODEMFRAMER_H
+#define UWXXMODEMFRAMER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define XMODEM_INVERSE                            0xff
+#define XMODEM_128_BLOCK_SIZE                     128
+#define XMODEM_1K_BLOCK_SIZE                      1024
+#define XMODEM_CRC16_POLYNOMIAL                   0x1021
+#define XMODEM_CRC16_TABLE_SIZE                   256
+
+/******************************************************************************/
+// Forward declaration of Class, Struct & Unions
+/******************************************************************************/
+//Enum used for type of XModem packet
+enum XModemPacketTypes
+{
+    XModemPacketType128BytePacket               = 0x01,
+    XModemPacketType1024BytePacket              = 0x02,
+    XModemPacketTypeEndOfFrame                  = 0x04,
+    XModemPacketTypeAck                         = 0x06,
+    XModemPacketTypeNack                        = 0x15,
+    XModemPacketTypeCancel                      = 0x18,
+    XModemPacketTypeCRCRequest                  = 0x43
+};
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+//8-bit arithmetic sum of the data (original XModem checksum, also used by the
+//HL7800 with 1K blocks)
+struct XModemChecksumSum8
+{
+    static constexpr size_t Size = 1;
+
+    static inline uint8_t
+    Calculate(
+        const uint8_t *pData,
+        size_t nSize
+        )
+    {
+        //Accumulate in a wide register so the loop vectorises, only the low byte is kept
+        uint32_t nSum = 0;
+        size_t i = 0;
+        while (i < nSize)
+        {
+            nSum += pData[i];
+            ++i;
+        }
+
+        return (uint8_t)nSum;
+    }
+
+    static inline void
+    Append(
+        uint8_t *pOut,
+        const uint8_t *pData,
+        size_t nSize
+        )
+    {
+        pOut[0] = Calculate(pData, nSize);
+    }
+};
+
+//Lookup table for CRC-16/XMODEM, generated at compile time
+struct XModemCRC16Table
+{
+    uint16_t aTable[XMODEM_CRC16_TABLE_SIZE];
+
+    constexpr
+    XModemCRC16Table(
+        ) : aTable()
+    {
+        for (uint32_t i = 0; i < XMODEM_CRC16_TABLE_SIZE; ++i)
+        {
+            uint16_t nCRC = (uint16_t)(i << 8);
+            for (int j = 0; j < 8; ++j)
+            {
+                nCRC = (nCRC & 0x8000) ? (uint16_t)((nCRC << 1) ^ XMODEM_CRC16_POLYNOMIAL) : (uint16_t)(nCRC << 1);
+            }
+            aTable[i] = nCRC;
+        }
+    }
+};
+
+inline constexpr XModemCRC16Table ctXModemCRC16Table{};
+
+//CRC-16/XMODEM (polynomial 0x1021, initial value 0), transmitted big-endian
+struct XModemChecksumCRC16
+{
+    static constexpr size_t Size = 2;
+
+    static inline uint16_t
+    Calculate(
+        const uint8_t *pData,
+        size_t nSize
+        )
+    {
+        uint16_t nCRC = 0;
+        size_t i = 0;
+        while (i < nSize)
+        {
+            nCRC = (uint16_t)((nCRC << 8) ^ ctXModemCRC16Table.aTable[((nCRC >> 8) ^ pData[i]) & 0xff]);
+            ++i;
+        }
+
+        return nCRC;
+    }
+
+    static inline void
+    Append(
+        uint8_t *pOut,
+        const uint8_t *pData,
+        size_t nSize
+        )
+    {
+        uint16_t nCRC = Calculate(pData, nSize);
+        pOut[0] = (uint8_t)(nCRC >> 8);
+        pOut[1] = (uint8_t)(nCRC & 0xff);
+    }
+};
+
+//Packet framer for one block size and integrity type. Packets are laid out
+//as: start byte, packet number, inverse packet number, data, checksum.
+template <size_t BlockSize, class Checksum>
+class XModemFramer
+{
+    static_assert(BlockSize == XMODEM_128_BLOCK_SIZE || BlockSize == XMODEM_1K_BLOCK_SIZE, "XModem block size must be 128 or 1024 bytes");
+
+public:
+    static constexpr size_t DataSize = BlockSize;
+    static constexpr size_t HeaderSize = 3;
+    static constexpr size_t ChecksumSize = Checksum::Size;
+    static constexpr size_t PacketSize = HeaderSize + DataSize + ChecksumSize;
+    static constexpr uint8_t StartByte = (BlockSize == XMODEM_1K_BLOCK_SIZE ? XModemPacketType1024BytePacket : XModemPacketType128BytePacket);
+
+    typedef std::array<uint8_t, PacketSize> Packet;
+
+    //Returns where the data of a packet is to be placed, so it can be read
+    //straight into the packet buffer without an intermediate copy
+    static inline uint8_t *
+    Payload(
+        Packet &aPacket
+        )
+    {
+        return aPacket.data() + HeaderSize;
+    }
+
+    //Completes a packet whose first nDataSize payload bytes are already in
+    //place: pads the remainder of the block and fills in header and checksum
+    static inline void
+    FrameInPlace(
+        Packet &aPacket,
+        uint8_t nPacketNumber,
+        size_t nDataSize,
+        uint8_t nPadding
+        )
+    {
+        FrameInPlace(aPacket.data(), nPacketNumber, nDataSize, nPadding);
+    }
+
+    //As above for a packet held in a larger buffer (of at least PacketSize
+    //bytes), so one buffer can carry either block size
+    static inline void
+    FrameInPlace(
+        uint8_t *pPacket,
+        uint8_t nPacketNumber,
+        size_t nDataSize,
+        uint8_t nPadding
+        )
+    {
+        if (nDataSize < DataSize)
+        {
+            memset(pPacket + HeaderSize + nDataSize, nPadding, DataSize - nDataSize);
+        }
+        pPacket[0] = StartByte;
+        pPacket[1] = nPacketNumber;
+        pPacket[2] = (uint8_t)(XMODEM_INVERSE - nPacketNumber);
+        Checksum::Append(pPacket + HeaderSize + DataSize, pPacket + HeaderSize, DataSize);
+    }
+
+    //Copies up to one block of data into the packet and frames it
+    static inline void
+    Frame(
+        Packet &aPacket,
+        uint8_t nPacketNumber,
+        const uint8_t *pData,
+        size_t nDataSize,
+        uint8_t nPadding
+        )
+    {
+        if (nDataSize > DataSize)
+        {
+            nDataSize = DataSize;
+        }
+        memcpy(aPacket.data() + HeaderSize, pData, nDataSize);
+        FrameInPlace(aPacket, nPacketNumber, nDataSize, nPadding);
+    }
+
+    //Checks the header and checksum of a received packet
+    static inline bool
+    Validate(
+        const uint8_t *pPacket,
+        uint8_t nExpectedPacketNumber
+        )
+    {
+        uint8_t aChecksum[ChecksumSize];
+        if (pPacket[0] != StartByte || pPacket[1] != nExpectedPacketNumber || pPacket[2] != (uint8_t)(XMODEM_INVERSE - nExpectedPacketNumber))
+        {
+            return false;
+        }
+        Checksum::Append(aChecksum, pPacket + HeaderSize, DataSize);
+
+        return (memcmp(aChecksum, pPacket + HeaderSize + DataSize, ChecksumSize) == 0);
+    }
+
+    //Sends a packet over any transport with a QIODevice style write(const char *, qint64)
+    template <class Transport>
+    static inline auto
+    Send(
+        Transport &tTransport,
+        const Packet &aPacket
+        ) -> decltype(tTransport.write((const char *)0, 0))
+    {
+        return tTransport.write(reinterpret_cast<const char *>(aPacket.data()), PacketSize);
+    }
+};
+
+//Framers used by the application
+typedef XModemFramer<XMODEM_1K_BLOCK_SIZE, XModemChecksumSum8> XModem1KSum8Framer;
+typedef XModemFramer<XMODEM_1K_BLOCK_SIZE, XModemChecksumCRC16> XModem1KCRC16Framer;
+typedef XModemFramer<XMODEM_128_BLOCK_SIZE, XModemChecksumSum8> XModem128Sum8Framer;
+typedef XModemFramer<XMODEM_128_BLOCK_SIZE, XModemChecksumCRC16> XModem128CRC16Framer;
+
+#endif // UWXXMODEMFRAMER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
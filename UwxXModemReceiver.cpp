@@ -0,0 +1,498 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxXModemReceiver.cpp
+**
+** Notes: XModem (128/1K, checksum/CRC-16) receive engine. Received data is
+**        streamed to a preallocated file and a checkpoint is kept alongside
+**        it so an interrupted transfer can be resumed.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxXModemReceiver.h"
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstring>
+
+/******************************************************************************/
+// Local Functions or Private Members
+/******************************************************************************/
+XModemReceiver::XModemReceiver(QObject *parent) :
+    QObject(parent)
+{
+    connect(&tmrRequest, SIGNAL(timeout()), this, SLOT(RequestTimerTimeout()));
+    tmrRequest.setSingleShot(false);
+}
+
+//=============================================================================
+//=============================================================================
+XModemReceiver::~XModemReceiver(
+    )
+{
+    disconnect(this, SLOT(RequestTimerTimeout()));
+    tmrRequest.stop();
+
+    if (bRunning == true)
+    {
+        //Keep what has been received so far so it can be resumed
+        WriteCheckpoint();
+        fpOutput.close();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+bool
+XModemReceiver::Start(
+    const QString &strFilename,
+    qint64 nExpectedSize,
+    QString *pstrError
+    )
+{
+    //Opens the output file (resuming from its checkpoint if there is one) and requests the transfer from the sender
+    if (bRunning == true)
+    {
+        *pstrError = "A transfer is already in progress";
+        return false;
+    }
+
+    nResumeOffset = 0;
+    QFile fpCheckpoint(CheckpointPath(strFilename));
+    if (QFile::exists(strFilename) && fpCheckpoint.open(QFile::ReadOnly))
+    {
+        QDataStream dsCheckpoint(&fpCheckpoint);
+        quint32 nMagic = 0;
+        quint16 nVersion = 0;
+        qint64 nOffset = 0;
+        qint64 nCheckpointSize = 0;
+        dsCheckpoint.setByteOrder(QDataStream::LittleEndian);
+        dsCheckpoint >> nMagic >> nVersion >> nOffset >> nCheckpointSize;
+        if (dsCheckpoint.status() == QDataStream::Ok && nMagic == XMODEM_RECEIVE_CHECKPOINT_MAGIC && nVersion == XMODEM_RECEIVE_CHECKPOINT_VERSION && nOffset > 0 && nOffset <= QFileInfo(strFilename).size())
+        {
+            nResumeOffset = nOffset;
+            if (nExpectedSize <= 0)
+            {
+                nExpectedSize = nCheckpointSize;
+            }
+        }
+        fpCheckpoint.close();
+    }
+
+    fpOutput.setFileName(strFilename);
+    if (!fpOutput.open(nResumeOffset > 0 ? QFile::ReadWrite : (QFile::WriteOnly | QFile::Truncate)))
+    {
+        *pstrError = fpOutput.errorString();
+        return false;
+    }
+
+    //Preallocate the file so it does not need to grow for every block
+    nExpectedFileSize = (nExpectedSize > 0 ? nExpectedSize : 0);
+    nAllocatedSize = fpOutput.size();
+    if (nExpectedFileSize > nAllocatedSize && fpOutput.resize(nExpectedFileSize))
+    {
+        nAllocatedSize = nExpectedFileSize;
+    }
+
+    nPacketFill = 0;
+    nPacketSize = 0;
+    bStarted = false;
+    bCRCMode = true;
+    nExpectedPacket = XMODEM_RECEIVE_FIRST_PACKET_ID;
+    nStreamOffset = 0;
+    nBlocksSinceCheckpoint = 0;
+    nRetries = 0;
+    nCancels = 0;
+    bRunning = true;
+
+    //Ask for a 1K/CRC-16 transfer, falls back to the 8-bit checksum if the sender does not respond
+    SendResponse(XModemPacketTypeCRCRequest);
+    nRequests = 1;
+    tmrRequest.start(XMODEM_RECEIVE_REQUEST_INTERVAL_MS);
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+XModemReceiver::Abort(
+    const QString &strReason
+    )
+{
+    if (bRunning == false)
+    {
+        return;
+    }
+
+    SendResponse(XModemPacketTypeCancel);
+    SendResponse(XModemPacketTypeCancel);
+    Finish(false, strReason);
+}
+
+//=============================================================================
+//=============================================================================
+bool
+XModemReceiver::IsRunning(
+    ) const
+{
+    return bRunning;
+}
+
+//=============================================================================
+//=============================================================================
+void
+XModemReceiver::ProcessData(
+    const QByteArray &baData
+    )
+{
+    //Assembles packets from the received data, which may hold partial or several packets
+    if (bRunning == false)
+    {
+        return;
+    }
+
+    const uint8_t *pData = reinterpret_cast<const uint8_t *>(baData.constData());
+    size_t nSize = baData.size();
+    size_t i = 0;
+    while (i < nSize && bRunning == true)
+    {
+        if (nPacketFill == 0)
+        {
+            //Waiting for the start of a packet
+            uint8_t nByte = pData[i];
+            ++i;
+            if (nByte == XModemPacketType128BytePacket || nByte == XModemPacketType1024BytePacket)
+            {
+                nPacketSize = XModem1KCRC16Framer::HeaderSize + (nByte == XModemPacketType1024BytePacket ? XMODEM_1K_BLOCK_SIZE : XMODEM_128_BLOCK_SIZE) + (bCRCMode == true ? XModemChecksumCRC16::Size : XModemChecksumSum8::Size);
+                aPacket[0] = nByte;
+                nPacketFill = 1;
+                nCancels = 0;
+                if (bStarted == false)
+                {
+                    //Sender has started, the checksum type can no longer change
+                    bStarted = true;
+                    tmrRequest.setInterval(XMODEM_RECEIVE_PACKET_TIMEOUT_MS);
+                }
+            }
+            else if (nByte == XModemPacketTypeEndOfFrame)
+            {
+                SendResponse(XModemPacketTypeAck);
+                Finish(true, QString("Received ").append(QString::number(nStreamOffset)).append(" bytes"));
+            }
+            else if (nByte == XModemPacketTypeCancel)
+            {
+                ++nCancels;
+                if (nCancels >= XMODEM_RECEIVE_CANCEL_COUNT)
+                {
+                    Finish(false, "Transfer cancelled by sender");
+                }
+            }
+            else
+            {
+                //Line noise between packets
+                nCancels = 0;
+            }
+            continue;
+        }
+
+        size_t nCopy = qMin(nPacketSize - nPacketFill, nSize - i);
+        memcpy(aPacket.data() + nPacketFill, pData + i, nCopy);
+        nPacketFill += nCopy;
+        i += nCopy;
+        if (nPacketFill == nPacketSize)
+        {
+            HandlePacket();
+            nPacketFill = 0;
+        }
+    }
+
+    if (bRunning == true && bStarted == true)
+    {
+        //Restart the packet timeout
+        tmrRequest.start();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+qint64
+XModemReceiver::BytesReceived(
+    ) const
+{
+    return nStreamOffset;
+}
+
+//=============================================================================
+//=============================================================================
+qint64
+XModemReceiver::ResumedBytes(
+    ) const
+{
+    return nResumeOffset;
+}
+
+//=============================================================================
+//=============================================================================
+QString
+XModemReceiver::CheckpointPath(
+    const QString &strFilename
+    )
+{
+    return QString(strFilename).append(XMODEM_RECEIVE_CHECKPOINT_EXTENSION);
+}
+
+//=============================================================================
+//=============================================================================
+void
+XModemReceiver::RequestTimerTimeout(
+    )
+{
+    if (bStarted == false)
+    {
+        //No response to the start request yet
+        if (nRequests >= XMODEM_RECEIVE_MAX_REQUESTS)
+        {
+            Finish(false, "No response from sender");
+            return;
+        }
+        else if (nRequests >= XMODEM_RECEIVE_CRC_REQUESTS)
+        {
+            //Sender may not support CRC-16
+            bCRCMode = false;
+        }
+
+        SendResponse(bCRCMode == true ? XModemPacketTypeCRCRequest : XModemPacketTypeNack);
+        ++nRequests;
+        return;
+    }
+
+    //Sender stalled part way through a packet or between packets
+    nPacketFill = 0;
+    ++nRetries;
+    if (nRetries > XMODEM_RECEIVE_MAX_RETRIES)
+    {
+        Abort("Timed out waiting for data from sender");
+        return;
+    }
+
+    SendResponse(XModemPacketTypeNack);
+}
+
+//=============================================================================
+//=============================================================================
+void
+XModemReceiver::HandlePacket(
+    )
+{
+    //Checks a complete packet and stores its data
+    if ((uint8_t)(aPacket[1] + aPacket[2]) != XMODEM_INVERSE || PacketValid() == false)
+    {
+        if (aPacket[1] == (uint8_t)(nExpectedPacket - 1) && (uint8_t)(aPacket[1] + aPacket[2]) == XMODEM_INVERSE && nStreamOffset > 0)
+        {
+            //Repeat of the previous packet (our ACK was lost), it has already been stored
+            SendResponse(XModemPacketTypeAck);
+            return;
+        }
+        else if ((uint8_t)(aPacket[1] + aPacket[2]) == XMODEM_INVERSE && aPacket[1] != nExpectedPacket)
+        {
+            //Sender has skipped a packet, the transfer cannot continue
+            Abort(QString("Lost packet sequence, expected packet ").append(QString::number(nExpectedPacket)).append(" but got ").append(QString::number(aPacket[1])));
+            return;
+        }
+
+        ++nRetries;
+        if (nRetries > XMODEM_RECEIVE_MAX_RETRIES)
+        {
+            Abort("Too many corrupt packets received");
+            return;
+        }
+
+        SendResponse(XModemPacketTypeNack);
+        return;
+    }
+
+    //Acknowledge first so the sender can start on the next block whilst this one is written out
+    size_t nDataSize = nPacketSize - XModem1KCRC16Framer::HeaderSize - (bCRCMode == true ? XModemChecksumCRC16::Size : XModemChecksumSum8::Size);
+    SendResponse(XModemPacketTypeAck);
+    if (StoreData(aPacket.data() + XModem1KCRC16Framer::HeaderSize, nDataSize) == false)
+    {
+        Abort(QString("Failed to write received data: ").append(fpOutput.errorString()));
+        return;
+    }
+
+    ++nExpectedPacket;
+    nRetries = 0;
+}
+
+//=============================================================================
+//=============================================================================
+bool
+XModemReceiver::PacketValid(
+    )
+{
+    //Verifies the header and checksum of the current packet with the framer for its geometry
+    if (aPacket[0] == XModemPacketType1024BytePacket)
+    {
+        return (bCRCMode == true ? XModem1KCRC16Framer::Validate(aPacket.data(), nExpectedPacket) : XModem1KSum8Framer::Validate(aPacket.data(), nExpectedPacket));
+    }
+
+    return (bCRCMode == true ? XModem128CRC16Framer::Validate(aPacket.data(), nExpectedPacket) : XModem128Sum8Framer::Validate(aPacket.data(), nExpectedPacket));
+}
+
+//=============================================================================
+//=============================================================================
+bool
+XModemReceiver::StoreData(
+    const uint8_t *pData,
+    qint64 nSize
+    )
+{
+    //Writes the data of a block to the file. Data already stored by a previous attempt is
+    //compared instead, the sender may now be sending a different file under the same name.
+    qint64 nOffset = nStreamOffset;
+    nStreamOffset += nSize;
+    if (nOffset < nResumeOffset)
+    {
+        qint64 nStoredSize = qMin(nSize, nResumeOffset - nOffset);
+        QByteArray baStored;
+        if (fpOutput.seek(nOffset))
+        {
+            baStored = fpOutput.read(nStoredSize);
+        }
+
+        if (baStored.length() == nStoredSize && memcmp(baStored.constData(), pData, nStoredSize) == 0)
+        {
+            if (nStoredSize == nSize)
+            {
+                return true;
+            }
+
+            //Block spans the resume point
+            pData += nStoredSize;
+            nSize -= nStoredSize;
+            nOffset = nResumeOffset;
+        }
+        else
+        {
+            //Stored data is from a different file, everything from here on is written again
+            nResumeOffset = nOffset;
+            QFile::remove(CheckpointPath(fpOutput.fileName()));
+        }
+    }
+
+    if (nOffset + nSize > nAllocatedSize)
+    {
+        //Grow the file in large steps rather than per block
+        if (!fpOutput.resize(nOffset + nSize + XMODEM_RECEIVE_PREALLOCATE_SIZE))
+        {
+            return false;
+        }
+        nAllocatedSize = nOffset + nSize + XMODEM_RECEIVE_PREALLOCATE_SIZE;
+    }
+
+    if (fpOutput.pos() != nOffset && !fpOutput.seek(nOffset))
+    {
+        return false;
+    }
+    else if (fpOutput.write(reinterpret_cast<const char *>(pData), nSize) != nSize)
+    {
+        return false;
+    }
+
+    ++nBlocksSinceCheckpoint;
+    if (nBlocksSinceCheckpoint >= XMODEM_RECEIVE_CHECKPOINT_BLOCKS)
+    {
+        nBlocksSinceCheckpoint = 0;
+        return WriteCheckpoint();
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void
+XModemReceiver::SendResponse(
+    uint8_t nResponse
+    )
+{
+    emit WriteData(QByteArray(1, (char)nResponse));
+}
+
+//=============================================================================
+//=============================================================================
+bool
+XModemReceiver::WriteCheckpoint(
+    )
+{
+    //Records how much of the file is safely stored, the data is flushed first so the checkpoint never runs ahead of it
+    if (!fpOutput.isOpen() || !fpOutput.flush())
+    {
+        return false;
+    }
+
+    QSaveFile fpCheckpoint(CheckpointPath(fpOutput.fileName()));
+    if (!fpCheckpoint.open(QFile::WriteOnly))
+    {
+        return false;
+    }
+
+    QDataStream dsCheckpoint(&fpCheckpoint);
+    dsCheckpoint.setByteOrder(QDataStream::LittleEndian);
+    dsCheckpoint << (quint32)XMODEM_RECEIVE_CHECKPOINT_MAGIC << (quint16)XMODEM_RECEIVE_CHECKPOINT_VERSION << qMax(nStreamOffset, nResumeOffset) << nExpectedFileSize;
+
+    return fpCheckpoint.commit();
+}
+
+//=============================================================================
+//=============================================================================
+void
+XModemReceiver::Finish(
+    bool bSuccess,
+    const QString &strMessage
+    )
+{
+    tmrRequest.stop();
+    bRunning = false;
+
+    if (bSuccess == true)
+    {
+        //Trim the preallocated space (and the padding of the final block if the size is known)
+        fpOutput.resize(nExpectedFileSize > 0 && nExpectedFileSize < nStreamOffset ? nExpectedFileSize : nStreamOffset);
+        fpOutput.close();
+        QFile::remove(CheckpointPath(fpOutput.fileName()));
+    }
+    else
+    {
+        //Keep the partial file and checkpoint for a later resume
+        if (qMax(nStreamOffset, nResumeOffset) > 0)
+        {
+            WriteCheckpoint();
+        }
+        fpOutput.close();
+    }
+
+    emit Finished(bSuccess, strMessage);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,160 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: UwxXModemReceiver.h
+**
+** Notes: XModem (128/1K, checksum/CRC-16) receive engine. Received data is
+**        streamed to a preallocated file and a checkpoint is kept alongside
+**        it so an interrupted transfer can be resumed.
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+#ifndef UWXXMODEMRECEIVER_H
+#define UWXXMODEMRECEIVER_H
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QByteArray>
+#include <QString>
+#include "UwxXModemFramer.h"
+
+/******************************************************************************/
+// Defines
+/******************************************************************************/
+#define XMODEM_RECEIVE_CHECKPOINT_MAGIC           0x584d5243
+#define XMODEM_RECEIVE_CHECKPOINT_VERSION         1
+#define XMODEM_RECEIVE_CHECKPOINT_EXTENSION       ".xmrcp"
+#define XMODEM_RECEIVE_CHECKPOINT_BLOCKS          64
+#define XMODEM_RECEIVE_PREALLOCATE_SIZE           (1024 * 1024)
+#define XMODEM_RECEIVE_REQUEST_INTERVAL_MS        3000
+#define XMODEM_RECEIVE_CRC_REQUESTS               4
+#define XMODEM_RECEIVE_MAX_REQUESTS               20
+#define XMODEM_RECEIVE_PACKET_TIMEOUT_MS          10000
+#define XMODEM_RECEIVE_MAX_RETRIES                10
+#define XMODEM_RECEIVE_CANCEL_COUNT               2
+#define XMODEM_RECEIVE_FIRST_PACKET_ID            1
+
+/******************************************************************************/
+// Class definitions
+/******************************************************************************/
+class XModemReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit
+    XModemReceiver(
+        QObject *parent = 0
+        );
+    ~XModemReceiver(
+        );
+    bool
+    Start(
+        const QString &strFilename,
+        qint64 nExpectedSize,
+        QString *pstrError
+        );
+    void
+    Abort(
+        const QString &strReason
+        );
+    bool
+    IsRunning(
+        ) const;
+    void
+    ProcessData(
+        const QByteArray &baData
+        );
+    qint64
+    BytesReceived(
+        ) const;
+    qint64
+    ResumedBytes(
+        ) const;
+    static QString
+    CheckpointPath(
+        const QString &strFilename
+        );
+
+signals:
+    void
+    WriteData(
+        QByteArray baData
+        );
+    void
+    Finished(
+        bool bSuccess,
+        QString strMessage
+        );
+
+private slots:
+    void
+    RequestTimerTimeout(
+        );
+
+private:
+    void
+    HandlePacket(
+        );
+    bool
+    PacketValid(
+        );
+    bool
+    StoreData(
+        const uint8_t *pData,
+        qint64 nSize
+        );
+    void
+    SendResponse(
+        uint8_t nResponse
+        );
+    bool
+    WriteCheckpoint(
+        );
+    void
+    Finish(
+        bool bSuccess,
+        const QString &strMessage
+        );
+
+    QFile fpOutput;                                 //File received data is written to
+    XModem1KCRC16Framer::Packet aPacket;            //Buffer for the packet being received, sized for the largest packet
+    size_t nPacketFill = 0;                         //Bytes of the current packet received so far
+    size_t nPacketSize = 0;                         //Size of the current packet once its start byte is known
+    bool bRunning = false;                          //If a transfer is in progress
+    bool bStarted = false;                          //If the sender has started sending packets
+    bool bCRCMode = true;                           //If CRC-16 rather than the 8-bit checksum is in use
+    uint8_t nExpectedPacket = XMODEM_RECEIVE_FIRST_PACKET_ID; //Packet number of the next expected packet
+    qint64 nStreamOffset = 0;                       //Offset of the next received data in the file being transferred
+    qint64 nResumeOffset = 0;                       //Data before this offset was stored by a previous attempt
+    qint64 nAllocatedSize = 0;                      //Size the output file has been preallocated to
+    qint64 nExpectedFileSize = 0;                   //Expected size of the file, 0 if unknown
+    int nBlocksSinceCheckpoint = 0;                 //Blocks stored since the last checkpoint was written
+    int nRequests = 0;                              //Transfer start requests sent
+    int nRetries = 0;                               //Consecutive errors
+    int nCancels = 0;                               //Consecutive cancel bytes received
+    QTimer tmrRequest;                              //Start request and packet timeout timer
+};
+
+#endif // UWXXMODEMRECEIVER_H
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
@@ -0,0 +1,61 @@
+#XModemUtil Qt project include file, transfer engine shared by the application and the benchmark tool
+QT       += core gui widgets serialport network concurrent sql
+
+CONFIG += c++17
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# You can also make your code fail to compile if you use deprecated APIs.
+# In order to do so, uncomment the following line.
+# You can also select to disable deprecated APIs only up to a certain version of Qt.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+SOURCES += \
+        $$PWD/UwxFirmwareCatalog.cpp \
+        $$PWD/UwxFirmwarePrefetcher.cpp \
+        $$PWD/UwxFlashHistory.cpp \
+        $$PWD/UwxHttpServer.cpp \
+        $$PWD/UwxImageVerifier.cpp \
+        $$PWD/UwxLineWatchdog.cpp \
+        $$PWD/UwxLinkProfiles.cpp \
+        $$PWD/UwxMainWindow.cpp \
+        $$PWD/UwxMetrics.cpp \
+        $$PWD/UwxPopup.cpp \
+        $$PWD/UwxRealtimeProfile.cpp \
+        $$PWD/UwxSerialTrace.cpp \
+        $$PWD/UwxSharedImage.cpp \
+        $$PWD/UwxStartupProfile.cpp \
+        $$PWD/UwxTransferProgress.cpp \
+        $$PWD/UwxUpgradePlanner.cpp \
+        $$PWD/UwxXModemReceiver.cpp
+
+HEADERS += \
+        $$PWD/UwxFirmwareCatalog.h \
+        $$PWD/UwxFirmwarePrefetcher.h \
+        $$PWD/UwxFlashHistory.h \
+        $$PWD/UwxHttpServer.h \
+        $$PWD/UwxImageVerifier.h \
+        $$PWD/UwxLineWatchdog.h \
+        $$PWD/UwxLinkProfiles.h \
+        $$PWD/UwxMainWindow.h \
+        $$PWD/UwxMetrics.h \
+        $$PWD/UwxPopup.h \
+        $$PWD/UwxRealtimeProfile.h \
+        $$PWD/UwxSerialTrace.h \
+        $$PWD/UwxSharedImage.h \
+        $$PWD/UwxStartupProfile.h \
+        $$PWD/UwxTransferProgress.h \
+        $$PWD/UwxUpgradePlanner.h \
+        $$PWD/UwxXModemFramer.h \
+        $$PWD/UwxXModemReceiver.h
+
+FORMS += \
+        $$PWD/UwxMainWindow.ui \
+        $$PWD/UwxPopup.ui
+
+RESOURCES += \
+        $$PWD/UwTerminalXCertificate.qrc
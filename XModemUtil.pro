@@ -1,41 +1,10 @@
-#XModemUtil Qt project qmake file
-QT       += core gui widgets serialport network
+#XModemUtil Qt project qmake file, builds the application and the benchmark tool
+TEMPLATE = subdirs
 
-TARGET = XModemUtil
-TEMPLATE = app
+#Flashing application: window, daemon, scanner and mirror
+SUBDIRS += app
+app.file = XModemUtilApp.pro
 
-# The following define makes your compiler emit warnings if you use
-# any feature of Qt which has been marked as deprecated (the exact warnings
-# depend on your compiler). Please consult the documentation of the
-# deprecated API in order to know how to port your code away from it.
-DEFINES += QT_DEPRECATED_WARNINGS
-
-# You can also make your code fail to compile if you use deprecated APIs.
-# In order to do so, uncomment the following line.
-# You can also select to disable deprecated APIs only up to a certain version of Qt.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-        UwxMainWindow.cpp \
-        UwxPopup.cpp \
-        main.cpp
-
-HEADERS += \
-        UwxMainWindow.h \
-        UwxPopup.h
-
-FORMS += \
-        UwxMainWindow.ui \
-        UwxPopup.ui
-
-RESOURCES += \
-        UwTerminalXCertificate.qrc
-
-#Windows application version information
-win32:RC_FILE = version.rc
-
-#Windows application icon
-win32:RC_ICONS = images/XModemUtil32.ico
-
-#Mac application icon
-#ICON = MacXModemUtilIcon.icns
+#Benchmarks and stress tests against simulated modules, kept out of the application
+SUBDIRS += bench
+bench.file = XModemUtilBench.pro
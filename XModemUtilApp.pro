@@ -0,0 +1,25 @@
+#XModemUtil Qt project qmake file, flashing application
+TARGET = XModemUtil
+TEMPLATE = app
+
+include(XModemUtil.pri)
+
+SOURCES += \
+        UwxFirmwareMirror.cpp \
+        UwxFlashDaemon.cpp \
+        UwxFleetScanner.cpp \
+        main.cpp
+
+HEADERS += \
+        UwxFirmwareMirror.h \
+        UwxFlashDaemon.h \
+        UwxFleetScanner.h
+
+#Windows application version information
+win32:RC_FILE = version.rc
+
+#Windows application icon
+win32:RC_ICONS = images/XModemUtil32.ico
+
+#Mac application icon
+#ICON = MacXModemUtilIcon.icns
@@ -0,0 +1,33 @@
+#XModemUtil Qt project qmake file, benchmark and stress test tool
+TARGET = XModemUtilBench
+TEMPLATE = app
+CONFIG += console
+
+include(XModemUtil.pri)
+
+SOURCES += \
+        UwxBenchmark.cpp \
+        benchmain.cpp
+
+HEADERS += \
+        UwxBenchmark.h
+
+#Simulated devices on pseudo terminals, used for benchmarking and stress testing
+unix {
+    SOURCES += UwxPtySimulator.cpp \
+               UwxStressTest.cpp
+    HEADERS += UwxPtySimulator.h \
+               UwxStressTest.h
+}
+
+#Coroutine reactor engine, needs epoll and C++20 coroutines (GCC 10 only enables them with -fcoroutines)
+linux {
+    CONFIG += c++2a
+    linux-g++*: QMAKE_CXXFLAGS += -fcoroutines
+    SOURCES += UwxReactor.cpp \
+               UwxReactorBenchmark.cpp \
+               UwxReactorSession.cpp
+    HEADERS += UwxReactor.h \
+               UwxReactorBenchmark.h \
+               UwxReactorSession.h
+}
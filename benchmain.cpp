@@ -0,0 +1,135 @@
+/******************************************************************************
+** Copyright (C) 2020 Laird Connectivity
+**
+** Project: XModemUtil
+**
+** Module: benchmain.cpp
+**
+** Notes: Benchmark and stress test tool, built separately so the application
+**        carries no simulator or benchmark code
+**
+** License: This program is free software: you can redistribute it and/or
+**          modify it under the terms of the GNU General Public License as
+**          published by the Free Software Foundation, version 3.
+**
+**          This program is distributed in the hope that it will be useful,
+**          but WITHOUT ANY WARRANTY; without even the implied warranty of
+**          MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**          GNU General Public License for more details.
+**
+**          You should have received a copy of the GNU General Public License
+**          along with this program.  If not, see http://www.gnu.org/licenses/
+**
+*******************************************************************************/
+
+/******************************************************************************/
+// Include Files
+/******************************************************************************/
+#include "UwxBenchmark.h"
+#ifdef Q_OS_UNIX
+#include "UwxStressTest.h"
+#endif
+#ifdef Q_OS_LINUX
+#include "UwxReactorBenchmark.h"
+#endif
+#include "UwxRealtimeProfile.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <cstdlib>
+
+/******************************************************************************/
+// Global functions
+/******************************************************************************/
+int
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    //Engines are windows, use -platform offscreen on machines without a display
+    QApplication a(argc, argv);
+
+    //Command line options
+    QCommandLineParser clpParser;
+    QCommandLineOption cloRealtime("realtime", "Run transfers with the real-time performance profile: fifo or rr scheduling where permitted, locked packet buffers and optional CPU pinning. Block jitter statistics are logged after each transfer.", "policy");
+    QCommandLineOption cloRealtimePriority("realtime-priority", "Real-time scheduling priority used by --realtime (default 10).", "priority", QString::number(REALTIME_DEFAULT_PRIORITY));
+    QCommandLineOption cloCpu("cpu", "Comma separated CPU numbers to pin transfers to, used by --realtime.", "cpus");
+    QCommandLineOption cloBenchmark("benchmark", "Run the checksum, packet framing, response parsing, hashing and receive benchmarks and exit. Fails if a kernel does not match its reference.");
+    QCommandLineOption cloBenchmarkFormat("benchmark-format", "Output format of --benchmark: text or json (default text).", "format", "text");
+#ifdef Q_OS_UNIX
+    QCommandLineOption cloStress("stress", "Upgrade the given number of simulated modules (up to 256) concurrently over pseudo terminals, report throughput, block latency, CPU and memory use, then exit. Use -platform offscreen on machines without a display.", "sessions");
+    QCommandLineOption cloStressSize("stress-size", "Firmware image size used by the stress test (default 262144).", "bytes", QString::number(STRESS_DEFAULT_IMAGE_SIZE));
+    QCommandLineOption cloStressByteErrors("stress-byte-errors", "Probability of each byte of a block being corrupted on the simulated line, used by --stress (default 0).", "probability", "0");
+    QCommandLineOption cloStressFixedBlocks("stress-fixed-blocks", "Always send 1K blocks in the stress test, for comparison with the adaptive block size.");
+#endif
+#ifdef Q_OS_LINUX
+    QCommandLineOption cloReactorBenchmark("reactor-benchmark", "Upgrade 16, 64 and 256 simulated modules with the single-threaded coroutine reactor and with a thread per port, compare their cost and exit.");
+#endif
+    clpParser.addHelpOption();
+    clpParser.addOption(cloRealtime);
+    clpParser.addOption(cloRealtimePriority);
+    clpParser.addOption(cloCpu);
+    clpParser.addOption(cloBenchmark);
+    clpParser.addOption(cloBenchmarkFormat);
+#ifdef Q_OS_UNIX
+    clpParser.addOption(cloStress);
+    clpParser.addOption(cloStressSize);
+    clpParser.addOption(cloStressByteErrors);
+    clpParser.addOption(cloStressFixedBlocks);
+#endif
+#ifdef Q_OS_LINUX
+    clpParser.addOption(cloReactorBenchmark);
+#endif
+    clpParser.process(a);
+
+    if (clpParser.isSet(cloBenchmark))
+    {
+        //Microbenchmarks, no window is needed
+        QTextStream tsOutput(stdout);
+        return Benchmark::Run(tsOutput, (clpParser.value(cloBenchmarkFormat) == "json" ? BenchmarkFormatJSON : BenchmarkFormatText));
+    }
+
+#ifdef Q_OS_LINUX
+    if (clpParser.isSet(cloReactorBenchmark))
+    {
+        //Simulated modules and engines without any window
+        QTextStream tsOutput(stdout);
+        return ReactorBenchmark::Run(tsOutput);
+    }
+#endif
+
+    if (clpParser.isSet(cloRealtime))
+    {
+        //Engines run on this thread, parts of the profile which are not permitted are skipped
+        QList<int> lstCpus;
+        foreach (const QString &strCpu, clpParser.value(cloCpu).split(',', QString::SkipEmptyParts))
+        {
+            lstCpus.append(strCpu.trimmed().toInt());
+        }
+
+        QStringList lstNotes;
+        RealtimeProfile::Apply((clpParser.value(cloRealtime) == "rr" ? RealtimeSchedulingPolicyRoundRobin : RealtimeSchedulingPolicyFIFO), clpParser.value(cloRealtimePriority).toInt(), lstCpus, &lstNotes);
+        foreach (const QString &strNote, lstNotes)
+        {
+            QTextStream(stderr) << "Real-time profile: " << strNote << "\n";
+        }
+    }
+
+#ifdef Q_OS_UNIX
+    if (clpParser.isSet(cloStress))
+    {
+        //Many engines against simulated modules in this process, no window is shown
+        QTextStream tsOutput(stdout);
+        StressTest stTest;
+        return stTest.Run(tsOutput, clpParser.value(cloStress).toInt(), clpParser.value(cloStressSize).toLongLong(), STRESS_DEFAULT_SEED, clpParser.value(cloStressByteErrors).toDouble(), !clpParser.isSet(cloStressFixedBlocks));
+    }
+#endif
+
+    //Nothing to run
+    clpParser.showHelp(EXIT_FAILURE);
+}
+
+/******************************************************************************/
+// END OF FILE
+/******************************************************************************/
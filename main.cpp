@@ -25,7 +25,20 @@
 // Include Files
 /******************************************************************************/
 #include "UwxMainWindow.h"
+#include "UwxFleetScanner.h"
+#include "UwxMetrics.h"
+#include "UwxFlashDaemon.h"
+#include "UwxRealtimeProfile.h"
+#include "UwxFlashHistory.h"
+#include "UwxFirmwareMirror.h"
+#include "UwxLineWatchdog.h"
+#include "UwxStartupProfile.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QTextStream>
+#include <QHostAddress>
+#include <cstdlib>
 
 /******************************************************************************/
 // Global functions
@@ -36,9 +49,212 @@ main(
     char *argv[]
     )
 {
+    StartupProfile::Begin();
     QApplication a(argc, argv);
+    StartupProfile::Mark("QApplication");
+
+    //Command line options
+    QCommandLineParser clpParser;
+    QCommandLineOption cloRecord("record", "Record all serial traffic to a trace file.", "trace");
+    QCommandLineOption cloReplay("replay", "Replay a recorded trace instead of using a serial port, exits once complete. Use -platform offscreen on machines without a display.", "trace");
+    QCommandLineOption cloReplaySpeed("replay-speed", "Replay speed multiplier (default 1, 0 replays without delays).", "factor", "1");
+    QCommandLineOption cloFile("file", "Firmware file to use for the replayed firmware update.", "file");
+    QCommandLineOption cloReceive("receive", "Receive a file from the module with XModem (the transfer must be started on the module), exits once complete. An interrupted receive is resumed when run again with the same file.", "file");
+    QCommandLineOption cloReceiveSize("receive-size", "Expected size of the received file, used to preallocate it and remove the final block padding.", "bytes", "0");
+    QCommandLineOption cloPort("port", "Serial port to use.", "port");
+    QCommandLineOption cloBaud("baud", "Serial port baud rate (default 115200).", "rate", "115200");
+    QCommandLineOption cloFlow("flow", "Serial port flow control used by --scan: none, hardware or software (default hardware).", "flow", "hardware");
+    QCommandLineOption cloScan("scan", "Query the module on every serial port at the same time, output the mode and firmware version of each and exit. The modules are left in the mode they were found in.");
+    QCommandLineOption cloScanFormat("scan-format", "Output format of --scan: table, csv or json (default table).", "format", "table");
+    QCommandLineOption cloMetricsPort("metrics-port", "Serve transfer statistics in Prometheus text format on http://127.0.0.1:<port>/metrics.", "port");
+    QCommandLineOption cloDaemon("daemon", "Run as a flashing service accepting JSON jobs on the named local socket, engines are kept running between jobs. Use -platform offscreen on machines without a display.", "name");
+    QCommandLineOption cloRealtime("realtime", "Run transfers with the real-time performance profile: fifo or rr scheduling where permitted, locked packet buffers and optional CPU pinning. Block jitter statistics are logged after each transfer.", "policy");
+    QCommandLineOption cloRealtimePriority("realtime-priority", "Real-time scheduling priority used by --realtime (default 10).", "priority", QString::number(REALTIME_DEFAULT_PRIORITY));
+    QCommandLineOption cloCpu("cpu", "Comma separated CPU numbers to pin transfers to, used by --realtime.", "cpus");
+    QCommandLineOption cloHistoryReport("history-report", "Output sessions, success rate and throughput from the flash history grouped by station, adapter, firmware or module, then exit.", "group");
+    QCommandLineOption cloPrefetchRate("prefetch-rate", "Bandwidth in KiB/s used to download the firmware files recent modules are likely to need once the online catalog is loaded, 0 disables prefetching (default 256).", "rate", QString::number(FIRMWARE_PREFETCH_DEFAULT_RATE / 1024));
+    QCommandLineOption cloMirrorPort("mirror-port", "Serve the firmware catalog and verified cached firmware files to other stations over HTTP on the given port, fetching anything missing from upstream once.", "port");
+    QCommandLineOption cloMirrorBind("mirror-bind", "Address the firmware mirror listens on (default all interfaces).", "address");
+    QCommandLineOption cloMirrorUpstream("mirror-upstream", "Server the mirror fetches from, as scheme://host[:port] (default the online firmware server).", "url");
+    QCommandLineOption cloFirmwareHost("firmware-host", "Fetch firmware files from a station running --mirror-port (host:port), falling back to the online server if it cannot answer. The catalog is fetched from the online server, and only from the mirror when the online server cannot be reached.", "host");
+    QCommandLineOption cloLineReset("line-reset", "The fixture wires DTR (and RTS when flow control is not hardware) to the module reset, a module which stops responding is reset by pulsing them before it is asked to enter the bootloader.");
+    QCommandLineOption cloNoHistory("no-history", "Do not record sessions in the flash history database.");
+    QCommandLineOption cloStartupProfile("startup-profile", "Show the main window, output how long each phase of startup took up to the first frame, then exit. Fails if the cold start took longer than " + QString::number(STARTUP_PROFILE_BUDGET_MS) + " ms.");
+    clpParser.addHelpOption();
+    clpParser.addOption(cloRecord);
+    clpParser.addOption(cloReplay);
+    clpParser.addOption(cloReplaySpeed);
+    clpParser.addOption(cloFile);
+    clpParser.addOption(cloReceive);
+    clpParser.addOption(cloReceiveSize);
+    clpParser.addOption(cloPort);
+    clpParser.addOption(cloBaud);
+    clpParser.addOption(cloFlow);
+    clpParser.addOption(cloScan);
+    clpParser.addOption(cloScanFormat);
+    clpParser.addOption(cloMetricsPort);
+    clpParser.addOption(cloDaemon);
+    clpParser.addOption(cloRealtime);
+    clpParser.addOption(cloRealtimePriority);
+    clpParser.addOption(cloCpu);
+    clpParser.addOption(cloHistoryReport);
+    clpParser.addOption(cloNoHistory);
+    clpParser.addOption(cloLineReset);
+    clpParser.addOption(cloStartupProfile);
+    clpParser.addOption(cloMirrorPort);
+    clpParser.addOption(cloMirrorBind);
+    clpParser.addOption(cloMirrorUpstream);
+    clpParser.addOption(cloFirmwareHost);
+    clpParser.addOption(cloPrefetchRate);
+    clpParser.process(a);
+    StartupProfile::Mark("Command line");
+    LineWatchdog::SetResetWired(clpParser.isSet(cloLineReset));
+
+    if (clpParser.isSet(cloRealtime))
+    {
+        //Engines run on this thread, parts of the profile which are not permitted are skipped
+        QList<int> lstCpus;
+        foreach (const QString &strCpu, clpParser.value(cloCpu).split(',', QString::SkipEmptyParts))
+        {
+            lstCpus.append(strCpu.trimmed().toInt());
+        }
+
+        QStringList lstNotes;
+        RealtimeProfile::Apply((clpParser.value(cloRealtime) == "rr" ? RealtimeSchedulingPolicyRoundRobin : RealtimeSchedulingPolicyFIFO), clpParser.value(cloRealtimePriority).toInt(), lstCpus, &lstNotes);
+        foreach (const QString &strNote, lstNotes)
+        {
+            QTextStream(stderr) << "Real-time profile: " << strNote << "\n";
+        }
+    }
+
+    MetricsServer msMetrics;
+    if (clpParser.isSet(cloMetricsPort))
+    {
+        //Statistics are only collected when they are being served
+        QString strError;
+        if (!msMetrics.Listen(clpParser.value(cloMetricsPort).toUShort(), &strError))
+        {
+            QTextStream(stderr) << "Unable to serve metrics on port " << clpParser.value(cloMetricsPort) << ": " << strError << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    FirmwareMirror fmMirror;
+    if (clpParser.isSet(cloMirrorPort))
+    {
+        //Serves the rest of the line alongside whatever else this instance does
+        QString strError;
+        QHostAddress haBind(QHostAddress::Any);
+        if (clpParser.isSet(cloMirrorBind) && !haBind.setAddress(clpParser.value(cloMirrorBind)))
+        {
+            QTextStream(stderr) << "Invalid firmware mirror address " << clpParser.value(cloMirrorBind) << "\n";
+            return EXIT_FAILURE;
+        }
+        else if (!fmMirror.Listen(haBind, clpParser.value(cloMirrorPort).toUShort(), (clpParser.isSet(cloMirrorUpstream) ? clpParser.value(cloMirrorUpstream) : FirmwareMirror::DefaultUpstream()), &strError))
+        {
+            QTextStream(stderr) << "Unable to serve firmware mirror on port " << clpParser.value(cloMirrorPort) << ": " << strError << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (clpParser.isSet(cloScan))
+    {
+        //Inventory of every port, no window is shown
+        QTextStream tsOutput(stdout);
+        QString strFlow = clpParser.value(cloFlow);
+        QString strFormat = clpParser.value(cloScanFormat);
+        FleetScanner fsScanner;
+        return fsScanner.Run(tsOutput, (strFormat == "json" ? FleetScanFormatJSON : (strFormat == "csv" ? FleetScanFormatCSV : FleetScanFormatTable)), clpParser.value(cloBaud).toInt(), (strFlow == "none" ? ComboBaudRateHandshakingNone : (strFlow == "software" ? ComboBaudRateHandshakingSoftware : ComboBaudRateHandshakingHardware)));
+    }
+
+    if (clpParser.isSet(cloHistoryReport))
+    {
+        //Read-only report, sessions being recorded by other instances are not blocked
+        QTextStream tsOutput(stdout);
+        QString strGroup = clpParser.value(cloHistoryReport);
+        return FlashHistory::Report(tsOutput, FlashHistory::DefaultPath(), (strGroup == "adapter" ? FlashHistoryReportGroupAdapter : (strGroup == "firmware" ? FlashHistoryReportGroupFirmware : (strGroup == "module" ? FlashHistoryReportGroupModule : FlashHistoryReportGroupStation))));
+    }
+
+    if (!clpParser.isSet(cloNoHistory))
+    {
+        QObject::connect(&a, SIGNAL(aboutToQuit()), &FlashHistory::Instance(), SLOT(Close()));
+        if (clpParser.isSet(cloDaemon) || clpParser.isSet(cloReplay) || clpParser.isSet(cloReceive))
+        {
+            //Sessions start without waiting for the user, so the history must be open first
+            FlashHistory::Instance().OpenDefault();
+        }
+    }
+
+    if (clpParser.isSet(cloDaemon))
+    {
+        //Flashing service, no window is shown
+        QString strError;
+        FlashDaemon fdDaemon;
+        if (!fdDaemon.Listen(clpParser.value(cloDaemon), &strError))
+        {
+            QTextStream(stderr) << "Unable to listen on " << clpParser.value(cloDaemon) << ": " << strError << "\n";
+            return EXIT_FAILURE;
+        }
+
+        return a.exec();
+    }
+
     MainWindow w;
+    StartupProfile::Mark("Main window");
+    w.SetPrefetchRate(clpParser.value(cloPrefetchRate).toLongLong() * 1024);
+    w.SetFirmwareHost(clpParser.value(cloFirmwareHost));
+
+    if (clpParser.isSet(cloReplay))
+    {
+        //Offline replay of a recorded session
+        QString strError;
+        if (!clpParser.isSet(cloFile) || !w.StartTraceReplay(clpParser.value(cloReplay), clpParser.value(cloFile), clpParser.value(cloReplaySpeed).toDouble(), &strError))
+        {
+            QTextStream(stderr) << "Unable to replay trace: " << (clpParser.isSet(cloFile) ? strError : QString("--file is required")) << "\n";
+            return EXIT_FAILURE;
+        }
+
+        return a.exec();
+    }
+
+    if (clpParser.isSet(cloRecord) && !w.StartTraceRecording(clpParser.value(cloRecord)))
+    {
+        QTextStream(stderr) << "Unable to create trace file " << clpParser.value(cloRecord) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    if (clpParser.isSet(cloReceive))
+    {
+        //Pull a file from the module
+        QString strError;
+        if (!clpParser.isSet(cloPort) || !w.StartXModemReceive(clpParser.value(cloPort), clpParser.value(cloBaud).toInt(), clpParser.value(cloReceive), clpParser.value(cloReceiveSize).toLongLong(), &strError))
+        {
+            QTextStream(stderr) << "Unable to receive file: " << (clpParser.isSet(cloPort) ? strError : QString("--port is required")) << "\n";
+            return EXIT_FAILURE;
+        }
+
+        return a.exec();
+    }
+
     w.show();
+    StartupProfile::Mark("Show");
+
+    if (clpParser.isSet(cloStartupProfile))
+    {
+        //Exits once the events queued by showing the window (the first paint) have been handled
+        QTextStream tsOutput(stdout);
+        QTimer::singleShot(0, &a, SLOT(quit()));
+        a.exec();
+        StartupProfile::Mark("First frame");
+        return StartupProfile::Report(tsOutput, STARTUP_PROFILE_BUDGET_MS);
+    }
+
+    if (!clpParser.isSet(cloNoHistory))
+    {
+        //Nothing can be flashed before the window is shown, so opening the
+        //database waits until the first frame has been drawn
+        QTimer::singleShot(0, &FlashHistory::Instance(), SLOT(OpenDefault()));
+    }
 
     return a.exec();
 }